@@ -0,0 +1,180 @@
+import { Data, PackedDataset, StriatedPlaneMisfit, striatedPlaneMisfit } from "./data"
+import { HomogeneousEngine } from "./geomeca"
+import { Matrix3x3 } from "./types/math"
+
+/**
+ * @category Inversion
+ */
+export type InteractiveSessionParams = {
+    // Number of bins of the histogram of signed angular deviations over [-180, 180] degrees (default 36)
+    nbBins?: number
+}
+
+/**
+ * @brief Incremental evaluation of a dataset while the user changes the rough stress tensor (interactive phase).
+ *
+ * The dataset is packed once. For the stress tensor S = -s1 s1^T - R s2 s2^T (rows s1, s3, s2 of Hrot), the traction
+ * components on each striated plane are linear in R. Their constant part and their coefficient in R are cached when
+ * the orientation changes (setRotation), so that:
+ * - a change of the stress ratio alone (setStressRatio) only evaluates the R-dependent terms: 3 multiply-adds, a square root
+ *   and a single arctangent per plane (the angular misfit is deduced from the signed deviation, without arccosine),
+ * - a change of the orientation recomputes the cached terms (6 dot products per plane), then updates the results.
+ *
+ * Each update refreshes together the misfit of each datum, the signed angular deviations of the striated planes with
+ * their histogram, and the Mohr positions (normal and shear stresses) of the striated planes.
+ * Rows are ordered as in PackedDataset: the striated planes first, then the other data.
+ *
+ * @example
+ * ```ts
+ * const session = new InteractiveSession(data)
+ * session.update(stressTensor.Rrot, R)
+ * // While the user drags the stress ratio slider
+ * session.setStressRatio(R)
+ * draw(session.misfits, session.histogram, session.normalStress, session.shearStress)
+ * ```
+ * @category Inversion
+ */
+export class InteractiveSession {
+    readonly packed: PackedDataset
+    // Misfit of each datum
+    readonly misfits: Float64Array
+    // Signed angular deviation (degrees) between the measured striation and the computed shear stress of each striated plane,
+    // positive from the striation toward the perpendicular direction (nPerpStriation). In [-90, 90] for non oriented striations
+    readonly deviations: Float64Array
+    // Histogram of the signed angular deviations over [-180, 180] degrees
+    readonly histogram: Uint32Array
+    // Mohr positions of the striated planes (rock mechanics sign convention: compression > 0)
+    readonly normalStress: Float64Array
+    readonly shearStress: Float64Array
+
+    // Per plane: normal stress, shear along the striation and shear along the perpendicular, as (constant, coefficient of R) pairs
+    private tractions: Float64Array
+    private Hrot_: Matrix3x3 = undefined
+    private stressRatio_ = 0
+    private misfit_ = 0
+    private engine = new HomogeneousEngine()
+
+    constructor(data: Data[] | PackedDataset, { nbBins = 36 }: InteractiveSessionParams = {}) {
+        this.packed = data instanceof PackedDataset ? data : new PackedDataset(data)
+        this.packed.striatedPlanes.checkFrictionAngles()
+        const np = this.packed.striatedPlanes.count
+        this.misfits = new Float64Array(this.packed.size)
+        this.deviations = new Float64Array(np)
+        this.histogram = new Uint32Array(Math.max(1, Math.floor(nbBins)))
+        this.normalStress = new Float64Array(np)
+        this.shearStress = new Float64Array(np)
+        this.tractions = new Float64Array(6 * np)
+    }
+
+    get Hrot(): Matrix3x3 {
+        return this.Hrot_
+    }
+
+    get stressRatio(): number {
+        return this.stressRatio_
+    }
+
+    /**
+     * The (weighted) mean misfit of the dataset for the current stress tensor
+     */
+    get misfit(): number {
+        return this.misfit_
+    }
+
+    /**
+     * Change both the orientation and the stress ratio
+     */
+    update(Hrot: Matrix3x3, stressRatio: number): void {
+        this.stressRatio_ = stressRatio
+        this.setRotation(Hrot)
+    }
+
+    /**
+     * Change the orientation of the principal axes (rows sigma_1, sigma_3, sigma_2 of Hrot)
+     */
+    setRotation(Hrot: Matrix3x3): void {
+        this.Hrot_ = Hrot
+        const planes = this.packed.striatedPlanes
+        const T = this.tractions
+        const n = planes.normals, st = planes.striations, pe = planes.perpStriations
+        const ux = Hrot[0][0], uy = Hrot[0][1], uz = Hrot[0][2]
+        const vx = Hrot[2][0], vy = Hrot[2][1], vz = Hrot[2][2]
+
+        for (let i = 0, j = 0, o = 0; i < planes.count; ++i, j += 3, o += 6) {
+            const nx = n[j], ny = n[j + 1], nz = n[j + 2]
+            const sx = st[j], sy = st[j + 1], sz = st[j + 2]
+            const px = pe[j], py = pe[j + 1], pz = pe[j + 2]
+            const un = ux * nx + uy * ny + uz * nz
+            const vn = vx * nx + vy * ny + vz * nz
+            // Traction t = S n = -(u.n) u - R (v.n) v, projected on n, s and p
+            T[o] = -un * un
+            T[o + 1] = -vn * vn
+            T[o + 2] = -un * (ux * sx + uy * sy + uz * sz)
+            T[o + 3] = -vn * (vx * sx + vy * sy + vz * sz)
+            T[o + 4] = -un * (ux * px + uy * py + uz * pz)
+            T[o + 5] = -vn * (vx * px + vy * py + vz * pz)
+        }
+
+        this.refresh()
+    }
+
+    /**
+     * Change the stress ratio only (the cached traction terms are reused)
+     */
+    setStressRatio(stressRatio: number): void {
+        if (this.Hrot_ === undefined) {
+            throw new Error('The orientation of the stress tensor must be set before the stress ratio (see setRotation)')
+        }
+        this.stressRatio_ = stressRatio
+        this.refresh()
+    }
+
+    private refresh(): void {
+        const planes = this.packed.striatedPlanes
+        const T = this.tractions
+        const R = this.stressRatio_
+        const nbBins = this.histogram.length
+        const toDegrees = 180 / Math.PI
+        this.histogram.fill(0)
+
+        let sum = 0
+        for (let i = 0, o = 0; i < planes.count; ++i, o += 6) {
+            const sn = T[o] + R * T[o + 1]
+            const ts = T[o + 2] + R * T[o + 3]
+            const tp = T[o + 4] + R * T[o + 5]
+            const tm = Math.sqrt(ts * ts + tp * tp)
+
+            // Signed angle from the striation to the shear stress, folded to [-PI/2, PI/2] when the sense of the striation is unknown
+            let angle = Math.atan2(tp, ts)
+            if (planes.oriented[i] === 0) {
+                if (angle > Math.PI / 2) angle -= Math.PI
+                else if (angle < -Math.PI / 2) angle += Math.PI
+            }
+
+            const kind = planes.kind[i]
+            const misfit = kind === StriatedPlaneMisfit.ANGLE && tm > 0
+                // Same as the arccosine of the cosine of the angle (see striatedPlaneMisfit)
+                ? Math.abs(angle)
+                : striatedPlaneMisfit(
+                    kind, planes.oriented[i] === 1, sn, ts, tp, tm,
+                    planes.cohesion[i], planes.frictionAngle[i], planes.frictionWeight[i])
+            this.misfits[i] = misfit
+            sum += planes.weights[i] * misfit
+
+            const deviation = angle * toDegrees
+            this.deviations[i] = deviation
+            const bin = Math.floor((deviation + 180) * nbBins / 360)
+            this.histogram[bin < 0 ? 0 : bin >= nbBins ? nbBins - 1 : bin]++
+
+            this.normalStress[i] = -sn
+            this.shearStress[i] = tm
+        }
+
+        if (this.packed.nbOthers > 0) {
+            this.engine.setHypotheticalStress(this.Hrot_, R)
+            sum += this.packed.othersCost(this.engine.stress(undefined), this.misfits, planes.count)
+        }
+
+        this.misfit_ = this.packed.totalWeight === 0 ? 0 : sum / this.packed.totalWeight
+    }
+}
@@ -1,8 +1,27 @@
 import { SearchMethod } from "./search/SearchMethod"
 import { cloneMatrix3x3, Matrix3x3, newMatrix3x3, newMatrix3x3Identity, Vector3 } from "./types/math"
-import { Data } from "./data"
-import { MonteCarlo } from "./search"
-import { HypotheticalSolutionTensorParameters } from "./geomeca"
+import { Data } from "./data/Data"
+import { EvaluationCache } from "./data/EvaluationCache"
+import { MisfitObjective } from "./data/MisfitObjective"
+import { PackedDataset } from "./data/PackedDataset"
+import { MonteCarlo } from "./search/MonteCarlo"
+import { HypotheticalSolutionTensorParameters } from "./geomeca/HypotheticalSolutionTensorParameters"
+
+/**
+ * @brief Rock parameters found by a joint stress/friction inversion (see MonteCarloFriction)
+ * @category Inversion
+ */
+export type FrictionSolution = {
+    cohesion: number,
+    frictionAngle: number,
+    // Sampled cohesions (rows of the misfit slice)
+    cohesions: Float64Array,
+    // Sampled friction angles in radians (columns of the misfit slice)
+    frictionAngles: Float64Array,
+    // Mean misfit over (cohesion, friction angle) for the best stress tensor:
+    // misfits[i * frictionAngles.length + j]
+    misfits: Float64Array
+}
 
 /**
  * @category Inversion
@@ -13,7 +32,10 @@ export type MisfitCriteriunSolution = {
     rotationMatrixW: Matrix3x3,
     rotationMatrixD: Matrix3x3,
     stressRatio: number,
-    stressTensorSolution: Matrix3x3
+    stressTensorSolution: Matrix3x3,
+    friction?: FrictionSolution,
+    // Proven lower bound of the misfit over the search domain, if the search method provides one (see BranchAndBound)
+    lowerBound?: number
 }
 
 /**
@@ -26,7 +48,15 @@ export function cloneMisfitCriteriunSolution(misfitCriteriunSolution: MisfitCrit
         rotationMatrixW: cloneMatrix3x3(misfitCriteriunSolution.rotationMatrixW),
         rotationMatrixD: cloneMatrix3x3(misfitCriteriunSolution.rotationMatrixD),
         stressRatio: misfitCriteriunSolution.stressRatio,
-        stressTensorSolution: misfitCriteriunSolution.stressTensorSolution
+        stressTensorSolution: misfitCriteriunSolution.stressTensorSolution,
+        friction: misfitCriteriunSolution.friction === undefined ? undefined : {
+            cohesion: misfitCriteriunSolution.friction.cohesion,
+            frictionAngle: misfitCriteriunSolution.friction.frictionAngle,
+            cohesions: misfitCriteriunSolution.friction.cohesions.slice(),
+            frictionAngles: misfitCriteriunSolution.friction.frictionAngles.slice(),
+            misfits: misfitCriteriunSolution.friction.misfits.slice()
+        },
+        lowerBound: misfitCriteriunSolution.lowerBound
     }
 }
 
@@ -56,6 +86,9 @@ export class InverseMethod {
     }
     private searchMethod_: SearchMethod = new MonteCarlo()
     private data_:  Data[] = []
+    private objective_: MisfitObjective = undefined
+    private cache_: EvaluationCache = undefined
+    private singlePrecision_ = false
 
     get data() {
         return this.data_
@@ -77,6 +110,30 @@ export class InverseMethod {
         this.searchMethod_ = search
     }
 
+    /**
+     * Set a robust reduction of the per-datum misfits (see MisfitObjective). The search method must implement runPacked.
+     * Set undefined to use the mean misfit again.
+     */
+    setObjective(objective: MisfitObjective) {
+        this.objective_ = objective
+    }
+
+    /**
+     * Memoize the misfits evaluated by the search method (see EvaluationCache). The search method must implement runPacked.
+     * The cache is cleared at each run. Set undefined to remove the cache.
+     */
+    setEvaluationCache(cache: EvaluationCache) {
+        this.cache_ = cache
+    }
+
+    /**
+     * Rank the trials of the search in single precision (see PackedDataset.setSinglePrecision). The search method must implement runPacked.
+     * The misfit of the solution is evaluated again in double precision.
+     */
+    setSinglePrecision(enabled: boolean) {
+        this.singlePrecision_ = enabled
+    }
+
     addData(data: Data | Data[]) {
         if (Array.isArray(data)) {
             data.forEach( d => this.data_.push(d) )
@@ -94,6 +151,21 @@ export class InverseMethod {
             this.misfitCriteriunSolution.misfit  = Number.POSITIVE_INFINITY
         }
 
+        if (this.objective_ !== undefined || this.cache_ !== undefined || this.singlePrecision_) {
+            if (this.searchMethod_.runPacked === undefined) {
+                throw new Error('The search method does not support robust objectives, evaluation caches nor single precision')
+            }
+            const packed = new PackedDataset(this.data_, { objective: this.objective_, singlePrecision: this.singlePrecision_ })
+            packed.setCache(this.cache_)
+            const solution = this.searchMethod_.runPacked(packed, this.misfitCriteriunSolution)
+            if (this.singlePrecision_ && Number.isFinite(solution.misfit)) {
+                const engine = this.searchMethod_.getEngine()
+                engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+                solution.misfit = packed.exactCost(engine)
+            }
+            return solution
+        }
+
         return this.searchMethod_.run(this.data_, this.misfitCriteriunSolution)
     }
 
@@ -0,0 +1,191 @@
+import { PackedDataset } from "./data"
+import { cloneMisfitCriteriunSolution, createDefaultSolution, InverseMethod, MisfitCriteriunSolution } from "./InverseMethod"
+import { MonteCarlo } from "./search"
+import { SearchMethod } from "./search/SearchMethod"
+
+/**
+ * @brief Down-weighting of a datum according to its misfit m for the solution of the previous round
+ * @category Inversion
+ */
+export enum ReweightingFunction {
+    // Weight 1 below the threshold c, 0 above (rejection of the outliers)
+    THRESHOLD,
+    // Weight 1 below c, c / m above
+    HUBER,
+    // Tukey's biweight: (1 - (m / c)^2)^2 below c, 0 above
+    BISQUARE,
+    // 1 / (1 + (m / c)^2)
+    CAUCHY
+}
+
+/**
+ * @category Inversion
+ */
+export type IterativeReweightingParams = {
+    // The threshold c of the reweighting function, in the unit of the misfits
+    threshold: number,
+    weighting?: ReweightingFunction,
+    // Maximum number of rounds, including the first (cold) inversion
+    maxRounds?: number,
+    // The loop stops when no weight changes by more than tolerance from one round to the next
+    tolerance?: number,
+    // Prior weight of each datum (same order as the data), multiplied by the reweighting function. Default is 1
+    weights?: ArrayLike<number>,
+    // Search of the warm rounds, seeded with the previous solution (see SearchMethod.setInteractiveSolution).
+    // It should explore a narrow interval with a few trials. Default is a MonteCarlo of 250 trials
+    // in a cone of 10° and a stress ratio interval of ±0.1
+    refineSearch?: SearchMethod
+}
+
+/**
+ * @category Inversion
+ */
+export type ReweightingRound = {
+    // The solution of the round, its misfit being the weighted mean misfit with the weights of the round
+    solution: MisfitCriteriunSolution,
+    // The weights used by the round (same order as the data)
+    weights: Float64Array,
+    // The largest change of a weight from the previous round (0 for the first round)
+    maxWeightChange: number
+}
+
+/**
+ * @category Inversion
+ */
+export type ReweightedSolution = {
+    solution: MisfitCriteriunSolution,
+    // One entry per round: the trajectory of the weights
+    rounds: ReweightingRound[],
+    // True if the weights stabilised before maxRounds
+    converged: boolean
+}
+
+/**
+ * @brief Iteratively reweighted inversion (IRLS): invert, down-weight the data with a large misfit, and invert again
+ * until the weights stabilise.
+ *
+ * The data are packed once. The first round is a full (cold) run of the search method of the InverseMethod. Each next round
+ * updates the weight columns in place (see PackedDataset.setWeights) and runs the refine search around the previous solution,
+ * starting from the previous solution itself re-evaluated with the new weights, so that the misfit of a round can only
+ * improve on it. With the default refine search, the whole loop costs about two cold inversions of 1000 trials.
+ *
+ * @example
+ * ```ts
+ * const inv = new InverseMethod()
+ * inv.addData(data)
+ * inv.setSearchMethod(new MonteCarlo({ nbRandomTrials: 2000 }))
+ * const irls = new IterativeReweightedInversion(inv, { threshold: 20 * Math.PI / 180, weighting: ReweightingFunction.BISQUARE })
+ * const { solution, rounds } = irls.run()
+ * ```
+ * @category Inversion
+ */
+export class IterativeReweightedInversion {
+    private inverse: InverseMethod
+    private threshold: number
+    private weighting: ReweightingFunction
+    private maxRounds: number
+    private tolerance: number
+    private priors: Float64Array = undefined
+    private refineSearch: SearchMethod
+
+    constructor(inverse: InverseMethod, {
+        threshold, weighting = ReweightingFunction.BISQUARE, maxRounds = 10, tolerance = 1e-2, weights = undefined, refineSearch = undefined
+    }: IterativeReweightingParams) {
+        if (!(threshold > 0)) {
+            throw new Error(`The threshold of the reweighting must be positive (got ${threshold})`)
+        }
+        if (maxRounds < 1) {
+            throw new Error(`The number of rounds must be at least 1 (got ${maxRounds})`)
+        }
+        this.inverse = inverse
+        this.threshold = threshold
+        this.weighting = weighting
+        this.maxRounds = maxRounds
+        this.tolerance = tolerance
+        if (weights !== undefined) {
+            this.priors = Float64Array.from(weights)
+        }
+        this.refineSearch = refineSearch ?? new MonteCarlo({
+            nbRandomTrials: 250,
+            rotAngleHalfInterval: 10 * Math.PI / 180,
+            stressRatioHalfInterval: 0.1
+        })
+    }
+
+    run(): ReweightedSolution {
+        const data = this.inverse.data
+        const n = data.length
+        if (n === 0) {
+            throw new Error('No data provided')
+        }
+        if (this.priors !== undefined && this.priors.length !== n) {
+            throw new Error(`The number of weights (got ${this.priors.length}) should be the number of data (got ${n})`)
+        }
+
+        const search = this.inverse.searchMethod
+        if (search.runPacked === undefined || this.refineSearch.runPacked === undefined) {
+            throw new Error('The iterative reweighting requires search methods working on packed data (runPacked)')
+        }
+        const engine = search.getEngine()
+        this.refineSearch.setEngine(engine)
+
+        let weights = this.priors === undefined ? new Float64Array(n).fill(1) : this.priors.slice()
+        const packed = new PackedDataset(data, { weights })
+
+        // Cold round
+        let solution = search.runPacked(packed, createDefaultSolution())
+        const rounds: ReweightingRound[] = [{ solution, weights, maxWeightChange: 0 }]
+
+        const misfits = new Float64Array(n)
+        let converged = false
+        while (rounds.length < this.maxRounds) {
+            engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+            packed.costs(engine, misfits)
+
+            const next = new Float64Array(n)
+            let change = 0
+            for (let i = 0; i < n; ++i) {
+                const k = packed.packedOrder[i]
+                next[k] = (this.priors === undefined ? 1 : this.priors[k]) * this.weight(misfits[i])
+                change = Math.max(change, Math.abs(next[k] - weights[k]))
+            }
+            if (change <= this.tolerance) {
+                converged = true
+                break
+            }
+            packed.setWeights(next)
+            if (packed.totalWeight === 0) {
+                throw new Error('All the data are rejected by the reweighting (increase the threshold)')
+            }
+            weights = next
+
+            // Warm round: the previous solution is the incumbent, with its misfit for the new weights
+            const incumbent = cloneMisfitCriteriunSolution(solution)
+            incumbent.misfit = packed.cost(engine)
+            this.refineSearch.setInteractiveSolution({ rot: solution.rotationMatrixW, stressRatio: solution.stressRatio })
+            solution = this.refineSearch.runPacked(packed, incumbent)
+            rounds.push({ solution, weights, maxWeightChange: change })
+        }
+
+        return { solution, rounds, converged }
+    }
+
+    private weight(m: number): number {
+        const c = this.threshold
+        switch (this.weighting) {
+            case ReweightingFunction.THRESHOLD:
+                return m <= c ? 1 : 0
+            case ReweightingFunction.HUBER:
+                return m <= c ? 1 : c / m
+            case ReweightingFunction.CAUCHY:
+                return 1 / (1 + (m / c) * (m / c))
+            default: {
+                if (m >= c) {
+                    return 0
+                }
+                const u = 1 - (m / c) * (m / c)
+                return u * u
+            }
+        }
+    }
+}
@@ -0,0 +1,339 @@
+import { Data } from "./data/Data"
+import { PackedDataset } from "./data/PackedDataset"
+import { SpatialIndex } from "./data/SpatialIndex"
+import { createDefaultSolution, MisfitCriteriunSolution } from "./InverseMethod"
+import { SearchMethodFactory } from "./search/Factory"
+import { SearchMethod } from "./search/SearchMethod"
+import { SearchWorkers } from "./search/SearchWorkers"
+import { Matrix3x3, newMatrix3x3, Point3D } from "./types/math"
+
+/* eslint @typescript-eslint/no-explicit-any: off -- need to have any here for the parameters of the search methods */
+
+/**
+ * @brief Weighting of the data inside a window
+ * @category Inversion
+ */
+export enum WindowTaper {
+    // Weight 1 for all the data inside the window
+    UNIFORM,
+    // Weight exp(-d^2 / (2 sigma^2)) with sigma = radius / 2, where d is the distance to the center of the window
+    GAUSSIAN
+}
+
+/**
+ * @category Inversion
+ */
+export type SlidingWindowParams = {
+    // Radius of the windows
+    radius: number,
+    taper?: WindowTaper,
+    // Windows with less data are skipped
+    minData?: number,
+    // Seed the search of a window with the solution of the previous one
+    seed?: boolean,
+    // Cell size of the spatial index (see SpatialIndex)
+    cellSize?: number,
+    // With workers, number of consecutive windows run by a worker, seeded from one another (see setWorkers). Default is 8
+    stripLength?: number
+}
+
+/**
+ * @category Inversion
+ */
+export type WindowSolution = {
+    center: Point3D,
+    // Number of data inside the window
+    nbData: number,
+    // Undefined if the window has less than minData data
+    solution: MisfitCriteriunSolution
+}
+
+/**
+ * @brief Local inversions of the stress tensor in moving windows over the positions of the data (stress maps).
+ *
+ * The positions of the data are indexed once (see SpatialIndex). For each window, the data inside the window are selected
+ * by the index and packed with their weights (see WindowTaper), so that the trials of a window only evaluate its own data:
+ * a window of n data costs O(n) per trial, plus O(n) once for packing, whatever the size of the dataset.
+ *
+ * When seeding is enabled (default), the search of a window starts around the solution of the previous window
+ * (see SearchMethod.setInteractiveSolution), so consecutive windows should be neighbors (see windowCenters), and the
+ * search method should be set with a reduced search interval (e.g., rotAngleHalfInterval for MonteCarlo).
+ *
+ * The windows are run in the calling thread, or by workers (see setWorkers): the centers are then split in strips of
+ * stripLength consecutive windows, each strip being run by one worker and seeded independently. The data are then packed once
+ * in shared buffers, and each worker copies the rows of its windows out of the shared columns (see PackedDataset.subsetPacked).
+ *
+ * @example
+ * ```ts
+ * const search = new MonteCarlo({ nbRandomTrials: 2000, rotAngleHalfInterval: Math.PI / 6 })
+ * const sliding = new SlidingWindowInversion(data, search, { radius: 500, taper: WindowTaper.GAUSSIAN })
+ * const centers = windowCenters([0, 0, 0], [10000, 10000, 0], [21, 21, 1])
+ * const solutions = sliding.run(centers)
+ * ```
+ * @category Inversion
+ */
+export class SlidingWindowInversion {
+    readonly index: SpatialIndex
+    private searchMethod: SearchMethod
+    private radius: number
+    private taper: WindowTaper
+    private minData: number
+    private seed: boolean
+    private stripLength: number
+    private previous: MisfitCriteriunSolution = undefined
+    private ids: number[] = []
+    private weights: number[] = []
+    private packed: PackedDataset = undefined
+    private workers: SearchWorkers = undefined
+    private workersSearch: { method: string, params?: any } = undefined
+
+    constructor(data: Data[], searchMethod: SearchMethod, { radius, taper = WindowTaper.UNIFORM, minData = 1, seed = true, cellSize = undefined, stripLength = 8 }: SlidingWindowParams) {
+        if (!(radius > 0)) {
+            throw new Error(`The radius of the windows must be positive (got ${radius})`)
+        }
+        if (!(stripLength >= 1)) {
+            throw new Error(`The strips of windows must have at least one window (got ${stripLength})`)
+        }
+        this.index = new SpatialIndex(data, cellSize)
+        this.searchMethod = searchMethod
+        this.radius = radius
+        this.taper = taper
+        this.minData = Math.max(1, minData)
+        this.seed = seed
+        this.stripLength = Math.floor(stripLength)
+    }
+
+    /**
+     * @brief Run the windows of run() with workers (undefined to run them in the calling thread).
+     * Each worker creates its own search method, so the method is given by its name in SearchMethodFactory and its
+     * parameters (e.g., the same parameters as the search method given at construction). The data are then packed with
+     * the shared option, and must be of packed types (see PackedDataset.share).
+     * @param workers The workers
+     * @param search The name and the parameters of the search method of the workers
+     */
+    setWorkers(workers: SearchWorkers, search: { method: string, params?: any } = undefined): void {
+        if (workers !== undefined && (search === undefined || search.method === undefined)) {
+            throw new Error('The workers of the sliding windows require the name of a search method (see SearchMethodFactory)')
+        }
+        if (workers === undefined) {
+            this.packed = undefined
+        }
+        this.workers = workers
+        this.workersSearch = search
+    }
+
+    /**
+     * Forget the solution of the previous window (the next window is not seeded)
+     */
+    resetSeed() {
+        this.previous = undefined
+    }
+
+    /**
+     * Run the inversion of each window, in the given order (by strips with workers, see setWorkers)
+     */
+    run(centers: Point3D[]): WindowSolution[] {
+        if (this.workers === undefined) {
+            return centers.map(center => this.runWindow(center))
+        }
+
+        const L = this.stripLength
+        const count = Math.ceil(centers.length / L)
+        const inputs = new Float64Array(count * (1 + 3 * L))
+        centers.forEach((center, i) => {
+            const strip = Math.floor(i / L) * (1 + 3 * L)
+            inputs[strip]++
+            inputs.set(center, strip + 1 + 3 * (i % L))
+        })
+        const outputs = new Float64Array(count * L * WINDOW)
+        const params: WindowsTaskParams = {
+            radius: this.radius, taper: this.taper, minData: this.minData, seed: this.seed, cellSize: this.index.cellSize,
+            method: this.workersSearch.method, params: this.workersSearch.params
+        }
+        this.workers.run(this.packedDataset(), 'Sliding Window', params, inputs, count, outputs)
+
+        // The strips are contiguous in the outputs
+        return centers.map((center, i) => {
+            const solution = readWindow(outputs.subarray(i * WINDOW, (i + 1) * WINDOW))
+            if (solution !== undefined) {
+                this.previous = solution
+            }
+            return { center: [...center] as Point3D, nbData: outputs[i * WINDOW + NB_DATA], solution }
+        })
+    }
+
+    /**
+     * Run the inversion of the window centered at center, in the calling thread
+     */
+    runWindow(center: Point3D): WindowSolution {
+        const nbData = windowWeights(this.index, center, this.radius, this.taper, this.ids, this.weights)
+        if (nbData < this.minData) {
+            return { center: [...center] as Point3D, nbData, solution: undefined }
+        }
+
+        if (this.seed && this.previous !== undefined) {
+            this.searchMethod.setInteractiveSolution({ rot: this.previous.rotationMatrixW, stressRatio: this.previous.stressRatio })
+        }
+
+        let solution: MisfitCriteriunSolution
+        if (this.searchMethod.runPacked !== undefined) {
+            const packed = new PackedDataset(this.ids.map(i => this.index.data[i]), { weights: this.weights })
+            solution = this.searchMethod.runPacked(packed, createDefaultSolution())
+        } else if (this.taper === WindowTaper.UNIFORM) {
+            solution = this.searchMethod.run(this.ids.map(i => this.index.data[i]), createDefaultSolution())
+        } else {
+            throw new Error('Tapered windows require a search method working on packed data (runPacked)')
+        }
+
+        this.previous = solution
+        return { center: [...center] as Point3D, nbData, solution }
+    }
+
+    // The data packed once in shared buffers for the workers
+    private packedDataset(): PackedDataset {
+        if (this.packed === undefined) {
+            this.packed = new PackedDataset(this.index.data, { shared: true })
+        }
+        return this.packed
+    }
+}
+
+/**
+ * @brief Centers of a regular grid of windows inside the box [min, max], ordered as a serpentine (boustrophedon)
+ * so that two consecutive windows are always neighbors (see seeding in SlidingWindowInversion).
+ * @param min The first corner of the box
+ * @param max The second corner of the box
+ * @param counts The number of windows along each axis
+ * @category Inversion
+ */
+export function windowCenters(min: Point3D, max: Point3D, counts: [number, number, number]): Point3D[] {
+    const coord = (k: number, i: number) => counts[k] <= 1 ? (min[k] + max[k]) / 2 : min[k] + i * (max[k] - min[k]) / (counts[k] - 1)
+
+    const centers: Point3D[] = []
+    let row = 0
+    for (let k = 0; k < counts[2]; ++k) {
+        for (let jj = 0; jj < counts[1]; ++jj) {
+            // Reverse every other layer and every other row
+            const j = k % 2 === 0 ? jj : counts[1] - 1 - jj
+            for (let ii = 0; ii < counts[0]; ++ii) {
+                const i = row % 2 === 0 ? ii : counts[0] - 1 - ii
+                centers.push([coord(0, i), coord(1, j), coord(2, k)])
+            }
+            row++
+        }
+    }
+    return centers
+}
+
+// --------------- Hidden to users
+
+/**
+ * Select the data inside the window and their weights (see WindowTaper)
+ * @param ids Receives the indices of the data inside the window
+ * @param weights Receives the weight of each datum of ids
+ * @returns The number of data inside the window
+ */
+function windowWeights(index: SpatialIndex, center: Point3D, radius: number, taper: WindowTaper, ids: number[], weights: number[]): number {
+    index.queryRadius(center, radius, ids)
+    // sigma = radius / 2
+    const f = -2 / (radius * radius)
+    weights.length = ids.length
+    ids.forEach((i, k) => weights[k] = taper === WindowTaper.UNIFORM ? 1 : Math.exp(f * index.distance2(i, center)))
+    return ids.length
+}
+
+// Layout of the output of a window in the strips run by the workers
+const NB_DATA = 0
+const MISFIT = 1
+const STRESS_RATIO = 2
+const LOWER_BOUND = 3
+const W = 4
+const D = 13
+const S = 22
+const WINDOW = 31
+
+export type WindowsTaskParams = {
+    radius: number,
+    taper: WindowTaper,
+    minData: number,
+    seed: boolean,
+    cellSize: number,
+    method: string,
+    params: any
+}
+
+function writeMatrix(m: Matrix3x3, out: Float64Array, offset: number): void {
+    for (let i = 0; i < 3; ++i) {
+        for (let j = 0; j < 3; ++j) {
+            out[offset + 3 * i + j] = m[i][j]
+        }
+    }
+}
+
+function readMatrix(values: Float64Array, offset: number): Matrix3x3 {
+    const m = newMatrix3x3()
+    for (let i = 0; i < 3; ++i) {
+        for (let j = 0; j < 3; ++j) {
+            m[i][j] = values[offset + 3 * i + j]
+        }
+    }
+    return m
+}
+
+// Undefined for a skipped window (NaN misfit)
+function readWindow(out: Float64Array): MisfitCriteriunSolution {
+    if (Number.isNaN(out[MISFIT])) {
+        return undefined
+    }
+    return {
+        misfit: out[MISFIT],
+        rotationMatrixW: readMatrix(out, W),
+        rotationMatrixD: readMatrix(out, D),
+        stressRatio: out[STRESS_RATIO],
+        stressTensorSolution: readMatrix(out, S),
+        lowerBound: Number.isNaN(out[LOWER_BOUND]) ? undefined : out[LOWER_BOUND]
+    }
+}
+
+// The spatial index of the positions of each attached dataset, in the workers
+const indices = new WeakMap<PackedDataset, SpatialIndex>()
+
+/**
+ * The task of the workers (see SearchTasks): a strip of consecutive windows of SlidingWindowInversion.run, seeded from
+ * one another. The input is the number of windows followed by their centers, the output has WINDOW values per window.
+ * The rows of each window are copied out of the attached dataset (see PackedDataset.subsetPacked).
+ */
+export function runWindowsTask(packed: PackedDataset, params: WindowsTaskParams, input: Float64Array, output: Float64Array): void {
+    let index = indices.get(packed)
+    if (index === undefined || index.cellSize !== params.cellSize) {
+        index = new SpatialIndex(packed.positions, params.cellSize)
+        indices.set(packed, index)
+    }
+    const search = SearchMethodFactory.create(params.method, params.params)
+    if (search === undefined || search.runPacked === undefined) {
+        throw new Error(`The search method "${params.method}" cannot run the windows in workers (runPacked)`)
+    }
+
+    const ids: number[] = []
+    const weights: number[] = []
+    let previous: MisfitCriteriunSolution = undefined
+    for (let w = 0; w < input[0]; ++w) {
+        const center: Point3D = [input[1 + 3 * w], input[2 + 3 * w], input[3 + 3 * w]]
+        const out = output.subarray(w * WINDOW, (w + 1) * WINDOW)
+        out[NB_DATA] = windowWeights(index, center, params.radius, params.taper, ids, weights)
+        if (out[NB_DATA] < params.minData) {
+            out[MISFIT] = Number.NaN
+            continue
+        }
+        if (params.seed && previous !== undefined) {
+            search.setInteractiveSolution({ rot: previous.rotationMatrixW, stressRatio: previous.stressRatio })
+        }
+        previous = search.runPacked(packed.subsetPacked(ids, weights), createDefaultSolution())
+        out[MISFIT] = previous.misfit
+        out[STRESS_RATIO] = previous.stressRatio
+        out[LOWER_BOUND] = previous.lowerBound === undefined ? Number.NaN : previous.lowerBound
+        writeMatrix(previous.rotationMatrixW, out, W)
+        writeMatrix(previous.rotationMatrixD, out, D)
+        writeMatrix(previous.stressTensorSolution, out, S)
+    }
+}
@@ -0,0 +1,89 @@
+import { Data, PackedDataset } from "../data"
+import { computeTractions, createTractionColumns, TractionColumns } from "../geomeca/TractionKernel"
+import { MisfitCriteriunSolution } from "../InverseMethod"
+
+/**
+ * @brief Positions of the data of a dataset on the normalized Mohr diagram, plus the geometry of the 3 Mohr circles.
+ *
+ * The diagram follows the rock mechanics sign convention (compression > 0) and is normalized such that
+ * sigma_3 = 0, sigma_2 = R (the stress ratio) and sigma_1 = 1.
+ * @category Domain
+ */
+export type MohrPointCloud = {
+    // Number of points
+    count: number,
+    // Packed pairs (sigma_n, tau): the point of row i is (points[2i], points[2i+1])
+    points: Float32Array,
+    // Packed pairs (center, radius) of the Mohr circles 3_1, 3_2 and 2_1 (in this order)
+    circles: Float32Array,
+    // Indices in the dataset of the data which are not striated planes, hence not placed on the diagram
+    skipped: Int32Array
+}
+
+/**
+ * @brief Place every striated plane of a dataset on the normalized Mohr diagram, in one pass and without string building
+ * (see mohrCirclePoint for the GOCAD output of a single element).
+ *
+ * The traction components of all the planes are computed by the batched kernel (see computeTractions), then converted
+ * into single precision pairs (sigma_n, tau), which can be uploaded as is into a vertex buffer.
+ * Rows are ordered as in PackedDataset (striated planes only). The other data types have no point on the diagram:
+ * they are skipped and their indices are reported in skipped.
+ *
+ * The tractions are computed into a scratch of this module, grown when needed, so the scratch of the packed dataset
+ * is left untouched (e.g., while a search runs on the same dataset) and repeated calls do not allocate.
+ *
+ * @param solution The stress solution (stressTensorSolution has the principal values -1, 0 and -stressRatio, as returned by the search methods)
+ * @param data The dataset, packed or not
+ * @param out Optional cloud to fill (reused when large enough)
+ * @example
+ * ```ts
+ * const packed = new PackedDataset(data)
+ * const cloud = mohrPointCloud(inv.run(), packed)
+ * draw(cloud.points, cloud.count, cloud.circles)
+ * ```
+ * @category Domain
+ */
+export function mohrPointCloud(
+    solution: Pick<MisfitCriteriunSolution, 'stressTensorSolution' | 'stressRatio'>,
+    data: Data[] | PackedDataset, out: MohrPointCloud = undefined): MohrPointCloud
+{
+    const packed = data instanceof PackedDataset ? data : new PackedDataset(data)
+    const planes = packed.striatedPlanes
+    const n = planes.count
+
+    if (out === undefined || out.points.length < 2 * n) {
+        out = { count: n, points: new Float32Array(2 * n), circles: new Float32Array(6), skipped: undefined }
+    }
+    out.count = n
+    // The others follow the striated planes in the packed order (an attached dataset has no order: its rows are reported)
+    out.skipped = packed.packedOrder.length === packed.size
+        ? packed.packedOrder.subarray(n)
+        : Int32Array.from({ length: packed.nbOthers }, (_, i) => n + i)
+
+    const R = solution.stressRatio
+    const c = out.circles
+    c[0] = 0.5; c[1] = 0.5                      // 3_1
+    c[2] = R / 2; c[3] = R / 2                  // 3_2
+    c[4] = (1 + R) / 2; c[5] = (1 - R) / 2      // 2_1
+
+    if (scratch.normalStress.length < n) {
+        scratch = createTractionColumns(n)
+    }
+    const t = scratch
+    computeTractions(solution.stressTensorSolution, planes.normals, planes.striations, planes.perpStriations, t, n)
+
+    const sn = t.normalStress
+    const tau = t.shearMag
+    const points = out.points
+    for (let i = 0, j = 0; i < n; ++i, j += 2) {
+        points[j] = -sn[i]
+        points[j + 1] = tau[i]
+    }
+
+    return out
+}
+
+// --------------- Hidden to users
+
+// Traction scratch shared by the calls, grown when needed
+let scratch: TractionColumns = createTractionColumns(0)
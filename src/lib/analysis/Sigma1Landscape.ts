@@ -0,0 +1,358 @@
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { striatedPlaneMisfit } from "../data/PackedStriatedPlanes"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { Matrix3x3, newMatrix3x3, Vector3 } from "../types"
+
+/**
+ * @category Domain
+ */
+export type Sigma1LandscapeParams = {
+    // Angular size of the cells at the center of the stereonet, in degrees (default 2)
+    resolution?: number,
+    // Number of rotations of sigma_3 around sigma_1 in [0, PI) for the coarse scan (default 8)
+    nbRotations?: number,
+    // Number of stress ratios in [0, 1] for the coarse scan (default 3)
+    nbStressRatios?: number,
+    // Number of local refinement levels around the best node of the coarse scan (default 4)
+    refinements?: number
+}
+
+/**
+ * @brief Packed raster of a Sigma1Landscape: cell (i, j) is at index i + j * size,
+ * where i increases toward the East and j toward the North. Cells outside the stereonet are NaN.
+ * @category Domain
+ */
+export type Sigma1Raster = {
+    size: number,
+    // Best misfit over the sigma_3 rotation and the stress ratio
+    misfits: Float32Array,
+    // Rotation angle of sigma_3 around sigma_1 of the best misfit (radians, see Sigma1Landscape.rotation)
+    rotations: Float32Array,
+    // Stress ratio of the best misfit
+    stressRatios: Float32Array
+}
+
+/**
+ * @brief Misfit landscape over the orientations of sigma_1: for each cell of a lower hemisphere equal-area (Schmidt)
+ * stereonet, the misfit of the dataset is minimized over the rotation of sigma_3 around sigma_1 and over the stress ratio.
+ *
+ * For a given orientation, the stress tensor S = -s1 s1^T - R s2 s2^T is linear in R, and the traction components on the
+ * striated planes are linear combinations of the projections of the principal directions. These projections are computed once
+ * per cell (sigma_1), so that each (rotation, R) only involves a few multiply-adds per plane.
+ * Each cell is minimized by a coarse scan over (rotation, R) followed by a local refinement around the best node.
+ * The data which are not striated planes are evaluated with their own cost() method.
+ *
+ * The cells are independent: runCells allows to split the raster between several workers, each filling a range of cells
+ * of a shared raster. Sigma1LandscapePool (lib/server, Node.js only) does so with a pool of worker threads.
+ *
+ * @example
+ * ```ts
+ * const landscape = new Sigma1Landscape(data, { resolution: 2 })
+ * const raster = landscape.run()
+ * // Best stress tensor for the cell c
+ * const Hrot = landscape.rotation(c, raster.rotations[c])
+ * const R = raster.stressRatios[c]
+ * ```
+ * @category Domain
+ */
+export class Sigma1Landscape {
+    readonly packed: PackedDataset
+    readonly size: number
+    private nbRotations: number
+    private refinements: number
+    private cosRot: Float64Array
+    private sinRot: Float64Array
+    private stressRatios: Float64Array
+    private projections: Float64Array
+    private sums: Float64Array
+    private engine = new HomogeneousEngine()
+
+    constructor(data: Data[] | PackedDataset, { resolution = 2, nbRotations = 8, nbStressRatios = 3, refinements = 4 }: Sigma1LandscapeParams = {}) {
+        if (!(resolution > 0)) {
+            throw new Error(`The resolution of the stereonet must be positive (got ${resolution})`)
+        }
+        this.packed = data instanceof PackedDataset ? data : new PackedDataset(data)
+
+        // Near the center of the Schmidt net, d(radius)/d(angle) = 1/sqrt(2) for a unit net
+        this.size = Math.max(1, Math.ceil(2 * Math.SQRT2 / (resolution * Math.PI / 180)))
+
+        this.nbRotations = Math.max(1, Math.floor(nbRotations))
+        this.refinements = Math.max(0, Math.floor(refinements))
+        this.cosRot = new Float64Array(this.nbRotations)
+        this.sinRot = new Float64Array(this.nbRotations)
+        for (let k = 0; k < this.nbRotations; ++k) {
+            this.cosRot[k] = Math.cos(k * Math.PI / this.nbRotations)
+            this.sinRot[k] = Math.sin(k * Math.PI / this.nbRotations)
+        }
+
+        const nr = Math.max(1, Math.floor(nbStressRatios))
+        this.stressRatios = new Float64Array(nr)
+        for (let j = 0; j < nr; ++j) {
+            this.stressRatios[j] = nr === 1 ? 0.5 : j / (nr - 1)
+        }
+
+        this.packed.striatedPlanes.checkFrictionAngles()
+        this.projections = new Float64Array(9 * this.packed.striatedPlanes.count)
+        this.sums = new Float64Array(nr)
+    }
+
+    get nbCells(): number {
+        return this.size * this.size
+    }
+
+    /**
+     * Allocate a raster for this landscape (all the cells are NaN)
+     * @param shared Allocate the raster in SharedArrayBuffers, so that several workers can fill it (see Sigma1LandscapePool)
+     */
+    createRaster(shared: boolean = false): Sigma1Raster {
+        const n = this.nbCells
+        const f32 = () => (shared ? new Float32Array(new SharedArrayBuffer(4 * n)) : new Float32Array(n)).fill(NaN)
+        return {
+            size: this.size,
+            misfits: f32(),
+            rotations: f32(),
+            stressRatios: f32()
+        }
+    }
+
+    /**
+     * Compute the whole raster
+     */
+    run(): Sigma1Raster {
+        const raster = this.createRaster()
+        this.runCells(0, this.nbCells, raster)
+        return raster
+    }
+
+    /**
+     * Compute the cells [first, first + count) of the raster
+     */
+    runCells(first: number, count: number, raster: Sigma1Raster): void {
+        const last = Math.min(first + count, this.nbCells)
+        for (let c = first; c < last; ++c) {
+            const axes = this.axes(c)
+            if (axes === undefined) {
+                continue
+            }
+            this.minimize(axes, c, raster)
+        }
+    }
+
+    /**
+     * Unit vector of sigma_1 (lower hemisphere) of a cell, or undefined if the cell is outside the stereonet
+     */
+    sigma1(cell: number): Vector3 {
+        const axes = this.axes(cell)
+        return axes === undefined ? undefined : axes[0]
+    }
+
+    /**
+     * The rotation tensor Hrot (rows sigma_1, sigma_3, sigma_2) of a cell, for a rotation of sigma_3 around sigma_1
+     */
+    rotation(cell: number, angle: number): Matrix3x3 {
+        const axes = this.axes(cell)
+        if (axes === undefined) {
+            throw new Error(`Cell ${cell} is outside the stereonet`)
+        }
+        return hrot(axes, Math.cos(angle), Math.sin(angle))
+    }
+
+    /**
+     * sigma_1 and an orthonormal basis (a, b) of the plane perpendicular to sigma_1, with (sigma_1, a, b) right-handed
+     */
+    private axes(cell: number): [Vector3, Vector3, Vector3] {
+        const i = cell % this.size
+        const j = Math.floor(cell / this.size)
+        const x = -1 + (i + 0.5) * 2 / this.size
+        const y = -1 + (j + 0.5) * 2 / this.size
+        const rho = Math.sqrt(x * x + y * y)
+        if (rho > 1) {
+            return undefined
+        }
+
+        // Inverse of the lower hemisphere equal-area projection: rho = sqrt(2) sin(psi / 2), psi = angle from the downward vertical
+        const psi = 2 * Math.asin(rho / Math.SQRT2)
+        const s = Math.sin(psi)
+        const u: Vector3 = rho === 0 ? [0, 0, -1] : [s * x / rho, s * y / rho, -Math.cos(psi)]
+
+        // a is horizontal (or East for a vertical sigma_1), b = u x a
+        let a: Vector3 = [-u[1], u[0], 0]
+        const na = Math.sqrt(a[0] * a[0] + a[1] * a[1])
+        a = na < 1e-12 ? [1, 0, 0] : [a[0] / na, a[1] / na, 0]
+        const b: Vector3 = [
+            u[1] * a[2] - u[2] * a[1],
+            u[2] * a[0] - u[0] * a[2],
+            u[0] * a[1] - u[1] * a[0]
+        ]
+        return [u, a, b]
+    }
+
+    private minimize(axes: [Vector3, Vector3, Vector3], cell: number, raster: Sigma1Raster): void {
+        this.project(axes)
+
+        // Coarse scan over (rotation, stress ratio)
+        const ratios = this.stressRatios
+        const nr = ratios.length
+        const sums = this.sums
+        let best = Number.POSITIVE_INFINITY
+        let bestRot = 0
+        let bestRatio = 0
+        for (let k = 0; k < this.nbRotations; ++k) {
+            this.sweep(axes, this.cosRot[k], this.sinRot[k])
+            for (let r = 0; r < nr; ++r) {
+                if (sums[r] < best) {
+                    best = sums[r]
+                    bestRot = k * Math.PI / this.nbRotations
+                    bestRatio = ratios[r]
+                }
+            }
+        }
+
+        // Local refinement (pattern search) around the best node, halving the steps at each level
+        let dRot = Math.PI / this.nbRotations / 2
+        let dRatio = nr > 1 ? 0.5 / (nr - 1) : 0.25
+        for (let level = 0; level < this.refinements; ++level) {
+            let moved = true
+            while (moved) {
+                moved = false
+                for (let m = 0; m < 4; ++m) {
+                    const rot = bestRot + (m === 0 ? dRot : m === 1 ? -dRot : 0)
+                    const ratio = bestRatio + (m === 2 ? dRatio : m === 3 ? -dRatio : 0)
+                    if (ratio < 0 || ratio > 1) {
+                        continue
+                    }
+                    const v = this.evaluate(axes, Math.cos(rot), Math.sin(rot), ratio, best)
+                    if (v < best) {
+                        best = v
+                        bestRot = rot
+                        bestRatio = ratio
+                        moved = true
+                    }
+                }
+            }
+            dRot /= 2
+            dRatio /= 2
+        }
+
+        // The rotation is defined modulo PI
+        bestRot = bestRot - Math.PI * Math.floor(bestRot / Math.PI)
+
+        const total = this.packed.totalWeight
+        raster.misfits[cell] = total === 0 ? 0 : best / total
+        raster.rotations[cell] = bestRot
+        raster.stressRatios[cell] = bestRatio
+    }
+
+    /**
+     * Projections of sigma_1, a and b on the normal, the striation and the perpendicular direction of each plane
+     */
+    private project([u, a, b]: [Vector3, Vector3, Vector3]): void {
+        const planes = this.packed.striatedPlanes
+        const P = this.projections
+        const n = planes.normals, st = planes.striations, pe = planes.perpStriations
+        for (let i = 0, j = 0, o = 0; i < planes.count; ++i, j += 3, o += 9) {
+            const nx = n[j], ny = n[j + 1], nz = n[j + 2]
+            const sx = st[j], sy = st[j + 1], sz = st[j + 2]
+            const px = pe[j], py = pe[j + 1], pz = pe[j + 2]
+            P[o] = u[0] * nx + u[1] * ny + u[2] * nz
+            P[o + 1] = u[0] * sx + u[1] * sy + u[2] * sz
+            P[o + 2] = u[0] * px + u[1] * py + u[2] * pz
+            P[o + 3] = a[0] * nx + a[1] * ny + a[2] * nz
+            P[o + 4] = a[0] * sx + a[1] * sy + a[2] * sz
+            P[o + 5] = a[0] * px + a[1] * py + a[2] * pz
+            P[o + 6] = b[0] * nx + b[1] * ny + b[2] * nz
+            P[o + 7] = b[0] * sx + b[1] * sy + b[2] * sz
+            P[o + 8] = b[0] * px + b[1] * py + b[2] * pz
+        }
+    }
+
+    /**
+     * Weighted sums of the misfits for all the sampled stress ratios (written in this.sums), for one rotation of sigma_3
+     */
+    private sweep(axes: [Vector3, Vector3, Vector3], c: number, s: number): void {
+        const planes = this.packed.striatedPlanes
+        const P = this.projections
+        const ratios = this.stressRatios
+        const nr = ratios.length
+        const sums = this.sums
+        sums.fill(0)
+
+        for (let i = 0, o = 0; i < planes.count; ++i, o += 9) {
+            const un = P[o], us = P[o + 1], up = P[o + 2]
+            // sigma_3 = c a + s b, sigma_2 = sigma_1 x sigma_3 = c b - s a
+            const vn = c * P[o + 6] - s * P[o + 3]
+            const vs = c * P[o + 7] - s * P[o + 4]
+            const vp = c * P[o + 8] - s * P[o + 5]
+
+            // Traction t = S n = -(u.n) u - R (v.n) v, projected on n, s and p
+            const snA = -un * un, snB = -vn * vn
+            const tsA = -un * us, tsB = -vn * vs
+            const tpA = -un * up, tpB = -vn * vp
+
+            const w = planes.weights[i]
+            const kind = planes.kind[i], oriented = planes.oriented[i] === 1
+            const cohesion = planes.cohesion[i], frictionAngle = planes.frictionAngle[i], frictionWeight = planes.frictionWeight[i]
+            for (let r = 0; r < nr; ++r) {
+                const R = ratios[r]
+                const ts = tsA + R * tsB
+                const tp = tpA + R * tpB
+                sums[r] += w * striatedPlaneMisfit(
+                    kind, oriented, snA + R * snB, ts, tp, Math.sqrt(ts * ts + tp * tp),
+                    cohesion, frictionAngle, frictionWeight)
+            }
+        }
+
+        if (this.packed.nbOthers > 0) {
+            const H = hrot(axes, c, s)
+            for (let r = 0; r < nr; ++r) {
+                sums[r] += this.othersCost(H, ratios[r])
+            }
+        }
+    }
+
+    /**
+     * Weighted sum of the misfits for one rotation of sigma_3 and one stress ratio.
+     * The evaluation stops as soon as the sum exceeds bound (the misfits are positive).
+     */
+    private evaluate(axes: [Vector3, Vector3, Vector3], c: number, s: number, R: number, bound: number): number {
+        const planes = this.packed.striatedPlanes
+        const P = this.projections
+        let sum = 0
+        for (let i = 0, o = 0; i < planes.count; ++i, o += 9) {
+            const un = P[o]
+            const vn = c * P[o + 6] - s * P[o + 3]
+            const vs = c * P[o + 7] - s * P[o + 4]
+            const vp = c * P[o + 8] - s * P[o + 5]
+            const ts = -un * P[o + 1] - R * vn * vs
+            const tp = -un * P[o + 2] - R * vn * vp
+            sum += planes.weights[i] * striatedPlaneMisfit(
+                planes.kind[i], planes.oriented[i] === 1, -un * un - R * vn * vn, ts, tp, Math.sqrt(ts * ts + tp * tp),
+                planes.cohesion[i], planes.frictionAngle[i], planes.frictionWeight[i])
+            if ((i & 63) === 63 && sum >= bound) {
+                return sum
+            }
+        }
+        if (this.packed.nbOthers > 0) {
+            sum += this.othersCost(hrot(axes, c, s), R)
+        }
+        return sum
+    }
+
+    private othersCost(H: Matrix3x3, R: number): number {
+        this.engine.setHypotheticalStress(H, R)
+        return this.packed.othersCost(this.engine.stress(undefined))
+    }
+}
+
+// --------------- Hidden to users
+
+function hrot([u, a, b]: [Vector3, Vector3, Vector3], c: number, s: number): Matrix3x3 {
+    const H = newMatrix3x3()
+    for (let k = 0; k < 3; ++k) {
+        H[0][k] = u[k]
+        H[1][k] = c * a[k] + s * b[k]
+        H[2][k] = c * b[k] - s * a[k]
+    }
+    return H
+}
@@ -10,3 +10,5 @@ export * from './RegularDomain2D'
 export * from './RegularDomain3D'
 export * from './RandomDomain2D'
 export * from './RandomDomain3D'
+export * from './Sigma1Landscape'
+export * from './MohrPointCloud'
@@ -0,0 +1,15 @@
+/*
+ * Slim entry of the library, imported by the inversion server (src/server.ts) and its workers.
+ *
+ * The main entry (./index.ts) re-exports every module, so importing it evaluates all the data types, search methods,
+ * datasets and analyses. This entry only exports the server and the registries: the modules of a job are evaluated when
+ * the job needs them (see DataFactory, SearchMethodFactory and SearchTasks).
+ */
+
+export * from './server'
+
+export { DataFactory } from './data/Factory'
+export { SearchMethodFactory } from './search/Factory'
+export { SearchTasks } from './search/SearchWorkers'
+export { readDataset, DatasetReadResult } from './io/DatasetReader'
+export { MisfitCriteriunSolution } from './InverseMethod'
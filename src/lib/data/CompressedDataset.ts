@@ -0,0 +1,225 @@
+import { Engine } from "../geomeca/Engine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { Vector3 } from "../types"
+import { Data } from "./Data"
+import { PackedDataset } from "./PackedDataset"
+import { PackedStriatedPlanes, StriatedPlaneMisfit } from "./PackedStriatedPlanes"
+import { StriatedPlaneKin } from "./StriatedPlane_Kin"
+
+/**
+ * @category Data
+ */
+export type CompressedDatasetParams = {
+    // Angular size of the bins of the normals and of the striations, in radians (default 1°)
+    resolution?: number,
+    // Optional weight of each datum (same order as data). Default is 1 for all the data
+    weights?: ArrayLike<number>
+}
+
+/**
+ * @brief Approximate dataset for the coarse stages of a search: the striated planes with close orientations are replaced
+ * by weighted representatives, with a worst-case bound of the error on the misfit.
+ *
+ * The normals and the striations are binned on the sphere (cube map bins of angular size about resolution), per misfit
+ * criterion and orientation flag. The representative of a bin has the mean orientation of its planes and their total weight.
+ * The striated planes with a friction criterion and the other data are kept as they are.
+ *
+ * If a plane is deduced from its representative by a rotation of angle e, its misfit for a normalized stress tensor
+ * (principal values -1, -R, 0) differs from the misfit of the representative by at most asin(e / |tau|), where tau is the
+ * shear stress on the representative (the shear stress moves by at most e). misfitErrorBound sums these bounds for the stress
+ * set in an engine, from the representatives only.
+ *
+ * Any search method can run on packed (see SearchMethod.runPacked), and the final solution be evaluated on full.
+ * The compression ratio depends on how clustered the orientations are: a catalog made of families of similar planes
+ * is compressed to a few representatives per family.
+ *
+ * @example
+ * ```ts
+ * const compressed = new CompressedDataset(data, { resolution: 0.5 * Math.PI / 180 })
+ * const coarse = search.runPacked(compressed.packed, createDefaultSolution())
+ * engine.setHypotheticalStress(coarse.rotationMatrixW, coarse.stressRatio)
+ * const misfit = compressed.full.cost(engine)
+ * const error = compressed.misfitErrorBound(engine)
+ * ```
+ * @category Data
+ */
+export class CompressedDataset {
+    // The original data
+    readonly full: PackedDataset
+    // The representatives, then the data which are not compressed
+    readonly packed: PackedDataset
+    // Number of representatives (the first striated planes of packed)
+    readonly nbRepresentatives: number
+    // Largest rotation angle between a plane and its representative
+    readonly maxDeviation: number
+    // Per representative: the largest rotation angle of its planes, and their total weight
+    private deviations: Float64Array
+    private clusterWeights: Float64Array
+
+    constructor(data: Data[], { resolution = Math.PI / 180, weights = undefined }: CompressedDatasetParams = {}) {
+        if (!(resolution > 0)) {
+            throw new Error(`The resolution of the compression must be positive (got ${resolution})`)
+        }
+        if (weights !== undefined && weights.length !== data.length) {
+            throw new Error(`The number of weights (got ${weights.length}) should be the number of data (got ${data.length})`)
+        }
+        this.full = new PackedDataset(data, { weights })
+
+        const planes: StriatedPlaneKin[] = []
+        const planesWeights: number[] = []
+        const kept: Data[] = []
+        const keptWeights: number[] = []
+        data.forEach((d, i) => {
+            const w = weights === undefined ? 1 : weights[i]
+            if (d instanceof StriatedPlaneKin) {
+                planes.push(d)
+                planesWeights.push(w)
+            } else {
+                kept.push(d)
+                keptWeights.push(w)
+            }
+        })
+
+        // The packed columns give the orientations and the criterion of each plane
+        const columns = PackedStriatedPlanes.pack(planes)
+        const bins = new Map<string, number[]>()
+        const keptPlanes: Data[] = []
+        const keptPlanesWeights: number[] = []
+        for (let i = 0; i < columns.count; ++i) {
+            const kind = columns.kind[i]
+            if (kind !== StriatedPlaneMisfit.ANGLE && kind !== StriatedPlaneMisfit.DOT) {
+                keptPlanes.push(planes[i])
+                keptPlanesWeights.push(planesWeights[i])
+                continue
+            }
+            const key = `${kind},${columns.oriented[i]},${binKey(columns.normals, 3 * i, resolution)},${binKey(columns.striations, 3 * i, resolution)}`
+            if (!bins.has(key)) {
+                bins.set(key, [])
+            }
+            bins.get(key).push(i)
+        }
+
+        const representatives: Data[] = []
+        this.nbRepresentatives = bins.size
+        this.deviations = new Float64Array(bins.size)
+        this.clusterWeights = new Float64Array(bins.size)
+        let k = 0
+        for (const rows of bins.values()) {
+            const { representative, weight, deviation } = clusterRepresentative(columns, rows, planes, planesWeights)
+            representatives.push(representative)
+            this.clusterWeights[k] = weight
+            this.deviations[k] = deviation
+            k++
+        }
+        this.maxDeviation = this.deviations.reduce((a, e) => Math.max(a, e), 0)
+
+        this.packed = new PackedDataset([...representatives, ...keptPlanes, ...kept], {
+            weights: [...this.clusterWeights, ...keptPlanesWeights, ...keptWeights]
+        })
+    }
+
+    /**
+     * @brief Upper bound of |packed.cost(engine) - full.cost(engine)| for the stress set in a homogeneous engine,
+     * computed from the representatives only (weighted mean misfit).
+     */
+    misfitErrorBound(engine: Engine): number {
+        if (!(engine instanceof HomogeneousEngine)) {
+            throw new Error('The error bound of a compressed dataset is only available for a homogeneous stress field')
+        }
+        if (this.full.totalWeight === 0) {
+            return 0
+        }
+
+        const planes = this.packed.striatedPlanes
+        planes.computeTractions(engine.stress(undefined))
+        const shearMag = planes.tractions.shearMag
+        let sum = 0
+        for (let k = 0; k < this.nbRepresentatives; ++k) {
+            const e = this.deviations[k]
+            if (e === 0) {
+                continue
+            }
+            const angle = planes.kind[k] === StriatedPlaneMisfit.ANGLE
+            const max = angle ? Math.PI : 1
+            // The direction of the shear stress is arbitrary if the shear stress may vanish
+            let bound = max
+            if (e < shearMag[k]) {
+                // |cos(a) - cos(b)| / 2 <= |a - b| / 2 for the DOT criterion
+                bound = angle ? Math.asin(e / shearMag[k]) : Math.asin(e / shearMag[k]) / 2
+            }
+            sum += this.clusterWeights[k] * bound
+        }
+        return sum / this.full.totalWeight
+    }
+}
+
+// --------------- Hidden to users
+
+// Cube map bin of the unit vector v[offset..offset+3]
+function binKey(v: Float64Array, offset: number, resolution: number): string {
+    const x = v[offset], y = v[offset + 1], z = v[offset + 2]
+    const ax = Math.abs(x), ay = Math.abs(y), az = Math.abs(z)
+    let face: number, u: number, w: number
+    if (ax >= ay && ax >= az) {
+        face = x > 0 ? 0 : 1; u = y / ax; w = z / ax
+    } else if (ay >= az) {
+        face = y > 0 ? 2 : 3; u = x / ay; w = z / ay
+    } else {
+        face = z > 0 ? 4 : 5; u = x / az; w = y / az
+    }
+    // The angular size of a bin is at most resolution (the gnomonic projection dilates the angles)
+    return `${face},${Math.floor((u + 1) / resolution)},${Math.floor((w + 1) / resolution)}`
+}
+
+function clusterRepresentative(
+    columns: PackedStriatedPlanes, rows: number[], planes: StriatedPlaneKin[], weights: number[]): { representative: StriatedPlaneKin, weight: number, deviation: number }
+{
+    const n: Vector3 = [0, 0, 0], s: Vector3 = [0, 0, 0]
+    let weight = 0
+    for (const i of rows) {
+        // The orientation is averaged with unit weights, so that a zero weight cannot cancel the orientation
+        for (let c = 0; c < 3; ++c) {
+            n[c] += columns.normals[3 * i + c]
+            s[c] += columns.striations[3 * i + c]
+        }
+        weight += weights[i]
+    }
+    const nr = normalize(n)
+    // The striation of the representative lies in its plane
+    const d = dot(s, nr)
+    const sr = normalize([s[0] - d * nr[0], s[1] - d * nr[1], s[2] - d * nr[2]])
+    const pr = cross(nr, sr)
+
+    // The perpendicular direction keeps the convention of the data
+    const i0 = rows[0]
+    const p0: Vector3 = [columns.perpStriations[3 * i0], columns.perpStriations[3 * i0 + 1], columns.perpStriations[3 * i0 + 2]]
+    const n0: Vector3 = [columns.normals[3 * i0], columns.normals[3 * i0 + 1], columns.normals[3 * i0 + 2]]
+    const s0: Vector3 = [columns.striations[3 * i0], columns.striations[3 * i0 + 1], columns.striations[3 * i0 + 2]]
+    const sign = dot(p0, cross(n0, s0)) < 0 ? -1 : 1
+
+    // Largest rotation angle between the frame (n, s, n x s) of a plane and the one of the representative
+    let deviation = 0
+    for (const i of rows) {
+        const ni: Vector3 = [columns.normals[3 * i], columns.normals[3 * i + 1], columns.normals[3 * i + 2]]
+        const si: Vector3 = [columns.striations[3 * i], columns.striations[3 * i + 1], columns.striations[3 * i + 2]]
+        const nn = dot(ni, nr), ss = dot(si, sr)
+        const trace = nn + ss + nn * ss - dot(ni, sr) * dot(si, nr)
+        deviation = Math.max(deviation, Math.acos(Math.max(-1, Math.min(1, (trace - 1) / 2))))
+    }
+
+    const representative = planes[i0].withOrientation(nr, sr, [sign * pr[0], sign * pr[1], sign * pr[2]])
+    return { representative, weight, deviation }
+}
+
+function dot(a: Vector3, b: Vector3): number {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+}
+
+function cross(a: Vector3, b: Vector3): Vector3 {
+    return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+}
+
+function normalize(v: Vector3): Vector3 {
+    const l = Math.hypot(v[0], v[1], v[2])
+    return [v[0] / l, v[1] / l, v[2] / l]
+}
@@ -6,7 +6,7 @@ import {
 import { StriatedPlaneProblemType } from "./types"
 import { minRotAngleRotationTensor } from "../types/math"
 import { ConjugateFaults } from "./ConjugateFaults"
-import { HypotheticalSolutionTensorParameters } from "../geomeca"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
 
 /** 
  Compactional Shear Bands: 
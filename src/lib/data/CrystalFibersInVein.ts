@@ -5,6 +5,7 @@ import { SphericalCoords } from "../types/SphericalCoords"
 import { DataArgument, DataDescription, DataStatus, createDataArgument, createDataStatus } from "./DataDescription"
 import { toFloat } from "../utils"
 import { Tokens } from "./types"
+import { readPosition } from "../io/DataReader"
 
 
 /**
@@ -56,6 +57,9 @@ export class CrystalFibersInVein extends ExtensionFracture {
         // As for extension fractures, the misfit is a normalized function of the angle between unit vector 'normal' and the hypothetical stress axis Sigma 3 
         this.nPlane = trendPlunge2unitAxis({ trend: this.crystal_fibers_trend, plunge: this.crystal_fibers_plunge })
 
+        // Read position if any
+        readPosition(createDataArgument(args[0]), this.pos, result)
+
         return result
     }
 }
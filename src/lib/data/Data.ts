@@ -1,4 +1,5 @@
 import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
+import { FaultVectorBatch } from "../io/DataReader"
 import { Matrix3x3, Point3D, Vector3 } from "../types/math"
 import { DataStatus } from "./DataDescription"
 import { Tokens } from "./types"
@@ -44,9 +45,11 @@ export abstract class Data  {
 
     /**
      * Replace the constructor
+     * @param args The lines of the datum
+     * @param batch The batch conversion of the striated planes of the file, if any (see readDataset)
      */
     //abstract initialize(params: DataParameters[]): boolean
-    abstract initialize(args: Tokens[]): DataStatus
+    abstract initialize(args: Tokens[], batch?: FaultVectorBatch): DataStatus
 
     /**
      * @brief Check the consistency of the datum
@@ -72,6 +75,21 @@ export abstract class Data  {
         { displ, strain, stress }:
         { displ?: Vector3, strain?: HypotheticalSolutionTensorParameters, stress?: HypotheticalSolutionTensorParameters }): number
 
+    /**
+     * @brief Lower bound of the cost of this datum over a cell of hypothetical stress tensors (see BranchAndBound).
+     *
+     * The cell is made of the tensors whose principal frame is at most rotationRadius (in radians) from the frame of stress,
+     * and whose stress ratio is at most stressRatioRadius from the stress ratio of stress. The default bound (0) is always valid.
+     * @param options.stress The stress tensor at the center of the cell
+     * @param options.rotationRadius The angular radius of the cell
+     * @param options.stressRatioRadius The half width of the stress ratio interval of the cell
+     */
+    costLowerBound(
+        { stress, rotationRadius, stressRatioRadius }:
+        { stress: HypotheticalSolutionTensorParameters, rotationRadius: number, stressRatioRadius: number }): number {
+        return 0
+    }
+
     /**
      * After stress inversion, get the infered data orientation/magnitude/etc for this specific Data
      */
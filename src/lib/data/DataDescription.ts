@@ -92,12 +92,13 @@ export const DataDescription = {
         'maxFrictionAngle', // 14
         'minAngleS1n',      // 15
         'maxAngleS1n',      // 16
-        'beddingPlaneStrike',// 17
-        'beddingPlaneDip',  // 18
-        'beddingPlaneDipDirection',// 19
-        'x',                // 20
-        'y',                // 21
-        'z',                // 22
+        'scale',            // 17
+        'beddingPlaneStrike',// 18
+        'beddingPlaneDip',  // 19
+        'beddingPlaneDipDirection',// 20
+        'x',                // 21
+        'y',                // 22
+        'z',                // 23
     ],
     type: [
         (v: string, arg: DataArgument) => myParseInt(v, arg),     // 0
@@ -125,11 +126,13 @@ export const DataDescription = {
         (v: string, arg: DataArgument) => myParseFloat(v, arg),
 
         (v: string, arg: DataArgument) => myParseFloat(v, arg),
+
         (v: string, arg: DataArgument) => myParseFloat(v, arg),   // 18
+        (v: string, arg: DataArgument) => myParseFloat(v, arg),
         (v: string, arg: DataArgument) => v,
 
-        (v: string, arg: DataArgument) => myParseFloat(v, arg),
         (v: string, arg: DataArgument) => myParseFloat(v, arg),   // 21
+        (v: string, arg: DataArgument) => myParseFloat(v, arg),
         (v: string, arg: DataArgument) => myParseFloat(v, arg)
     ],
     ranges: [
@@ -150,7 +153,7 @@ export const DataDescription = {
         '[0, 90[',                            // 14
         ']0, 90[',
         ']0, 90[',                              // 16
-        '[0, 90]',
+        '∈ R+*',
         '[0, 360[',                             // 18
         '[0, 90]',
         '[N, S, E, W, NE, SE, SW, NW, UND]',    // 20
@@ -237,23 +240,24 @@ export const DataDescription = {
         },
         // 17
         (v: string) => {
-            // Strike
+            // Scale
             const vv = DataDescription.type[17](v)
-            return vv >= 0 && vv < 360
+            return vv > 0
         },
         // 18
         (v: string) => {
-            // Dip
+            // Strike
             const vv = DataDescription.type[18](v)
-            return vv >= 0 && vv <= 90
+            return vv >= 0 && vv < 360
         },
         // 19
-        (v: string) => directionExists(v), // 19
-        // 20
         (v: string) => {
-            const vv = DataDescription.type[20](v)
-            return true
+            // Dip
+            const vv = DataDescription.type[19](v)
+            return vv >= 0 && vv <= 90
         },
+        // 20
+        (v: string) => directionExists(v), // 20
         // 21
         (v: string) => {
             const vv = DataDescription.type[21](v)
@@ -264,6 +268,11 @@ export const DataDescription = {
             const vv = DataDescription.type[22](v)
             return true
         },
+        // 23
+        (v: string) => {
+            const vv = DataDescription.type[23](v)
+            return true
+        },
     ],
 
     putMessage(arg: DataArgument) {
@@ -0,0 +1,207 @@
+import { Matrix3x3 } from "../types"
+import { matrixToQuaternion } from "../search/utils"
+
+/**
+ * @category Data
+ */
+export type EvaluationCacheParams = {
+    // Maximum number of cached misfits (default 65536)
+    capacity?: number,
+    // Rotations closer than about resolution (radians) share the same entry (default 1e-4)
+    resolution?: number,
+    // Stress ratios closer than stressRatioResolution share the same entry (default 1e-4)
+    stressRatioResolution?: number
+}
+
+/**
+ * @category Data
+ */
+export type EvaluationCacheStats = {
+    hits: number,
+    misses: number,
+    evictions: number,
+    // Number of cached misfits
+    size: number,
+    // hits / (hits + misses), 0 before the first lookup
+    hitRate: number
+}
+
+/**
+ * @brief Memo of the misfits of a dataset, keyed by the quantised hypothetical stress (rotation quaternion and stress ratio).
+ *
+ * Once set to a PackedDataset (see PackedDataset.setCache), every cost() with a homogeneous engine looks up the cache first,
+ * whatever the search method, so that revisiting a rotation (grid refinements, polls of pattern searches,
+ * chains of annealing...) costs a hash lookup instead of a pass over the data.
+ * The rotations are quantised with the given resolution, so a rotation close to an already evaluated one
+ * gets the cached misfit: keep the resolution below the precision expected from the search.
+ *
+ * The memory is bounded by the capacity: when the cache is full, an entry is evicted with the CLOCK policy
+ * (an approximation of LRU, each entry having a reference bit set when it is hit).
+ *
+ * A misfit whose evaluation was abandoned (see the bound of PackedDataset.cost) is stored as a lower bound,
+ * and only reused for lookups with a lower or equal bound.
+ *
+ * A cache belongs to one dataset: it is cleared when the dataset, its weights or its objective change.
+ *
+ * @example
+ * ```ts
+ * const cache = new EvaluationCache({ capacity: 1 << 16, resolution: 1e-4 })
+ * inv.setEvaluationCache(cache)
+ * inv.run()
+ * console.log(cache.stats().hitRate)
+ * ```
+ * @category Data
+ */
+export class EvaluationCache {
+    readonly capacity: number
+    private rotationScale: number
+    private stressRatioScale: number
+    // Slot of each hash
+    private slots = new Map<number, number>()
+    // Per slot: the 5 integers of the key, its hash, the misfit, exact (1) or lower bound (0), the reference bit
+    private keys: Int32Array
+    private hashes: Float64Array
+    private values: Float64Array
+    private exact: Uint8Array
+    private referenced: Uint8Array
+    private size_ = 0
+    private hand = 0
+    private hits = 0
+    private misses = 0
+    private evictions = 0
+    // The key of the last lookup (see store)
+    private key = new Int32Array(5)
+    private hash = 0
+    private q = new Float64Array(4)
+
+    constructor({ capacity = 1 << 16, resolution = 1e-4, stressRatioResolution = 1e-4 }: EvaluationCacheParams = {}) {
+        if (capacity < 1 || !(resolution > 0) || !(stressRatioResolution > 0)) {
+            throw new Error('For an evaluation cache choose capacity >= 1, resolution > 0 and stressRatioResolution > 0')
+        }
+        this.capacity = Math.floor(capacity)
+        // The angle of a rotation is twice the variation of its unit quaternion
+        this.rotationScale = 2 / resolution
+        this.stressRatioScale = 1 / stressRatioResolution
+        this.keys = new Int32Array(5 * this.capacity)
+        this.hashes = new Float64Array(this.capacity)
+        this.values = new Float64Array(this.capacity)
+        this.exact = new Uint8Array(this.capacity)
+        this.referenced = new Uint8Array(this.capacity)
+    }
+
+    get size(): number {
+        return this.size_
+    }
+
+    stats(): EvaluationCacheStats {
+        const lookups = this.hits + this.misses
+        return {
+            hits: this.hits,
+            misses: this.misses,
+            evictions: this.evictions,
+            size: this.size_,
+            hitRate: lookups === 0 ? 0 : this.hits / lookups
+        }
+    }
+
+    resetStats(): void {
+        this.hits = 0
+        this.misses = 0
+        this.evictions = 0
+    }
+
+    /**
+     * Remove all the entries (the statistics are kept)
+     */
+    clear(): void {
+        this.slots.clear()
+        this.size_ = 0
+        this.hand = 0
+    }
+
+    /**
+     * @brief Look up the misfit of a hypothetical stress
+     * @param Hrot The rotation of the hypothetical stress
+     * @param stressRatio The stress ratio
+     * @param bound The bound of the evaluation (see PackedDataset.cost)
+     * @returns The cached misfit, or NaN if it must be evaluated (then call store with the evaluated misfit)
+     */
+    lookup(Hrot: Matrix3x3, stressRatio: number, bound: number = Number.POSITIVE_INFINITY): number {
+        this.quantise(Hrot, stressRatio)
+        const slot = this.slots.get(this.hash)
+        if (slot !== undefined && this.sameKey(slot)) {
+            const value = this.values[slot]
+            if (this.exact[slot] === 1 || value >= bound) {
+                this.referenced[slot] = 1
+                this.hits++
+                return value
+            }
+        }
+        this.misses++
+        return Number.NaN
+    }
+
+    /**
+     * @brief Store the misfit of the hypothetical stress of the last lookup
+     * @param misfit The evaluated misfit
+     * @param exact False if the evaluation may have been abandoned (misfit >= bound)
+     */
+    store(misfit: number, exact: boolean): void {
+        let slot = this.slots.get(this.hash)
+        if (slot === undefined) {
+            slot = this.size_ < this.capacity ? this.size_++ : this.evict()
+            this.slots.set(this.hash, slot)
+        }
+        // A colliding key replaces the entry
+        this.keys.set(this.key, 5 * slot)
+        this.hashes[slot] = this.hash
+        this.values[slot] = misfit
+        this.exact[slot] = exact ? 1 : 0
+        this.referenced[slot] = 0
+    }
+
+    // CLOCK: the first slot without reference bit is evicted, clearing the bits on the way
+    private evict(): number {
+        while (this.referenced[this.hand] === 1) {
+            this.referenced[this.hand] = 0
+            this.hand = (this.hand + 1) % this.capacity
+        }
+        const slot = this.hand
+        this.hand = (this.hand + 1) % this.capacity
+        this.slots.delete(this.hashes[slot])
+        this.evictions++
+        return slot
+    }
+
+    private quantise(Hrot: Matrix3x3, stressRatio: number): void {
+        const q = this.q
+        matrixToQuaternion(Hrot, q, 0)
+        // q and -q are the same rotation: the largest component is made positive
+        let k = 0
+        for (let i = 1; i < 4; ++i) {
+            if (Math.abs(q[i]) > Math.abs(q[k])) {
+                k = i
+            }
+        }
+        const s = q[k] < 0 ? -this.rotationScale : this.rotationScale
+        let h1 = 0x811c9dc5 | 0, h2 = 0x01000193
+        for (let i = 0; i < 5; ++i) {
+            const v = i < 4 ? Math.round(s * q[i]) : Math.round(stressRatio * this.stressRatioScale)
+            this.key[i] = v
+            h1 = Math.imul(h1 ^ v, 0x01000193)
+            h2 = Math.imul(h2 + v, 0x5bd1e995) ^ (h2 >>> 15)
+        }
+        // 52 bits hash, exactly represented by a number
+        this.hash = (h1 >>> 0) * 0x100000 + (h2 >>> 12)
+    }
+
+    private sameKey(slot: number): boolean {
+        const o = 5 * slot
+        for (let i = 0; i < 5; ++i) {
+            if (this.keys[o + i] !== this.key[i]) {
+                return false
+            }
+        }
+        return true
+    }
+}
@@ -2,9 +2,10 @@ import { Matrix3x3, scalarProductUnitVectors, Vector3 } from "../types"
 import { fromAnglesToNormal } from "../utils/fromAnglesToNormal"
 import { Data } from "./Data"
 import { FractureStrategy, Tokens } from "./types"
-import { HypotheticalSolutionTensorParameters } from "../geomeca"
-import { DataStatus } from "./DataDescription"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
+import { createDataArgument, DataStatus } from "./DataDescription"
 import { decodePlane } from "../utils/PlaneHelper"
+import { readPosition } from "../io/DataReader"
 
 /**
  * @brief Represent an observed and measured joint
@@ -48,9 +49,7 @@ export class ExtensionFracture extends Data {
         })
 
         // Read position if any
-        if (toks[19].length !== 0) this.pos[0] = parseFloat(toks[19])
-        if (toks[20].length !== 0) this.pos[1] = parseFloat(toks[20])
-        if (toks[21].length !== 0) this.pos[2] = parseFloat(toks[21])
+        readPosition(createDataArgument(toks), this.pos, plane.result)
 
         return plane.result
     }
@@ -1,29 +1,32 @@
 import { Data } from './Data'
-import { ExtensionFracture } from './ExtensionFracture'
-import { StriatedPlaneKin } from './StriatedPlane_Kin'
-// import { StriatedPlaneFriction1 } from './StriatedPlane_Friction1'
-// import { StriatedPlaneFriction2 } from './StriatedPlane_Friction2'
-import { ConjugateCompactionalShearBands } from './ConjugateCompactionalShearBands'
-import { ConjugateFaults } from './ConjugateFaults'
-import { ConjugateDilatantShearBands } from './ConjugateDilatantShearBands'
-import { StriatedDilatantShearBand } from './StriatedDilatantShearBand'
-import { NeoformedStriatedPlane } from './NeoformedStriatedPlane'
-import { StriatedCompactionalShearBand } from './StriatedCompactionalShearBand'
-import { DilationBand } from './DilationBand'
-import { CompactionBand } from './CompactionBand'
-import { StyloliteInterface } from './StyloliteInterface'
 
 /* eslint @typescript-eslint/no-explicit-any: off -- need to have any here for the factory */
+/**
+ * @brief Registry of the data types by name.
+ *
+ * A type is either bound directly (bind), or through a loader called the first time the type is requested (bindLazy).
+ * The built-in types are bound lazily at the end of this module: a data type is only loaded and evaluated when a dataset
+ * uses it, so that a process that reads a few types (e.g., a worker of InversionServer) does not load the others.
+ * @category Data
+ */
 export namespace DataFactory {
 
-    const map_: Map<string, any> = new Map()
+    // The class of each type, or its loader until the type is requested
+    const map_: Map<string, { type?: any, loader?: () => any }> = new Map()
 
     export const bind = (obj: any, name: string = '') => {
-        name.length === 0 ? map_.set(obj.name, obj) : map_.set(name, obj)
+        name.length === 0 ? map_.set(obj.name, { type: obj }) : map_.set(name, { type: obj })
+    }
+
+    /**
+     * Register a type whose class is given by loader on first request
+     */
+    export const bindLazy = (name: string, loader: () => any) => {
+        map_.set(name, { loader })
     }
 
     export const create = (name: string, params: any = undefined): Data => {
-        const M = map_.get(name)
+        const M = resolve(name)
         if (M) {
             return new M(params)
         }
@@ -42,33 +45,56 @@ export namespace DataFactory {
         return data.constructor.name
     }
 
+    /**
+     * Load all the lazy types now (e.g., before taking a startup snapshot)
+     */
+    export const preload = (): void => {
+        Array.from(map_.keys()).forEach(resolve)
+    }
+
+    const resolve = (name: string): any => {
+        const entry = map_.get(name)
+        if (entry === undefined) {
+            return undefined
+        }
+        if (entry.type === undefined) {
+            entry.type = entry.loader()
+            entry.loader = undefined
+        }
+        return entry.type
+    }
+
 }
 
+// --------------- Hidden to users
+
+/*
+ * Registration of the built-in data types. The modules are required in the loaders, and not imported, so that they are
+ * evaluated on first request only.
+ */
+
 // Fault planes
-DataFactory.bind(StriatedPlaneKin, 'Striated Plane')
-DataFactory.bind(NeoformedStriatedPlane, 'Neoformed Striated Plane')
-// DataFactory.bind(StriatedPlaneFriction1, 'Striated Plane Friction1')
-// DataFactory.bind(StriatedPlaneFriction2, 'Striated Plane Friction2')
+DataFactory.bindLazy('Striated Plane', () => require('./StriatedPlane_Kin').StriatedPlaneKin)
+DataFactory.bindLazy('Neoformed Striated Plane', () => require('./NeoformedStriatedPlane').NeoformedStriatedPlane)
+DataFactory.bindLazy('Striated Plane Friction1', () => require('./StriatedPlane_Friction1').StriatedPlaneFriction1)
+DataFactory.bindLazy('Striated Plane Friction2', () => require('./StriatedPlane_Friction2').StriatedPlaneFriction2)
 
 // Striated shear bands
-DataFactory.bind(StriatedDilatantShearBand, 'Striated Dilatant Shear Band')
-DataFactory.bind(StriatedCompactionalShearBand, 'Striated Compactional Shear Band')
+DataFactory.bindLazy('Striated Dilatant Shear Band', () => require('./StriatedDilatantShearBand').StriatedDilatantShearBand)
+DataFactory.bindLazy('Striated Compactional Shear Band', () => require('./StriatedCompactionalShearBand').StriatedCompactionalShearBand)
 
 // Conjugate fault planes and deformation bands
-DataFactory.bind(ConjugateFaults, 'Conjugate Faults 1')
-DataFactory.bind(ConjugateFaults, 'Conjugate Faults 2')
-DataFactory.bind(ConjugateCompactionalShearBands, 'Conjugate Compactional Shear Bands 1')
-DataFactory.bind(ConjugateCompactionalShearBands, 'Conjugate Compactional Shear Bands 2')
-DataFactory.bind(ConjugateDilatantShearBands, 'Conjugate Dilatant Shear Bands 1')
-DataFactory.bind(ConjugateDilatantShearBands, 'Conjugate Dilatant Shear Bands 2')
+DataFactory.bindLazy('Conjugate Faults 1', () => require('./ConjugateFaults').ConjugateFaults)
+DataFactory.bindLazy('Conjugate Faults 2', () => require('./ConjugateFaults').ConjugateFaults)
+DataFactory.bindLazy('Conjugate Compactional Shear Bands 1', () => require('./ConjugateCompactionalShearBands').ConjugateCompactionalShearBands)
+DataFactory.bindLazy('Conjugate Compactional Shear Bands 2', () => require('./ConjugateCompactionalShearBands').ConjugateCompactionalShearBands)
+DataFactory.bindLazy('Conjugate Dilatant Shear Bands 1', () => require('./ConjugateDilatantShearBands').ConjugateDilatantShearBands)
+DataFactory.bindLazy('Conjugate Dilatant Shear Bands 2', () => require('./ConjugateDilatantShearBands').ConjugateDilatantShearBands)
 
 // Extensional fractures and dilation bands
-DataFactory.bind(DilationBand, 'Dilation Band')
-DataFactory.bind(ExtensionFracture, 'Extension Fracture')
+DataFactory.bindLazy('Dilation Band', () => require('./DilationBand').DilationBand)
+DataFactory.bindLazy('Extension Fracture', () => require('./ExtensionFracture').ExtensionFracture)
 
 // Compresional interfaces and compaction bands
-DataFactory.bind(CompactionBand, 'Compaction Band')
-DataFactory.bind(StyloliteInterface, 'Stylolite Interface')
-
-
-
+DataFactory.bindLazy('Compaction Band', () => require('./CompactionBand').CompactionBand)
+DataFactory.bindLazy('Stylolite Interface', () => require('./StyloliteInterface').StyloliteInterface)
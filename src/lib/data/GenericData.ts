@@ -0,0 +1,604 @@
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
+import { Matrix3x3, Point3D, Vector3 } from "../types"
+import { Data } from "./Data"
+import { createDataStatus, DataStatus } from "./DataDescription"
+import { Tokens } from "./types"
+
+/**
+ * @brief Cost of one datum computed by a plain function (see GenericKernel.fromFunction)
+ * @param values The values of the columns of the datum (same order as the columns of the kernel)
+ * @param stress The hypothetical stress tensor
+ * @category Data
+ */
+export type GenericCostFunction = (values: Float64Array, stress: HypotheticalSolutionTensorParameters) => number
+
+/**
+ * @brief Cost function shared by a family of GenericData, defined over named per-datum columns and the stress parameters.
+ *
+ * A kernel is usually compiled from a restricted expression. The expression is parsed and checked once, then turned into
+ * two specialized functions: one evaluating a single datum, and one looping over packed columns (see PackedGenericData),
+ * so that custom observations run at about the speed of the built-in data types.
+ *
+ * The expression may use:
+ * - numbers, the operators + - * / ^ (power) and parentheses,
+ * - the names of the columns,
+ * - the components of the stress tensor: sxx, sxy, sxz, syy, syz, szz,
+ * - the principal stresses s1, s2, s3 and the components of the principal directions s1x, s1y, s1z, s2x, ..., s3z,
+ * - the functions abs, sqrt, exp, log, sin, cos, tan, asin, acos, atan, atan2, min, max, pow and clamp(x, min, max),
+ * - sn(nx, ny, nz) and tau(nx, ny, nz), the normal stress and the magnitude of the shear stress on the plane of unit normal n.
+ *
+ * When the expression cannot describe the observation, a plain function can be used instead (fromFunction). It is called
+ * once per datum, which is slower.
+ *
+ * @example
+ * ```ts
+ * // Measured normal stress on a plane
+ * const kernel = GenericKernel.compile('abs(sn(nx, ny, nz) - measured)', ['nx', 'ny', 'nz', 'measured'])
+ * const data = rows.map(r => new GenericData(kernel, { nx: r[0], ny: r[1], nz: r[2], measured: r[3] }))
+ * ```
+ * @category Data
+ */
+export class GenericKernel {
+    readonly columns: string[]
+    // Undefined for a kernel defined by a plain function
+    readonly expression: string
+    private row_: (values: Float64Array, stress: HypotheticalSolutionTensorParameters) => number
+    private batch_: BatchFunction
+
+    /**
+     * Compile an expression over the columns
+     * @param expression The expression giving the cost of a datum
+     * @param columns The names of the per-datum columns
+     */
+    static compile(expression: string, columns: string[]): GenericKernel {
+        checkColumns(columns)
+        const ast = new Parser(expression, columns).parse()
+
+        let row: GenericCostFunction
+        let batch: BatchFunction
+        try {
+            row = new Function(rowSource(ast, columns))() as GenericCostFunction
+            batch = new Function(batchSource(ast, columns))() as BatchFunction
+        } catch (e) {
+            // Code generation is not allowed (e.g., content security policy): interpret the expression
+            row = (values, stress) => interpret(ast, values, stressEnv(stress))
+            batch = undefined
+        }
+
+        return new GenericKernel(columns, row, batch, expression)
+    }
+
+    /**
+     * Use a plain function called once per datum
+     * @param columns The names of the per-datum columns
+     * @param f The cost function
+     */
+    static fromFunction(columns: string[], f: GenericCostFunction): GenericKernel {
+        checkColumns(columns)
+        return new GenericKernel(columns, f, undefined)
+    }
+
+    private constructor(columns: string[], row: GenericCostFunction, batch: BatchFunction, expression: string = undefined) {
+        this.columns = [...columns]
+        this.expression = expression
+        this.row_ = row
+        this.batch_ = batch
+    }
+
+    /**
+     * True if the kernel has a specialized batched loop
+     */
+    get compiled(): boolean {
+        return this.batch_ !== undefined
+    }
+
+    /**
+     * Cost of one datum
+     */
+    cost(values: Float64Array, stress: HypotheticalSolutionTensorParameters): number {
+        return this.row_(values, stress)
+    }
+
+    /**
+     * Cost of count packed rows
+     * @param columns One packed column per name (same order as columns)
+     * @param weights The weight of each row
+     * @param stress The hypothetical stress tensor (homogeneous)
+     * @param out Optional per-row costs
+     * @param count The number of rows
+     * @returns The weighted sum of the costs
+     */
+    costs(columns: Float64Array[], weights: Float64Array, stress: HypotheticalSolutionTensorParameters, out: Float64Array, count: number): number {
+        if (this.batch_ !== undefined) {
+            return this.batch_(columns, weights, stress, out, count)
+        }
+
+        const values = new Float64Array(columns.length)
+        let sum = 0
+        for (let i = 0; i < count; ++i) {
+            for (let k = 0; k < columns.length; ++k) {
+                values[k] = columns[k][i]
+            }
+            const v = this.row_(values, stress)
+            if (out !== undefined) {
+                out[i] = v
+            }
+            sum += weights[i] * v
+        }
+        return sum
+    }
+}
+
+/**
+ * @brief A custom observation whose cost is given by a GenericKernel applied to its own column values.
+ *
+ * The data of the same kernel are packed together by PackedDataset (see PackedGenericData).
+ * @category Data
+ */
+export class GenericData extends Data {
+    readonly kernel: GenericKernel
+    readonly values: Float64Array
+
+    /**
+     * @param kernel The cost function
+     * @param values The values of the columns, by name or in the order of the columns of the kernel
+     * @param position Optional position of the datum
+     */
+    constructor(kernel: GenericKernel, values: { [name: string]: number } | ArrayLike<number>, position: Point3D = undefined) {
+        super()
+        this.kernel = kernel
+        this.values = new Float64Array(kernel.columns.length)
+        if (isArrayLike(values)) {
+            if (values.length !== kernel.columns.length) {
+                throw new Error(`GenericData expects ${kernel.columns.length} values (got ${values.length})`)
+            }
+            this.values.set(values)
+        } else {
+            kernel.columns.forEach((name, k) => {
+                if (values[name] === undefined) {
+                    throw new Error(`GenericData: missing value of column "${name}"`)
+                }
+                this.values[k] = values[name]
+            })
+        }
+        if (position !== undefined) {
+            this.pos = [...position] as Point3D
+        }
+    }
+
+    initialize(args: Tokens[]): DataStatus {
+        const result = createDataStatus()
+        result.status = false
+        result.messages.push('GenericData cannot be read from a data file, it has to be built with a GenericKernel')
+        return result
+    }
+
+    check({ displ, strain, stress }: { displ?: Vector3, strain?: Matrix3x3, stress?: Matrix3x3 }): boolean {
+        return stress !== undefined
+    }
+
+    cost({ displ, strain, stress }: { displ?: Vector3, strain?: HypotheticalSolutionTensorParameters, stress?: HypotheticalSolutionTensorParameters }): number {
+        return this.kernel.cost(this.values, stress)
+    }
+}
+
+/**
+ * @brief Packed columns of the GenericData sharing the same kernel, evaluated by the batched loop of the kernel.
+ *
+ * All the columns, except the per-row scratch, are views on a single buffer, which may be a SharedArrayBuffer
+ * attached by other threads without copy (see attach).
+ * @category Data
+ */
+export class PackedGenericData {
+    readonly kernel: GenericKernel
+    readonly count: number
+    readonly data: GenericData[]
+    // One column per name of the kernel
+    readonly columns: Float64Array[]
+    // Weight of each row in the sums of misfits (1 by default)
+    readonly weights: Float64Array
+    // Index of each row in the list of data it was packed from
+    readonly rows: Int32Array
+    // The buffer holding the columns, the weights and the rows
+    readonly buffer: ArrayBufferLike
+    private scratch: Float64Array
+    private values: Float64Array
+
+    /**
+     * Pack a list of GenericData sharing the same kernel
+     * @param data The data
+     * @param rows Optional index of each datum in its original list
+     * @param shared Allocate the columns in a SharedArrayBuffer (see PackedDataset.share)
+     */
+    static pack(data: GenericData[], rows: ArrayLike<number> = undefined, shared: boolean = false): PackedGenericData {
+        if (data.length === 0) {
+            throw new Error('PackedGenericData: nothing to pack')
+        }
+        const kernel = data[0].kernel
+        const size = data.length * bytesPerRow(kernel)
+        const block = new PackedGenericData(kernel, data, shared ? new SharedArrayBuffer(size) : new ArrayBuffer(size))
+        data.forEach((d, i) => {
+            if (d.kernel !== kernel) {
+                throw new Error('PackedGenericData: all the data must share the same kernel')
+            }
+            d.values.forEach((v, k) => block.columns[k][i] = v)
+            block.rows[i] = rows === undefined ? i : rows[i]
+        })
+        block.weights.fill(1)
+        return block
+    }
+
+    /**
+     * Create views on the columns packed in another thread (no copy). The rows have no datum.
+     * @param kernel The kernel of the packed data (e.g., compiled again from the same expression)
+     * @param buffer The buffer of the packed data
+     */
+    static attach(kernel: GenericKernel, buffer: ArrayBufferLike): PackedGenericData {
+        return new PackedGenericData(kernel, [], buffer)
+    }
+
+    /**
+     * Copy some rows into a new block sharing the same kernel, with their datum if any (see PackedDataset.subsetPacked)
+     * @param indices The rows of this block to copy
+     * @param rows The index of each copied row in its new list of data
+     * @param weights The weight of each copied row
+     */
+    subset(indices: ArrayLike<number>, rows: ArrayLike<number>, weights: ArrayLike<number>): PackedGenericData {
+        const m = indices.length
+        const data = this.data.length === 0 ? [] : Array.from(indices, i => this.data[i])
+        const block = new PackedGenericData(this.kernel, data, new ArrayBuffer(m * bytesPerRow(this.kernel)))
+        for (let r = 0; r < m; ++r) {
+            this.columns.forEach((c, k) => block.columns[k][r] = c[indices[r]])
+            block.rows[r] = rows[r]
+            block.weights[r] = weights[r]
+        }
+        return block
+    }
+
+    private constructor(kernel: GenericKernel, data: GenericData[], buffer: ArrayBufferLike) {
+        const n = buffer.byteLength / bytesPerRow(kernel)
+        if (!Number.isInteger(n)) {
+            throw new Error('The buffer of the packed generic data does not match the columns of the kernel')
+        }
+        this.kernel = kernel
+        this.count = n
+        this.data = data
+        this.buffer = buffer
+        this.columns = kernel.columns.map((_, k) => new Float64Array(buffer, 8 * k * n, n))
+        this.weights = new Float64Array(buffer, 8 * kernel.columns.length * n, n)
+        this.rows = new Int32Array(buffer, 8 * (kernel.columns.length + 1) * n, n)
+        this.scratch = new Float64Array(n)
+        this.values = new Float64Array(kernel.columns.length)
+    }
+
+    /**
+     * Compute the weighted sum of the misfits for a homogeneous stress tensor
+     */
+    sumCosts(stress: HypotheticalSolutionTensorParameters): number {
+        return this.count === 0 ? 0 : this.kernel.costs(this.columns, this.weights, stress, undefined, this.count)
+    }
+
+    /**
+     * Compute the misfit of each row for a homogeneous stress tensor, written in out[offset + rows[i]]
+     * @returns The weighted sum of the misfits
+     */
+    costs(stress: HypotheticalSolutionTensorParameters, out: Float64Array, offset: number = 0): number {
+        if (this.count === 0) {
+            return 0
+        }
+        const sum = this.kernel.costs(this.columns, this.weights, stress, this.scratch, this.count)
+        for (let i = 0; i < this.count; ++i) {
+            out[offset + this.rows[i]] = this.scratch[i]
+        }
+        return sum
+    }
+
+    /**
+     * Compute the misfit of each row for a spatially varying stress field, written in out[offset + rows[i]]
+     * @param stressAt The stress tensor acting on row i
+     */
+    costsAt(stressAt: (i: number) => HypotheticalSolutionTensorParameters, out: Float64Array, offset: number = 0): void {
+        for (let i = 0; i < this.count; ++i) {
+            this.columns.forEach((c, k) => this.values[k] = c[i])
+            out[offset + this.rows[i]] = this.kernel.cost(this.values, stressAt(i))
+        }
+    }
+
+    /**
+     * Compute the weighted sum of the misfits for a spatially varying stress field, one row at a time
+     * @param stressAt The stress tensor acting on row i
+     */
+    sumCostsAt(stressAt: (i: number) => HypotheticalSolutionTensorParameters): number {
+        let sum = 0
+        for (let i = 0; i < this.count; ++i) {
+            this.columns.forEach((c, k) => this.values[k] = c[i])
+            sum += this.weights[i] * this.kernel.cost(this.values, stressAt(i))
+        }
+        return sum
+    }
+}
+
+// --------------- Hidden to users
+
+type BatchFunction = (columns: Float64Array[], weights: Float64Array, stress: HypotheticalSolutionTensorParameters, out: Float64Array, count: number) => number
+
+type Node =
+    { type: 'num', value: number } |
+    { type: 'column', index: number } |
+    { type: 'stress', name: string } |
+    { type: 'neg', arg: Node } |
+    { type: 'bin', op: string, left: Node, right: Node } |
+    { type: 'call', name: string, args: Node[] }
+
+const STRESS_NAMES = [
+    'sxx', 'sxy', 'sxz', 'syy', 'syz', 'szz',
+    's1', 's2', 's3',
+    's1x', 's1y', 's1z', 's2x', 's2y', 's2z', 's3x', 's3y', 's3z'
+]
+
+// Name and number of arguments of the allowed functions
+const FUNCTIONS: { [name: string]: number } = {
+    abs: 1, sqrt: 1, exp: 1, log: 1, sin: 1, cos: 1, tan: 1, asin: 1, acos: 1, atan: 1,
+    atan2: 2, min: 2, max: 2, pow: 2, clamp: 3, sn: 3, tau: 3
+}
+
+// Float64 columns and weight, plus the Int32 row
+function bytesPerRow(kernel: GenericKernel): number {
+    return 8 * (kernel.columns.length + 1) + 4
+}
+
+function isArrayLike(v: any): v is ArrayLike<number> {
+    return typeof v.length === 'number'
+}
+
+function checkColumns(columns: string[]) {
+    const seen = new Set<string>()
+    columns.forEach(name => {
+        if (!/^[A-Za-z_][A-Za-z0-9_]*$/.test(name)) {
+            throw new Error(`GenericKernel: invalid column name "${name}"`)
+        }
+        if (STRESS_NAMES.includes(name) || FUNCTIONS[name] !== undefined) {
+            throw new Error(`GenericKernel: the column name "${name}" is reserved`)
+        }
+        if (seen.has(name)) {
+            throw new Error(`GenericKernel: duplicated column "${name}"`)
+        }
+        seen.add(name)
+    })
+}
+
+/**
+ * Recursive descent parser. Grammar:
+ *   expr   = term (('+' | '-') term)*
+ *   term   = unary (('*' | '/') unary)*
+ *   unary  = '-' unary | power
+ *   power  = atom ('^' unary)?
+ *   atom   = number | name | name '(' expr (',' expr)* ')' | '(' expr ')'
+ */
+class Parser {
+    private tokens: string[]
+    private pos = 0
+
+    constructor(private expression: string, private columns: string[]) {
+        this.tokens = expression.match(/\d+\.?\d*(?:[eE][+-]?\d+)?|\.\d+(?:[eE][+-]?\d+)?|[A-Za-z_][A-Za-z0-9_]*|\S/g) || []
+    }
+
+    parse(): Node {
+        const node = this.expr()
+        if (this.pos < this.tokens.length) {
+            this.error(`unexpected "${this.tokens[this.pos]}"`)
+        }
+        return node
+    }
+
+    private error(msg: string): never {
+        throw new Error(`GenericKernel: ${msg} in expression "${this.expression}"`)
+    }
+
+    private peek(): string {
+        return this.tokens[this.pos]
+    }
+
+    private expect(t: string) {
+        if (this.tokens[this.pos] !== t) {
+            this.error(`expected "${t}"`)
+        }
+        this.pos++
+    }
+
+    private expr(): Node {
+        let left = this.term()
+        while (this.peek() === '+' || this.peek() === '-') {
+            const op = this.tokens[this.pos++]
+            left = { type: 'bin', op, left, right: this.term() }
+        }
+        return left
+    }
+
+    private term(): Node {
+        let left = this.unary()
+        while (this.peek() === '*' || this.peek() === '/') {
+            const op = this.tokens[this.pos++]
+            left = { type: 'bin', op, left, right: this.unary() }
+        }
+        return left
+    }
+
+    private unary(): Node {
+        if (this.peek() === '-') {
+            this.pos++
+            return { type: 'neg', arg: this.unary() }
+        }
+        if (this.peek() === '+') {
+            this.pos++
+            return this.unary()
+        }
+        return this.power()
+    }
+
+    private power(): Node {
+        const base = this.atom()
+        if (this.peek() === '^') {
+            this.pos++
+            return { type: 'call', name: 'pow', args: [base, this.unary()] }
+        }
+        return base
+    }
+
+    private atom(): Node {
+        const t = this.tokens[this.pos++]
+        if (t === undefined) {
+            this.error('unexpected end')
+        }
+        if (t === '(') {
+            const node = this.expr()
+            this.expect(')')
+            return node
+        }
+        if (/^[\d.]/.test(t)) {
+            const value = Number(t)
+            if (!Number.isFinite(value)) {
+                this.error(`invalid number "${t}"`)
+            }
+            return { type: 'num', value }
+        }
+        if (/^[A-Za-z_]/.test(t)) {
+            if (this.peek() === '(') {
+                const nbArgs = FUNCTIONS[t]
+                if (nbArgs === undefined) {
+                    this.error(`unknown function "${t}"`)
+                }
+                this.pos++
+                const args = [this.expr()]
+                while (this.peek() === ',') {
+                    this.pos++
+                    args.push(this.expr())
+                }
+                this.expect(')')
+                if (args.length !== nbArgs) {
+                    this.error(`${t} expects ${nbArgs} argument(s)`)
+                }
+                return { type: 'call', name: t, args }
+            }
+            const index = this.columns.indexOf(t)
+            if (index !== -1) {
+                return { type: 'column', index }
+            }
+            if (STRESS_NAMES.includes(t)) {
+                return { type: 'stress', name: t }
+            }
+            this.error(`unknown name "${t}"`)
+        }
+        this.error(`unexpected "${t}"`)
+    }
+}
+
+/**
+ * JavaScript code of a node. Only checked nodes reach this point (numbers, known names and allowed functions)
+ */
+function generate(node: Node, column: (index: number) => string): string {
+    switch (node.type) {
+        case 'num': return `(${node.value})`
+        case 'column': return column(node.index)
+        case 'stress': return node.name
+        case 'neg': return `(-${generate(node.arg, column)})`
+        case 'bin': return `(${generate(node.left, column)} ${node.op} ${generate(node.right, column)})`
+        case 'call': {
+            const args = node.args.map(a => generate(a, column)).join(', ')
+            switch (node.name) {
+                case 'clamp': return `clamp_(${args})`
+                case 'sn': return `sn_(${args})`
+                case 'tau': return `tau_(${args})`
+                default: return `Math.${node.name}(${args})`
+            }
+        }
+    }
+}
+
+// Unpack the stress parameters and define the helpers (inlined by the JIT)
+const PROLOGUE = `
+    const S = stress.S
+    const sxx = S[0][0], sxy = S[0][1], sxz = S[0][2], syy = S[1][1], syz = S[1][2], szz = S[2][2]
+    const s1 = stress.s1_X, s2 = stress.s2_Z, s3 = stress.s3_Y
+    const s1x = stress.S1_X[0], s1y = stress.S1_X[1], s1z = stress.S1_X[2]
+    const s2x = stress.S2_Z[0], s2y = stress.S2_Z[1], s2z = stress.S2_Z[2]
+    const s3x = stress.S3_Y[0], s3y = stress.S3_Y[1], s3z = stress.S3_Y[2]
+    const clamp_ = (x, a, b) => x < a ? a : x > b ? b : x
+    const sn_ = (x, y, z) => (sxx * x + sxy * y + sxz * z) * x + (sxy * x + syy * y + syz * z) * y + (sxz * x + syz * y + szz * z) * z
+    const tau_ = (x, y, z) => {
+        const tx = sxx * x + sxy * y + sxz * z, ty = sxy * x + syy * y + syz * z, tz = sxz * x + syz * y + szz * z
+        const n = tx * x + ty * y + tz * z
+        return Math.sqrt(Math.max(0, tx * tx + ty * ty + tz * tz - n * n))
+    }
+`
+
+function rowSource(ast: Node, columns: string[]): string {
+    return `"use strict"; return function (values, stress) {${PROLOGUE}
+    return ${generate(ast, k => `values[${k}]`)}
+}`
+}
+
+function batchSource(ast: Node, columns: string[]): string {
+    const cols = columns.map((_, k) => `const c${k} = columns[${k}]`).join('\n    ')
+    return `"use strict"; return function (columns, weights, stress, out, count) {${PROLOGUE}
+    ${cols}
+    let sum = 0
+    if (out !== undefined) {
+        for (let i = 0; i < count; ++i) {
+            const v = ${generate(ast, k => `c${k}[i]`)}
+            out[i] = v
+            sum += weights[i] * v
+        }
+    } else {
+        for (let i = 0; i < count; ++i) {
+            sum += weights[i] * ${generate(ast, k => `c${k}[i]`)}
+        }
+    }
+    return sum
+}`
+}
+
+function stressEnv(stress: HypotheticalSolutionTensorParameters): { [name: string]: number } {
+    const S = stress.S
+    return {
+        sxx: S[0][0], sxy: S[0][1], sxz: S[0][2], syy: S[1][1], syz: S[1][2], szz: S[2][2],
+        s1: stress.s1_X, s2: stress.s2_Z, s3: stress.s3_Y,
+        s1x: stress.S1_X[0], s1y: stress.S1_X[1], s1z: stress.S1_X[2],
+        s2x: stress.S2_Z[0], s2y: stress.S2_Z[1], s2z: stress.S2_Z[2],
+        s3x: stress.S3_Y[0], s3y: stress.S3_Y[1], s3z: stress.S3_Y[2]
+    }
+}
+
+function interpret(node: Node, values: Float64Array, env: { [name: string]: number }): number {
+    switch (node.type) {
+        case 'num': return node.value
+        case 'column': return values[node.index]
+        case 'stress': return env[node.name]
+        case 'neg': return -interpret(node.arg, values, env)
+        case 'bin': {
+            const a = interpret(node.left, values, env)
+            const b = interpret(node.right, values, env)
+            switch (node.op) {
+                case '+': return a + b
+                case '-': return a - b
+                case '*': return a * b
+                default: return a / b
+            }
+        }
+        case 'call': {
+            const a = node.args.map(arg => interpret(arg, values, env))
+            switch (node.name) {
+                case 'clamp': return a[0] < a[1] ? a[1] : a[0] > a[2] ? a[2] : a[0]
+                case 'sn':
+                case 'tau': {
+                    const tx = env.sxx * a[0] + env.sxy * a[1] + env.sxz * a[2]
+                    const ty = env.sxy * a[0] + env.syy * a[1] + env.syz * a[2]
+                    const tz = env.sxz * a[0] + env.syz * a[1] + env.szz * a[2]
+                    const n = tx * a[0] + ty * a[1] + tz * a[2]
+                    return node.name === 'sn' ? n : Math.sqrt(Math.max(0, tx * tx + ty * ty + tz * tz - n * n))
+                }
+                default: return (Math as any)[node.name](...a)
+            }
+        }
+    }
+}
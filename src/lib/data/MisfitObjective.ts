@@ -0,0 +1,236 @@
+/**
+ * @brief Reduction of the per-datum misfits into the misfit of a dataset
+ * @category Data
+ */
+export enum MisfitObjectiveType {
+    // Weighted mean of the misfits (default)
+    MEAN,
+    // Weighted mean of the misfits, the largest misfits being removed (fraction trim of the total weight)
+    TRIMMED_MEAN,
+    // Weighted quantile of the misfits (quantile = 0.5 for the median)
+    QUANTILE,
+    // Weighted mean of the Huber function of the misfits: m^2 / 2 below delta, delta (m - delta / 2) above
+    HUBER
+}
+
+/**
+ * @brief Robust misfit objective of a dataset (see PackedDataset).
+ * @example
+ * ```ts
+ * const packed = new PackedDataset(data, { objective: { type: MisfitObjectiveType.TRIMMED_MEAN, trim: 0.2 } })
+ * ```
+ * @category Data
+ */
+export type MisfitObjective = {
+    type: MisfitObjectiveType,
+    // TRIMMED_MEAN: fraction of the total weight removed, in [0, 1)
+    trim?: number,
+    // QUANTILE: the quantile, in [0, 1]
+    quantile?: number,
+    // HUBER: the misfit where the quadratic part becomes linear
+    delta?: number
+}
+
+/**
+ * @brief Check the parameters of an objective
+ * @category Data
+ */
+export function checkMisfitObjective(objective: MisfitObjective): void {
+    switch (objective.type) {
+        case MisfitObjectiveType.TRIMMED_MEAN:
+            if (!(objective.trim >= 0 && objective.trim < 1)) {
+                throw new Error(`The trimmed fraction must be in [0, 1) (got ${objective.trim})`)
+            }
+            break
+        case MisfitObjectiveType.QUANTILE:
+            if (!(objective.quantile >= 0 && objective.quantile <= 1)) {
+                throw new Error(`The quantile must be in [0, 1] (got ${objective.quantile})`)
+            }
+            break
+        case MisfitObjectiveType.HUBER:
+            if (!(objective.delta > 0)) {
+                throw new Error(`The Huber threshold must be positive (got ${objective.delta})`)
+            }
+            break
+    }
+}
+
+/**
+ * @brief Reduce per-datum misfits according to an objective, in linear time.
+ *
+ * The trimmed mean and the quantile use a weighted quickselect (expected linear time) instead of a sort.
+ * The order buffer is reordered in place and can be reused from one call to the next (no allocation).
+ * @param objective The objective
+ * @param misfits The misfits (unchanged)
+ * @param weights The weight of each misfit
+ * @param count The number of misfits
+ * @param totalWeight The sum of the weights
+ * @param order Scratch buffer of at least count indices
+ * @category Data
+ */
+export function reduceMisfits(
+    objective: MisfitObjective, misfits: Float64Array, weights: Float64Array, count: number, totalWeight: number, order: Int32Array): number
+{
+    if (count === 0 || totalWeight <= 0) {
+        return 0
+    }
+
+    switch (objective.type) {
+        case MisfitObjectiveType.TRIMMED_MEAN: {
+            const target = (1 - objective.trim) * totalWeight
+            weightedSelect(misfits, weights, count, target, order)
+            // The kept data are the ones below the threshold, plus the part of the threshold datum needed to reach the target weight
+            return (selection.sumBelow + (target - selection.weightBelow) * selection.value) / target
+        }
+        case MisfitObjectiveType.QUANTILE: {
+            weightedSelect(misfits, weights, count, Math.max(objective.quantile * totalWeight, Number.MIN_VALUE), order)
+            return selection.value
+        }
+        case MisfitObjectiveType.HUBER: {
+            let sum = 0
+            for (let i = 0; i < count; ++i) {
+                sum += weights[i] * huber(misfits[i], objective.delta)
+            }
+            return sum / totalWeight
+        }
+        default: {
+            let sum = 0
+            for (let i = 0; i < count; ++i) {
+                sum += weights[i] * misfits[i]
+            }
+            return sum / totalWeight
+        }
+    }
+}
+
+/**
+ * @brief Accumulate the misfits [start, end) of a dataset whose misfits are computed by chunks, to bound the objective
+ * before all the misfits are known (see partialMisfitsLowerBound).
+ * @param objective The objective
+ * @param misfits The misfits
+ * @param weights The weight of each misfit
+ * @param start The first misfit to accumulate
+ * @param end The end of the misfits to accumulate
+ * @param bound The bound of interest (the quantile is only compared with it)
+ * @param sum The value returned for the previous chunks (0 for the first chunk)
+ * @returns The accumulated value of the chunks: the weight of the misfits not below bound for the quantile,
+ * the weighted sum of the terms of the objective otherwise (0 for the trimmed mean)
+ * @category Data
+ */
+export function accumulateMisfits(
+    objective: MisfitObjective, misfits: Float64Array, weights: Float64Array, start: number, end: number, bound: number, sum: number): number
+{
+    switch (objective.type) {
+        case MisfitObjectiveType.TRIMMED_MEAN:
+            return 0
+        case MisfitObjectiveType.QUANTILE:
+            for (let i = start; i < end; ++i) {
+                if (misfits[i] >= bound) {
+                    sum += weights[i]
+                }
+            }
+            return sum
+        case MisfitObjectiveType.HUBER:
+            for (let i = start; i < end; ++i) {
+                sum += weights[i] * huber(misfits[i], objective.delta)
+            }
+            return sum
+        default:
+            for (let i = start; i < end; ++i) {
+                sum += weights[i] * misfits[i]
+            }
+            return sum
+    }
+}
+
+/**
+ * @brief Lower bound of an objective when only some misfits of the dataset are known, the others being unknown (e.g., not computed yet).
+ * It allows to abandon an evaluation as soon as the objective cannot be below a given bound.
+ * The bound is 0 for the trimmed mean, which cannot be bounded without the other misfits.
+ * @param objective The objective
+ * @param sum The known misfits, accumulated by accumulateMisfits
+ * @param totalWeight The sum of the weights of all the misfits
+ * @param bound The bound given to accumulateMisfits
+ * @category Data
+ */
+export function partialMisfitsLowerBound(objective: MisfitObjective, sum: number, totalWeight: number, bound: number): number {
+    if (totalWeight <= 0) {
+        return 0
+    }
+
+    switch (objective.type) {
+        case MisfitObjectiveType.TRIMMED_MEAN:
+            return 0
+        case MisfitObjectiveType.QUANTILE:
+            // The quantile is at least bound if the data not below bound weigh more than (1 - quantile) of the total weight
+            return sum > (1 - objective.quantile) * totalWeight ? bound : 0
+        default:
+            // The terms of the sums are non negative
+            return sum / totalWeight
+    }
+}
+
+// --------------- Hidden to users
+
+function huber(m: number, delta: number): number {
+    return m <= delta ? m * m / 2 : delta * (m - delta / 2)
+}
+
+// Result of weightedSelect (no allocation)
+const selection = {
+    value: 0,
+    // Weight and weighted sum of the misfits strictly below value
+    weightBelow: 0,
+    sumBelow: 0
+}
+
+// Find the smallest misfit such that the weight of the misfits lower or equal reaches target (weighted quickselect, 3-way partition)
+function weightedSelect(misfits: Float64Array, weights: Float64Array, count: number, target: number, order: Int32Array): void {
+    for (let i = 0; i < count; ++i) {
+        order[i] = i
+    }
+
+    let lo = 0, hi = count
+    let weightBelow = 0, sumBelow = 0
+    for (;;) {
+        // Median of three as pivot
+        const a = misfits[order[lo]], b = misfits[order[(lo + hi) >> 1]], c = misfits[order[hi - 1]]
+        const pivot = Math.max(Math.min(a, b), Math.min(Math.max(a, b), c))
+
+        // order[lo, lt) < pivot, order[lt, gt) = pivot, order[gt, hi) > pivot
+        let lt = lo, i = lo, gt = hi
+        let wl = 0, sl = 0, we = 0
+        while (i < gt) {
+            const k = order[i]
+            const m = misfits[k]
+            if (m < pivot) {
+                wl += weights[k]
+                sl += weights[k] * m
+                order[i] = order[lt]
+                order[lt] = k
+                lt++
+                i++
+            } else if (m > pivot) {
+                gt--
+                order[i] = order[gt]
+                order[gt] = k
+            } else {
+                we += weights[k]
+                i++
+            }
+        }
+
+        if (weightBelow + wl >= target && lt > lo) {
+            hi = lt
+        } else if (weightBelow + wl + we >= target || gt === hi) {
+            selection.value = pivot
+            selection.weightBelow = weightBelow + wl
+            selection.sumBelow = sumBelow + sl
+            return
+        } else {
+            weightBelow += wl + we
+            sumBelow += sl + we * pivot
+            lo = gt
+        }
+    }
+}
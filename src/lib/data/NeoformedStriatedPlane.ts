@@ -6,17 +6,16 @@ import {
     multiplyTensors, transposeTensor, minRotAngleRotationTensor, newMatrix3x3
 } from "../types"
 import { Data } from "./Data"
-import { FaultHelper } from "../utils/FaultHelper"
 import { 
     Tokens, FractureStrategy, StriatedPlaneProblemType, 
     createPlane, createRuptureFrictionAngles, 
     createSigma1_nPlaneAngle, createStriation
 } from "./types"
-import { HypotheticalSolutionTensorParameters } from "../geomeca"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
 import { DataArgument, DataStatus, createDataArgument, createDataStatus } from "./DataDescription"
 import { isDefined, toInt } from "../utils"
 import { DataFactory } from "./Factory"
-import { readFrictionAngleInterval, readSigma1nPlaneInterval, readStriatedFaultPlane } from "../io/DataReader"
+import { FaultVectorBatch, faultVectors, readFrictionAngleInterval, readPosition, readSigma1nPlaneInterval, readStriatedFaultPlane } from "../io/DataReader"
 
 
 /** 
@@ -76,7 +75,6 @@ export class NeoformedStriatedPlane extends Data {
     protected plane: boolean = false
     protected nPlane: Vector3 = undefined
     protected nStriation: Vector3 = undefined
-    protected pos: Vector3 = undefined
     protected problemType = StriatedPlaneProblemType.DYNAMIC
     protected strategy = FractureStrategy.ANGLE
     protected oriented = true
@@ -121,10 +119,12 @@ export class NeoformedStriatedPlane extends Data {
         optional: [8, 11, 12, 15, 16]
     */
 
-    initialize(args: Tokens[]): DataStatus {
+    initialize(args: Tokens[], batch: FaultVectorBatch = undefined): DataStatus {
         const toks = args[0]
         let result = createDataStatus()
         const arg: DataArgument = createDataArgument()
+        arg.toks = toks
+        arg.data = this
 
         // -----------------------------------
         // Read parameters definning plane orientation, striation orientation and type of movement
@@ -134,7 +134,8 @@ export class NeoformedStriatedPlane extends Data {
         const ruptureFricAngle = createRuptureFrictionAngles()
         const sigma1_nPlane = createSigma1_nPlaneAngle()
 
-        readStriatedFaultPlane(arg, plane, striation, result)
+        readStriatedFaultPlane(arg, plane, striation, result, batch)
+        readPosition(arg, this.pos, result)
 
         // -----------------------------------
         // Read parameters defining the angular interval for friction of for the angle between Sigma 1 and the plane normal <Sigma 1, nPlane>
@@ -154,7 +155,7 @@ export class NeoformedStriatedPlane extends Data {
         // -----------------------------------
 
         // Check that nPlane and nStriation are unit vectors
-        const f = FaultHelper.create(plane, striation)
+        const f = faultVectors(arg, plane, striation, batch)
 
         this.nPlane = f.normal
         this.nStriation = f.striation
@@ -0,0 +1,792 @@
+import { Engine } from "../geomeca/Engine"
+import { isFieldEngine } from "../geomeca/FieldEngine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
+import { Matrix3x3 } from "../types"
+import { Data } from "./Data"
+import { EvaluationCache } from "./EvaluationCache"
+import { GenericData, GenericKernel, PackedGenericData } from "./GenericData"
+import { accumulateMisfits, checkMisfitObjective, MisfitObjective, MisfitObjectiveType, partialMisfitsLowerBound, reduceMisfits } from "./MisfitObjective"
+import { ABANDON_CHUNK, PackedStriatedPlanes } from "./PackedStriatedPlanes"
+import { StriatedPlaneKin } from "./StriatedPlane_Kin"
+
+/**
+ * @brief Handle of a dataset packed in SharedArrayBuffers (see PackedDataset.share).
+ *
+ * The handle only holds the shared buffers and a few numbers, so posting it to a worker neither copies nor clones the data.
+ * @category Data
+ */
+export type SharedDatasetHandle = {
+    size: number,
+    // The sum of the weights and the number of changes of the weights (see PackedDataset.setWeights)
+    weightState: SharedArrayBuffer,
+    positions: SharedArrayBuffer,
+    othersWeights: SharedArrayBuffer,
+    striatedPlanes: SharedArrayBuffer,
+    // The single precision columns of the striated planes, if they were built (see PackedStriatedPlanes.setSinglePrecision)
+    striatedPlanes32?: SharedArrayBuffer,
+    // One entry per kernel. The kernels are compiled again from their expression by each worker
+    genericData: { expression: string, columns: string[], buffer: SharedArrayBuffer }[]
+}
+
+/**
+ * @brief Columns copied from some rows of a packed dataset (see PackedDataset.subsetPacked)
+ * @category Data
+ */
+export type PackedRows = {
+    striatedPlanes: PackedStriatedPlanes,
+    // The weights of the rows which are not striated planes
+    othersWeights: Float64Array,
+    genericData: PackedGenericData[],
+    // 3 values per row, in the packed order
+    positions: Float64Array
+}
+
+/**
+ * @category Data
+ */
+export type PackedDatasetParams = {
+    // Optional weight of each datum (same order as data). Default is 1 for all the data
+    weights?: ArrayLike<number>,
+    // Allocate the packed columns in SharedArrayBuffers, so that the dataset can be shared with workers (see share)
+    shared?: boolean,
+    // Reduction of the per-datum misfits (weighted mean by default, see setObjective)
+    objective?: MisfitObjective,
+    // Rank the hypothetical stresses in single precision (see setSinglePrecision)
+    singlePrecision?: boolean
+}
+
+/**
+ * @brief Agreement between the single and double precision misfits of a set of hypothetical stresses (see PackedDataset.checkSinglePrecision)
+ * @category Data
+ */
+export type SinglePrecisionCheck = {
+    // Largest absolute difference between the two misfits of a stress
+    maxError: number,
+    // Kendall rank correlation between the two rankings of the stresses (1 if they are the same)
+    rankCorrelation: number,
+    // True if both precisions give the same best stress
+    sameBest: boolean
+}
+
+/**
+ * @brief A dataset split into packed blocks evaluated by batched kernels, plus the data evaluated one by one.
+ *
+ * Striated planes (including the friction variants) are packed once, at construction, into typed columns.
+ * GenericData are packed by kernel (see PackedGenericData) and evaluated by the batched loop of their kernel.
+ * The data types that are not packed yet keep using their own cost() method.
+ *
+ * Each datum can be given a weight (e.g., a spatial taper for local inversions, see SlidingWindowInversion).
+ * The misfit of the dataset is then the weighted mean of the misfits of the data.
+ *
+ * A dataset packed with the shared option can be used by several workers without copy: the main thread posts
+ * the handle returned by share(), and each worker attaches to it with new PackedDataset(handle). The attached dataset
+ * has views on the shared columns (read-only by convention) and its own scratch buffers, so attaching costs the same
+ * whatever the size of the dataset. An attached dataset has no Data objects: it is evaluated by homogeneous or field engines only.
+ * The weights and their sum are shared as well, so the attached datasets see the weights set afterwards on the shared dataset
+ * (see setWeights), provided that the weights are not changed while a worker evaluates the dataset.
+ * The rows of a dataset can be copied into a smaller dataset with their own weights (see subset and subsetPacked),
+ * e.g., for the windows of SlidingWindowInversion, which are then evaluated over their own rows only.
+ *
+ * @example
+ * ```ts
+ * const packed = new PackedDataset(data)
+ * for (...) {
+ *     engine.setHypotheticalStress(Wrot, stressRatio)
+ *     const misfit = packed.cost(engine)
+ * }
+ *
+ * // Sharing with workers
+ * const shared = new PackedDataset(data, { shared: true })
+ * worker.postMessage(shared.share())
+ * // In the worker
+ * onmessage = e => { const packed = new PackedDataset(e.data) ... }
+ * ```
+ * @category Data
+ */
+export class PackedDataset {
+    readonly data: Data[]
+    readonly striatedPlanes: PackedStriatedPlanes
+    // The data which are not striated planes (empty for an attached dataset)
+    readonly others: Data[]
+    // Weights of the others (same order)
+    readonly othersWeights: Float64Array
+    // Packed positions (3 values per row): the striated planes first, then the others
+    readonly positions: Float64Array
+    // Index in data of each packed row (the striated planes first, then the others). Empty for an attached dataset
+    readonly packedOrder: Int32Array
+    // The GenericData of the others, one block per kernel
+    readonly genericData: PackedGenericData[]
+    // Index in others of the data evaluated one by one
+    private plainOthers: Int32Array
+    private size_: number
+    // The sum of the weights and the number of changes of the weights, shared with the attached datasets
+    private weightState_: Float64Array
+    // The number of changes of the weights seen by the cache
+    private weightVersion_ = 0
+    // The weights given at construction (same order as data), if any
+    private weights_: Float64Array = undefined
+    private objective_: MisfitObjective = { type: MisfitObjectiveType.MEAN }
+    private cache_: EvaluationCache = undefined
+    // Scratch of the robust objectives, in the packed order (the striated planes first, then the others)
+    private misfits_: Float64Array = undefined
+    private packedWeights_: Float64Array = undefined
+    private order_: Int32Array = undefined
+
+    /**
+     * @param data The data to pack, the handle of a shared dataset to attach to, or the copied rows of a dataset (see subsetPacked)
+     * @param params The weights of the data and the allocation of the columns
+     */
+    constructor(data: Data[] | SharedDatasetHandle | PackedRows, { weights = undefined, shared = false, objective = undefined, singlePrecision = false }: PackedDatasetParams = {}) {
+        if (objective !== undefined) {
+            checkMisfitObjective(objective)
+            this.objective_ = objective
+        }
+
+        if (isPackedRows(data)) {
+            // Like an attached dataset, without Data objects
+            this.data = []
+            this.others = []
+            this.size_ = data.positions.length / 3
+            this.packedOrder = new Int32Array(0)
+            this.positions = data.positions
+            this.othersWeights = data.othersWeights
+            this.striatedPlanes = data.striatedPlanes
+            this.genericData = data.genericData
+            this.plainOthers = new Int32Array(0)
+            this.weightState_ = new Float64Array(2)
+            this.weightState_[0] = this.striatedPlanes.weights.reduce((a, w) => a + w, 0) + this.othersWeights.reduce((a, w) => a + w, 0)
+            if (singlePrecision) {
+                this.striatedPlanes.setSinglePrecision(true)
+            }
+            return
+        }
+
+        if (!Array.isArray(data)) {
+            const handle = data
+            this.data = []
+            this.others = []
+            this.size_ = handle.size
+            this.weightState_ = new Float64Array(handle.weightState)
+            this.weightVersion_ = this.weightState_[1]
+            this.packedOrder = new Int32Array(0)
+            this.positions = new Float64Array(handle.positions)
+            this.othersWeights = new Float64Array(handle.othersWeights)
+            this.striatedPlanes = PackedStriatedPlanes.attach(handle.striatedPlanes, handle.striatedPlanes32)
+            this.genericData = handle.genericData.map(g => PackedGenericData.attach(GenericKernel.compile(g.expression, g.columns), g.buffer))
+            this.plainOthers = new Int32Array(0)
+            this.striatedPlanes.setSinglePrecision(singlePrecision)
+            return
+        }
+
+        if (weights !== undefined && weights.length !== data.length) {
+            throw new Error(`The number of weights (got ${weights.length}) should be the number of data (got ${data.length})`)
+        }
+
+        this.data = data
+        this.size_ = data.length
+        if (weights !== undefined) {
+            this.weights_ = Float64Array.from(weights)
+        }
+        const planes: StriatedPlaneKin[] = []
+        const planesWeights: number[] = []
+        const planesIndices: number[] = []
+        const others: Data[] = []
+        const othersWeights: number[] = []
+        const othersIndices: number[] = []
+        data.forEach((d, i) => {
+            const w = weights === undefined ? 1 : weights[i]
+            if (d instanceof StriatedPlaneKin) {
+                planes.push(d)
+                planesWeights.push(w)
+                planesIndices.push(i)
+            } else {
+                others.push(d)
+                othersWeights.push(w)
+                othersIndices.push(i)
+            }
+        })
+        this.packedOrder = Int32Array.from([...planesIndices, ...othersIndices])
+
+        const f64 = (n: number) => shared ? new Float64Array(new SharedArrayBuffer(8 * n)) : new Float64Array(n)
+
+        this.striatedPlanes = PackedStriatedPlanes.pack(planes, shared)
+        this.striatedPlanes.weights.set(planesWeights)
+        this.others = others
+        this.othersWeights = f64(othersWeights.length)
+        this.othersWeights.set(othersWeights)
+        const blocks = new Map<GenericKernel, number[]>()
+        const plain: number[] = []
+        others.forEach((d, i) => {
+            if (d instanceof GenericData) {
+                if (!blocks.has(d.kernel)) {
+                    blocks.set(d.kernel, [])
+                }
+                blocks.get(d.kernel).push(i)
+            } else {
+                plain.push(i)
+            }
+        })
+        this.genericData = Array.from(blocks.values()).map(rows => {
+            const block = PackedGenericData.pack(rows.map(r => others[r] as GenericData), rows, shared)
+            rows.forEach((r, k) => block.weights[k] = othersWeights[r])
+            return block
+        })
+        this.plainOthers = new Int32Array(plain)
+        this.weightState_ = f64(2)
+        this.weightState_[0] = planesWeights.reduce((a, w) => a + w, 0) + othersWeights.reduce((a, w) => a + w, 0)
+
+        this.positions = f64(3 * data.length)
+        const ordered: Data[] = [...planes, ...others]
+        ordered.forEach((d, i) => {
+            // Data without position are located at the origin
+            if (d.position !== undefined) {
+                this.positions.set(d.position, 3 * i)
+            }
+        })
+        this.striatedPlanes.setSinglePrecision(singlePrecision)
+    }
+
+    get objective(): MisfitObjective {
+        return this.objective_
+    }
+
+    /**
+     * @brief Set the reduction of the per-datum misfits used by cost() (weighted mean, trimmed mean, quantile or Huber).
+     *
+     * The robust objectives write the per-datum misfits in a scratch buffer allocated once, then reduce them
+     * in linear time (see reduceMisfits). The weighted mean does not need the buffer.
+     */
+    setObjective(objective: MisfitObjective): void {
+        checkMisfitObjective(objective)
+        this.objective_ = objective
+        this.clearCache()
+    }
+
+    get singlePrecision(): boolean {
+        return this.striatedPlanes.singlePrecision
+    }
+
+    /**
+     * @brief Evaluate the striated planes in single precision in cost() and costs() with a homogeneous engine (see PackedStriatedPlanes.setSinglePrecision).
+     * It is enough to rank the trials of a search, but the misfit of the final solution should be evaluated again with exactCost().
+     */
+    setSinglePrecision(enabled: boolean): void {
+        this.striatedPlanes.setSinglePrecision(enabled)
+        this.clearCache()
+    }
+
+    get cache(): EvaluationCache {
+        return this.cache_
+    }
+
+    /**
+     * @brief Memoize the misfits computed by cost() with a homogeneous engine (see EvaluationCache).
+     * The cache is cleared, since it belongs to this dataset. Set undefined to remove the cache.
+     */
+    setCache(cache: EvaluationCache): void {
+        this.cache_ = cache
+        this.clearCache()
+    }
+
+    /**
+     * Sum of the weights of all the data
+     */
+    get totalWeight(): number {
+        return this.weightState_[0]
+    }
+
+    /**
+     * @brief Change the weights of the data in place, without packing the data again
+     * (e.g., for iteratively reweighted inversions, see IterativeReweightedInversion).
+     * The dataset must not be attached. When the dataset is shared, the attached datasets see the new weights
+     * and their caches are cleared at their next evaluation.
+     * @param weights The weight of each datum (same order as data)
+     */
+    setWeights(weights: ArrayLike<number>): void {
+        if (this.data.length !== this.size_) {
+            throw new Error('The weights of an attached dataset cannot be changed')
+        }
+        if (weights.length !== this.size_) {
+            throw new Error(`The number of weights (got ${weights.length}) should be the number of data (got ${this.size_})`)
+        }
+
+        if (this.weights_ === undefined) {
+            this.weights_ = new Float64Array(this.size_)
+        }
+        this.weights_.set(weights)
+
+        const np = this.striatedPlanes.count
+        let total = 0
+        for (let i = 0; i < this.size_; ++i) {
+            const w = weights[this.packedOrder[i]]
+            if (i < np) {
+                this.striatedPlanes.weights[i] = w
+            } else {
+                this.othersWeights[i - np] = w
+            }
+            total += w
+        }
+        for (const block of this.genericData) {
+            block.rows.forEach((r, k) => block.weights[k] = this.othersWeights[r])
+        }
+        this.weightState_[0] = total
+        this.weightState_[1]++
+        this.weightVersion_ = this.weightState_[1]
+        this.clearCache()
+    }
+
+    get size(): number {
+        return this.size_
+    }
+
+    /**
+     * Number of data which are not striated planes
+     */
+    get nbOthers(): number {
+        return this.othersWeights.length
+    }
+
+    /**
+     * @brief Pack a subset of the data, keeping their weights, the objective and the precision (e.g., for multi-fidelity searches,
+     * see SuccessiveHalving, or for the windows of SlidingWindowInversion).
+     * The dataset must not be attached, since an attached dataset has no Data objects (see subsetPacked).
+     * @param indices The indices of the data to keep, in data
+     * @param weights Optional weights of the kept data (same order as indices), replacing their own weights
+     */
+    subset(indices: ArrayLike<number>, weights: ArrayLike<number> = undefined): PackedDataset {
+        if (this.data.length !== this.size_) {
+            throw new Error('An attached dataset cannot be subsampled')
+        }
+        if (weights !== undefined && weights.length !== indices.length) {
+            throw new Error(`The number of weights (got ${weights.length}) should be the number of indices (got ${indices.length})`)
+        }
+        const data = Array.from(indices, i => this.data[i])
+        if (weights === undefined && this.weights_ !== undefined) {
+            weights = Array.from(indices, i => this.weights_[i])
+        }
+        return new PackedDataset(data, { weights, objective: this.objective_, singlePrecision: this.singlePrecision })
+    }
+
+    /**
+     * @brief Copy some rows of the packed columns into a new dataset with their own weights, keeping the objective and the precision.
+     * Unlike subset, the Data objects are not needed, so an attached dataset can be subsampled without copying the whole dataset
+     * (e.g., the windows of SlidingWindowInversion run by the workers). Copying costs O(rows.length), and the new dataset
+     * has no Data objects (as an attached dataset). The dataset must only contain packed data types (as for share).
+     * @param rows The rows to keep, in the packed order (the striated planes first, then the others, as positions)
+     * @param weights The weight of each kept row (same order as rows)
+     */
+    subsetPacked(rows: ArrayLike<number>, weights: ArrayLike<number>): PackedDataset {
+        if (this.plainOthers.length > 0) {
+            throw new Error(`The data of type ${this.others[this.plainOthers[0]].constructor.name} cannot be copied by rows (not packed)`)
+        }
+        if (weights.length !== rows.length) {
+            throw new Error(`The number of weights (got ${weights.length}) should be the number of rows (got ${rows.length})`)
+        }
+
+        const np = this.striatedPlanes.count
+        const planes: number[] = []
+        const planesWeights: number[] = []
+        // New index in the others of each kept row which is not a striated plane
+        const others = new Map<number, number>()
+        const othersWeights: number[] = []
+        const positions = new Float64Array(3 * rows.length)
+        let p = 0
+        for (let r = 0; r < rows.length; ++r) {
+            const i = rows[r]
+            if (i < np) {
+                planes.push(i)
+                planesWeights.push(weights[r])
+                positions.set(this.positions.subarray(3 * i, 3 * i + 3), 3 * p++)
+            }
+        }
+        for (let r = 0; r < rows.length; ++r) {
+            const i = rows[r]
+            if (i >= np) {
+                others.set(i - np, othersWeights.length)
+                othersWeights.push(weights[r])
+                positions.set(this.positions.subarray(3 * i, 3 * i + 3), 3 * p++)
+            }
+        }
+
+        const genericData: PackedGenericData[] = []
+        for (const block of this.genericData) {
+            const indices: number[] = []
+            const blockRows: number[] = []
+            const blockWeights: number[] = []
+            block.rows.forEach((r, k) => {
+                const o = others.get(r)
+                if (o !== undefined) {
+                    indices.push(k)
+                    blockRows.push(o)
+                    blockWeights.push(othersWeights[o])
+                }
+            })
+            if (indices.length > 0) {
+                genericData.push(block.subset(indices, blockRows, blockWeights))
+            }
+        }
+
+        return new PackedDataset({
+            striatedPlanes: this.striatedPlanes.subset(planes, planesWeights),
+            othersWeights: Float64Array.from(othersWeights),
+            genericData,
+            positions
+        }, { objective: this.objective_ })
+    }
+
+    /**
+     * @brief Get the handle of the shared columns, to be posted to workers (see the constructor).
+     * The dataset must have been packed with the shared option, and only contain packed data types
+     * (striated planes and GenericData compiled from an expression).
+     */
+    share(): SharedDatasetHandle {
+        const sab = (a: Float64Array | ArrayBufferLike) => {
+            const buffer = a instanceof Float64Array ? a.buffer : a
+            if (!(buffer instanceof SharedArrayBuffer)) {
+                throw new Error('The dataset must be packed with the shared option to be shared')
+            }
+            return buffer
+        }
+        if (this.plainOthers.length > 0) {
+            throw new Error(`The data of type ${this.others[this.plainOthers[0]].constructor.name} cannot be shared (not packed)`)
+        }
+        return {
+            size: this.size_,
+            weightState: sab(this.weightState_),
+            positions: sab(this.positions),
+            othersWeights: sab(this.othersWeights),
+            striatedPlanes: sab(this.striatedPlanes.buffer),
+            striatedPlanes32: this.striatedPlanes.buffer32 === undefined ? undefined : sab(this.striatedPlanes.buffer32),
+            genericData: this.genericData.map(g => {
+                if (g.kernel.expression === undefined) {
+                    throw new Error('GenericData defined by a plain function cannot be shared (use an expression)')
+                }
+                return { expression: g.kernel.expression, columns: g.kernel.columns, buffer: sab(g.buffer) }
+            })
+        }
+    }
+
+    /**
+     * @brief Compute the misfit of the dataset for the hypothetical stress set in the engine: the (weighted) mean misfit of the data
+     * by default, or the robust objective (see setObjective).
+     * Without weights, the mean is the same as averaging the cost() of each datum.
+     * @param engine The engine
+     * @param bound Optional bound for early abandon (e.g., the best misfit of a search): when the misfit is not below bound,
+     * the evaluation may stop early and return any value >= bound. The trimmed mean is always evaluated completely.
+     * With a cache (see setCache), the misfits of the hypothetical stresses already evaluated are looked up instead.
+     */
+    cost(engine: Engine, bound: number = Number.POSITIVE_INFINITY): number {
+        if (this.size_ === 0 || this.totalWeight === 0) {
+            return 0
+        }
+        if (this.cache_ !== undefined && engine instanceof HomogeneousEngine) {
+            if (this.weightVersion_ !== this.weightState_[1]) {
+                // The weights were changed by the shared dataset
+                this.weightVersion_ = this.weightState_[1]
+                this.cache_.clear()
+            }
+            const cached = this.cache_.lookup(engine.Hrot(), engine.stressRatio(), bound)
+            if (!Number.isNaN(cached)) {
+                return cached
+            }
+            const misfit = this.evaluateCost(engine, bound)
+            this.cache_.store(misfit, misfit < bound)
+            return misfit
+        }
+        return this.evaluateCost(engine, bound)
+    }
+
+    /**
+     * Same as cost(), in double precision and without the cache
+     */
+    exactCost(engine: Engine): number {
+        if (this.size_ === 0 || this.totalWeight === 0) {
+            return 0
+        }
+        const single = this.striatedPlanes.singlePrecision
+        this.striatedPlanes.setSinglePrecision(false)
+        try {
+            return this.evaluateCost(engine, Number.POSITIVE_INFINITY)
+        } finally {
+            this.striatedPlanes.setSinglePrecision(single)
+        }
+    }
+
+    /**
+     * @brief Compare the rankings of hypothetical stresses by their misfits in single and double precision
+     * (e.g., to check that single precision is enough for a dataset before a search).
+     * @param engine The engine
+     * @param stresses The hypothetical stresses (e.g., a sample of the trials of a search)
+     */
+    checkSinglePrecision(engine: Engine, stresses: { rot: Matrix3x3, stressRatio: number }[]): SinglePrecisionCheck {
+        const single = this.striatedPlanes.singlePrecision
+        const n = stresses.length
+        const misfits32 = new Float64Array(n)
+        const misfits64 = new Float64Array(n)
+        try {
+            stresses.forEach(({ rot, stressRatio }, i) => {
+                engine.setHypotheticalStress(rot, stressRatio)
+                this.striatedPlanes.setSinglePrecision(true)
+                misfits32[i] = this.evaluateCost(engine, Number.POSITIVE_INFINITY)
+                this.striatedPlanes.setSinglePrecision(false)
+                misfits64[i] = this.evaluateCost(engine, Number.POSITIVE_INFINITY)
+            })
+        } finally {
+            this.striatedPlanes.setSinglePrecision(single)
+        }
+
+        let maxError = 0, best32 = 0, best64 = 0
+        for (let i = 0; i < n; ++i) {
+            maxError = Math.max(maxError, Math.abs(misfits32[i] - misfits64[i]))
+            if (misfits32[i] < misfits32[best32]) {
+                best32 = i
+            }
+            if (misfits64[i] < misfits64[best64]) {
+                best64 = i
+            }
+        }
+        let concordance = 0
+        for (let i = 0; i < n; ++i) {
+            for (let j = i + 1; j < n; ++j) {
+                concordance += Math.sign(misfits32[i] - misfits32[j]) * Math.sign(misfits64[i] - misfits64[j])
+            }
+        }
+        const pairs = n * (n - 1) / 2
+        return { maxError, rankCorrelation: pairs === 0 ? 1 : concordance / pairs, sameBest: best32 === best64 }
+    }
+
+    private clearCache(): void {
+        if (this.cache_ !== undefined) {
+            this.cache_.clear()
+        }
+    }
+
+    private evaluateCost(engine: Engine, bound: number): number {
+        if (this.objective_.type !== MisfitObjectiveType.MEAN) {
+            return this.robustCost(engine, bound)
+        }
+
+        if (isFieldEngine(engine)) {
+            // The tensors at all the positions are evaluated at once. Only the data which are not packed need
+            // the principal stresses
+            const np = this.striatedPlanes.count
+            engine.evaluate(this.positions, this.size_)
+            let sum = this.striatedPlanes.sumCostsField(engine.tensors())
+            if (this.nbOthers > 0) {
+                engine.decompose(np, this.nbOthers)
+                for (const block of this.genericData) {
+                    sum += block.sumCostsAt(i => engine.stressAt(np + block.rows[i]))
+                }
+                for (let k = 0; k < this.plainOthers.length; ++k) {
+                    const i = this.plainOthers[k]
+                    sum += this.othersWeights[i] * this.others[i].cost({ stress: engine.stressAt(np + i) })
+                }
+            }
+            return sum / this.totalWeight
+        }
+
+        if (!(engine instanceof HomogeneousEngine)) {
+            if (this.data.length !== this.size_) {
+                throw new Error('An attached dataset can only be evaluated by a homogeneous engine or a field engine')
+            }
+            // The stress depends on the position of each datum
+            const planes = this.striatedPlanes
+            let sum = 0
+            for (let i = 0; i < planes.count; ++i) {
+                const d = planes.data[i]
+                sum += planes.weights[i] * d.cost({ stress: engine.stress(d.position) })
+            }
+            for (let i = 0; i < this.others.length; ++i) {
+                const d = this.others[i]
+                sum += this.othersWeights[i] * d.cost({ stress: engine.stress(d.position) })
+            }
+            return sum / this.totalWeight
+        }
+
+        const stress = engine.stress(undefined)
+        const boundSum = bound * this.totalWeight
+        const sum = this.striatedPlanes.sumCosts(stress, boundSum)
+        if (sum >= boundSum) {
+            return sum / this.totalWeight
+        }
+        return (sum + this.othersCost(stress)) / this.totalWeight
+    }
+
+    /**
+     * @brief Compute the misfit of each datum, in the packed order (the striated planes first, then the others)
+     * @param engine The engine
+     * @param out The misfit of the i-th packed datum is written in out[i]
+     */
+    costs(engine: Engine, out: Float64Array): void {
+        const np = this.striatedPlanes.count
+        if (isFieldEngine(engine)) {
+            engine.evaluate(this.positions, this.size_)
+            this.striatedPlanes.costsField(engine.tensors(), out, 0)
+            if (this.nbOthers > 0) {
+                engine.decompose(np, this.nbOthers)
+                for (const block of this.genericData) {
+                    block.costsAt(i => engine.stressAt(np + block.rows[i]), out, np)
+                }
+                for (let k = 0; k < this.plainOthers.length; ++k) {
+                    const i = this.plainOthers[k]
+                    out[np + i] = this.others[i].cost({ stress: engine.stressAt(np + i) })
+                }
+            }
+            return
+        }
+
+        if (!(engine instanceof HomogeneousEngine)) {
+            if (this.data.length !== this.size_) {
+                throw new Error('An attached dataset can only be evaluated by a homogeneous engine or a field engine')
+            }
+            const planes = this.striatedPlanes
+            for (let i = 0; i < np; ++i) {
+                const d = planes.data[i]
+                out[i] = d.cost({ stress: engine.stress(d.position) })
+            }
+            this.others.forEach((d, i) => out[np + i] = d.cost({ stress: engine.stress(d.position) }))
+            return
+        }
+
+        const stress = engine.stress(undefined)
+        this.striatedPlanes.costs(stress, out, 0)
+        this.othersCost(stress, out, np)
+    }
+
+    /**
+     * @brief Compute the (weighted) mean misfit of the dataset for the hypothetical stress set in the engine, together with a lower bound
+     * of the mean misfit over the cell of hypothetical stress tensors centered on it (see BranchAndBound).
+     *
+     * The bounds of the striated planes are deduced from the traction columns filled by the evaluation at the center,
+     * and the other data are bounded by their costLowerBound() method (0 for the GenericData).
+     * @param engine The engine (homogeneous stress field only)
+     * @param rotationRadius The angular radius of the cell
+     * @param stressRatioRadius The half width of the stress ratio interval of the cell
+     * @returns The mean misfit at the center and the lower bound over the cell
+     */
+    costWithLowerBound(engine: Engine, rotationRadius: number, stressRatioRadius: number): [number, number] {
+        if (!(engine instanceof HomogeneousEngine)) {
+            throw new Error('The lower bound of the misfit is only available for a homogeneous stress field')
+        }
+        if (this.objective_.type !== MisfitObjectiveType.MEAN) {
+            throw new Error('The lower bound of the misfit is only available for the mean objective')
+        }
+        if (this.size_ === 0 || this.totalWeight === 0) {
+            return [0, 0]
+        }
+
+        const stress = engine.stress(undefined)
+        const cost = this.striatedPlanes.sumCosts(stress) + this.othersCost(stress)
+        let bound = this.striatedPlanes.sumLowerBoundsFromTractions(rotationRadius, stressRatioRadius)
+        for (let k = 0; k < this.plainOthers.length; ++k) {
+            const i = this.plainOthers[k]
+            bound += this.othersWeights[i] * this.others[i].costLowerBound({ stress, rotationRadius, stressRatioRadius })
+        }
+        return [cost / this.totalWeight, bound / this.totalWeight]
+    }
+
+    /**
+     * Robust objective: the per-datum misfits are written in the scratch buffer, then reduced
+     */
+    private robustCost(engine: Engine, bound: number): number {
+        if (this.misfits_ === undefined) {
+            this.misfits_ = new Float64Array(this.size_)
+            this.order_ = new Int32Array(this.size_)
+            this.packedWeights_ = new Float64Array(this.size_)
+        }
+        // The weights may have been changed since the last evaluation (by this dataset, or by the shared dataset it is attached to)
+        this.packedWeights_.set(this.striatedPlanes.weights)
+        this.packedWeights_.set(this.othersWeights, this.striatedPlanes.count)
+        const misfits = this.misfits_
+
+        if (engine instanceof HomogeneousEngine && bound < Number.POSITIVE_INFINITY && this.objective_.type !== MisfitObjectiveType.TRIMMED_MEAN) {
+            // Early abandon, checked after each chunk of striated planes (as for the mean), then the others are evaluated
+            const stress = engine.stress(undefined)
+            const planes = this.striatedPlanes
+            const np = planes.count
+            planes.checkFrictionAngles()
+            planes.computeTractions(stress)
+            let sum = 0
+            for (let start = 0; start < np; start += ABANDON_CHUNK) {
+                const end = Math.min(np, start + ABANDON_CHUNK)
+                planes.costsFromTractions(misfits, 0, start, end)
+                sum = accumulateMisfits(this.objective_, misfits, this.packedWeights_, start, end, bound, sum)
+                const lower = partialMisfitsLowerBound(this.objective_, sum, this.totalWeight, bound)
+                if (lower >= bound) {
+                    return lower
+                }
+            }
+            this.othersCost(stress, misfits, np)
+        } else {
+            this.costs(engine, misfits)
+        }
+
+        return reduceMisfits(this.objective_, misfits, this.packedWeights_, this.size_, this.totalWeight, this.order_)
+    }
+
+    /**
+     * @brief Compute the weighted sum of the misfits of the others for a homogeneous stress tensor.
+     * @param stress The hypothetical stress tensor
+     * @param misfits Optional per-datum misfits, written in misfits[offset + i] for the i-th datum of others
+     * @param offset The position of the first datum of others in misfits
+     */
+    othersCost(stress: HypotheticalSolutionTensorParameters, misfits: Float64Array = undefined, offset: number = 0): number {
+        let sum = 0
+        for (const block of this.genericData) {
+            sum += misfits === undefined ? block.sumCosts(stress) : block.costs(stress, misfits, offset)
+        }
+        for (let k = 0; k < this.plainOthers.length; ++k) {
+            const i = this.plainOthers[k]
+            const misfit = this.others[i].cost({ stress })
+            if (misfits !== undefined) {
+                misfits[offset + i] = misfit
+            }
+            sum += this.othersWeights[i] * misfit
+        }
+        return sum
+    }
+
+    /**
+     * @brief Compute the (weighted) mean misfit of the dataset over a grid of rock parameters (cohesion, friction angle),
+     * for the hypothetical stress set in the engine.
+     *
+     * The traction components and the costs of the data without friction law are computed only once,
+     * then the friction misfits are deduced for each node of the grid.
+     * @param engine The engine (homogeneous stress field only)
+     * @param cohesions The sampled cohesions
+     * @param frictionAngles The sampled friction angles (in radians)
+     * @param out The mean misfit of node (i, j) is written in out[i * frictionAngles.length + j]
+     */
+    frictionCosts(engine: Engine, cohesions: ArrayLike<number>, frictionAngles: ArrayLike<number>, out: Float64Array): void {
+        if (!(engine instanceof HomogeneousEngine)) {
+            throw new Error('Joint friction inversion is only available for a homogeneous stress field')
+        }
+        if (this.objective_.type !== MisfitObjectiveType.MEAN) {
+            throw new Error('Joint friction inversion is only available for the mean objective')
+        }
+        if (this.size_ === 0 || this.totalWeight === 0) {
+            out.fill(0)
+            return
+        }
+
+        const stress = engine.stress(undefined)
+        const othersSum = this.othersCost(stress)
+
+        this.striatedPlanes.computeTractions(stress)
+
+        const nf = frictionAngles.length
+        for (let i = 0; i < cohesions.length; ++i) {
+            for (let j = 0; j < nf; ++j) {
+                const sum = othersSum + this.striatedPlanes.sumCostsFromTractions(cohesions[i], frictionAngles[j])
+                out[i * nf + j] = sum / this.totalWeight
+            }
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+function isPackedRows(data: Data[] | SharedDatasetHandle | PackedRows): data is PackedRows {
+    return !Array.isArray(data) && data.striatedPlanes instanceof PackedStriatedPlanes
+}
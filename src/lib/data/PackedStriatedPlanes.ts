@@ -0,0 +1,596 @@
+import { Matrix3x3, Vector3 } from "../types"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
+import { computeTractions, computeTractionsField, computeTractionsSingle, createTractionColumns, TractionColumns } from "../geomeca/TractionKernel"
+import { StriatedPlaneKin } from "./StriatedPlane_Kin"
+
+const EPS = 1e-7
+// Number of rows between two checks of the bound of sumCosts
+export const ABANDON_CHUNK = 256
+
+/**
+ * @brief Misfit criterion of a packed striated plane
+ * @category Data
+ */
+export enum StriatedPlaneMisfit {
+    // Angular difference between measured and calculated striae
+    ANGLE,
+    // 0.5 - cos(angular difference) / 2
+    DOT,
+    // Angular difference plus the weighted friction angle deficit relative to the Mohr-Coulomb line of the rock
+    FRICTION_1,
+    // Angular distance between the shifted stress vector and the closest axis satisfying the kinematic and frictional constraints
+    FRICTION_2
+}
+
+/**
+ * @brief Misfit of one striated plane computed from its traction components (see TractionColumns).
+ *
+ * This function is shared by the per-datum cost() methods and by the batched kernel of PackedStriatedPlanes,
+ * so both evaluation paths return exactly the same value.
+ * @param kind The misfit criterion
+ * @param oriented True if the sense of the striation is known
+ * @param normalStress The normal stress (compression < 0)
+ * @param shearStriation The shear stress component along the striation
+ * @param shearPerp The shear stress component along the in-plane direction perpendicular to the striation
+ * @param shearMag The magnitude of the shear stress
+ * @param cohesion The rock cohesion (friction criteria only)
+ * @param frictionAngle The rock friction angle in radians (friction criteria only)
+ * @param frictionWeight The weight of the friction term (FRICTION_1 only)
+ * @category Data
+ */
+export function striatedPlaneMisfit(
+    kind: StriatedPlaneMisfit, oriented: boolean,
+    normalStress: number, shearStriation: number, shearPerp: number, shearMag: number,
+    cohesion: number, frictionAngle: number, frictionWeight: number): number
+{
+    switch (kind) {
+        case StriatedPlaneMisfit.FRICTION_1: return frictionMisfit1(oriented, normalStress, shearStriation, shearMag, cohesion, frictionAngle, frictionWeight)
+        case StriatedPlaneMisfit.FRICTION_2: return frictionMisfit2(normalStress, shearStriation, shearPerp, cohesion, frictionAngle)
+    }
+
+    let cosAngularDifStriae = -1
+    if (shearMag > 0) {
+        // cosAngularDifStriae = cos(angular difference between calculated and measured striae)
+        cosAngularDifStriae = clamp(shearStriation / shearMag)
+    }
+    // else: the calculated shear stress is zero (i.e., the fault plane is parallel to a principal stress)
+    // In such case, the angular difference is taken as PI
+
+    if (kind === StriatedPlaneMisfit.ANGLE) {
+        return oriented ? Math.acos(cosAngularDifStriae) : Math.acos(Math.abs(cosAngularDifStriae))
+    }
+    return oriented ? 0.5 - cosAngularDifStriae / 2 : 0.5 - Math.abs(cosAngularDifStriae) / 2
+}
+
+/**
+ * @brief Lower bound of the misfit of one striated plane over a cell of hypothetical stress tensors (see BranchAndBound),
+ * computed from the traction components at the center of the cell.
+ *
+ * For a normalized stress tensor (principal values -1, -R, 0), the shear stress moves by at most rotationRadius
+ * when the principal frame rotates by rotationRadius, and by at most stressRatioRadius / 2 when the stress ratio changes by stressRatioRadius.
+ * Its direction therefore deviates from the direction at the center by at most asin(deviation / shearMag), plus rotationRadius for
+ * the rotation of the frame itself. The friction criteria are bounded by 0.
+ * @param kind The misfit criterion
+ * @param oriented True if the sense of the striation is known
+ * @param shearStriation The shear stress component along the striation at the center of the cell
+ * @param shearMag The magnitude of the shear stress at the center of the cell
+ * @param rotationRadius The angular radius of the cell
+ * @param stressRatioRadius The half width of the stress ratio interval of the cell
+ * @category Data
+ */
+export function striatedPlaneMisfitLowerBound(
+    kind: StriatedPlaneMisfit, oriented: boolean, shearStriation: number, shearMag: number,
+    rotationRadius: number, stressRatioRadius: number): number
+{
+    if (kind === StriatedPlaneMisfit.FRICTION_1 || kind === StriatedPlaneMisfit.FRICTION_2) {
+        return 0
+    }
+
+    const deviation = rotationRadius + stressRatioRadius / 2
+    if (deviation >= shearMag) {
+        // The shear stress may vanish in the cell, and its direction is then arbitrary
+        return 0
+    }
+
+    const c = clamp(shearStriation / shearMag)
+    const angle = oriented ? Math.acos(c) : Math.acos(Math.abs(c))
+    const bound = Math.max(0, angle - rotationRadius - Math.asin(deviation / shearMag))
+
+    if (kind === StriatedPlaneMisfit.ANGLE) {
+        return bound
+    }
+    return 0.5 - Math.cos(bound) / 2
+}
+
+/**
+ * @brief Packed columns of striated planes (and of the friction variants), evaluated by a batched kernel.
+ *
+ * The traction components of all the planes are computed in one pass for a given stress tensor (see computeTractions),
+ * then the misfit of each row is deduced without any allocation.
+ *
+ * All the columns, except the per-row scratch (tractions), are views on a single buffer, which may be a SharedArrayBuffer
+ * attached by other threads without copy (see attach). The single precision columns, when built, are views on a second buffer
+ * shared in the same way (see setSinglePrecision).
+ *
+ * @example
+ * ```ts
+ * const planes = PackedStriatedPlanes.pack(data.filter(d => d instanceof StriatedPlaneKin))
+ * engine.setHypotheticalStress(Wrot, stressRatio)
+ * const sum = planes.sumCosts(engine.stress(undefined))
+ * ```
+ * @category Data
+ */
+export class PackedStriatedPlanes {
+    // 13 Float64 values (normal, striation, perpendicular, cohesion, friction angle, friction weight, weight) and 2 bytes per row
+    static readonly BYTES_PER_ROW = 13 * 8 + 2
+
+    readonly count: number
+    readonly data: StriatedPlaneKin[]
+    readonly normals: Float64Array
+    readonly striations: Float64Array
+    readonly perpStriations: Float64Array
+    readonly kind: Uint8Array
+    readonly oriented: Uint8Array
+    readonly cohesion: Float64Array
+    readonly frictionAngle: Float64Array
+    readonly frictionWeight: Float64Array
+    // Weight of each row in the sums of misfits (1 by default)
+    readonly weights: Float64Array
+    // Per-row scratch of the batched kernel (never shared)
+    readonly tractions: TractionColumns
+    // The buffer holding all the columns except the tractions
+    readonly buffer: ArrayBufferLike
+    private buffer32_: ArrayBufferLike = undefined
+    private normals32: Float32Array = undefined
+    private striations32: Float32Array = undefined
+    private perpStriations32: Float32Array = undefined
+    private single_ = false
+    // True if the traction columns were computed from the single precision columns
+    private singleTractions_ = false
+    // True if a row with a friction criterion has no rock friction angle (only the given rock parameters can be used)
+    private frictionUnset_ = false
+
+    /**
+     * Pack a list of striated planes (StriatedPlaneKin and its subclasses). Each datum writes its own row.
+     * @param data The striated planes
+     * @param shared Allocate the columns in a SharedArrayBuffer (see PackedDataset.share)
+     */
+    static pack(data: StriatedPlaneKin[], shared: boolean = false): PackedStriatedPlanes {
+        const buffer = shared ? new SharedArrayBuffer(data.length * PackedStriatedPlanes.BYTES_PER_ROW) : undefined
+        const planes = new PackedStriatedPlanes(data, buffer)
+        data.forEach((d, i) => d.pack(planes, i))
+        planes.checkRockParameters()
+        return planes
+    }
+
+    /**
+     * Create views on the columns of planes packed in another thread (no copy). The rows have no datum.
+     * @param buffer The buffer of the packed planes
+     * @param buffer32 Optional buffer of the single precision columns built by the packed planes (see setSinglePrecision)
+     */
+    static attach(buffer: ArrayBufferLike, buffer32: ArrayBufferLike = undefined): PackedStriatedPlanes {
+        const planes = new PackedStriatedPlanes([], buffer)
+        if (buffer32 !== undefined) {
+            planes.createSingleColumns(buffer32)
+        }
+        planes.checkRockParameters()
+        return planes
+    }
+
+    /**
+     * Copy some rows into new planes, with their datum if any (e.g., the data of a window, see PackedDataset.subsetPacked).
+     * The single precision columns are copied as well, if they were built.
+     * @param rows The rows to copy
+     * @param weights The weight of each copied row (same order as rows)
+     */
+    subset(rows: ArrayLike<number>, weights: ArrayLike<number>): PackedStriatedPlanes {
+        const m = rows.length
+        const data = this.data.length === 0 ? [] : Array.from(rows, i => this.data[i])
+        const planes = new PackedStriatedPlanes(data, new ArrayBuffer(m * PackedStriatedPlanes.BYTES_PER_ROW))
+        for (let r = 0; r < m; ++r) {
+            const i = rows[r]
+            for (let k = 0; k < 3; ++k) {
+                planes.normals[3 * r + k] = this.normals[3 * i + k]
+                planes.striations[3 * r + k] = this.striations[3 * i + k]
+                planes.perpStriations[3 * r + k] = this.perpStriations[3 * i + k]
+            }
+            planes.cohesion[r] = this.cohesion[i]
+            planes.frictionAngle[r] = this.frictionAngle[i]
+            planes.frictionWeight[r] = this.frictionWeight[i]
+            planes.weights[r] = weights[r]
+            planes.kind[r] = this.kind[i]
+            planes.oriented[r] = this.oriented[i]
+        }
+        if (this.buffer32_ !== undefined) {
+            planes.createSingleColumns(new ArrayBuffer(9 * 4 * m))
+            for (let r = 0; r < m; ++r) {
+                const i = rows[r]
+                for (let k = 0; k < 3; ++k) {
+                    planes.normals32[3 * r + k] = this.normals32[3 * i + k]
+                    planes.striations32[3 * r + k] = this.striations32[3 * i + k]
+                    planes.perpStriations32[3 * r + k] = this.perpStriations32[3 * i + k]
+                }
+            }
+        }
+        planes.single_ = this.single_
+        planes.checkRockParameters()
+        return planes
+    }
+
+    /**
+     * @param data The striated planes (empty when attaching a buffer)
+     * @param buffer Optional buffer holding the columns (allocated if undefined)
+     */
+    constructor(data: StriatedPlaneKin[], buffer: ArrayBufferLike = undefined) {
+        const n = buffer === undefined ? data.length : buffer.byteLength / PackedStriatedPlanes.BYTES_PER_ROW
+        if (!Number.isInteger(n) || (data.length > 0 && data.length !== n)) {
+            throw new Error(`The buffer of the packed planes does not match the number of planes (got ${data.length})`)
+        }
+        this.count = n
+        this.data = data
+        this.buffer = buffer === undefined ? new ArrayBuffer(n * PackedStriatedPlanes.BYTES_PER_ROW) : buffer
+
+        let offset = 0
+        const f64 = (size: number) => {
+            const a = new Float64Array(this.buffer, offset, size)
+            offset += 8 * size
+            return a
+        }
+        const u8 = (size: number) => {
+            const a = new Uint8Array(this.buffer, offset, size)
+            offset += size
+            return a
+        }
+        this.normals = f64(3 * n)
+        this.striations = f64(3 * n)
+        this.perpStriations = f64(3 * n)
+        this.cohesion = f64(n)
+        this.frictionAngle = f64(n)
+        this.frictionWeight = f64(n)
+        this.weights = f64(n)
+        this.kind = u8(n)
+        this.oriented = u8(n)
+        if (buffer === undefined || data.length > 0) {
+            this.weights.fill(1)
+        }
+        this.tractions = createTractionColumns(n)
+    }
+
+    get singlePrecision(): boolean {
+        return this.single_
+    }
+
+    /**
+     * The buffer holding the single precision columns, undefined until they are built (see setSinglePrecision)
+     */
+    get buffer32(): ArrayBufferLike {
+        return this.buffer32_
+    }
+
+    /**
+     * @brief Evaluate the misfits for a homogeneous stress tensor in single precision, to rank the trials of a search.
+     *
+     * The planes are read from float32 columns, and the angular misfits use an arccosine accurate to 2e-8 instead of Math.acos.
+     * The tractions and the sums are still computed in double precision.
+     *
+     * The float32 columns are built once, at the first call, in a buffer shared as the double precision one (see buffer32).
+     * Attached planes read the columns built by the packed planes, so they must be built before the buffers are posted.
+     * The double precision columns are kept for the exact evaluations (see PackedDataset.exactCost).
+     *
+     * Only the homogeneous evaluations are changed: the field evaluations (sumCostsField and costsField)
+     * and the lower bounds stay in double precision.
+     */
+    setSinglePrecision(enabled: boolean): void {
+        if (enabled && this.buffer32_ === undefined) {
+            if (this.data.length === 0 && this.count > 0) {
+                throw new Error('The single precision columns of attached planes must be built before sharing them (see PackedDataset.share)')
+            }
+            const bytes = 9 * 4 * this.count
+            this.createSingleColumns(this.buffer instanceof SharedArrayBuffer ? new SharedArrayBuffer(bytes) : new ArrayBuffer(bytes))
+            this.normals32.set(this.normals)
+            this.striations32.set(this.striations)
+            this.perpStriations32.set(this.perpStriations)
+        }
+        this.single_ = enabled
+    }
+
+    setPlane(i: number, normal: Vector3, striation: Vector3, perpStriation: Vector3) {
+        const j = 3 * i
+        for (let k = 0; k < 3; ++k) {
+            this.normals[j + k] = normal[k]
+            this.striations[j + k] = striation[k]
+            this.perpStriations[j + k] = perpStriation[k]
+        }
+        if (this.buffer32_ !== undefined) {
+            this.normals32.set(normal, j)
+            this.striations32.set(striation, j)
+            this.perpStriations32.set(perpStriation, j)
+        }
+    }
+
+    /**
+     * Compute the misfit of each row for a homogeneous stress tensor
+     * @param stress The hypothetical stress tensor
+     * @param out The per-row costs, written in out[offset + i]
+     * @param offset The position of the first row in out
+     */
+    costs(stress: HypotheticalSolutionTensorParameters, out: Float64Array, offset: number = 0): void {
+        this.checkFrictionAngles()
+        this.fillTractions(stress.S)
+        this.costsFromTractions(out, offset)
+    }
+
+    /**
+     * Compute the weighted sum of the misfits for a homogeneous stress tensor
+     * @param stress The hypothetical stress tensor
+     * @param bound Optional bound: the sum is abandoned as soon as it reaches bound, and the partial sum (>= bound) is returned
+     */
+    sumCosts(stress: HypotheticalSolutionTensorParameters, bound: number = Number.POSITIVE_INFINITY): number {
+        this.checkFrictionAngles()
+        this.fillTractions(stress.S)
+        return this.sumOwnCostsFromTractions(bound)
+    }
+
+    /**
+     * Compute the weighted sum of the misfits for a spatially varying stress field
+     * @param tensors The packed tensors (6 values per row), row i acting on plane i (see FieldEngine.tensors())
+     */
+    sumCostsField(tensors: Float64Array): number {
+        this.checkFrictionAngles()
+        computeTractionsField(tensors, this.normals, this.striations, this.perpStriations, this.tractions, this.count)
+        this.singleTractions_ = false
+        return this.sumOwnCostsFromTractions()
+    }
+
+    /**
+     * Compute the misfit of each row for a spatially varying stress field
+     * @param tensors The packed tensors (6 values per row), row i acting on plane i (see FieldEngine.tensors())
+     * @param out The per-row costs, written in out[offset + i]
+     * @param offset The position of the first row in out
+     */
+    costsField(tensors: Float64Array, out: Float64Array, offset: number = 0): void {
+        this.checkFrictionAngles()
+        computeTractionsField(tensors, this.normals, this.striations, this.perpStriations, this.tractions, this.count)
+        this.singleTractions_ = false
+        this.costsFromTractions(out, offset)
+    }
+
+    /**
+     * Fill the traction columns for a homogeneous stress tensor, without computing the misfits.
+     * The columns can then be reused by sumCostsFromTractions() for several rock parameters.
+     */
+    computeTractions(stress: HypotheticalSolutionTensorParameters): void {
+        this.fillTractions(stress.S)
+    }
+
+    /**
+     * True if at least one row uses a friction criterion
+     */
+    get hasFriction(): boolean {
+        return this.kind.some(k => k === StriatedPlaneMisfit.FRICTION_1 || k === StriatedPlaneMisfit.FRICTION_2)
+    }
+
+    /**
+     * Compute the weighted sum of the misfits from the traction columns already filled (see computeTractions),
+     * using the given rock parameters for the rows with a friction criterion instead of their own parameters.
+     * The friction weight of each row is kept.
+     * @param cohesion The rock cohesion
+     * @param frictionAngle The rock friction angle in radians
+     */
+    sumCostsFromTractions(cohesion: number, frictionAngle: number): number {
+        const t = this.tractions
+        let sum = 0
+        for (let i = 0; i < this.count; ++i) {
+            sum += this.weights[i] * striatedPlaneMisfit(
+                this.kind[i], this.oriented[i] === 1,
+                t.normalStress[i], t.shearStriation[i], t.shearPerp[i], t.shearMag[i],
+                cohesion, frictionAngle, this.frictionWeight[i])
+        }
+        return sum
+    }
+
+    /**
+     * Compute the weighted sum of the lower bounds of the misfits over a cell of hypothetical stress tensors,
+     * from the traction columns filled at the center of the cell (see striatedPlaneMisfitLowerBound)
+     * @param rotationRadius The angular radius of the cell
+     * @param stressRatioRadius The half width of the stress ratio interval of the cell
+     */
+    sumLowerBoundsFromTractions(rotationRadius: number, stressRatioRadius: number): number {
+        const t = this.tractions
+        let sum = 0
+        for (let i = 0; i < this.count; ++i) {
+            sum += this.weights[i] * striatedPlaneMisfitLowerBound(
+                this.kind[i], this.oriented[i] === 1,
+                t.shearStriation[i], t.shearMag[i],
+                rotationRadius, stressRatioRadius)
+        }
+        return sum
+    }
+
+    /**
+     * Throw if a row with a friction criterion has no rock friction angle. Such rows can be packed, since the rock parameters
+     * may be given by the search (see sumCostsFromTractions and MonteCarloFriction), but not evaluated with their own parameters.
+     */
+    checkFrictionAngles(): void {
+        if (this.frictionUnset_) {
+            // A positive friction angle has to be defined prior to stress tensor inversion
+            throw new Error('For friction analysis choose frictionAngleRock > 0, or invert the rock parameters (see MonteCarloFriction)')
+        }
+    }
+
+    private checkRockParameters(): void {
+        this.frictionUnset_ = false
+        for (let i = 0; i < this.count; ++i) {
+            const k = this.kind[i]
+            if ((k === StriatedPlaneMisfit.FRICTION_1 || k === StriatedPlaneMisfit.FRICTION_2) && !(this.frictionAngle[i] > EPS)) {
+                this.frictionUnset_ = true
+                return
+            }
+        }
+    }
+
+    private createSingleColumns(buffer32: ArrayBufferLike): void {
+        const n = this.count
+        if (buffer32.byteLength !== 9 * 4 * n) {
+            throw new Error('The buffer of the single precision columns does not match the number of planes')
+        }
+        this.buffer32_ = buffer32
+        this.normals32 = new Float32Array(buffer32, 0, 3 * n)
+        this.striations32 = new Float32Array(buffer32, 12 * n, 3 * n)
+        this.perpStriations32 = new Float32Array(buffer32, 24 * n, 3 * n)
+    }
+
+    private fillTractions(S: Matrix3x3): void {
+        this.singleTractions_ = this.single_
+        if (this.single_) {
+            computeTractionsSingle(S, this.normals32, this.striations32, this.perpStriations32, this.tractions, this.count)
+        } else {
+            computeTractions(S, this.normals, this.striations, this.perpStriations, this.tractions, this.count)
+        }
+    }
+
+    private sumOwnCostsFromTractions(bound: number = Number.POSITIVE_INFINITY): number {
+        const t = this.tractions
+        const single = this.singleTractions_
+        let sum = 0
+        for (let start = 0; start < this.count; start += ABANDON_CHUNK) {
+            const end = Math.min(this.count, start + ABANDON_CHUNK)
+            for (let i = start; i < end; ++i) {
+                sum += this.weights[i] * (single && this.kind[i] === StriatedPlaneMisfit.ANGLE
+                    ? angleMisfitSingle(this.oriented[i] === 1, t.shearStriation[i], t.shearMag[i])
+                    : striatedPlaneMisfit(
+                        this.kind[i], this.oriented[i] === 1,
+                        t.normalStress[i], t.shearStriation[i], t.shearPerp[i], t.shearMag[i],
+                        this.cohesion[i], this.frictionAngle[i], this.frictionWeight[i]))
+            }
+            if (sum >= bound) {
+                break
+            }
+        }
+        return sum
+    }
+
+    /**
+     * Compute the misfit of each row from the traction columns already filled
+     * @param out The per-row costs, written in out[offset + i]
+     * @param offset The position of the first row in out
+     * @param start The first row to compute
+     * @param end The end of the rows to compute
+     */
+    costsFromTractions(out: Float64Array, offset: number = 0, start: number = 0, end: number = this.count): void {
+        const t = this.tractions
+        const single = this.singleTractions_
+        for (let i = start; i < end; ++i) {
+            out[offset + i] = single && this.kind[i] === StriatedPlaneMisfit.ANGLE
+                ? angleMisfitSingle(this.oriented[i] === 1, t.shearStriation[i], t.shearMag[i])
+                : striatedPlaneMisfit(
+                    this.kind[i], this.oriented[i] === 1,
+                    t.normalStress[i], t.shearStriation[i], t.shearPerp[i], t.shearMag[i],
+                    this.cohesion[i], this.frictionAngle[i], this.frictionWeight[i])
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+function clamp(v: number): number {
+    return v > 1 ? 1 : (v < -1 ? -1 : v)
+}
+
+// Arccosine with an absolute error below 2e-8 (Abramowitz and Stegun 4.4.46), faster than Math.acos
+function acosSingle(x: number): number {
+    const a = x < 0 ? -x : x
+    const p = 1.5707963050 + a * (-0.2145988016 + a * (0.0889789874 + a * (-0.0501743046 +
+        a * (0.0308918810 + a * (-0.0170881256 + a * (0.0066700901 + a * -0.0012624911))))))
+    const r = Math.sqrt(1 - a) * p
+    return x < 0 ? Math.PI - r : r
+}
+
+// Same as the ANGLE criterion of striatedPlaneMisfit, with acosSingle
+function angleMisfitSingle(oriented: boolean, shearStriation: number, shearMag: number): number {
+    const c = shearMag > 0 ? clamp(shearStriation / shearMag) : -1
+    return acosSingle(oriented ? c : Math.abs(c))
+}
+
+function frictionMisfit1(
+    oriented: boolean, normalStress: number, shearStriation: number, shearMag: number,
+    cohesion: number, frictionAngle: number, frictionWeight: number): number
+{
+    // The misfit distance is defined by the sum of 2 terms:
+    //      1) The angular difference between measured and calculated striation
+    //      2) The weighted angular difference between the friction angle of the fault plane and the rock friction angle,
+    //          for fault planes located below the friction line.
+
+    let angularDifStriae = Math.PI / 2
+    if (shearMag > EPS) {
+        const c = clamp(shearStriation / shearMag)
+        angularDifStriae = oriented ? Math.acos(c) : Math.acos(Math.abs(c))
+    }
+    // else: the fault plane is sub-perpendicular to a principal stress axis and should not be sheared.
+    // The plane is eliminated from the solution set by imposing a large angular difference (PI/2)
+
+    // The normalized Mohr circle is shifted such that the friction line intersects the origin of the plane (normal stress, shear stress)
+    // The normal stress is shifted accordingly by adding deltaNormalStress (compression > 0)
+    const deltaNormalStress = cohesion / Math.tan(frictionAngle)
+    const shiftedNormalStress = - normalStress + deltaNormalStress
+
+    let deltaFrictionAngle = frictionAngle
+    if (shiftedNormalStress > EPS) {
+        // Angle between the shifted stress vector and the Sigma_n axis in the Mohr-Coulomb plane
+        const frictionAngleFaultPlane = Math.atan(shearMag / shiftedNormalStress)
+        // The stress vector satisfies the friction law if it is located along or above the friction line
+        deltaFrictionAngle = frictionAngleFaultPlane >= frictionAngle ? 0 : frictionAngle - frictionAngleFaultPlane
+    }
+    // else: the shear stress and the shifted normal stress are zero, thus the frictional misfit component is maximal
+
+    return angularDifStriae + frictionWeight * deltaFrictionAngle
+}
+
+function frictionMisfit2(
+    normalStress: number, shearStriation: number, shearPerp: number,
+    cohesion: number, frictionAngle: number): number
+{
+    // The misfit distance is the angular distance between the shifted stress vector F and the closest axis Fkf
+    // that satisfies both the kinematical and frictional costraints (see StriatedPlaneFriction2).
+
+    // The stress vector is shifted by -deltaNormalStress n, such that the Mohr Coulomb line intersects the origin:
+    //      F = (normalStress - deltaNormalStress) n + tau
+    const deltaNormalStress = cohesion / Math.tan(frictionAngle)
+    const fn = normalStress - deltaNormalStress
+    const magF = Math.sqrt(fn * fn + shearStriation * shearStriation + shearPerp * shearPerp)
+
+    if (magF <= EPS) {
+        return Math.PI / 2
+    }
+
+    // Normalized stress vector F in the local reference frame (xl,yl,zl) = (striation, perp striation, normal),
+    // using the rock mechanics sign convention for the normal component (compression > 0)
+    const Fx = clamp(shearStriation / magF)
+    const Fy = clamp(Math.abs(shearPerp) / magF)
+    const Fz = clamp(Math.abs(fn) / magF)
+
+    // Colatitude angle theta_z in interval [0, PI/2] since yl >= 0
+    const theta_z = Math.acos(Fy)
+    if (Math.abs(theta_z) <= EPS) {
+        // The stress vector is parallel to yl
+        return Math.PI / 2
+    }
+
+    // Azimuthal angle phi_z in interval [-PI/2, PI/2]:  xl = sin(theta_z) * sin(phi_z)
+    const phi_z = Math.asin(clamp(Fx / Math.sin(theta_z)))
+
+    if (phi_z >= frictionAngle) {
+        // Case 1: the stress vector satisfies the frictional criterion.
+        // The closest axis Fkf is located along a great circle passing by yl
+        return (Math.PI / 2) - theta_z
+    }
+
+    // frictionStriaUnitVecLocal = (sin(frictionAngle), 0, cos(frictionAngle)) is the closest axis satisfying the kinematic and frictional criteria
+    const misfit = Math.acos(clamp(Fx * Math.sin(frictionAngle) + Fz * Math.cos(frictionAngle)))
+    if (phi_z > 0) {
+        // Case 2: the angular difference between measured and calculated striation < PI/2
+        return misfit
+    }
+    // Case 3: the angular difference between measured and calculated striation >= PI/2
+    return Math.max(misfit, Math.PI / 2)
+}
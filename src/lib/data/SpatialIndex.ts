@@ -0,0 +1,211 @@
+import { Point3D } from "../types"
+import { Data } from "./Data"
+
+/**
+ * @brief Uniform grid over the positions of a set of data, for fast neighborhood queries (local inversions).
+ *
+ * The grid is built once in compressed form: the data indices are sorted by cell, and cellStart[c] gives the first
+ * entry of cell c in cellItems (cellStart has one more entry than the number of cells).
+ * Data without position are located at the origin.
+ *
+ * @example
+ * ```ts
+ * const index = new SpatialIndex(data)
+ * const ids = index.queryRadius([1000, 2000, 0], 500)
+ * const local = ids.map(i => data[i])
+ * ```
+ * @category Data
+ */
+export class SpatialIndex {
+    // The indexed data (empty when indexing positions)
+    readonly data: Data[]
+    // Packed positions (3 values per datum, same order as data)
+    readonly positions: Float64Array
+    readonly min: Point3D = [0, 0, 0]
+    readonly max: Point3D = [0, 0, 0]
+    readonly cellSize: number
+    readonly dims: [number, number, number] = [1, 1, 1]
+    private cellStart: Int32Array
+    private cellItems: Int32Array
+
+    /**
+     * @param data The data to index, or their packed positions (3 values per datum, e.g., PackedDataset.positions
+     * in a worker, where the data are attached without Data objects). The positions are not copied
+     * @param cellSize The size of the cells. Default is chosen to have about 4 data per cell
+     */
+    constructor(data: Data[] | Float64Array, cellSize: number = undefined) {
+        if (data instanceof Float64Array) {
+            this.data = []
+            this.positions = data
+        } else {
+            this.data = data
+            this.positions = new Float64Array(3 * data.length)
+            data.forEach((d, i) => {
+                if (d.position !== undefined) {
+                    this.positions.set(d.position, 3 * i)
+                }
+            })
+        }
+        const n = this.positions.length / 3
+
+        for (let k = 0; k < 3; ++k) {
+            this.min[k] = n === 0 ? 0 : Number.POSITIVE_INFINITY
+            this.max[k] = n === 0 ? 0 : Number.NEGATIVE_INFINITY
+        }
+        for (let i = 0; i < n; ++i) {
+            for (let k = 0; k < 3; ++k) {
+                const v = this.positions[3 * i + k]
+                if (v < this.min[k]) this.min[k] = v
+                if (v > this.max[k]) this.max[k] = v
+            }
+        }
+
+        if (cellSize === undefined) {
+            cellSize = defaultCellSize(this.min, this.max, n)
+        }
+        if (!(cellSize > 0)) {
+            throw new Error(`The cell size of the spatial index must be positive (got ${cellSize})`)
+        }
+        this.cellSize = cellSize
+
+        for (let k = 0; k < 3; ++k) {
+            this.dims[k] = Math.max(1, Math.floor((this.max[k] - this.min[k]) / cellSize) + 1)
+        }
+
+        // Counting sort of the data by cell
+        const nbCells = this.dims[0] * this.dims[1] * this.dims[2]
+        const cells = new Int32Array(n)
+        this.cellStart = new Int32Array(nbCells + 1)
+        for (let i = 0; i < n; ++i) {
+            cells[i] = this.cellOf(this.positions[3 * i], this.positions[3 * i + 1], this.positions[3 * i + 2])
+            this.cellStart[cells[i] + 1]++
+        }
+        for (let c = 0; c < nbCells; ++c) {
+            this.cellStart[c + 1] += this.cellStart[c]
+        }
+        const fill = this.cellStart.slice(0, nbCells)
+        this.cellItems = new Int32Array(n)
+        for (let i = 0; i < n; ++i) {
+            this.cellItems[fill[cells[i]]++] = i
+        }
+    }
+
+    get size(): number {
+        return this.positions.length / 3
+    }
+
+    /**
+     * Get the indices of the data whose distance to center is less than or equal to radius
+     * @param center The center of the sphere
+     * @param radius The radius of the sphere
+     * @param out Optional array to fill (cleared first)
+     */
+    queryRadius(center: Point3D, radius: number, out: number[] = []): number[] {
+        out.length = 0
+        const r2 = radius * radius
+        this.visit(
+            [center[0] - radius, center[1] - radius, center[2] - radius],
+            [center[0] + radius, center[1] + radius, center[2] + radius],
+            i => {
+                const dx = this.positions[3 * i] - center[0]
+                const dy = this.positions[3 * i + 1] - center[1]
+                const dz = this.positions[3 * i + 2] - center[2]
+                if (dx * dx + dy * dy + dz * dz <= r2) {
+                    out.push(i)
+                }
+            })
+        return out
+    }
+
+    /**
+     * Get the indices of the data located in the axis aligned box [min, max]
+     * @param out Optional array to fill (cleared first)
+     */
+    queryBox(min: Point3D, max: Point3D, out: number[] = []): number[] {
+        out.length = 0
+        this.visit(min, max, i => {
+            for (let k = 0; k < 3; ++k) {
+                const v = this.positions[3 * i + k]
+                if (v < min[k] || v > max[k]) {
+                    return
+                }
+            }
+            out.push(i)
+        })
+        return out
+    }
+
+    /**
+     * Squared distance between datum i and a point
+     */
+    distance2(i: number, p: Point3D): number {
+        const dx = this.positions[3 * i] - p[0]
+        const dy = this.positions[3 * i + 1] - p[1]
+        const dz = this.positions[3 * i + 2] - p[2]
+        return dx * dx + dy * dy + dz * dz
+    }
+
+    private cellCoord(v: number, k: number): number {
+        const c = Math.floor((v - this.min[k]) / this.cellSize)
+        return c < 0 ? 0 : c >= this.dims[k] ? this.dims[k] - 1 : c
+    }
+
+    private cellOf(x: number, y: number, z: number): number {
+        return this.cellCoord(x, 0) + this.dims[0] * (this.cellCoord(y, 1) + this.dims[1] * this.cellCoord(z, 2))
+    }
+
+    /**
+     * Call cb for each datum of the cells overlapping the box [min, max]
+     */
+    private visit(min: Point3D, max: Point3D, cb: (i: number) => void): void {
+        if (this.positions.length === 0) {
+            return
+        }
+        for (let k = 0; k < 3; ++k) {
+            if (max[k] < this.min[k] || min[k] > this.max[k]) {
+                return
+            }
+        }
+        const i0 = this.cellCoord(min[0], 0), i1 = this.cellCoord(max[0], 0)
+        const j0 = this.cellCoord(min[1], 1), j1 = this.cellCoord(max[1], 1)
+        const k0 = this.cellCoord(min[2], 2), k1 = this.cellCoord(max[2], 2)
+        for (let k = k0; k <= k1; ++k) {
+            for (let j = j0; j <= j1; ++j) {
+                const row = this.dims[0] * (j + this.dims[1] * k)
+                const start = this.cellStart[row + i0]
+                const end = this.cellStart[row + i1 + 1]
+                for (let e = start; e < end; ++e) {
+                    cb(this.cellItems[e])
+                }
+            }
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+const DATA_PER_CELL = 4
+
+/**
+ * Cell size giving about DATA_PER_CELL data per cell, using only the non flat axes of the bounding box
+ * (e.g., data at the same depth are indexed by a 2D grid)
+ */
+function defaultCellSize(min: Point3D, max: Point3D, n: number): number {
+    let measure = 1
+    let dim = 0
+    let largest = 0
+    for (let k = 0; k < 3; ++k) {
+        const extent = max[k] - min[k]
+        largest = Math.max(largest, extent)
+        if (extent > 0) {
+            measure *= extent
+            dim++
+        }
+    }
+    if (dim === 0 || n === 0) {
+        return 1
+    }
+    const size = Math.pow(measure * DATA_PER_CELL / n, 1 / dim)
+    // Avoid too many cells for very anisotropic boxes
+    return Math.max(size, largest / 1024)
+}
@@ -6,7 +6,7 @@ import {
     multiplyTensors, transposeTensor, minRotAngleRotationTensor, newMatrix3x3, deg2rad
 } from "../types"
 import {
-    Direction, FaultHelper, TypeOfMovement,
+    Direction, TypeOfMovement,
     directionExists, getDirectionFromString, getTypeOfMovementFromString, sensOfMovementExists
 } from "../utils/FaultHelper"
 import { Tokens, StriatedPlaneProblemType, createStriation, createPlane, createSigma1_nPlaneAngle } from "./types"
@@ -14,7 +14,7 @@ import { DataArgument, DataStatus, createDataArgument, createDataStatus } from "
 import { toInt } from "../utils"
 import { NeoformedStriatedPlane } from "./NeoformedStriatedPlane"
 import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
-import { readSigma1nPlaneInterval, readStriatedFaultPlane } from "../io/DataReader"
+import { FaultVectorBatch, faultVectors, readPosition, readSigma1nPlaneInterval, readStriatedFaultPlane } from "../io/DataReader"
 
 
 /**
@@ -68,16 +68,19 @@ b) The sense of mouvement is indicated for each fault plane:
 
 export class StriatedCompactionalShearBand extends NeoformedStriatedPlane {
 
-    initialize(args: Tokens[]): DataStatus {
+    initialize(args: Tokens[], batch: FaultVectorBatch = undefined): DataStatus {
         const toks = args[0]
         const result = createDataStatus()
         const arg = createDataArgument()
+        arg.toks = toks
+        arg.data = this
 
         // -----------------------------------
         // Read parameters definning plane orientation, striation orientation and type of movement
         const plane = createPlane()
         const striation = createStriation()
-        readStriatedFaultPlane(arg, plane, striation, result)
+        readStriatedFaultPlane(arg, plane, striation, result, batch)
+        readPosition(arg, this.pos, result)
 
         // -----------------------------------
 
@@ -92,7 +95,7 @@ export class StriatedCompactionalShearBand extends NeoformedStriatedPlane {
         // -----------------------------------
 
         // Check that nPlane and nStriation are unit vectors
-        const f = FaultHelper.create(plane, striation)
+        const f = faultVectors(arg, plane, striation, batch)
 
         this.nPlane = f.normal
         this.nStriation = f.striation
@@ -0,0 +1,110 @@
+import { PackedStriatedPlanes, StriatedPlaneMisfit, striatedPlaneMisfit } from "./PackedStriatedPlanes"
+import { StriatedPlaneKin } from "./StriatedPlane_Kin"
+
+/**
+ * Striated plane constrained by a friction law.
+ *
+ * For each striated fault the misfit distance is defined by the sum of 2 terms:
+ *      1) The angular difference between measured and calculated striation
+ *      2) The weighted angular difference between the friction angle of the fault plane and the rock friction angle,
+ *          for fault planes located below the friction line:
+ *
+ *      misfitDistance = angularDifStriae + weightFriction * deltaFrictionAngle
+ *
+ * The normal stress is calculated by shifting the origin of the normalized Mohr circle, such that the Mohr Coulomb law
+ * (defined by the cohesion and friction angle of the rock) passes by the new origin.
+ * This condition allows to calculate friction angles for the total stress vectors that can be directly compared with the rock friction angle.
+ * Moreover, this condition is consistent with a residual friction law for shear faulting.
+ *
+ * The rock parameters are set through setOptions (e.g., from the json parameters of a csv file):
+ * ```json
+ * "params": {
+ *     "type": "Striated Plane Friction1",
+ *     "friction": 0.5,
+ *     "cohesion": 0.1,
+ *     "weightFriction": 1
+ * }
+ * ```
+ * where the friction angle is in radians and the cohesion is defined for the normalized stress tensor (sigma_1 = -1, sigma_3 = 0).
+ * @category Data
+ */
+export class StriatedPlaneFriction1 extends StriatedPlaneKin {
+    protected cohesionRock_ = 0
+    protected frictionAngleRock_ = 0
+    protected weightFriction_ = 1
+
+    set cohesionRock(c: number) {
+        this.cohesionRock_ = c
+    }
+
+    get cohesionRock() {
+        return this.cohesionRock_
+    }
+
+    set frictionAngleRock(f: number) {
+        if (f <= this.EPS) {
+            // A positive friction angle has to be defined prior to stress tensor inversion
+            throw new Error('For friction analysis choose frictionAngleRock > 0')
+        }
+        this.frictionAngleRock_ = f
+    }
+
+    get frictionAngleRock() {
+        return this.frictionAngleRock_
+    }
+
+    set weightFriction(w: number) {
+        this.weightFriction_ = w
+    }
+
+    get weightFriction() {
+        return this.weightFriction_
+    }
+
+    setOptions(options: { [key: string]: any }): boolean {
+        if (options.cohesion !== undefined) {
+            this.cohesionRock = options.cohesion
+        }
+
+        if (options.friction !== undefined) {
+            this.frictionAngleRock = options.friction
+        }
+
+        if (options.weightFriction !== undefined) {
+            this.weightFriction = options.weightFriction
+        }
+
+        return true
+    }
+
+    /**
+     * The rock parameters are packed even if the friction angle is not set yet, since a joint inversion of the rock parameters
+     * (see MonteCarloFriction) replaces them. The packed misfits check the friction angle instead.
+     */
+    pack(planes: PackedStriatedPlanes, i: number): void {
+        super.pack(planes, i)
+        planes.cohesion[i] = this.cohesionRock_
+        planes.frictionAngle[i] = this.frictionAngleRock_
+        planes.frictionWeight[i] = this.weightFriction_
+    }
+
+    protected misfitKind(): StriatedPlaneMisfit {
+        return StriatedPlaneMisfit.FRICTION_1
+    }
+
+    protected misfit(normalStress: number, shearStriation: number, shearPerp: number, shearMag: number): number {
+        this.checkFrictionAngle()
+        return striatedPlaneMisfit(
+            this.misfitKind(), this.oriented,
+            normalStress, shearStriation, shearPerp, shearMag,
+            this.cohesionRock_, this.frictionAngleRock_, this.weightFriction_
+        )
+    }
+
+    protected checkFrictionAngle() {
+        if (this.frictionAngleRock_ <= this.EPS) {
+            // A positive friction angle has to be defined prior to stress tensor inversion
+            throw new Error('For friction analysis choose frictionAngleRock > 0')
+        }
+    }
+}
@@ -0,0 +1,28 @@
+import { StriatedPlaneMisfit } from "./PackedStriatedPlanes"
+import { StriatedPlaneFriction1 } from "./StriatedPlane_Friction1"
+
+/**
+ * Striated plane constrained by a friction law.
+ *
+ * For each striated fault the misfit distance is defined in terms of an angular distance between the stress vector F
+ * and the closest axis Fkf that satisfies both the kinematical and frictional costraints.
+ * In other words, Fkf is such that its projection on the fault plane is parallel to the measured striation
+ * and it is located along or above the friction line in the Mohr Circle diagram.
+ *
+ * The normal stress is calculated by shifting the origin of the normalized Mohr circle toward the left, such that the friction law passes by the new origin.
+ * This condition allows to calculate friction angles for the total stress vectors that can be directly compared with the rock friction angle.
+ * Moreover, this condition is consistent with a residual friction law for shear faulting.
+ *
+ * Let (xl,yl,zl) be a local right-handed reference frame fixed to the fault plane, where:
+ *      xl = unit vector pointing toward the striation
+ *      yl = unit vector perpendicular to the striation and located in the fault plane
+ *      zl = fault normal (i.e., pointing upward)
+ *
+ * The rock parameters (cohesion, friction angle in radians) are set as for StriatedPlaneFriction1. The friction weight is not used.
+ * @category Data
+ */
+export class StriatedPlaneFriction2 extends StriatedPlaneFriction1 {
+    protected misfitKind(): StriatedPlaneMisfit {
+        return StriatedPlaneMisfit.FRICTION_2
+    }
+}
@@ -1,15 +1,16 @@
-import { Matrix3x3, normalizeVector, scalarProductUnitVectors, Vector3 } from "../types"
+import { Matrix3x3, normalizeVector, scalarProduct, scalarProductUnitVectors, Vector3 } from "../types"
 import { Data } from "./Data"
 import { faultStressComponents } from "../types/mechanics"
 import {
-    FaultHelper, Direction, TypeOfMovement, getDirectionFromString,
+    Direction, TypeOfMovement, getDirectionFromString,
     directionExists, getTypeOfMovementFromString, sensOfMovementExists
 } from "../utils/FaultHelper"
 import { Tokens, FractureStrategy, StriatedPlaneProblemType, createPlane, createStriation } from "./types"
-import { HypotheticalSolutionTensorParameters } from "../geomeca"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
 import { createDataArgument, createDataStatus, DataStatus } from "./DataDescription"
-import { readStriatedFaultPlane } from "../io/DataReader"
+import { FaultVectorBatch, faultVectors, readPosition, readStriatedFaultPlane } from "../io/DataReader"
 import { toInt } from "../utils"
+import { PackedStriatedPlanes, StriatedPlaneMisfit, striatedPlaneMisfit } from "./PackedStriatedPlanes"
 
 /**
  * @category Data
@@ -17,7 +18,6 @@ import { toInt } from "../utils"
 export class StriatedPlaneKin extends Data {
     protected nPlane: Vector3 = undefined
     protected nStriation: Vector3 = undefined
-    protected pos: Vector3 = undefined
     protected problemType = StriatedPlaneProblemType.DYNAMIC
     protected strategy = FractureStrategy.ANGLE
     protected oriented = true
@@ -25,7 +25,7 @@ export class StriatedPlaneKin extends Data {
     protected nPerpStriation: Vector3
     protected noPlane = 0
 
-    initialize(args: Tokens[]): DataStatus {
+    initialize(args: Tokens[], batch: FaultVectorBatch = undefined): DataStatus {
         const toks = args[0]
         const result = createDataStatus()
         const arg = createDataArgument()
@@ -35,14 +35,15 @@ export class StriatedPlaneKin extends Data {
         // Read parameters definning plane orientation, striation orientation and type of movement
         const plane = createPlane()
         const striation = createStriation()
-        readStriatedFaultPlane(arg, plane, striation, result)
+        readStriatedFaultPlane(arg, plane, striation, result, batch)
+        readPosition(arg, this.pos, result)
 
         // -----------------------------------
 
         // If the striation trend is defined (and not the strike direction and rake), then calculate th
 
         // Check that nPlane and nStriation are unit vectors
-        const f = FaultHelper.create(plane, striation)
+        const f = faultVectors(arg, plane, striation, batch)
         this.nPlane = f.normal
         this.nStriation = f.striation
         this.nPerpStriation = f.e_perp_striation
@@ -67,55 +68,58 @@ export class StriatedPlaneKin extends Data {
     cost({ displ, strain, stress }: { displ: Vector3, strain: HypotheticalSolutionTensorParameters, stress: HypotheticalSolutionTensorParameters }): number {
         if (this.problemType === StriatedPlaneProblemType.DYNAMIC) {
             // For the first implementation, use the W&B hyp.
-            // let d = tensor_x_Vector({T: stress, V: this.nPlane}) // Cauchy
-            // d = normalizeVector(d)
 
             //==============  Stress analysis using continuum mechanics sign convention : Compressional stresses < 0
 
             // In principle, principal stresses are negative: (sigma 1, sigma 2, sigma 3) = (-1, -R, 0) 
-            // Calculate the magnitude of the shear stress vector in reference system S
+            // Calculate the stress components applied on the fault plane. The misfit is deduced from these components
+            // by the same function as the one used by the batched kernel (see PackedStriatedPlanes)
             const { shearStress, normalStress, shearStressMag } = faultStressComponents({ stressTensor: stress.S, normal: this.nPlane })
-            let cosAngularDifStriae = 0
-
-            if (shearStressMag > 0) { // shearStressMag > Epsilon would be more realistic ***
-                // nShearStress = unit vector parallel to the shear stress (i.e. representing the calculated striation)
-                let nShearStress = normalizeVector(shearStress, shearStressMag)
-                // The angular difference is calculated using the scalar product: 
-                // nShearStress . nStriation = |nShearStress| |nStriation| cos(angularDifStriae) = 1 . 1 . cos(angularDifStriae)
-                // cosAngularDifStriae = cos(angular difference between calculated and measured striae)
-                cosAngularDifStriae = scalarProductUnitVectors({ U: nShearStress, V: this.nStriation })
-
-            } else {
-                // The calculated shear stress is zero (i.e., the fault plane is parallel to a principal stress)
-                // In such situation we may consider that the calculated striation can have any direction.
-                // Nevertheless, the plane should not display striations as the shear stress is zero.
-                // Thus, in principle the plane is not compatible with the stress tensor, and it should be eliminated from the analysis
-                // In suchh case, the angular difference is taken as PI
-                cosAngularDifStriae = -1
-            }
-
-            if (this.strategy === FractureStrategy.ANGLE) {
-                // The misfit is defined by the angular difference (in radians) between measured and calculated striae
-                if (this.oriented) {
-                    // The sense of the striation is known
-                    return Math.acos(cosAngularDifStriae)
-                } else {
-                    // The sense of the striation is not known. Thus, we choose the sens that minimizes the angular difference 
-                    // and is more compatible with the observed striation.
-                    return Math.acos(Math.abs(cosAngularDifStriae))
-                }
-            } else {
-                // The misfit is defined by the the cosine of the angular difference between measured and calculated striae
-                if (this.oriented) {
-                    return 0.5 - cosAngularDifStriae / 2
-                } else {
-                    return 0.5 - Math.abs(cosAngularDifStriae) / 2
-                }
-            }
+            return this.misfit(
+                normalStress,
+                scalarProduct({ U: shearStress, V: this.nStriation }),
+                scalarProduct({ U: shearStress, V: this.nPerpStriation }),
+                shearStressMag
+            )
         }
         throw new Error('Kinematic not yet available')
     }
 
+    /**
+     * A copy of this datum with another orientation (e.g., the representative of a cluster of data, see CompressedDataset)
+     */
+    withOrientation(normal: Vector3, striation: Vector3, perpStriation: Vector3): StriatedPlaneKin {
+        const d = Object.assign(Object.create(Object.getPrototypeOf(this)), this) as StriatedPlaneKin
+        d.nPlane = normal
+        d.nStriation = striation
+        d.nPerpStriation = perpStriation
+        return d
+    }
+
+    /**
+     * Write this datum into row i of the packed columns used by the batched cost kernel
+     */
+    pack(planes: PackedStriatedPlanes, i: number): void {
+        planes.setPlane(i, this.nPlane, this.nStriation, this.nPerpStriation)
+        planes.kind[i] = this.misfitKind()
+        planes.oriented[i] = this.oriented ? 1 : 0
+    }
+
+    /**
+     * The misfit is defined either by the angular difference (in radians) between measured and calculated striae,
+     * or by the the cosine of this angular difference
+     */
+    protected misfitKind(): StriatedPlaneMisfit {
+        return this.strategy === FractureStrategy.ANGLE ? StriatedPlaneMisfit.ANGLE : StriatedPlaneMisfit.DOT
+    }
+
+    /**
+     * Misfit of this datum from the stress components applied on the plane
+     */
+    protected misfit(normalStress: number, shearStriation: number, shearPerp: number, shearMag: number): number {
+        return striatedPlaneMisfit(this.misfitKind(), this.oriented, normalStress, shearStriation, shearPerp, shearMag, 0, 0, 0)
+    }
+
     predict({ displ, strain, stress }: { displ?: Vector3; strain?: HypotheticalSolutionTensorParameters; stress?: HypotheticalSolutionTensorParameters }): number {
         const { shearStress, normalStress, shearStressMag } = faultStressComponents({ stressTensor: stress.S, normal: this.nPlane })
         let cosAngularDifStriae = 0
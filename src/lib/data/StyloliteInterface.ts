@@ -2,10 +2,11 @@ import { Matrix3x3, scalarProductUnitVectors, Vector3 } from "../types"
 import { fromAnglesToNormal } from "../utils/fromAnglesToNormal"
 import { Data } from "./Data"
 import { Tokens, FractureStrategy } from "./types"
-import { HypotheticalSolutionTensorParameters } from "../geomeca"
+import { HypotheticalSolutionTensorParameters } from "../geomeca/HypotheticalSolutionTensorParameters"
 import { Direction, toInt } from "../utils"
 import { createDataArgument, createDataStatus, DataArgument, DataDescription, DataStatus } from "./DataDescription"
 import { DataFactory } from "./Factory"
+import { readPosition } from "../io/DataReader"
 
 /**
  * 
@@ -66,9 +67,7 @@ import { DataFactory } from "./Factory"
         }
 
         // Read position if any
-        if (toks[19].length !== 0) this.pos[0] = parseFloat(toks[19])
-        if (toks[20].length !== 0) this.pos[1] = parseFloat(toks[20])
-        if (toks[21].length !== 0) this.pos[2] = parseFloat(toks[21])
+        readPosition(arg, this.pos, result)
 
         // Convert into normal
         this.normal = fromAnglesToNormal({strike, dip, dipDirection})
@@ -93,6 +92,17 @@ import { DataFactory } from "./Factory"
         }
     }
 
+    costLowerBound({ stress, rotationRadius }: { stress: HypotheticalSolutionTensorParameters, rotationRadius: number, stressRatioRadius: number }): number {
+        // Sigma 1 moves by at most rotationRadius within the cell, whatever the stress ratio
+        const dot = scalarProductUnitVectors({U: stress.S1_X, V: this.normal})
+        const angle = Math.max(0, Math.acos( Math.min(1, Math.abs(dot)) ) - rotationRadius)
+
+        switch(this.strategy) {
+            case FractureStrategy.DOT: return 1 - Math.cos(angle)
+            default: return angle / Math.PI
+        }
+    }
+
     predict({ displ, strain, stress }: { displ?: Vector3; strain?: HypotheticalSolutionTensorParameters; stress?: HypotheticalSolutionTensorParameters }): number {
         const dot = scalarProductUnitVectors({U: stress.S1_X, V: this.normal})
         return Math.acos( Math.abs(dot) ) / Math.PI
@@ -1,9 +1,10 @@
 import { StyloliteInterface } from "./StyloliteInterface"
 import { SphericalCoords } from "../types/SphericalCoords"
 import { trendPlunge2unitAxis } from "../types"
-import { DataDescription, DataStatus } from "./DataDescription"
+import { createDataArgument, DataDescription, DataStatus } from "./DataDescription"
 import { toFloat } from "../utils"
 import { Tokens } from "./types"
+import { readPosition } from "../io/DataReader"
 
 /**
  * Stylolite teeth are defined by a set of two parameters as follows:
@@ -62,6 +63,9 @@ export class StyloliteTeeth extends StyloliteInterface {
         // The misfit is a normalized function of the angle between the 'normal' and the hypothetical stress axis Sigma 1 
         this.normal = trendPlunge2unitAxis({ trend: this.stylolite_teeth_trend, plunge: this.stylolite_teeth_plunge })
 
+        // Read position if any
+        readPosition(createDataArgument(toks), this.pos, result)
+
         return result
     }
 }
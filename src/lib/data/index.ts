@@ -8,15 +8,21 @@ export * from './ConjugateCompactionalShearBands'
 export * from './ConjugateDilatantShearBands'
 export * from './ConjugateFaults'
 export * from './CompactionBand'
+export * from './CompressedDataset'
 export * from './CrystalFibersInVein'
 export * from './DilationBand'
+export * from './EvaluationCache'
 export * from './ExtensionFracture'
+export * from './GenericData'
+export * from './MisfitObjective'
 export * from './NeoformedStriatedPlane'
+export * from './PackedDataset'
+export * from './PackedStriatedPlanes'
+export * from './SpatialIndex'
 export * from './StriatedCompactionalShearBand'
 export * from './StriatedDilatantShearBand'
-// export * from './StriatedPlane_Friction1'
-// export * from './StriatedPlane_Friction2'
+export * from './StriatedPlane_Friction1'
+export * from './StriatedPlane_Friction2'
 export * from './StriatedPlane_Kin'
 export * from './StyloliteInterface'
 export * from './StyloliteTeeth'
-
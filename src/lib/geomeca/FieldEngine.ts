@@ -0,0 +1,48 @@
+import { Engine } from "./Engine"
+import { HypotheticalSolutionTensorParameters } from "./HypotheticalSolutionTensorParameters"
+
+/**
+ * @brief An engine whose stress varies with the position, evaluated for a whole set of positions at once.
+ *
+ * For each hypothetical stress (i.e., each trial of a search method), the tensors at all the data positions are computed
+ * in one call (evaluate) and cached in a packed buffer of 6 components per row (xx, xy, xz, yy, yz, zz).
+ * The eigen decomposition is only done for the rows that need it (decompose).
+ *
+ * @example
+ * ```ts
+ * engine.setHypotheticalStress(Wrot, stressRatio)
+ * engine.evaluate(positions)
+ * const S = engine.tensors() // used by the batched traction kernel
+ * engine.decompose(0, n)
+ * const stress = engine.stressAt(i) // used by Data.cost()
+ * ```
+ * @category Mechanics
+ */
+export interface FieldEngine extends Engine {
+    /**
+     * Compute and cache the stress tensors at the packed positions (3 values per row)
+     */
+    evaluate(positions: Float64Array, count?: number): void
+
+    /**
+     * The cached tensors (6 values per row)
+     */
+    tensors(): Float64Array
+
+    /**
+     * Compute the principal stresses and directions of the cached rows [first, first + count)
+     */
+    decompose(first: number, count: number): void
+
+    /**
+     * The decomposition of the cached row i (see decompose). The returned object is reused for the next trial.
+     */
+    stressAt(i: number): HypotheticalSolutionTensorParameters
+}
+
+/**
+ * @category Mechanics
+ */
+export function isFieldEngine(engine: Engine): engine is FieldEngine {
+    return engine !== undefined && typeof (engine as FieldEngine).evaluate === 'function' && typeof (engine as FieldEngine).stressAt === 'function'
+}
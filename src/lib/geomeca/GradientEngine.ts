@@ -0,0 +1,185 @@
+import { Matrix3x3, newMatrix3x3, Point3D, Vector3 } from "../types"
+import { FieldEngine } from "./FieldEngine"
+import { fromRotationsToTensor } from "./fromRotationsToTensor"
+import { HypotheticalSolutionTensorParameters } from "./HypotheticalSolutionTensorParameters"
+import { eigenSymmetricBatch } from "./SymmetricEigen"
+
+export type GradientEngineParams = {
+    // The position where the stress is the hypothetical stress of the search method
+    origin?: Point3D,
+    // Variation of the stress tensor per unit length along the X, Y and Z axes (geographic reference system)
+    gradientX?: Matrix3x3,
+    gradientY?: Matrix3x3,
+    gradientZ?: Matrix3x3
+}
+
+/**
+ * @brief Linear stress field: the stress at position p is the hypothetical stress of the search method
+ * (defined at the origin) plus a constant gradient:
+ *
+ *      S(p) = S0(Hrot, R) + (p - origin)_x Gx + (p - origin)_y Gy + (p - origin)_z Gz
+ *
+ * where the gradient tensors Gx, Gy and Gz are symmetric and defined in the geographic reference system S = (X,Y,Z).
+ * Stresses follow the continuum mechanics sign convention (compression < 0).
+ *
+ * For a set of data, the tensors are evaluated at all the positions in one call and cached (see FieldEngine).
+ *
+ * @example
+ * ```ts
+ * // The stress ratio increases by 0.1 per km along Z (in the principal frame of the solution this is not a pure ratio change,
+ * // but the gradient is expressed in the geographic frame)
+ * const engine = new GradientEngine({
+ *     gradientZ: [[0, 0, 0], [0, 0, 0], [0, 0, -1e-4]]
+ * })
+ * searchMethod.setEngine(engine)
+ * ```
+ * @category Mechanics
+ */
+export class GradientEngine implements FieldEngine {
+    private origin: Point3D
+    private gradients = new Float64Array(18)
+    private S0 = new Float64Array(6)
+    private Hrot_: Matrix3x3 = undefined
+    private stressRatio_: number = undefined
+    private S_: Matrix3x3 = undefined
+
+    private tensors_ = new Float64Array(0)
+    private values_ = new Float64Array(0)
+    private vectors_ = new Float64Array(0)
+    private params_: HypotheticalSolutionTensorParameters[] = []
+
+    constructor({ origin = [0, 0, 0], gradientX = newMatrix3x3(), gradientY = newMatrix3x3(), gradientZ = newMatrix3x3() }: GradientEngineParams = {}) {
+        this.origin = [...origin] as Point3D
+        this.setGradient(gradientX, gradientY, gradientZ)
+    }
+
+    setGradient(gradientX: Matrix3x3, gradientY: Matrix3x3, gradientZ: Matrix3x3) {
+        pack(gradientX, this.gradients, 0)
+        pack(gradientY, this.gradients, 6)
+        pack(gradientZ, this.gradients, 12)
+    }
+
+    setHypotheticalStress(Hrot: Matrix3x3, stressRatio: number): void {
+        const s = fromRotationsToTensor(Hrot, stressRatio)
+        this.S_ = s.S
+        this.Hrot_ = Hrot
+        this.stressRatio_ = stressRatio
+        pack(s.S, this.S0, 0)
+    }
+
+    Hrot(): Matrix3x3 {
+        return this.Hrot_
+    }
+
+    stressRatio(): number {
+        return this.stressRatio_
+    }
+
+    S(): Matrix3x3 {
+        return this.S_
+    }
+
+    stress(p: Vector3): HypotheticalSolutionTensorParameters {
+        const position = new Float64Array(p === undefined ? this.origin : p)
+        const tensor = new Float64Array(6)
+        const values = new Float64Array(3)
+        const vectors = new Float64Array(9)
+        this.tensorAt(position, 0, tensor, 0)
+        eigenSymmetricBatch(tensor, values, vectors, 0, 1)
+        const params = createParams()
+        fillParams(params, tensor, 0, values, 0, vectors, 0)
+        return params
+    }
+
+    evaluate(positions: Float64Array, count: number = positions.length / 3): void {
+        this.reserve(count)
+        for (let i = 0; i < count; ++i) {
+            this.tensorAt(positions, 3 * i, this.tensors_, 6 * i)
+        }
+    }
+
+    tensors(): Float64Array {
+        return this.tensors_
+    }
+
+    decompose(first: number, count: number): void {
+        eigenSymmetricBatch(this.tensors_, this.values_, this.vectors_, first, count)
+        for (let i = first; i < first + count; ++i) {
+            fillParams(this.params_[i], this.tensors_, 6 * i, this.values_, 3 * i, this.vectors_, 9 * i)
+        }
+    }
+
+    stressAt(i: number): HypotheticalSolutionTensorParameters {
+        return this.params_[i]
+    }
+
+    private tensorAt(positions: Float64Array, po: number, out: Float64Array, o: number): void {
+        const dx = positions[po] - this.origin[0]
+        const dy = positions[po + 1] - this.origin[1]
+        const dz = positions[po + 2] - this.origin[2]
+        const g = this.gradients
+        for (let k = 0; k < 6; ++k) {
+            out[o + k] = this.S0[k] + dx * g[k] + dy * g[6 + k] + dz * g[12 + k]
+        }
+    }
+
+    private reserve(count: number): void {
+        if (this.params_.length >= count) {
+            return
+        }
+        this.tensors_ = new Float64Array(6 * count)
+        this.values_ = new Float64Array(3 * count)
+        this.vectors_ = new Float64Array(9 * count)
+        while (this.params_.length < count) {
+            this.params_.push(createParams())
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+function pack(S: Matrix3x3, out: Float64Array, o: number): void {
+    out[o] = S[0][0]
+    out[o + 1] = S[0][1]
+    out[o + 2] = S[0][2]
+    out[o + 3] = S[1][1]
+    out[o + 4] = S[1][2]
+    out[o + 5] = S[2][2]
+}
+
+function createParams(): HypotheticalSolutionTensorParameters {
+    return {
+        S: newMatrix3x3(),
+        S1_X: [0, 0, 0],
+        S2_Z: [0, 0, 0],
+        S3_Y: [0, 0, 0],
+        s1_X: 0,
+        s2_Z: 0,
+        s3_Y: 0,
+        Hrot: newMatrix3x3()
+    }
+}
+
+function fillParams(
+    p: HypotheticalSolutionTensorParameters, tensors: Float64Array, to: number,
+    values: Float64Array, vo: number, vectors: Float64Array, eo: number): void
+{
+    const S = p.S
+    S[0][0] = tensors[to]
+    S[0][1] = S[1][0] = tensors[to + 1]
+    S[0][2] = S[2][0] = tensors[to + 2]
+    S[1][1] = tensors[to + 3]
+    S[1][2] = S[2][1] = tensors[to + 4]
+    S[2][2] = tensors[to + 5]
+
+    p.s1_X = values[vo]
+    p.s3_Y = values[vo + 1]
+    p.s2_Z = values[vo + 2]
+
+    // The rows of Hrot are the principal directions (sigma_1, sigma_3, sigma_2)
+    for (let k = 0; k < 3; ++k) {
+        p.S1_X[k] = p.Hrot[0][k] = vectors[eo + k]
+        p.S3_Y[k] = p.Hrot[1][k] = vectors[eo + 3 + k]
+        p.S2_Z[k] = p.Hrot[2][k] = vectors[eo + 6 + k]
+    }
+}
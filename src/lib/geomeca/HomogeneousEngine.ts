@@ -30,10 +30,8 @@ export class HomogeneousEngine implements Engine {
             S3_Y: this.S3_Yh,
             S2_Z: this.S2_Zh, 
             s1_X: this.values[0],
-            s3_Y: this.values[1],
-            s2_Z: this.values[2],
-            // s2_Z: this.values[2],
-            // s3_Y: this.values[1],
+            s2_Z: this.values[1],
+            s3_Y: this.values[2],
             Hrot: this.Hrot_
         }
     }
@@ -0,0 +1,270 @@
+/**
+ * @brief Eigen decomposition of packed symmetric 3x3 tensors.
+ *
+ * Tensors are packed by 6 components per row: (xx, xy, xz, yy, yz, zz).
+ * For row i, the principal stresses are written in values[3i..3i+2] and the normalized eigen vectors (as rows)
+ * in vectors[9i..9i+8], following the ordering of the library (sigma_1, sigma_3, sigma_2), i.e., the ordering of the rows of Hrot:
+ * - values[3i]   = sigma_1 (the most compressive, i.e., the smallest since compression < 0), eigen vector S1_X = vectors[9i..9i+2]
+ * - values[3i+1] = sigma_3 (the largest), eigen vector S3_Y = vectors[9i+3..9i+5]
+ * - values[3i+2] = sigma_2, eigen vector S2_Z = vectors[9i+6..9i+8]
+ *
+ * The eigen vectors define a right-handed reference system: S2_Z = S1_X x S3_Y.
+ *
+ * The eigen values are computed in closed form (trigonometric solution of the characteristic polynomial) and the
+ * eigen vectors of sigma_1 and sigma_3 from the cross products of the rows of (S - sigma I).
+ * Near degenerate tensors (two close eigen values), for which the closed form loses precision on the eigen vectors,
+ * are decomposed using the cyclic Jacobi method instead.
+ *
+ * @param tensors The packed symmetric tensors (6 values per row)
+ * @param values The packed eigen values to fill (3 values per row)
+ * @param vectors The packed eigen vectors to fill (9 values per row)
+ * @param first The first row to decompose
+ * @param count The number of rows to decompose
+ * @category Mechanics
+ */
+export function eigenSymmetricBatch(
+    tensors: Float64Array, values: Float64Array, vectors: Float64Array,
+    first: number = 0, count: number = tensors.length / 6 - first): void
+{
+    for (let i = first; i < first + count; ++i) {
+        if (!analytic(tensors, 6 * i, values, 3 * i, vectors, 9 * i)) {
+            jacobi(tensors, 6 * i, scratch)
+            storeSorted(scratch, values, 3 * i, vectors, 9 * i)
+        }
+    }
+}
+
+/**
+ * @brief Same as eigenSymmetricBatch, but always using the cyclic Jacobi method (slower, used as a reference).
+ * @category Mechanics
+ */
+export function eigenSymmetricBatchJacobi(
+    tensors: Float64Array, values: Float64Array, vectors: Float64Array,
+    first: number = 0, count: number = tensors.length / 6 - first): void
+{
+    for (let i = first; i < first + count; ++i) {
+        jacobi(tensors, 6 * i, scratch)
+        storeSorted(scratch, values, 3 * i, vectors, 9 * i)
+    }
+}
+
+// --------------- Hidden to users
+
+const MAX_SWEEPS = 32
+
+// Minimum relative gap between two eigen values for the closed form eigen vectors
+const MIN_RELATIVE_GAP = 1e-4
+
+/**
+ * Closed form decomposition of the tensor starting at t[o].
+ * Return false (nothing is written) if the tensor is too close to a degenerate one.
+ */
+function analytic(t: Float64Array, o: number, values: Float64Array, vo: number, vectors: Float64Array, eo: number): boolean {
+    const xx = t[o], xy = t[o + 1], xz = t[o + 2]
+    const yy = t[o + 3], yz = t[o + 4], zz = t[o + 5]
+
+    // Deviatoric part B = (S - q I) / p, where q is the mean stress
+    const q = (xx + yy + zz) / 3
+    const dx = xx - q, dy = yy - q, dz = zz - q
+    const p1 = xy * xy + xz * xz + yz * yz
+    const p = Math.sqrt((dx * dx + dy * dy + dz * dz + 2 * p1) / 6)
+    if (p <= 1e-12 * (Math.abs(q) + p)) {
+        return false
+    }
+
+    // det(B) / 2 = cos(3 phi), with the eigen values q + 2 p cos(phi + 2 k pi / 3)
+    const det = dx * (dy * dz - yz * yz) - xy * (xy * dz - yz * xz) + xz * (xy * yz - dy * xz)
+    let r = det / (2 * p * p * p)
+    r = r < -1 ? -1 : r > 1 ? 1 : r
+    const phi = Math.acos(r) / 3
+
+    const s3 = q + 2 * p * Math.cos(phi)                        // max
+    const s1 = q + 2 * p * Math.cos(phi + 2 * Math.PI / 3)      // min
+    const s2 = 3 * q - s1 - s3
+
+    const range = s3 - s1
+    if (s2 - s1 < MIN_RELATIVE_GAP * range || s3 - s2 < MIN_RELATIVE_GAP * range) {
+        return false
+    }
+
+    if (!eigenVector(xx, xy, xz, yy, yz, zz, s1, vectors, eo)) {
+        return false
+    }
+    if (!eigenVector(xx, xy, xz, yy, yz, zz, s3, vectors, eo + 3)) {
+        return false
+    }
+
+    // Orthogonalize S3_Y against S1_X (rounding errors), then S2_Z = S1_X x S3_Y
+    const x1 = vectors[eo], y1 = vectors[eo + 1], z1 = vectors[eo + 2]
+    let x3 = vectors[eo + 3], y3 = vectors[eo + 4], z3 = vectors[eo + 5]
+    const d = x1 * x3 + y1 * y3 + z1 * z3
+    x3 -= d * x1
+    y3 -= d * y1
+    z3 -= d * z1
+    const n3 = 1 / Math.sqrt(x3 * x3 + y3 * y3 + z3 * z3)
+    x3 *= n3
+    y3 *= n3
+    z3 *= n3
+    vectors[eo + 3] = x3
+    vectors[eo + 4] = y3
+    vectors[eo + 5] = z3
+    vectors[eo + 6] = y1 * z3 - z1 * y3
+    vectors[eo + 7] = z1 * x3 - x1 * z3
+    vectors[eo + 8] = x1 * y3 - y1 * x3
+
+    values[vo] = s1
+    values[vo + 1] = s3
+    values[vo + 2] = s2
+    return true
+}
+
+/**
+ * The eigen vector of the simple eigen value l is orthogonal to the rows of (S - l I): take the largest cross product
+ * of two rows. Return false if all the cross products vanish.
+ */
+function eigenVector(
+    xx: number, xy: number, xz: number, yy: number, yz: number, zz: number,
+    l: number, out: Float64Array, o: number): boolean
+{
+    const a = xx - l, b = yy - l, c = zz - l
+
+    // Rows: r0 = (a, xy, xz), r1 = (xy, b, yz), r2 = (xz, yz, c)
+    const u0 = xy * yz - xz * b, u1 = xz * xy - a * yz, u2 = a * b - xy * xy     // r0 x r1
+    const v0 = xy * c - xz * yz, v1 = xz * xz - a * c, v2 = a * yz - xy * xz     // r0 x r2
+    const w0 = b * c - yz * yz, w1 = yz * xz - xy * c, w2 = xy * yz - b * xz     // r1 x r2
+
+    const nu = u0 * u0 + u1 * u1 + u2 * u2
+    const nv = v0 * v0 + v1 * v1 + v2 * v2
+    const nw = w0 * w0 + w1 * w1 + w2 * w2
+
+    let x = u0, y = u1, z = u2, n = nu
+    if (nv > n) {
+        x = v0; y = v1; z = v2; n = nv
+    }
+    if (nw > n) {
+        x = w0; y = w1; z = w2; n = nw
+    }
+    if (n === 0) {
+        return false
+    }
+
+    const inv = 1 / Math.sqrt(n)
+    out[o] = x * inv
+    out[o + 1] = y * inv
+    out[o + 2] = z * inv
+    return true
+}
+
+// Scratch buffers: a = symmetric matrix (full storage), v = eigen vectors (as columns), d = eigen values
+type Scratch = {
+    a: Float64Array,
+    v: Float64Array,
+    d: Float64Array
+}
+
+const scratch: Scratch = {
+    a: new Float64Array(9),
+    v: new Float64Array(9),
+    d: new Float64Array(3)
+}
+
+/**
+ * Cyclic Jacobi method on the tensor starting at t[o]. The eigen values are written in s.d and the eigen vectors in the columns of s.v
+ */
+function jacobi(t: Float64Array, o: number, s: Scratch): void {
+    const a = s.a, v = s.v
+    a[0] = t[o]; a[1] = t[o + 1]; a[2] = t[o + 2]
+    a[3] = t[o + 1]; a[4] = t[o + 3]; a[5] = t[o + 4]
+    a[6] = t[o + 2]; a[7] = t[o + 4]; a[8] = t[o + 5]
+    v.fill(0)
+    v[0] = v[4] = v[8] = 1
+
+    const scale = Math.abs(a[0]) + Math.abs(a[4]) + Math.abs(a[8]) + Math.abs(a[1]) + Math.abs(a[2]) + Math.abs(a[5])
+    const tol = 1e-15 * scale
+
+    for (let sweep = 0; sweep < MAX_SWEEPS; ++sweep) {
+        const off = Math.abs(a[1]) + Math.abs(a[2]) + Math.abs(a[5])
+        if (off <= tol) {
+            break
+        }
+        rotate(a, v, 0, 1)
+        rotate(a, v, 0, 2)
+        rotate(a, v, 1, 2)
+    }
+
+    s.d[0] = a[0]
+    s.d[1] = a[4]
+    s.d[2] = a[8]
+}
+
+/**
+ * Jacobi rotation cancelling a[p][q]
+ */
+function rotate(a: Float64Array, v: Float64Array, p: number, q: number): void {
+    const apq = a[3 * p + q]
+    if (apq === 0) {
+        return
+    }
+    const app = a[3 * p + p]
+    const aqq = a[3 * q + q]
+    const theta = (aqq - app) / (2 * apq)
+    const t = (theta >= 0 ? 1 : -1) / (Math.abs(theta) + Math.sqrt(theta * theta + 1))
+    const c = 1 / Math.sqrt(t * t + 1)
+    const s = t * c
+
+    a[3 * p + p] = app - t * apq
+    a[3 * q + q] = aqq + t * apq
+    a[3 * p + q] = a[3 * q + p] = 0
+
+    // The remaining index r (p, q, r) is a permutation of (0, 1, 2)
+    const r = 3 - p - q
+    const arp = a[3 * r + p]
+    const arq = a[3 * r + q]
+    a[3 * r + p] = a[3 * p + r] = c * arp - s * arq
+    a[3 * r + q] = a[3 * q + r] = s * arp + c * arq
+
+    for (let k = 0; k < 3; ++k) {
+        const vkp = v[3 * k + p]
+        const vkq = v[3 * k + q]
+        v[3 * k + p] = c * vkp - s * vkq
+        v[3 * k + q] = s * vkp + c * vkq
+    }
+}
+
+/**
+ * Store the eigen values and vectors of the scratch in the (sigma_1, sigma_3, sigma_2) ordering.
+ * The eigen vectors are read from the columns of s.v
+ */
+function storeSorted(s: Scratch, values: Float64Array, vo: number, vectors: Float64Array, eo: number): void {
+    const d = s.d, v = s.v
+
+    // i1 = index of sigma_1 (min), i3 = index of sigma_3 (max), i2 = the remaining one
+    let i1 = 0, i3 = 0
+    for (let k = 1; k < 3; ++k) {
+        if (d[k] < d[i1]) i1 = k
+        if (d[k] > d[i3]) i3 = k
+    }
+    if (i1 === i3) {
+        // Isotropic tensor: any orthonormal basis is a solution
+        i1 = 0
+        i3 = 1
+    }
+    const i2 = 3 - i1 - i3
+
+    values[vo] = d[i1]
+    values[vo + 1] = d[i3]
+    values[vo + 2] = d[i2]
+
+    const x1 = v[i1], y1 = v[3 + i1], z1 = v[6 + i1]
+    const x3 = v[i3], y3 = v[3 + i3], z3 = v[6 + i3]
+    vectors[eo] = x1
+    vectors[eo + 1] = y1
+    vectors[eo + 2] = z1
+    vectors[eo + 3] = x3
+    vectors[eo + 4] = y3
+    vectors[eo + 5] = z3
+    // S2_Z = S1_X x S3_Y (right-handed principal reference system, as Hrot)
+    vectors[eo + 6] = y1 * z3 - z1 * y3
+    vectors[eo + 7] = z1 * x3 - x1 * z3
+    vectors[eo + 8] = x1 * y3 - y1 * x3
+}
@@ -0,0 +1,163 @@
+import { Matrix3x3 } from "../types"
+
+/**
+ * @brief Packed per-datum traction components acting on planes.
+ *
+ * Row i of each column refers to the i-th plane of the packed columns given to computeTractions.
+ * Stresses follow the continuum mechanics sign convention (compression < 0).
+ * @category Mechanics
+ */
+export type TractionColumns = {
+    // Normal stress: sigma_n = (S n) . n
+    normalStress: Float64Array,
+    // Shear stress component along the measured striation: tau . s
+    shearStriation: Float64Array,
+    // Shear stress component along the in-plane direction perpendicular to the striation: tau . p
+    shearPerp: Float64Array,
+    // Magnitude of the shear stress vector: |tau|
+    shearMag: Float64Array
+}
+
+/**
+ * @category Mechanics
+ */
+export function createTractionColumns(n: number): TractionColumns {
+    return {
+        normalStress: new Float64Array(n),
+        shearStriation: new Float64Array(n),
+        shearPerp: new Float64Array(n),
+        shearMag: new Float64Array(n)
+    }
+}
+
+/**
+ * @brief Compute in one pass the traction components of a homogeneous stress tensor S on a set of packed planes.
+ *
+ * Vectors are packed by triplets (x, y, z) of a Float64Array, i.e., the normal of plane i is (normals[3i], normals[3i+1], normals[3i+2]).
+ * For each plane, the total stress vector t = S n is evaluated once and decomposed into the normal stress and the shear stress vector,
+ * which is projected onto the striation s and onto the perpendicular in-plane direction p.
+ * @param S The stress tensor defined in the geographic reference system S = (X,Y,Z)
+ * @param normals Packed unit normals
+ * @param striations Packed unit striations
+ * @param perps Packed unit vectors perpendicular to the striations and located in the planes
+ * @param out The traction columns to fill (no allocation)
+ * @param count The number of planes to process (default is out.normalStress.length)
+ * @category Mechanics
+ */
+export function computeTractions(
+    S: Matrix3x3, normals: Float64Array, striations: Float64Array, perps: Float64Array,
+    out: TractionColumns, count: number = out.normalStress.length): void
+{
+    const s00 = S[0][0], s01 = S[0][1], s02 = S[0][2]
+    const s10 = S[1][0], s11 = S[1][1], s12 = S[1][2]
+    const s20 = S[2][0], s21 = S[2][1], s22 = S[2][2]
+
+    const normalStress = out.normalStress
+    const shearStriation = out.shearStriation
+    const shearPerp = out.shearPerp
+    const shearMag = out.shearMag
+
+    for (let i = 0, j = 0; i < count; ++i, j += 3) {
+        const nx = normals[j], ny = normals[j + 1], nz = normals[j + 2]
+
+        // Total stress vector t = S n
+        const tx = s00 * nx + s01 * ny + s02 * nz
+        const ty = s10 * nx + s11 * ny + s12 * nz
+        const tz = s20 * nx + s21 * ny + s22 * nz
+
+        // Normal stress (negative = compression)
+        const sn = tx * nx + ty * ny + tz * nz
+
+        // Shear stress vector: tau = t - sn n
+        const ux = tx - sn * nx
+        const uy = ty - sn * ny
+        const uz = tz - sn * nz
+
+        normalStress[i] = sn
+        shearStriation[i] = ux * striations[j] + uy * striations[j + 1] + uz * striations[j + 2]
+        shearPerp[i] = ux * perps[j] + uy * perps[j + 1] + uz * perps[j + 2]
+        shearMag[i] = Math.sqrt(ux * ux + uy * uy + uz * uz)
+    }
+}
+
+/**
+ * @brief Same as computeTractions, but reading planes stored in single precision (see PackedStriatedPlanes.setSinglePrecision).
+ * The arithmetic and the traction columns stay in double precision.
+ * @category Mechanics
+ */
+export function computeTractionsSingle(
+    S: Matrix3x3, normals: Float32Array, striations: Float32Array, perps: Float32Array,
+    out: TractionColumns, count: number = out.normalStress.length): void
+{
+    const s00 = S[0][0], s01 = S[0][1], s02 = S[0][2]
+    const s10 = S[1][0], s11 = S[1][1], s12 = S[1][2]
+    const s20 = S[2][0], s21 = S[2][1], s22 = S[2][2]
+
+    const normalStress = out.normalStress
+    const shearStriation = out.shearStriation
+    const shearPerp = out.shearPerp
+    const shearMag = out.shearMag
+
+    for (let i = 0, j = 0; i < count; ++i, j += 3) {
+        const nx = normals[j], ny = normals[j + 1], nz = normals[j + 2]
+
+        const tx = s00 * nx + s01 * ny + s02 * nz
+        const ty = s10 * nx + s11 * ny + s12 * nz
+        const tz = s20 * nx + s21 * ny + s22 * nz
+
+        const sn = tx * nx + ty * ny + tz * nz
+
+        const ux = tx - sn * nx
+        const uy = ty - sn * ny
+        const uz = tz - sn * nz
+
+        normalStress[i] = sn
+        shearStriation[i] = ux * striations[j] + uy * striations[j + 1] + uz * striations[j + 2]
+        shearPerp[i] = ux * perps[j] + uy * perps[j + 1] + uz * perps[j + 2]
+        shearMag[i] = Math.sqrt(ux * ux + uy * uy + uz * uz)
+    }
+}
+
+/**
+ * @brief Same as computeTractions, but with one stress tensor per plane (spatially varying stress field).
+ *
+ * The tensors are packed by 6 components per row: (xx, xy, xz, yy, yz, zz), i.e., the tensor acting on plane i
+ * starts at tensors[6i] (see FieldEngine.tensors()).
+ * @param tensors Packed symmetric stress tensors defined in the geographic reference system S = (X,Y,Z)
+ * @param normals Packed unit normals
+ * @param striations Packed unit striations
+ * @param perps Packed unit vectors perpendicular to the striations and located in the planes
+ * @param out The traction columns to fill (no allocation)
+ * @param count The number of planes to process (default is out.normalStress.length)
+ * @category Mechanics
+ */
+export function computeTractionsField(
+    tensors: Float64Array, normals: Float64Array, striations: Float64Array, perps: Float64Array,
+    out: TractionColumns, count: number = out.normalStress.length): void
+{
+    const normalStress = out.normalStress
+    const shearStriation = out.shearStriation
+    const shearPerp = out.shearPerp
+    const shearMag = out.shearMag
+
+    for (let i = 0, j = 0, k = 0; i < count; ++i, j += 3, k += 6) {
+        const sxx = tensors[k], sxy = tensors[k + 1], sxz = tensors[k + 2]
+        const syy = tensors[k + 3], syz = tensors[k + 4], szz = tensors[k + 5]
+        const nx = normals[j], ny = normals[j + 1], nz = normals[j + 2]
+
+        const tx = sxx * nx + sxy * ny + sxz * nz
+        const ty = sxy * nx + syy * ny + syz * nz
+        const tz = sxz * nx + syz * ny + szz * nz
+
+        const sn = tx * nx + ty * ny + tz * nz
+
+        const ux = tx - sn * nx
+        const uy = ty - sn * ny
+        const uz = tz - sn * nz
+
+        normalStress[i] = sn
+        shearStriation[i] = ux * striations[j] + uy * striations[j + 1] + uz * striations[j + 2]
+        shearPerp[i] = ux * perps[j] + uy * perps[j + 1] + uz * perps[j + 2]
+        shearMag[i] = Math.sqrt(ux * ux + uy * uy + uz * uz)
+    }
+}
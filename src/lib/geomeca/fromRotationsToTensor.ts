@@ -1,4 +1,4 @@
-import { stressTensorDelta } from "../search"
+import { stressTensorDelta } from "../search/utils"
 import { Matrix3x3, Vector3, transposeTensor } from "../types"
 import { HypotheticalSolutionTensorParameters } from "./HypotheticalSolutionTensorParameters"
 
@@ -1,3 +1,7 @@
 export { Engine } from './Engine'
 export { HypotheticalSolutionTensorParameters } from './HypotheticalSolutionTensorParameters'
 export { HomogeneousEngine } from './HomogeneousEngine'
+export * from './TractionKernel'
+export * from './FieldEngine'
+export * from './GradientEngine'
+export * from './SymmetricEigen'
@@ -1,3 +1,4 @@
+// Main entry: every module is evaluated on import. The inversion server and its workers use the slim entry (see core.ts)
 export * from './analysis'
 export * from './data'
 export * from './types'
@@ -6,4 +7,6 @@ export * from './search'
 export * from './io'
 
 export * from './InverseMethod'
-
+export * from './InteractiveSession'
+export * from './SlidingWindowInversion'
+export * from './IterativeReweightedInversion'
@@ -1,12 +1,23 @@
-import { DataArgument, DataDescription, DataFactory, DataStatus, Plane, RuptureFrictionAngles, Sigma1_nPlaneAngle, Striation } from "../data"
-import { deg2rad } from "../types"
-import { Direction, TypeOfMovement, isDefined, isGeographicDirection, isNumber, isTypeOfMovement } from "../utils"
+import { DataArgument, DataDescription, DataStatus, createDataArgument, createDataStatus } from "../data/DataDescription"
+import { DataFactory } from "../data/Factory"
+import { Plane, RuptureFrictionAngles, Sigma1_nPlaneAngle, Striation, Tokens, createPlane, createStriation } from "../data/types"
+import { deg2rad, Point3D, Vector3 } from "../types"
+import {
+    Direction, FaultAngleColumns, FaultBatchError, FaultHelper, FaultVectorColumns, TypeOfMovement, createFaultAngleColumns, fromAnglesToVectorsBatch,
+    isDefined, isGeographicDirection, isNumber, isTypeOfMovement, toFloat
+} from "../utils"
 
 /**
  * Read from data file the parameters definning the plane orientation, the striation orientation and the type of movement.
- * Special cases such as horizontal and vertical planes are considered
+ * Special cases such as horizontal and vertical planes are considered.
+ * Within readDataset, the parameters of a correct line are taken from the batch, which has already read them (see FaultVectorBatch).
+ * @param batch The batch conversion of the file, if any
  */
-export function readStriatedFaultPlane(arg: DataArgument, plane: Plane, striation: Striation, result: DataStatus): void {
+export function readStriatedFaultPlane(arg: DataArgument, plane: Plane, striation: Striation, result: DataStatus, batch: FaultVectorBatch = undefined): void {
+    if (batch !== undefined && batch.read(arg.toks, plane, striation)) {
+        return
+    }
+
     plane.strike = DataDescription.getParameter(arg.setIndex(2))
     plane.dip = DataDescription.getParameter(arg.setIndex(3))
     // The dip direction is read after the rake
@@ -413,3 +424,175 @@ export function readSigma1nPlaneInterval(arg: DataArgument, sigma1_nPlane: Sigma
         sigma1_nPlane.isDefined = true
     }
 }
+
+/**
+ * Read from data file the position of the datum (x, y, z in cols 21, 22, 23, see file-format.md), if any.
+ * Undefined coordinates keep their current value.
+ */
+export function readPosition(arg: DataArgument, pos: Point3D, result: DataStatus): void {
+    for (let k = 0; k < 3; ++k) {
+        const col = 21 + k
+        if (isDefined(arg.toks[col])) {
+            if (!isNumber(arg.toks[col])) {
+                result.status = false
+                result.messages.push(`Data number ${arg.toks[0]}, ${arg.toks[1]}, position: please set a number for ${DataDescription.names[col]} (col ${col}, got ${arg.toks[col]})`)
+                continue
+            }
+            pos[k] = toFloat(arg.toks[col])
+        }
+    }
+}
+
+/**
+ * @brief Unit vectors of the striated planes of a dataset, converted from the field angles in one batch (see fromAnglesToVectorsBatch).
+ *
+ * Each line defining a striated plane (strike, dip, and rake or striation trend in cols 2, 3, 5 and 7) is read once by the batch,
+ * and its angles are converted together with the other lines. The datum of the current line (see FaultVectorBatch.seek), when
+ * initialized with the batch (see Data.initialize), takes its parameters and vectors from the batch: readStriatedFaultPlane and
+ * faultVectors do not read the line again, nor call FaultHelper.create.
+ * A wrong line is not kept in the batch, so that its datum reads it and reports the error.
+ * @category Data
+ */
+export class FaultVectorBatch {
+    private lines: Tokens[]
+    // Row of each line in the columns, or -1 if the line is not in the batch
+    private rowOfLine: Int32Array
+    private angles: FaultAngleColumns
+    private vectors: FaultVectorColumns
+    private errors: Uint8Array
+    private line = -1
+
+    /**
+     * @param lines The lines of the data file
+     */
+    constructor(lines: Tokens[]) {
+        this.lines = lines
+        this.rowOfLine = new Int32Array(lines.length).fill(-1)
+        const angles = createFaultAngleColumns(lines.length)
+
+        // Reused by all the lines
+        const arg = createDataArgument()
+        const plane = createPlane()
+        const striation = createStriation()
+        const status = createDataStatus()
+
+        let n = 0
+        lines.forEach((toks, i) => {
+            if (!isNumber(toks[2]) || !isNumber(toks[3]) || (!isNumber(toks[5]) && !isNumber(toks[7]))) {
+                return
+            }
+            arg.toks = toks
+            resetFaultPlane(plane, striation, status)
+            try {
+                readStriatedFaultPlane(arg, plane, striation, status)
+            } catch (e) {
+                // The datum reports the error when it reads the line
+                return
+            }
+            if (!status.status || status.messages.length > 0) {
+                return
+            }
+
+            angles.strike[n] = plane.strike
+            angles.dip[n] = plane.dip
+            angles.dipDirection[n] = plane.dipDirection
+            angles.rake[n] = striation.rake
+            angles.strikeDirection[n] = striation.strikeDirection
+            angles.trend[n] = striation.trendIsDefined ? striation.trend : NaN
+            angles.typeOfMovement[n] = striation.typeOfMovement
+            this.rowOfLine[i] = n++
+        })
+
+        this.angles = angles
+        this.vectors = {
+            normals: new Float64Array(3 * n),
+            striations: new Float64Array(3 * n),
+            perpStriations: new Float64Array(3 * n)
+        }
+        this.errors = new Uint8Array(n)
+        fromAnglesToVectorsBatch(angles, this.vectors, this.errors, n)
+    }
+
+    /**
+     * Set the current line, i.e., the line read by the next datum
+     */
+    seek(line: number): void {
+        this.line = line
+    }
+
+    /**
+     * Set the parameters of the current line, if toks is the current line and it is in the batch
+     * @returns false if the line has to be read (see readStriatedFaultPlane)
+     */
+    read(toks: Tokens, plane: Plane, striation: Striation): boolean {
+        const i = this.row(toks)
+        if (i < 0) {
+            return false
+        }
+        const a = this.angles
+        plane.strike = a.strike[i]
+        plane.dip = a.dip[i]
+        plane.dipDirection = a.dipDirection[i]
+        striation.rake = a.rake[i]
+        striation.strikeDirection = a.strikeDirection[i]
+        striation.trendIsDefined = !Number.isNaN(a.trend[i])
+        striation.trend = striation.trendIsDefined ? a.trend[i] : 0
+        striation.typeOfMovement = a.typeOfMovement[i]
+        return true
+    }
+
+    /**
+     * The vectors of the current line, or undefined if toks is not the current line, if the line is not in the batch or if its
+     * angles are wrong
+     */
+    get(toks: Tokens): { normal: Vector3, striation: Vector3, e_perp_striation: Vector3 } {
+        const i = this.row(toks)
+        if (i < 0 || this.errors[i] !== FaultBatchError.NONE) {
+            return undefined
+        }
+        const { normals, striations, perpStriations } = this.vectors
+        const j = 3 * i
+        return {
+            normal: [normals[j], normals[j + 1], normals[j + 2]],
+            striation: [striations[j], striations[j + 1], striations[j + 2]],
+            e_perp_striation: [perpStriations[j], perpStriations[j + 1], perpStriations[j + 2]]
+        }
+    }
+
+    private row(toks: Tokens): number {
+        return this.line >= 0 && this.lines[this.line] === toks ? this.rowOfLine[this.line] : -1
+    }
+}
+
+/**
+ * @brief The unit vectors (normal, striation and perpendicular striation) of a striated plane read by readStriatedFaultPlane.
+ *
+ * Within readDataset they come from the batch conversion of the whole file (see FaultVectorBatch). Otherwise, or if the angles
+ * of the plane are wrong, they are computed by FaultHelper.create, which throws the corresponding error.
+ * @param batch The batch conversion of the file, if any
+ */
+export function faultVectors(arg: DataArgument, plane: Plane, striation: Striation, batch: FaultVectorBatch = undefined): { normal: Vector3, striation: Vector3, e_perp_striation: Vector3 } {
+    if (batch !== undefined) {
+        const v = batch.get(arg.toks)
+        if (v !== undefined) {
+            return v
+        }
+    }
+    return FaultHelper.create(plane, striation)
+}
+
+// --------------- Hidden to users
+
+function resetFaultPlane(plane: Plane, striation: Striation, status: DataStatus): void {
+    // Same values as createPlane, createStriation and createDataStatus
+    plane.strike = 0
+    plane.dip = 0
+    plane.dipDirection = Direction.UND
+    striation.rake = 0
+    striation.strikeDirection = Direction.UND
+    striation.trendIsDefined = true
+    striation.trend = 0
+    striation.typeOfMovement = TypeOfMovement.UND
+    status.status = true
+    status.messages.length = 0
+}
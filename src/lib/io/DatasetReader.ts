@@ -0,0 +1,91 @@
+import { Data } from "../data/Data"
+import { DataFactory } from "../data/Factory"
+import { Tokens } from "../data/types"
+import { isDefined, isNumber } from "../utils"
+import { FaultVectorBatch } from "./DataReader"
+
+/**
+ * @brief Result of readDataset
+ * @category Data
+ */
+export type DatasetReadResult = {
+    data: Data[],
+    // Deformation phase of each datum (same order as data), read in column 11 as an integer (1 if the column is empty)
+    phases: number[],
+    // One message per line which could not be read
+    messages: string[]
+}
+
+/**
+ * @brief Build the data of a CSV file (see file-format.md).
+ *
+ * Column 0 is the data number and column 1 the data type (see DataFactory). The lines whose first column is not a number
+ * (header, comments) are skipped. The columns are separated by ';', or by ',' for lines without ';'.
+ * Data made of several lines (see Data.nbLinkedData) read the following lines as well, and their deformation phase
+ * is the one of their first line.
+ *
+ * The parameters of the file (e.g., the params of a csv entry of a json configuration, see examples/data/friction1/data.json)
+ * are given to the setOptions method of each datum, such as the rock cohesion and friction angle of the friction data types.
+ * Their type, if any, replaces the data type of the lines.
+ *
+ * The striated planes are read once, and their field angles are converted to unit vectors in one batch (see FaultVectorBatch).
+ * @param text The content of the file
+ * @param params Optional parameters of the file
+ * @category Data
+ */
+export function readDataset(text: string, params: { [key: string]: any } = undefined): DatasetReadResult {
+    const lines: Tokens[] = []
+    text.split(/\r?\n/).forEach(line => {
+        const separator = line.includes(';') ? ';' : ','
+        const toks = line.split(separator).map(t => t.trim())
+        if (toks.length > 1 && toks[0].length > 0 && isNumber(toks[0])) {
+            lines.push(toks)
+        }
+    })
+
+    const result: DatasetReadResult = { data: [], phases: [], messages: [] }
+    // The fault planes of the file are read and converted to unit vectors in one batch
+    const batch = new FaultVectorBatch(lines)
+    readData(lines, params, result, batch)
+    return result
+}
+
+// --------------- Hidden to users
+
+function readData(lines: Tokens[], params: { [key: string]: any }, result: DatasetReadResult, batch: FaultVectorBatch): void {
+    for (let i = 0; i < lines.length;) {
+        const toks = lines[i]
+        const type = params !== undefined && params.type !== undefined ? params.type : toks[1]
+        const d = DataFactory.create(type)
+        if (d === undefined) {
+            result.messages.push(`Data number ${toks[0]}: unknown data type "${type}"`)
+            i++
+            continue
+        }
+
+        const n = Math.max(1, d.nbLinkedData())
+        const hasPhase = toks.length > 11 && isDefined(toks[11])
+        const phase = hasPhase ? Number(toks[11]) : 1
+        if (hasPhase && (!isNumber(toks[11]) || !Number.isInteger(phase))) {
+            result.messages.push(`Data number ${toks[0]}: invalid deformation phase "${toks[11]}"`)
+            i += n
+            continue
+        }
+        try {
+            batch.seek(i)
+            const status = d.initialize(lines.slice(i, i + n), batch)
+            if (params !== undefined) {
+                d.setOptions(params)
+            }
+            if (status.status) {
+                result.data.push(d)
+                result.phases.push(phase)
+            } else {
+                status.messages.forEach(m => result.messages.push(`Data number ${toks[0]}: ${m}`))
+            }
+        } catch (e) {
+            result.messages.push(`Data number ${toks[0]}: ${e.message}`)
+        }
+        i += n
+    }
+}
@@ -1,4 +1,5 @@
-import { Data, DataFactory } from "../data"
+import { Data } from "../data/Data"
+import { DataFactory } from "../data/Factory"
 import { trimAll } from "../utils"
 
 export function decodeCSV(lines: string): Data[] {
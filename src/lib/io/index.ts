@@ -1,2 +1,3 @@
 export * from './decodeCSV'
 // export * from './decodeCSV_Angles'
+export * from './DatasetReader'
@@ -0,0 +1,372 @@
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { Engine } from "../geomeca/Engine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { cloneMisfitCriteriunSolution, MisfitCriteriunSolution } from "../InverseMethod"
+import { Matrix3x3, multiplyTensors, newMatrix3x3Identity, Vector3 } from "../types"
+import { SearchMethod } from "./SearchMethod"
+import { SearchWorkers } from "./SearchWorkers"
+import { rotationVectorTensor } from "./utils"
+
+export type BranchAndBoundParams = {
+    // Maximum rotation angle around the interactive solution Rrot (PI to search the whole rotation space)
+    rotAngleHalfInterval?: number,
+    stressRatio?: number,
+    stressRatioHalfInterval?: number,
+    Rrot?: Matrix3x3,
+    // The search stops when the gap between the best misfit and the proven lower bound is below tolerance
+    tolerance?: number,
+    // The search also stops after this number of misfit evaluations (the gap is then larger than tolerance)
+    maxEvaluations?: number,
+    // Number of live cells subdivided at each step
+    batchSize?: number,
+    // Number of initial cells along each axis of the rotation space
+    initialSubdivision?: number
+}
+
+/**
+ * @brief Global search of the stress tensor by branch-and-bound over the rotation space and the stress ratio interval.
+ *
+ * The rotations are parameterized by their rotation vector (axis times angle) relative to the interactive solution Rrot,
+ * within the ball of radius rotAngleHalfInterval, and without the rotations giving the same stress tensor (see intersectsDomain).
+ * This domain is covered by cubic cells, times stress ratio intervals.
+ * A rotation in a cell of half side h is at most sqrt(3) h from the rotation at its center, which gives for each cell:
+ * - an upper bound: the misfit at the center of the cell,
+ * - a lower bound: the mean of the bounds of the data over the cell (see PackedDataset.costWithLowerBound).
+ *   Striated planes and stylolites have non trivial bounds, the other data are bounded by 0.
+ *
+ * The live cells with the smallest lower bounds are subdivided by batches (rotation cells into 8, or stress ratio intervals into 2),
+ * and the cells which cannot beat the best misfit by more than tolerance are pruned. The children of a batch (and the initial cells)
+ * are evaluated as one batch of independent cells (see evaluateCells). With workers (see setWorkers), each batch is split
+ * across the workers, which evaluate the cells on the shared dataset.
+ *
+ * The solution holds the proven lower bound of the misfit over the search domain (lowerBound), so that
+ * misfit - lowerBound is the gap certified by the search.
+ *
+ * @example
+ * ```ts
+ * const search = new BranchAndBound({ tolerance: 0.01, maxEvaluations: 100000 })
+ * inv.setSearchMethod(search)
+ * const sol = inv.run()
+ * console.log(sol.misfit, sol.misfit - sol.lowerBound)
+ * ```
+ * @category Search-Method
+ */
+export class BranchAndBound implements SearchMethod {
+    protected rotAngleHalfInterval: number
+    protected stressRatioHalfInterval: number
+    protected stressRatio0: number
+    protected tolerance: number
+    protected maxEvaluations: number
+    protected batchSize: number
+    protected initialSubdivision: number
+    protected Rrot: Matrix3x3 = undefined
+    protected engine: Engine = new HomogeneousEngine()
+    protected workers: SearchWorkers = undefined
+    private nbEvaluations_ = 0
+    // Misfit and lower bound of each cell of a batch
+    private results_ = new Float64Array(0)
+
+    constructor(
+        {stressRatio=0.5, stressRatioHalfInterval=0.5, rotAngleHalfInterval=Math.PI, Rrot=newMatrix3x3Identity(),
+         tolerance=1e-2, maxEvaluations=100000, batchSize=32, initialSubdivision=4}:
+        BranchAndBoundParams = {})
+    {
+        if (tolerance < 0) {
+            throw new Error(`The tolerance of the branch-and-bound search must be positive (got ${tolerance})`)
+        }
+        if (initialSubdivision < 1 || batchSize < 1) {
+            throw new Error('The initial subdivision and the batch size must be at least 1')
+        }
+        this.rotAngleHalfInterval = Math.min(rotAngleHalfInterval, Math.PI)
+        this.stressRatio0 = stressRatio
+        this.stressRatioHalfInterval = stressRatioHalfInterval
+        this.Rrot = Rrot
+        this.tolerance = tolerance
+        this.maxEvaluations = maxEvaluations
+        this.batchSize = batchSize
+        this.initialSubdivision = initialSubdivision
+    }
+
+    /**
+     * Number of misfit evaluations of the last run
+     */
+    get nbEvaluations(): number {
+        return this.nbEvaluations_
+    }
+
+    getEngine(): Engine {
+        return this.engine
+    }
+
+    setEngine(engine: Engine): void {
+        this.engine = engine
+    }
+
+    /**
+     * @brief Evaluate the batches of cells with workers (undefined to evaluate them in the calling thread).
+     * The dataset must then be packed with the shared option, and the engine must be homogeneous.
+     */
+    setWorkers(workers: SearchWorkers): void {
+        this.workers = workers
+    }
+
+    setInteractiveSolution({rot, stressRatio}:{rot: Matrix3x3, stressRatio: number}): void {
+        this.Rrot = rot
+        this.stressRatio0 = stressRatio
+    }
+
+    run(data: Data[], misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        return this.runPacked(new PackedDataset(data, { shared: this.workers !== undefined }), misfitCriteriaSolution)
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        if (this.workers !== undefined && !(this.engine instanceof HomogeneousEngine)) {
+            throw new Error('The workers of the branch-and-bound search only support the homogeneous engine')
+        }
+        const stressRatioMin = Math.max(0, Math.abs(this.stressRatio0) - this.stressRatioHalfInterval)
+        const stressRatioMax = Math.min(1, Math.abs(this.stressRatio0) + this.stressRatioHalfInterval)
+
+        console.log('Starting the branch-and-bound search...')
+
+        const solution = cloneMisfitCriteriunSolution(misfitCriteriaSolution)
+        const live = new CellHeap()
+        // Smallest lower bound of the pruned cells
+        let prunedBound = Number.POSITIVE_INFINITY
+        this.nbEvaluations_ = 0
+
+        // The cells of a refinement step, evaluated as one batch
+        const pending: Cell[] = []
+        let values = new Float64Array(0)
+        let bounds = new Float64Array(0)
+        const evaluatePending = () => {
+            const count = pending.length
+            if (values.length < CELL * count) {
+                values = new Float64Array(CELL * count)
+                bounds = new Float64Array(count)
+            }
+            pending.forEach((cell, k) => {
+                values.set(cell.r, CELL * k)
+                values[CELL * k + 3] = cell.h
+                values[CELL * k + 4] = cell.ratioMin
+                values[CELL * k + 5] = cell.ratioMax
+                bounds[k] = cell.bound
+            })
+            this.evaluateCells(packed, values, count, bounds, solution)
+            this.nbEvaluations_ += count
+
+            pending.forEach((cell, k) => {
+                cell.bound = bounds[k]
+                if (cell.bound < solution.misfit - this.tolerance) {
+                    live.push(cell)
+                } else {
+                    prunedBound = Math.min(prunedBound, cell.bound)
+                }
+            })
+            pending.length = 0
+        }
+
+        const a = this.rotAngleHalfInterval
+        const n = this.initialSubdivision
+        const h = a / n
+        for (let i = 0; i < n; ++i) {
+            for (let j = 0; j < n; ++j) {
+                for (let k = 0; k < n; ++k) {
+                    const r: Vector3 = [-a + (2 * i + 1) * h, -a + (2 * j + 1) * h, -a + (2 * k + 1) * h]
+                    if (this.intersectsDomain(r, h)) {
+                        pending.push({ r, h, ratioMin: stressRatioMin, ratioMax: stressRatioMax, bound: 0 })
+                    }
+                }
+            }
+        }
+        evaluatePending()
+
+        const batch: Cell[] = []
+        while (live.size > 0 && this.nbEvaluations_ < this.maxEvaluations) {
+            // The remaining cells cannot improve the solution by more than tolerance
+            if (live.top().bound >= solution.misfit - this.tolerance) {
+                break
+            }
+
+            batch.length = 0
+            while (batch.length < this.batchSize && live.size > 0 && live.top().bound < solution.misfit - this.tolerance) {
+                batch.push(live.pop())
+            }
+
+            for (const cell of batch) {
+                this.split(cell).forEach(child => {
+                    if (this.intersectsDomain(child.r, child.h)) {
+                        pending.push(child)
+                    }
+                })
+            }
+            evaluatePending()
+        }
+
+        const liveBound = live.size > 0 ? live.top().bound : Number.POSITIVE_INFINITY
+        solution.lowerBound = Math.min(liveBound, prunedBound, solution.misfit)
+        return solution
+    }
+
+    /**
+     * Evaluate a batch of independent cells: the misfit at the center of each cell, and its lower bound over the cell.
+     * @param packed The dataset
+     * @param cells The cells, 6 values each (rotation vector of the center, half side, minimum and maximum stress ratios)
+     * @param count The number of cells
+     * @param bounds The bound of the parent of cell k in bounds[k], replaced by the lower bound of the cell (never below the one of its parent)
+     * @param solution Updated if the center of a cell is better
+     */
+    protected evaluateCells(packed: PackedDataset, cells: Float64Array, count: number, bounds: Float64Array, solution: MisfitCriteriunSolution): void {
+        if (this.results_.length < 2 * count) {
+            this.results_ = new Float64Array(2 * count)
+        }
+        const results = this.results_.subarray(0, 2 * count)
+        if (this.workers !== undefined) {
+            this.workers.run(packed, 'Branch And Bound', { Rrot: this.Rrot }, cells.subarray(0, CELL * count), count, results)
+        } else {
+            for (let k = 0; k < count; ++k) {
+                evaluateCell(this.engine, packed, this.Rrot, cells.subarray(CELL * k, CELL * k + CELL), results.subarray(2 * k, 2 * k + 2))
+            }
+        }
+
+        for (let k = 0; k < count; ++k) {
+            bounds[k] = Math.max(bounds[k], results[2 * k + 1])
+            if (results[2 * k] < solution.misfit) {
+                const cell = cells.subarray(CELL * k, CELL * k + CELL)
+                const Drot = rotationVectorTensor(cell)
+                const Wrot = multiplyTensors({ A: Drot, B: this.Rrot })
+                const stressRatio = (cell[4] + cell[5]) / 2
+                this.engine.setHypotheticalStress(Wrot, stressRatio)
+                solution.misfit = results[2 * k]
+                solution.rotationMatrixD = Drot
+                solution.rotationMatrixW = Wrot
+                solution.stressRatio = stressRatio
+                solution.stressTensorSolution = this.engine.S()
+            }
+        }
+    }
+
+    /**
+     * Split the dimension with the largest effect on the bounds: the rotation cell into 8 cubes, or the stress ratio interval into 2
+     */
+    private split(cell: Cell): Cell[] {
+        // The bounds of the striated planes lose 2 sqrt(3) h for the rotation, and (ratioMax - ratioMin) / 4 for the stress ratio
+        if (2 * Math.sqrt(3) * cell.h >= (cell.ratioMax - cell.ratioMin) / 4) {
+            const h = cell.h / 2
+            const children: Cell[] = []
+            for (let c = 0; c < 8; ++c) {
+                const r: Vector3 = [
+                    cell.r[0] + (c & 1 ? h : -h),
+                    cell.r[1] + (c & 2 ? h : -h),
+                    cell.r[2] + (c & 4 ? h : -h)
+                ]
+                children.push({ r, h, ratioMin: cell.ratioMin, ratioMax: cell.ratioMax, bound: cell.bound })
+            }
+            return children
+        }
+        const mid = (cell.ratioMin + cell.ratioMax) / 2
+        return [
+            { r: cell.r, h: cell.h, ratioMin: cell.ratioMin, ratioMax: mid, bound: cell.bound },
+            { r: cell.r, h: cell.h, ratioMin: mid, ratioMax: cell.ratioMax, bound: cell.bound }
+        ]
+    }
+
+    /**
+     * True if the cube of center r and half side h intersects the search domain.
+     *
+     * The stress tensor is unchanged when its principal frame is rotated by PI around one of its axes, so each tensor is given by 4 rotations.
+     * Only the rotation closest to Rrot is kept: its quaternion (cos(angle/2), sin(angle/2) axis) has a scalar part larger than the other components,
+     * i.e., tan(angle/2) max|axis_i| <= 1. This removes 3/4 of the rotation space when rotAngleHalfInterval > PI/2, and nothing otherwise.
+     */
+    private intersectsDomain(r: Vector3, h: number): boolean {
+        // Both conditions increase with |r_i|, so the closest point of the cube to the origin is tested
+        const p = r.map(v => Math.max(0, Math.abs(v) - h))
+        const angle = Math.hypot(p[0], p[1], p[2])
+        if (angle > this.rotAngleHalfInterval) {
+            return false
+        }
+        return angle === 0 || Math.tan(angle / 2) * Math.max(p[0], p[1], p[2]) <= angle
+    }
+}
+
+// --------------- Hidden to users
+
+// Number of values of a cell in the batches of evaluateCells
+const CELL = 6
+
+/**
+ * The misfit at the center of a cell in out[0], and its lower bound over the cell in out[1]
+ */
+function evaluateCell(engine: Engine, packed: PackedDataset, Rrot: Matrix3x3, cell: Float64Array, out: Float64Array): void {
+    // Wrot = Drot Rrot (see MonteCarlo)
+    const Wrot = multiplyTensors({ A: rotationVectorTensor(cell), B: Rrot })
+    engine.setHypotheticalStress(Wrot, (cell[4] + cell[5]) / 2)
+    const [misfit, bound] = packed.costWithLowerBound(engine, Math.sqrt(3) * cell[3], (cell[5] - cell[4]) / 2)
+    out[0] = misfit
+    out[1] = bound
+}
+
+/**
+ * The task of the workers (see SearchTasks): one cell of evaluateCells
+ */
+export function evaluateCellTask(packed: PackedDataset, { Rrot }: { Rrot: Matrix3x3 }, cell: Float64Array, out: Float64Array): void {
+    evaluateCell(new HomogeneousEngine(), packed, Rrot, cell, out)
+}
+
+// A cubic cell of rotation vectors (center r, half side h) times a stress ratio interval
+type Cell = {
+    r: Vector3,
+    h: number,
+    ratioMin: number,
+    ratioMax: number,
+    bound: number
+}
+
+// Binary heap of the live cells, the cell with the smallest lower bound first
+class CellHeap {
+    private cells: Cell[] = []
+
+    get size(): number {
+        return this.cells.length
+    }
+
+    top(): Cell {
+        return this.cells[0]
+    }
+
+    push(cell: Cell): void {
+        const cells = this.cells
+        cells.push(cell)
+        let i = cells.length - 1
+        while (i > 0) {
+            const parent = (i - 1) >> 1
+            if (cells[parent].bound <= cells[i].bound) {
+                break
+            }
+            [cells[parent], cells[i]] = [cells[i], cells[parent]]
+            i = parent
+        }
+    }
+
+    pop(): Cell {
+        const cells = this.cells
+        const top = cells[0]
+        const last = cells.pop()
+        if (cells.length > 0) {
+            cells[0] = last
+            let i = 0
+            for (;;) {
+                const l = 2 * i + 1, r = l + 1
+                let best = i
+                if (l < cells.length && cells[l].bound < cells[best].bound) best = l
+                if (r < cells.length && cells[r].bound < cells[best].bound) best = r
+                if (best === i) {
+                    break
+                }
+                [cells[best], cells[i]] = [cells[i], cells[best]]
+                i = best
+            }
+        }
+        return top
+    }
+}
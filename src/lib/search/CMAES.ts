@@ -0,0 +1,450 @@
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { Engine } from "../geomeca/Engine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { cloneMisfitCriteriunSolution, MisfitCriteriunSolution } from "../InverseMethod"
+import { Matrix3x3, multiplyTensors, newMatrix3x3Identity } from "../types"
+import { Random } from "../utils/Random"
+import { SearchMethod } from "./SearchMethod"
+import { SearchWorkers } from "./SearchWorkers"
+import { rotationVectorTensor } from "./utils"
+
+export type CMAESParams = {
+    rotAngleHalfInterval?: number,
+    stressRatio?: number,
+    stressRatioHalfInterval?: number,
+    Rrot?: Matrix3x3,
+    // Total number of misfit evaluations, restarts included
+    nbEvaluations?: number,
+    // Initial step size (in radians for the rotation, and for the stress ratio)
+    sigma?: number,
+    // Population size of the first run (default 4 + 3 ln(4) = 8). Each restart doubles it
+    populationSize?: number,
+    // Maximum number of restarts
+    maxRestarts?: number,
+    // A run stops when the step size is below tolerance, or when the best misfit does not change by more than tolerance
+    tolerance?: number,
+    // Seed of the random trials, to reproduce a search (random by default, see Random)
+    seed?: number
+}
+
+/**
+ * @brief Covariance matrix adaptation evolution strategy (CMA-ES) for the stress tensor, with restarts of increasing population (IPOP).
+ *
+ * The search space has 4 dimensions: the rotation vector (axis times angle) relative to the interactive solution Rrot,
+ * i.e. Wrot = Drot Rrot as in MonteCarlo, and the stress ratio. The rotation vectors are limited to rotAngleHalfInterval and
+ * the stress ratio to its interval: the sampled points outside are projected on the domain before evaluation.
+ *
+ * Each generation samples its whole population first, then evaluates it as one batch (see evaluatePopulation). With workers
+ * (see setWorkers), the population is split across the workers, which evaluate the points on the shared dataset.
+ * The step size and the covariance of the sampling distribution adapt to the local shape of the misfit,
+ * so that smooth misfits are minimized with few evaluations. When a run stagnates, the search restarts from a random
+ * point with twice the population, which handles multimodal misfits, until the evaluation budget is spent.
+ *
+ * @example
+ * ```ts
+ * const search = new CMAES({ nbEvaluations: 3000 })
+ * inv.setSearchMethod(search)
+ * const sol = inv.run()
+ * ```
+ * @category Search-Method
+ */
+export class CMAES implements SearchMethod {
+    protected rotAngleHalfInterval: number
+    protected stressRatioHalfInterval: number
+    protected stressRatio0: number
+    protected Rrot: Matrix3x3 = undefined
+    protected nbEvaluations: number
+    protected sigma0: number
+    protected populationSize: number
+    protected maxRestarts: number
+    protected tolerance: number
+    protected engine: Engine = new HomogeneousEngine()
+    protected workers: SearchWorkers = undefined
+    protected seed: number
+    // The generator of the current run, seeded by seed at the start of each run
+    protected random: Random = undefined
+    private nbRestarts_ = 0
+
+    constructor(
+        {stressRatio=0.5, stressRatioHalfInterval=0.5, rotAngleHalfInterval=Math.PI, Rrot=newMatrix3x3Identity(),
+         nbEvaluations=5000, sigma=0.5, populationSize=4 + Math.floor(3 * Math.log(N)), maxRestarts=6, tolerance=1e-9, seed=undefined}:
+        CMAESParams = {})
+    {
+        if (sigma <= 0 || populationSize < 2) {
+            throw new Error('For CMA-ES choose sigma > 0 and populationSize >= 2')
+        }
+        this.rotAngleHalfInterval = Math.min(rotAngleHalfInterval, Math.PI)
+        this.stressRatio0 = stressRatio
+        this.stressRatioHalfInterval = stressRatioHalfInterval
+        this.Rrot = Rrot
+        this.nbEvaluations = nbEvaluations
+        this.sigma0 = sigma
+        this.populationSize = populationSize
+        this.maxRestarts = maxRestarts
+        this.tolerance = tolerance
+        this.seed = seed
+    }
+
+    setNbIter(n: number) {
+        this.nbEvaluations = n
+    }
+
+    /**
+     * Number of restarts of the last run
+     */
+    get nbRestarts(): number {
+        return this.nbRestarts_
+    }
+
+    /**
+     * @brief Evaluate the populations with workers (undefined to evaluate them in the calling thread).
+     * The dataset must then be packed with the shared option, and the engine must be homogeneous.
+     */
+    setWorkers(workers: SearchWorkers): void {
+        this.workers = workers
+    }
+
+    getEngine(): Engine {
+        return this.engine
+    }
+
+    setEngine(engine: Engine): void {
+        this.engine = engine
+    }
+
+    setInteractiveSolution({rot, stressRatio}:{rot: Matrix3x3, stressRatio: number}): void {
+        this.Rrot = rot
+        this.stressRatio0 = stressRatio
+    }
+
+    run(data: Data[], misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        return this.runPacked(new PackedDataset(data, { shared: this.workers !== undefined }), misfitCriteriaSolution)
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        if (this.workers !== undefined && !(this.engine instanceof HomogeneousEngine)) {
+            throw new Error('The workers of the CMA-ES search only support the homogeneous engine')
+        }
+        const stressRatioMin = Math.max(0, Math.abs(this.stressRatio0) - this.stressRatioHalfInterval)
+        const stressRatioMax = Math.min(1, Math.abs(this.stressRatio0) + this.stressRatioHalfInterval)
+
+        console.log('Starting the CMA-ES search...')
+
+        this.random = new Random(this.seed)
+
+        const solution = cloneMisfitCriteriunSolution(misfitCriteriaSolution)
+        const budget = { evaluations: 0 }
+        const mean = new Float64Array(N)
+        mean[3] = Math.min(stressRatioMax, Math.max(stressRatioMin, Math.abs(this.stressRatio0)))
+
+        let lambda = this.populationSize
+        this.nbRestarts_ = 0
+        for (;;) {
+            this.runOnce(packed, solution, mean, lambda, stressRatioMin, stressRatioMax, budget)
+            if (budget.evaluations >= this.nbEvaluations || this.nbRestarts_ >= this.maxRestarts) {
+                break
+            }
+            // Restart from a random point with a larger population
+            this.nbRestarts_++
+            lambda *= 2
+            randomRotationVector(this.random, this.rotAngleHalfInterval, mean)
+            mean[3] = stressRatioMin + this.random.next() * (stressRatioMax - stressRatioMin)
+        }
+        return solution
+    }
+
+    /**
+     * Evaluate the misfits of a population. The points are already in the search domain.
+     * @param packed The dataset
+     * @param points The points, N = 4 values each (rotation vector, stress ratio)
+     * @param count The number of points
+     * @param misfits The misfit of point k is written in misfits[k]
+     * @param solution Updated if a point is better
+     */
+    protected evaluatePopulation(packed: PackedDataset, points: Float64Array, count: number, misfits: Float64Array, solution: MisfitCriteriunSolution): void {
+        if (this.workers !== undefined) {
+            this.workers.run(packed, 'CMA-ES', { Rrot: this.Rrot }, points.subarray(0, N * count), count, misfits.subarray(0, count))
+        } else {
+            for (let k = 0; k < count; ++k) {
+                misfits[k] = evaluatePoint(this.engine, packed, this.Rrot, points.subarray(N * k, N * k + N))
+            }
+        }
+
+        for (let k = 0; k < count; ++k) {
+            if (misfits[k] < solution.misfit) {
+                const x = points.subarray(N * k, N * k + N)
+                const Drot = rotationVectorTensor(x)
+                const Wrot = multiplyTensors({ A: Drot, B: this.Rrot })
+                this.engine.setHypotheticalStress(Wrot, x[3])
+                solution.misfit = misfits[k]
+                solution.rotationMatrixD = Drot
+                solution.rotationMatrixW = Wrot
+                solution.stressRatio = x[3]
+                solution.stressTensorSolution = this.engine.S()
+            }
+        }
+    }
+
+    /**
+     * One CMA-ES run from mean, until stagnation or until the budget is spent (see Hansen, The CMA Evolution Strategy: A Tutorial)
+     */
+    private runOnce(
+        packed: PackedDataset, solution: MisfitCriteriunSolution, mean: Float64Array, lambda: number,
+        stressRatioMin: number, stressRatioMax: number, budget: { evaluations: number }): void
+    {
+        // Strategy parameters
+        const mu = Math.floor(lambda / 2)
+        const weights = new Float64Array(mu)
+        for (let i = 0; i < mu; ++i) {
+            weights[i] = Math.log((lambda + 1) / 2) - Math.log(i + 1)
+        }
+        const sumW = weights.reduce((a, w) => a + w, 0)
+        weights.forEach((w, i) => weights[i] = w / sumW)
+        const mueff = 1 / weights.reduce((a, w) => a + w * w, 0)
+        const cc = (4 + mueff / N) / (N + 4 + 2 * mueff / N)
+        const cs = (mueff + 2) / (N + mueff + 5)
+        const c1 = 2 / ((N + 1.3) ** 2 + mueff)
+        const cmu = Math.min(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((N + 2) ** 2 + mueff))
+        const damps = 1 + 2 * Math.max(0, Math.sqrt((mueff - 1) / (N + 1)) - 1) + cs
+        const chiN = Math.sqrt(N) * (1 - 1 / (4 * N) + 1 / (21 * N * N))
+
+        // State of the distribution
+        let sigma = this.sigma0
+        const pc = new Float64Array(N)
+        const ps = new Float64Array(N)
+        const C = identity()
+        const B = identity()
+        const D = new Float64Array(N).fill(1)
+
+        // Population
+        const z = new Float64Array(N)
+        const x = new Float64Array(N * lambda)
+        const y = new Float64Array(N * lambda)
+        const misfits = new Float64Array(lambda)
+        const order = new Int32Array(lambda)
+        const yw = new Float64Array(N)
+        const tmp = new Float64Array(N)
+
+        const history: number[] = []
+        const historyLength = 10 + Math.ceil(30 * N / lambda)
+
+        for (let generation = 0; ; ++generation) {
+            const count = Math.min(lambda, this.nbEvaluations - budget.evaluations)
+            if (count < mu) {
+                return
+            }
+
+            // Sample the whole population, x = m + sigma B D z, projected on the search domain
+            for (let k = 0; k < count; ++k) {
+                for (let i = 0; i < N; ++i) {
+                    z[i] = gaussian(this.random)
+                }
+                for (let i = 0; i < N; ++i) {
+                    let v = 0
+                    for (let j = 0; j < N; ++j) {
+                        v += B[i * N + j] * D[j] * z[j]
+                    }
+                    x[N * k + i] = mean[i] + sigma * v
+                }
+                this.project(x, N * k, stressRatioMin, stressRatioMax)
+                for (let i = 0; i < N; ++i) {
+                    y[N * k + i] = (x[N * k + i] - mean[i]) / sigma
+                }
+            }
+
+            this.evaluatePopulation(packed, x, count, misfits, solution)
+            budget.evaluations += count
+
+            for (let k = 0; k < count; ++k) {
+                order[k] = k
+            }
+            order.subarray(0, count).sort((a, b) => misfits[a] - misfits[b])
+
+            // Recombination
+            yw.fill(0)
+            for (let r = 0; r < mu; ++r) {
+                const k = order[r]
+                for (let i = 0; i < N; ++i) {
+                    yw[i] += weights[r] * y[N * k + i]
+                }
+            }
+            for (let i = 0; i < N; ++i) {
+                mean[i] += sigma * yw[i]
+            }
+
+            // Step size path: ps = (1 - cs) ps + sqrt(cs (2 - cs) mueff) C^-1/2 yw, with C^-1/2 = B D^-1 B^T
+            for (let j = 0; j < N; ++j) {
+                let v = 0
+                for (let i = 0; i < N; ++i) {
+                    v += B[i * N + j] * yw[i]
+                }
+                tmp[j] = v / D[j]
+            }
+            const csn = Math.sqrt(cs * (2 - cs) * mueff)
+            for (let i = 0; i < N; ++i) {
+                let v = 0
+                for (let j = 0; j < N; ++j) {
+                    v += B[i * N + j] * tmp[j]
+                }
+                ps[i] = (1 - cs) * ps[i] + csn * v
+            }
+            const psNorm = Math.hypot(ps[0], ps[1], ps[2], ps[3])
+            const hsig = psNorm / Math.sqrt(1 - Math.pow(1 - cs, 2 * (generation + 1))) / chiN < 1.4 + 2 / (N + 1) ? 1 : 0
+
+            // Covariance path and rank-one plus rank-mu update
+            const ccn = Math.sqrt(cc * (2 - cc) * mueff)
+            for (let i = 0; i < N; ++i) {
+                pc[i] = (1 - cc) * pc[i] + hsig * ccn * yw[i]
+            }
+            const oldWeight = 1 - c1 - cmu + c1 * (1 - hsig) * cc * (2 - cc)
+            for (let i = 0; i < N; ++i) {
+                for (let j = 0; j <= i; ++j) {
+                    let rankMu = 0
+                    for (let r = 0; r < mu; ++r) {
+                        const k = order[r]
+                        rankMu += weights[r] * y[N * k + i] * y[N * k + j]
+                    }
+                    const v = oldWeight * C[i * N + j] + c1 * pc[i] * pc[j] + cmu * rankMu
+                    C[i * N + j] = v
+                    C[j * N + i] = v
+                }
+            }
+
+            sigma *= Math.exp((cs / damps) * (psNorm / chiN - 1))
+
+            // C = B D^2 B^T
+            jacobiEigen(C, B, D)
+            for (let i = 0; i < N; ++i) {
+                D[i] = Math.sqrt(Math.max(D[i], 1e-300))
+            }
+
+            // Stagnation
+            history.push(misfits[order[0]])
+            if (history.length > historyLength) {
+                history.shift()
+            }
+            const maxD = Math.max(D[0], D[1], D[2], D[3])
+            if (sigma * maxD < this.tolerance) {
+                return
+            }
+            if (history.length === historyLength && Math.max(...history) - Math.min(...history) < this.tolerance) {
+                return
+            }
+            if (maxD > 1e7 * Math.min(D[0], D[1], D[2], D[3])) {
+                return
+            }
+        }
+    }
+
+    /**
+     * Project a point on the search domain: the rotation vector on the ball of radius rotAngleHalfInterval, the stress ratio on its interval
+     */
+    private project(x: Float64Array, offset: number, stressRatioMin: number, stressRatioMax: number): void {
+        const angle = Math.hypot(x[offset], x[offset + 1], x[offset + 2])
+        if (angle > this.rotAngleHalfInterval) {
+            const s = this.rotAngleHalfInterval / angle
+            x[offset] *= s
+            x[offset + 1] *= s
+            x[offset + 2] *= s
+        }
+        x[offset + 3] = Math.min(stressRatioMax, Math.max(stressRatioMin, x[offset + 3]))
+    }
+}
+
+// --------------- Hidden to users
+
+// Dimension of the search space (rotation vector and stress ratio)
+const N = 4
+
+// The misfit of a point of a population
+function evaluatePoint(engine: Engine, packed: PackedDataset, Rrot: Matrix3x3, x: Float64Array): number {
+    // Wrot = Drot Rrot (see MonteCarlo)
+    engine.setHypotheticalStress(multiplyTensors({ A: rotationVectorTensor(x), B: Rrot }), x[3])
+    return packed.cost(engine)
+}
+
+/**
+ * The task of the workers (see SearchTasks): one point of evaluatePopulation
+ */
+export function evaluatePointTask(packed: PackedDataset, { Rrot }: { Rrot: Matrix3x3 }, x: Float64Array, out: Float64Array): void {
+    out[0] = evaluatePoint(new HomogeneousEngine(), packed, Rrot, x)
+}
+
+function identity(): Float64Array {
+    const m = new Float64Array(N * N)
+    for (let i = 0; i < N; ++i) {
+        m[i * N + i] = 1
+    }
+    return m
+}
+
+// Standard normal random number (Box-Muller)
+function gaussian(random: Random): number {
+    const u = 1 - random.next()
+    return Math.sqrt(-2 * Math.log(u)) * Math.cos(2 * Math.PI * random.next())
+}
+
+// Rotation vector uniformly distributed in the rotations of angle at most maxAngle (same sampling as MonteCarlo)
+function randomRotationVector(random: Random, maxAngle: number, out: Float64Array): void {
+    const phi = random.next() * 2 * Math.PI
+    const z = 2 * random.next() - 1
+    const r = Math.sqrt(1 - z * z)
+    const angle = random.next() * maxAngle
+    out[0] = angle * r * Math.cos(phi)
+    out[1] = angle * r * Math.sin(phi)
+    out[2] = angle * z
+}
+
+// Eigen decomposition of a symmetric N x N matrix A (unchanged): A = V diag(values) V^T, the eigenvectors being the columns of V
+function jacobiEigen(A: Float64Array, V: Float64Array, values: Float64Array): void {
+    const a = Float64Array.from(A)
+    V.fill(0)
+    for (let i = 0; i < N; ++i) {
+        V[i * N + i] = 1
+    }
+
+    for (let sweep = 0; sweep < 50; ++sweep) {
+        let off = 0
+        for (let p = 0; p < N; ++p) {
+            for (let q = p + 1; q < N; ++q) {
+                off += a[p * N + q] * a[p * N + q]
+            }
+        }
+        if (off < 1e-30) {
+            break
+        }
+
+        for (let p = 0; p < N; ++p) {
+            for (let q = p + 1; q < N; ++q) {
+                const apq = a[p * N + q]
+                if (Math.abs(apq) < 1e-300) {
+                    continue
+                }
+                const theta = (a[q * N + q] - a[p * N + p]) / (2 * apq)
+                const t = Math.sign(theta || 1) / (Math.abs(theta) + Math.sqrt(theta * theta + 1))
+                const c = 1 / Math.sqrt(t * t + 1)
+                const s = t * c
+                for (let k = 0; k < N; ++k) {
+                    const akp = a[k * N + p], akq = a[k * N + q]
+                    a[k * N + p] = c * akp - s * akq
+                    a[k * N + q] = s * akp + c * akq
+                }
+                for (let k = 0; k < N; ++k) {
+                    const apk = a[p * N + k], aqk = a[q * N + k]
+                    a[p * N + k] = c * apk - s * aqk
+                    a[q * N + k] = s * apk + c * aqk
+                }
+                for (let k = 0; k < N; ++k) {
+                    const vkp = V[k * N + p], vkq = V[k * N + q]
+                    V[k * N + p] = c * vkp - s * vkq
+                    V[k * N + q] = s * vkp + c * vkq
+                }
+            }
+        }
+    }
+
+    for (let i = 0; i < N; ++i) {
+        values[i] = a[i * N + i]
+    }
+}
@@ -0,0 +1,329 @@
+import { Matrix3x3, newMatrix3x3, normalizeVector, Vector3 } from "../types"
+import { matrixToQuaternion, quaternionToMatrix } from "./utils"
+
+/**
+ * @brief Principal stress axis of a sampled stress tensor, as the row of its rotation matrix Wrot
+ * @category Search-Method
+ */
+export enum PrincipalAxis {
+    SIGMA_1 = 0,
+    SIGMA_3 = 1,
+    SIGMA_2 = 2
+}
+
+/**
+ * @brief Outline of the orientations of a principal axis over a confidence region (see confidenceCone)
+ * @category Search-Method
+ */
+export type ConfidenceCone = {
+    // The axis of the best sample
+    axis: Vector3,
+    // The largest angle between axis and the axis of a sample, in radians
+    halfAngle: number,
+    // Unit vectors around axis, in counterclockwise order (convex hull of the axes in the azimuthal equidistant projection centered on axis)
+    outline: Vector3[]
+}
+
+/**
+ * @brief All the sampled stress tensors whose misfit is within delta of the best misfit (the confidence region of the solution).
+ *
+ * A search method streams its samples with add() (see MonteCarlo.setConfidenceRegion). The samples above the threshold are
+ * rejected, and the accepted ones are filtered again when the best misfit improves, before the buffer grows. So the memory
+ * is proportional to the size of the region, not to the number of trials.
+ *
+ * Each sample is stored in 12 bytes: the rotation Wrot as a compressed quaternion (the 3 smallest components on 16 bits),
+ * the stress ratio on 14 bits (the 2 remaining bits give the dropped component) and the misfit as a float32.
+ * The angular precision of the rotations is about 1e-4 radian.
+ *
+ * @example
+ * ```ts
+ * const region = new ConfidenceRegion(0.02)
+ * const search = new MonteCarlo({ nbRandomTrials: 10000 })
+ * search.setConfidenceRegion(region)
+ * inv.setSearchMethod(search)
+ * inv.run()
+ * const cone1 = confidenceCone(region, PrincipalAxis.SIGMA_1)
+ * const [Rmin, Rmax] = stressRatioInterval(region)
+ * ```
+ * @category Search-Method
+ */
+export class ConfidenceRegion {
+    readonly delta: number
+    private best_ = Number.POSITIVE_INFINITY
+    private size_ = 0
+    private quaternions: Int16Array
+    private ratios: Uint16Array
+    private misfits: Float32Array
+    private q = new Float64Array(4)
+
+    /**
+     * @param delta The misfit above the best misfit of the samples which are kept
+     * @param capacity The initial number of samples of the buffer (it grows if needed)
+     */
+    constructor(delta: number, capacity: number = 1024) {
+        if (!(delta >= 0)) {
+            throw new Error(`The misfit interval of a confidence region must be non negative (got ${delta})`)
+        }
+        this.delta = delta
+        this.allocate(Math.max(1, Math.floor(capacity)))
+    }
+
+    /**
+     * The best misfit added so far
+     */
+    get best(): number {
+        return this.best_
+    }
+
+    /**
+     * Number of stored samples (some of them may be above the threshold until compact() is called)
+     */
+    get size(): number {
+        return this.size_
+    }
+
+    /**
+     * Size of the buffer in bytes
+     */
+    get byteLength(): number {
+        return this.quaternions.byteLength + this.ratios.byteLength + this.misfits.byteLength
+    }
+
+    /**
+     * The largest misfit of a sample of the region, when the best misfit is min(best, incumbent).
+     * A search method can abandon the evaluation of a sample above it.
+     */
+    threshold(incumbent: number = Number.POSITIVE_INFINITY): number {
+        return Math.min(incumbent, this.best_) + this.delta
+    }
+
+    clear(): void {
+        this.best_ = Number.POSITIVE_INFINITY
+        this.size_ = 0
+    }
+
+    /**
+     * Add a sample if its misfit is within delta of the best misfit
+     * @returns True if the sample is kept
+     */
+    add(Wrot: Matrix3x3, stressRatio: number, misfit: number): boolean {
+        if (misfit < this.best_) {
+            this.best_ = misfit
+        }
+        if (!(misfit <= this.best_ + this.delta)) {
+            return false
+        }
+
+        if (this.size_ === this.misfits.length) {
+            // Filter first, and grow only if the region itself is large
+            this.compact()
+            if (2 * this.size_ > this.misfits.length) {
+                this.grow(2 * this.misfits.length)
+            }
+        }
+
+        const i = this.size_++
+        matrixToQuaternion(Wrot, this.q, 0)
+        this.ratios[i] = encodeQuaternion(this.q, this.quaternions, 3 * i) | (Math.round(clamp01(stressRatio) * RATIO_SCALE) << 2)
+        this.misfits[i] = misfit
+        return true
+    }
+
+    /**
+     * Remove the samples above the threshold of the current best misfit
+     */
+    compact(): void {
+        const threshold = this.best_ + this.delta
+        let n = 0
+        for (let i = 0; i < this.size_; ++i) {
+            if (this.misfits[i] <= threshold) {
+                if (n !== i) {
+                    this.quaternions.copyWithin(3 * n, 3 * i, 3 * i + 3)
+                    this.ratios[n] = this.ratios[i]
+                    this.misfits[n] = this.misfits[i]
+                }
+                n++
+            }
+        }
+        this.size_ = n
+    }
+
+    /**
+     * Call callback for each sample of the region (after compaction).
+     * The matrix Wrot is reused from one call to the next: clone it to keep it.
+     */
+    forEach(callback: (Wrot: Matrix3x3, stressRatio: number, misfit: number, index: number) => void): void {
+        this.compact()
+        const W = newMatrix3x3()
+        for (let i = 0; i < this.size_; ++i) {
+            decodeQuaternion(this.quaternions, 3 * i, this.ratios[i] & 3, this.q)
+            quaternionToMatrix(this.q, 0, W)
+            callback(W, (this.ratios[i] >> 2) / RATIO_SCALE, this.misfits[i], i)
+        }
+    }
+
+    private allocate(capacity: number): void {
+        this.quaternions = new Int16Array(3 * capacity)
+        this.ratios = new Uint16Array(capacity)
+        this.misfits = new Float32Array(capacity)
+    }
+
+    private grow(capacity: number): void {
+        const quaternions = this.quaternions, ratios = this.ratios, misfits = this.misfits
+        this.allocate(capacity)
+        this.quaternions.set(quaternions.subarray(0, 3 * this.size_))
+        this.ratios.set(ratios.subarray(0, this.size_))
+        this.misfits.set(misfits.subarray(0, this.size_))
+    }
+}
+
+/**
+ * @brief Cone of the orientations of a principal axis over a confidence region, centered on the axis of the best sample
+ * @param region The confidence region (not empty)
+ * @param principalAxis The principal stress axis
+ * @category Search-Method
+ */
+export function confidenceCone(region: ConfidenceRegion, principalAxis: PrincipalAxis = PrincipalAxis.SIGMA_1): ConfidenceCone {
+    // The axes of the samples, and the best one
+    const axes: Vector3[] = []
+    let best = Number.POSITIVE_INFINITY, center: Vector3 = undefined
+    region.forEach((W, _, misfit) => {
+        const a = W[principalAxis]
+        axes.push([a[0], a[1], a[2]])
+        if (misfit < best) {
+            best = misfit
+            center = axes[axes.length - 1]
+        }
+    })
+    if (center === undefined) {
+        throw new Error('The confidence region is empty')
+    }
+
+    // Azimuthal equidistant projection centered on the best axis (the axes are undirected)
+    const [u, v] = tangentFrame(center)
+    const points: [number, number][] = [[0, 0]]
+    let halfAngle = 0
+    for (const a of axes) {
+        let c = dot(a, center)
+        const s = c < 0 ? -1 : 1
+        c = Math.min(1, s * c)
+        const theta = Math.acos(c)
+        if (theta > 0) {
+            const psi = Math.atan2(s * dot(a, v), s * dot(a, u))
+            points.push([theta * Math.cos(psi), theta * Math.sin(psi)])
+            halfAngle = Math.max(halfAngle, theta)
+        }
+    }
+
+    const outline = convexHull(points).map(([x, y]) => {
+        const theta = Math.hypot(x, y)
+        const ct = Math.cos(theta), st = theta === 0 ? 0 : Math.sin(theta) / theta
+        return normalizeVector([
+            ct * center[0] + st * (x * u[0] + y * v[0]),
+            ct * center[1] + st * (x * u[1] + y * v[1]),
+            ct * center[2] + st * (x * u[2] + y * v[2])
+        ])
+    })
+
+    return { axis: [...center] as Vector3, halfAngle, outline }
+}
+
+/**
+ * @brief Interval of the stress ratios of the samples of a confidence region
+ * @category Search-Method
+ */
+export function stressRatioInterval(region: ConfidenceRegion): [number, number] {
+    let min = Number.POSITIVE_INFINITY, max = Number.NEGATIVE_INFINITY
+    region.forEach((_, stressRatio) => {
+        min = Math.min(min, stressRatio)
+        max = Math.max(max, stressRatio)
+    })
+    if (min > max) {
+        throw new Error('The confidence region is empty')
+    }
+    return [min, max]
+}
+
+// --------------- Hidden to users
+
+// The stress ratio is stored on 14 bits
+const RATIO_SCALE = (1 << 14) - 1
+// The 3 smallest components of a unit quaternion are in [-1/sqrt(2), 1/sqrt(2)]
+const QUATERNION_SCALE = 32767 * Math.SQRT2
+
+function clamp01(v: number): number {
+    return Math.min(1, Math.max(0, v))
+}
+
+// Store the 3 smallest components of q (the largest one being made positive), and return the index of the largest one
+function encodeQuaternion(q: Float64Array, out: Int16Array, offset: number): number {
+    let k = 0
+    for (let i = 1; i < 4; ++i) {
+        if (Math.abs(q[i]) > Math.abs(q[k])) {
+            k = i
+        }
+    }
+    const s = q[k] < 0 ? -1 : 1
+    let j = offset
+    for (let i = 0; i < 4; ++i) {
+        if (i !== k) {
+            out[j++] = Math.round(s * q[i] * QUATERNION_SCALE)
+        }
+    }
+    return k
+}
+
+function decodeQuaternion(values: Int16Array, offset: number, k: number, q: Float64Array): void {
+    let sum = 0, j = offset
+    for (let i = 0; i < 4; ++i) {
+        if (i !== k) {
+            q[i] = values[j++] / QUATERNION_SCALE
+            sum += q[i] * q[i]
+        }
+    }
+    q[k] = Math.sqrt(Math.max(0, 1 - sum))
+    const norm = Math.sqrt(sum + q[k] * q[k])
+    for (let i = 0; i < 4; ++i) {
+        q[i] /= norm
+    }
+}
+
+function dot(a: Vector3, b: Vector3): number {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+}
+
+// Two unit vectors such that (u, v, n) is a direct orthonormal frame
+function tangentFrame(n: Vector3): [Vector3, Vector3] {
+    const helper: Vector3 = Math.abs(n[0]) < 0.9 ? [1, 0, 0] : [0, 1, 0]
+    const d = dot(helper, n)
+    const u = normalizeVector([helper[0] - d * n[0], helper[1] - d * n[1], helper[2] - d * n[2]])
+    const v: Vector3 = [n[1] * u[2] - n[2] * u[1], n[2] * u[0] - n[0] * u[2], n[0] * u[1] - n[1] * u[0]]
+    return [u, v]
+}
+
+// Convex hull of 2D points, counterclockwise (monotone chain)
+function convexHull(points: [number, number][]): [number, number][] {
+    const p = points.slice().sort((a, b) => a[0] - b[0] || a[1] - b[1])
+    if (p.length < 3) {
+        return p
+    }
+    const cross = (o: number[], a: number[], b: number[]) => (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0])
+    const lower: [number, number][] = []
+    for (const q of p) {
+        while (lower.length >= 2 && cross(lower[lower.length - 2], lower[lower.length - 1], q) <= 0) {
+            lower.pop()
+        }
+        lower.push(q)
+    }
+    const upper: [number, number][] = []
+    for (let i = p.length - 1; i >= 0; --i) {
+        const q = p[i]
+        while (upper.length >= 2 && cross(upper[upper.length - 2], upper[upper.length - 1], q) <= 0) {
+            upper.pop()
+        }
+        upper.push(q)
+    }
+    lower.pop()
+    upper.pop()
+    return lower.concat(upper)
+}
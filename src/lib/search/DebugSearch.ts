@@ -1,5 +1,6 @@
-import { Data } from "../data";
-import { Engine, HomogeneousEngine } from "../geomeca";
+import { Data } from "../data/Data";
+import { Engine } from "../geomeca/Engine";
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine";
 import { cloneMisfitCriteriunSolution, MisfitCriteriunSolution } from "../InverseMethod";
 import { Matrix3x3, multiplyTensors, newMatrix3x3, newMatrix3x3Identity, transposeTensor } from "../types";
 import { SearchMethod } from "./SearchMethod";
@@ -1,23 +1,36 @@
-import { MasterStress, StressTensor } from '../types'
-import { DebugSearch } from './DebugSearch'
-// import { GridSearch } from './GridSearch'
-import { MonteCarlo } from './MonteCarlo'
+import { cloneMatrix3x3, MasterStress, StressTensor } from '../types'
 import { SearchMethod } from './SearchMethod'
 
+/* eslint @typescript-eslint/no-explicit-any: off -- need to have any here for the factory */
+/**
+ * @brief Registry of the search methods by name.
+ *
+ * As for DataFactory, the built-in methods are bound lazily at the end of this module, so that a method is only loaded
+ * and evaluated when a job uses it.
+ * @category Search-Method
+ */
 export namespace SearchMethodFactory {
 
-    const map_: Map<string, any> = new Map()
+    // The class of each method, or its loader until the method is requested
+    const map_: Map<string, { type?: any, loader?: () => any }> = new Map()
 
     export const bind = (obj: any, name: string = '') => {
-        name.length === 0 ? map_.set(obj.name, obj) : map_.set(name, obj)
+        name.length === 0 ? map_.set(obj.name, { type: obj }) : map_.set(name, { type: obj })
+    }
+
+    /**
+     * Register a method whose class is given by loader on first request
+     */
+    export const bindLazy = (name: string, loader: () => any) => {
+        map_.set(name, { loader })
     }
 
     export const create = (name: string, params: any = undefined): SearchMethod => {
-        const M = map_.get(name)
+        const M = resolve(name)
         if (M) {
             const searchMethod = new M(params)
             // to be filled
-            if (params !== undefined) {
+            if (params !== undefined && params.interactiveStressTensor !== undefined) {
                 const ist = params.interactiveStressTensor
                 const st = new StressTensor({
                     trendS1: ist.trendS1,
@@ -27,7 +40,8 @@ export namespace SearchMethodFactory {
                     masterStress: ist.masterStress==='Sigma1' ? MasterStress.Sigma1 : MasterStress.Sigma3,
                     stressRatio: ist.stressRatio
                 })
-                searchMethod.setInteractiveSolution({rot: st.Rrot, stressRatio: st.stressRatio})
+                // Rrot is the live storage of the tensor (see StressTensor.Rrot)
+                searchMethod.setInteractiveSolution({rot: cloneMatrix3x3(st.Rrot), stressRatio: st.stressRatio})
             }
             return searchMethod
         }
@@ -42,8 +56,34 @@ export namespace SearchMethodFactory {
         return Array.from(map_.keys())
     }
 
+    /**
+     * Load all the lazy methods now (e.g., before taking a startup snapshot)
+     */
+    export const preload = (): void => {
+        Array.from(map_.keys()).forEach(resolve)
+    }
+
+    const resolve = (name: string): any => {
+        const entry = map_.get(name)
+        if (entry === undefined) {
+            return undefined
+        }
+        if (entry.type === undefined) {
+            entry.type = entry.loader()
+            entry.loader = undefined
+        }
+        return entry.type
+    }
+
 }
 
-// SearchMethodFactory.bind(GridSearch, 'Grid Search')
-SearchMethodFactory.bind(DebugSearch, 'Debug Search')
-SearchMethodFactory.bind(MonteCarlo, 'Monte Carlo')
\ No newline at end of file
+// --------------- Hidden to users
+
+// SearchMethodFactory.bindLazy('Grid Search', () => require('./GridSearch').GridSearch)
+SearchMethodFactory.bindLazy('Debug Search', () => require('./DebugSearch').DebugSearch)
+SearchMethodFactory.bindLazy('Monte Carlo', () => require('./MonteCarlo').MonteCarlo)
+SearchMethodFactory.bindLazy('Monte Carlo Friction', () => require('./MonteCarloFriction').MonteCarloFriction)
+SearchMethodFactory.bindLazy('Branch And Bound', () => require('./BranchAndBound').BranchAndBound)
+SearchMethodFactory.bindLazy('Parallel Tempering', () => require('./ParallelTempering').ParallelTempering)
+SearchMethodFactory.bindLazy('CMA-ES', () => require('./CMAES').CMAES)
+SearchMethodFactory.bindLazy('Successive Halving', () => require('./SuccessiveHalving').SuccessiveHalving)
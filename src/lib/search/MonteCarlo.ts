@@ -1,11 +1,15 @@
-import { Data } from "../data"
-import { Engine, HomogeneousEngine } from "../geomeca"
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { Engine } from "../geomeca/Engine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
 import { cloneMisfitCriteriunSolution, MisfitCriteriunSolution } from "../InverseMethod"
 import { 
     cloneMatrix3x3, Matrix3x3, multiplyTensors, 
     newMatrix3x3, newMatrix3x3Identity, properRotationTensor, 
     spherical2unitVectorCartesian, SphericalCoords, transposeTensor
 } from "../types"
+import { Random } from "../utils/Random"
+import { ConfidenceRegion } from "./ConfidenceRegion"
 import { SearchMethod } from "./SearchMethod"
 // import { stressTensorDelta } from "./utils"
 
@@ -14,23 +18,27 @@ export type MonteCarloParams = {
     nbRandomTrials?: number,
     stressRatio?: number,
     stressRatioHalfInterval?: number,
-    Rrot?: Matrix3x3
+    Rrot?: Matrix3x3,
+    // Seed of the random trials, to reproduce a search (random by default, see Random)
+    seed?: number
 }
 
 /**
  * @category Search-Method
  */
 export class MonteCarlo implements SearchMethod {
-    private rotAngleHalfInterval: number
-    private nbRandomTrials: number
-    private stressRatioHalfInterval: number
-    private stressRatio0: number
-    private Rrot: Matrix3x3 = undefined
-    private RTrot: Matrix3x3 = undefined
-    private engine: Engine = new HomogeneousEngine()
+    protected rotAngleHalfInterval: number
+    protected nbRandomTrials: number
+    protected stressRatioHalfInterval: number
+    protected stressRatio0: number
+    protected Rrot: Matrix3x3 = undefined
+    protected RTrot: Matrix3x3 = undefined
+    protected engine: Engine = new HomogeneousEngine()
+    protected region: ConfidenceRegion = undefined
+    protected seed: number
 
     constructor(
-        {stressRatio=0.5, stressRatioHalfInterval=0.25, rotAngleHalfInterval=Math.PI, nbRandomTrials=1000, Rrot=newMatrix3x3Identity()}:
+        {stressRatio=0.5, stressRatioHalfInterval=0.25, rotAngleHalfInterval=Math.PI, nbRandomTrials=1000, Rrot=newMatrix3x3Identity(), seed=undefined}:
         MonteCarloParams = {})
     {
         this.rotAngleHalfInterval = rotAngleHalfInterval
@@ -39,12 +47,21 @@ export class MonteCarlo implements SearchMethod {
         this.stressRatioHalfInterval = stressRatioHalfInterval
         this.Rrot = Rrot
         this.RTrot = transposeTensor(this.Rrot)
+        this.seed = seed
     }
 
     setNbIter(n: number) {
         this.nbRandomTrials = n
     }
 
+    /**
+     * Capture all the trials whose misfit is within region.delta of the best misfit (see ConfidenceRegion).
+     * Set undefined to stop the capture.
+     */
+    setConfidenceRegion(region: ConfidenceRegion): void {
+        this.region = region
+    }
+
     getEngine(): Engine {
         return this.engine
     }
@@ -55,10 +72,16 @@ export class MonteCarlo implements SearchMethod {
 
     setInteractiveSolution({rot, stressRatio}:{rot: Matrix3x3, stressRatio: number}): void {
         this.Rrot = rot
+        this.RTrot = transposeTensor(rot)
         this.stressRatio0 = stressRatio
     }
 
     run(data: Data[], misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        // The data are packed once, then evaluated for each trial by batched kernels
+        return this.runPacked(new PackedDataset(data), misfitCriteriaSolution)
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
         // The optimum stress tensor is calculated by exploring the stress orientations and the stress ratio around the approximate solution Sr (r = rough solution)
         // obtained by the user during the interactive analysis of flow lines on the sphere, Mohr circle diagram, and histogram of signed angular deviations.
         // More precisely, the minimization function is calculated for a set of stress tensors whose orientations are rotated around axes 
@@ -84,6 +107,8 @@ export class MonteCarlo implements SearchMethod {
 
         console.log('Starting the montecarlo search...')
 
+        const random = new Random(this.seed)
+
         let changed = false
         const newSolution = cloneMisfitCriteriunSolution(misfitCriteriaSolution)
 
@@ -91,15 +116,15 @@ export class MonteCarlo implements SearchMethod {
             // For each trial, a rotation axis in the unit sphere is calculated from a uniform random distribution.
 
             // phi = random variable representing azimuth [0, 2PI)
-            rotAxisSpheCoords.phi = Math.random() * 2 * Math.PI
+            rotAxisSpheCoords.phi = random.next() * 2 * Math.PI
             // theta = random variable representing the colatitude [0, PI)
             //      the arcos function ensures a uniform distribution for theta from a random value:
-            rotAxisSpheCoords.theta = Math.acos( 2*Math.random() - 1)
+            rotAxisSpheCoords.theta = Math.acos( 2*random.next() - 1)
 
             let rotAxis = spherical2unitVectorCartesian(rotAxisSpheCoords)
 
             // We only consider positive rotation angles around each rotation axis, since the whole sphere is covered by angles (phi,theta)
-            let rotAngle = Math.random() * this.rotAngleHalfInterval
+            let rotAngle = random.next() * this.rotAngleHalfInterval
                 
             // Calculate rotation tensors Drot and DTrot between systems Sr and Sw such that:
             //  Vr  = DTrot Vw        (DTrot is tensor Drot transposed)
@@ -116,7 +141,7 @@ export class MonteCarlo implements SearchMethod {
             Wrot  = transposeTensor( WTrot )
 
             // Stress ratio variation around R = (S2-S3)/(S1-S3)
-            let stressRatio = stressRatioMin + Math.random() * stressRatioEffectiveInterval // The strees ratio is in interval [0,1]
+            let stressRatio = stressRatioMin + random.next() * stressRatioEffectiveInterval // The strees ratio is in interval [0,1]
 
             // Calculate the stress tensor STdelta in reference frame S from the stress tensor in reference frame Sw
             // STdelta is defined according to the continuum mechanics sign convention : compression < 0
@@ -127,19 +152,7 @@ export class MonteCarlo implements SearchMethod {
             //     return previous + current.cost({stress: STdelta, rot: Wrot}
             // )} , 0) / data.length
 
-            this.engine.setHypotheticalStress(Wrot, stressRatio)
-
-            const misfit = data.reduce( (previous, current) => {
-                return previous + current.cost({stress: this.engine.stress(current.position)})
-            } , 0) / data.length
-            
-            if (misfit < newSolution.misfit) {
-                newSolution.misfit = misfit
-                newSolution.rotationMatrixD = cloneMatrix3x3(Drot)
-                newSolution.rotationMatrixW = cloneMatrix3x3(Wrot)
-                newSolution.stressRatio = stressRatio
-                newSolution.stressTensorSolution = this.engine.S() // was STdelta
-            }
+            this.evaluate(packed, newSolution, Drot, Wrot, stressRatio)
 
             // const misfitSum  = misfitCriteriaSolution.criterion.value(STdelta)
             // if (misfitSum < misfitCriteriaSolution.misfitSum) {
@@ -154,7 +167,30 @@ export class MonteCarlo implements SearchMethod {
         }
         return newSolution
             
-    }            
+    }
+
+    /**
+     * Evaluate the misfit of one trial and update the solution if it is better
+     */
+    protected evaluate(packed: PackedDataset, solution: MisfitCriteriunSolution, Drot: Matrix3x3, Wrot: Matrix3x3, stressRatio: number): void {
+        this.engine.setHypotheticalStress(Wrot, stressRatio)
+
+        // The evaluation can be abandoned as soon as the trial cannot beat the solution (or enter the confidence region)
+        const bound = this.region === undefined ? solution.misfit : this.region.threshold(solution.misfit)
+        const misfit = packed.cost(this.engine, bound)
+        if (this.region !== undefined && misfit < bound) {
+            this.region.add(Wrot, stressRatio, misfit)
+        }
+
+        if (misfit < solution.misfit) {
+            solution.misfit = misfit
+            solution.rotationMatrixD = cloneMatrix3x3(Drot)
+            solution.rotationMatrixW = cloneMatrix3x3(Wrot)
+            solution.stressRatio = stressRatio
+            solution.stressTensorSolution = this.engine.S() // was STdelta
+        }
+    }
+
     // To analyse the rotation axis for the best solution: 
     // The cartesian and spherical coords of a unit vector corresponding to the rotation axis are determined 
     // from the components of the tensor definning a proper rotation
@@ -0,0 +1,158 @@
+import { PackedDataset } from "../data/PackedDataset"
+import { PackedStriatedPlanes, StriatedPlaneMisfit } from "../data/PackedStriatedPlanes"
+import { FrictionSolution, MisfitCriteriunSolution } from "../InverseMethod"
+import { cloneMatrix3x3, Matrix3x3 } from "../types"
+import { MonteCarlo, MonteCarloParams } from "./MonteCarlo"
+
+export type MonteCarloFrictionParams = MonteCarloParams & {
+    cohesionMin?: number,
+    cohesionMax?: number,
+    nbCohesions?: number,
+    frictionAngleMin?: number,
+    frictionAngleMax?: number,
+    nbFrictionAngles?: number
+}
+
+/**
+ * @brief Joint inversion of the stress tensor and of the rock parameters (cohesion, friction angle)
+ * used by the friction-law striated planes (StriatedPlaneFriction1 and StriatedPlaneFriction2).
+ *
+ * The stress orientations and the stress ratio are sampled as in MonteCarlo. For each trial, the traction components
+ * on the fault planes are computed once and reused for all the nodes of a regular grid in (cohesion, frictionAngle).
+ * The rock parameters given to each datum (setOptions) are replaced by the ones of the grid, so they do not need to be set.
+ *
+ * The friction criteria only penalise the planes located below the friction line: the data bound the rock parameters
+ * from above, and the weaker rocks often have the same misfit. Among equal misfits, the strongest rock consistent
+ * with the data is kept, i.e., the largest shear strength c + sigma tan(phi) at the mean normal stress sigma of the planes.
+ *
+ * The solution holds the best rock parameters and the misfit slice over the grid for the best stress tensor
+ * (see FrictionSolution).
+ *
+ * @example
+ * ```ts
+ * const search = new MonteCarloFriction({
+ *     nbRandomTrials: 10000,
+ *     cohesionMin: 0, cohesionMax: 0.3, nbCohesions: 16,
+ *     frictionAngleMin: 10 * Math.PI / 180, frictionAngleMax: 40 * Math.PI / 180, nbFrictionAngles: 31
+ * })
+ * inv.setSearchMethod(search)
+ * const sol = inv.run()
+ * console.log(sol.friction.cohesion, sol.friction.frictionAngle)
+ * ```
+ * @category Search-Method
+ */
+export class MonteCarloFriction extends MonteCarlo {
+    private cohesions: Float64Array
+    private frictionAngles: Float64Array
+    private misfits: Float64Array
+    private friction: FrictionSolution = undefined
+
+    constructor(params: MonteCarloFrictionParams = {}) {
+        super(params)
+        const {
+            cohesionMin = 0, cohesionMax = 0, nbCohesions = 1,
+            frictionAngleMin = Math.PI / 6, frictionAngleMax = Math.PI / 6, nbFrictionAngles = 1
+        } = params
+
+        if (frictionAngleMin <= 0 || frictionAngleMax < frictionAngleMin) {
+            throw new Error('For friction analysis choose 0 < frictionAngleMin <= frictionAngleMax')
+        }
+        if (cohesionMin < 0 || cohesionMax < cohesionMin) {
+            throw new Error('For friction analysis choose 0 <= cohesionMin <= cohesionMax')
+        }
+
+        this.cohesions = sample(cohesionMin, cohesionMax, nbCohesions)
+        this.frictionAngles = sample(frictionAngleMin, frictionAngleMax, nbFrictionAngles)
+        this.misfits = new Float64Array(this.cohesions.length * this.frictionAngles.length)
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        if (!packed.striatedPlanes.hasFriction) {
+            throw new Error('Joint friction inversion requires striated planes with a friction law')
+        }
+
+        this.friction = undefined
+        const solution = super.runPacked(packed, misfitCriteriaSolution)
+
+        if (this.friction !== undefined) {
+            // Misfit slice over the rock parameters for the best stress tensor
+            const misfits = new Float64Array(this.misfits.length)
+            this.engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+            packed.frictionCosts(this.engine, this.cohesions, this.frictionAngles, misfits)
+            this.friction.misfits = misfits
+            solution.friction = this.friction
+        }
+
+        return solution
+    }
+
+    protected evaluate(packed: PackedDataset, solution: MisfitCriteriunSolution, Drot: Matrix3x3, Wrot: Matrix3x3, stressRatio: number): void {
+        this.engine.setHypotheticalStress(Wrot, stressRatio)
+        packed.frictionCosts(this.engine, this.cohesions, this.frictionAngles, this.misfits)
+
+        // The traction columns of the planes are filled by frictionCosts
+        const nf = this.frictionAngles.length
+        const sigma = meanCompression(packed.striatedPlanes)
+        const strength = (k: number) => this.cohesions[Math.floor(k / nf)] + sigma * Math.tan(this.frictionAngles[k % nf])
+        let best = 0, bestStrength = strength(0)
+        for (let k = 1; k < this.misfits.length; ++k) {
+            const d = this.misfits[k] - this.misfits[best]
+            if (d < -TIE || (d <= TIE && strength(k) > bestStrength)) {
+                best = k
+                bestStrength = strength(k)
+            }
+        }
+
+        const misfit = this.misfits[best]
+        if (this.region !== undefined) {
+            this.region.add(Wrot, stressRatio, misfit)
+        }
+        if (misfit < solution.misfit) {
+            solution.misfit = misfit
+            solution.rotationMatrixD = cloneMatrix3x3(Drot)
+            solution.rotationMatrixW = cloneMatrix3x3(Wrot)
+            solution.stressRatio = stressRatio
+            solution.stressTensorSolution = this.engine.S()
+            this.friction = {
+                cohesion: this.cohesions[Math.floor(best / nf)],
+                frictionAngle: this.frictionAngles[best % nf],
+                cohesions: this.cohesions.slice(),
+                frictionAngles: this.frictionAngles.slice(),
+                misfits: undefined
+            }
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+// Misfits closer than TIE are equal
+const TIE = 1e-12
+
+// Weighted mean normal stress of the planes with a friction criterion (compression > 0), from their traction columns
+function meanCompression(planes: PackedStriatedPlanes): number {
+    const normalStress = planes.tractions.normalStress
+    let sum = 0, weight = 0
+    for (let i = 0; i < planes.count; ++i) {
+        const k = planes.kind[i]
+        if (k === StriatedPlaneMisfit.FRICTION_1 || k === StriatedPlaneMisfit.FRICTION_2) {
+            sum -= planes.weights[i] * normalStress[i]
+            weight += planes.weights[i]
+        }
+    }
+    return weight === 0 ? 0 : sum / weight
+}
+
+function sample(min: number, max: number, n: number): Float64Array {
+    const nb = Math.max(1, Math.floor(n))
+    const values = new Float64Array(nb)
+    if (nb === 1) {
+        values[0] = min
+        return values
+    }
+    const step = (max - min) / (nb - 1)
+    for (let i = 0; i < nb; ++i) {
+        values[i] = min + i * step
+    }
+    return values
+}
@@ -0,0 +1,402 @@
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { Engine } from "../geomeca/Engine"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { cloneMisfitCriteriunSolution, MisfitCriteriunSolution } from "../InverseMethod"
+import { Matrix3x3, multiplyTensors, newMatrix3x3, newMatrix3x3Identity, transposeTensor } from "../types"
+import { Random } from "../utils/Random"
+import { SearchMethod } from "./SearchMethod"
+import { SearchWorkers } from "./SearchWorkers"
+import { matrixToQuaternion, quaternionToMatrix } from "./utils"
+
+export type ParallelTemperingParams = {
+    rotAngleHalfInterval?: number,
+    stressRatio?: number,
+    stressRatioHalfInterval?: number,
+    Rrot?: Matrix3x3,
+    // Total number of steps, shared by all the chains. Each step evaluates the misfit once, except the proposals
+    // outside of rotAngleHalfInterval, which are rejected without evaluation (see ParallelTempering.nbEvaluations)
+    nbSteps?: number,
+    // Number of replicas. With one chain and cooling < 1, the search is a simulated annealing
+    nbChains?: number,
+    // Temperatures of the coldest and of the hottest chains (in misfit units), geometrically spaced
+    temperatureMin?: number,
+    temperatureMax?: number,
+    // Factor applied to all the temperatures at the end of the run (geometric cooling schedule, 1 for none)
+    cooling?: number,
+    // Number of steps of each chain between two exchange attempts
+    swapInterval?: number,
+    // Maximum rotation angle of a proposal for the hottest chain. Colder chains use smaller steps
+    rotationStep?: number,
+    // Maximum change of the stress ratio of a proposal for the hottest chain
+    stressRatioStep?: number,
+    // Seed of the random proposals, to reproduce a search (random by default, see Random)
+    seed?: number
+}
+
+/**
+ * @brief Replica-exchange (parallel tempering) search of the stress tensor.
+ *
+ * Several Metropolis chains explore the stress orientations and the stress ratio at temperatures ranging from
+ * temperatureMin to temperatureMax. The hot chains cross the barriers of rugged misfit landscapes, while the cold chains
+ * refine the basins they are given: every swapInterval steps, the states of adjacent chains are exchanged with the
+ * usual replica-exchange probability min(1, exp((E_i - E_j) (1/T_i - 1/T_j))).
+ *
+ * The orientation of each chain is a unit quaternion, perturbed in place by a rotation around a random axis,
+ * and the stress ratio by a step reflected in the allowed interval. A proposal farther than rotAngleHalfInterval from Rrot
+ * is rejected (the chain stays in place) and counts as a step. The best tensor visited by any chain is returned.
+ *
+ * Between two exchanges, the chains are independent: each chain has its own random generator, and its swapInterval
+ * steps are one task (see runSegment). With workers (see setWorkers), the segments of all the chains run in parallel
+ * on the shared dataset, and the exchanges are done by the calling thread once all the segments are done.
+ * The search draws the same proposals with and without workers.
+ *
+ * @example
+ * ```ts
+ * const search = new ParallelTempering({ nbSteps: 20000, nbChains: 8 })
+ * inv.setSearchMethod(search)
+ * const sol = inv.run()
+ * ```
+ * @category Search-Method
+ */
+export class ParallelTempering implements SearchMethod {
+    protected rotAngleHalfInterval: number
+    protected stressRatioHalfInterval: number
+    protected stressRatio0: number
+    protected Rrot: Matrix3x3 = undefined
+    protected RTrot: Matrix3x3 = undefined
+    protected nbSteps: number
+    protected nbChains: number
+    protected temperatureMin: number
+    protected temperatureMax: number
+    protected cooling: number
+    protected swapInterval: number
+    protected rotationStep: number
+    protected stressRatioStep: number
+    protected engine: Engine = new HomogeneousEngine()
+    protected workers: SearchWorkers = undefined
+    protected seed: number
+    private nbSwaps_ = 0
+    private nbEvaluations_ = 0
+
+    constructor(
+        {stressRatio=0.5, stressRatioHalfInterval=0.5, rotAngleHalfInterval=Math.PI, Rrot=newMatrix3x3Identity(),
+         nbSteps=10000, nbChains=8, temperatureMin=1e-3, temperatureMax=0.2, cooling=1, swapInterval=10,
+         rotationStep=Math.PI / 4, stressRatioStep=0.2, seed=undefined}:
+        ParallelTemperingParams = {})
+    {
+        if (nbChains < 1) {
+            throw new Error(`The number of chains must be at least 1 (got ${nbChains})`)
+        }
+        if (temperatureMin <= 0 || temperatureMax < temperatureMin) {
+            throw new Error('For parallel tempering choose 0 < temperatureMin <= temperatureMax')
+        }
+        if (cooling <= 0 || cooling > 1) {
+            throw new Error(`The cooling factor must be in (0, 1] (got ${cooling})`)
+        }
+        this.rotAngleHalfInterval = rotAngleHalfInterval
+        this.stressRatio0 = stressRatio
+        this.stressRatioHalfInterval = stressRatioHalfInterval
+        this.Rrot = Rrot
+        this.RTrot = transposeTensor(Rrot)
+        this.nbSteps = nbSteps
+        this.nbChains = nbChains
+        this.temperatureMin = temperatureMin
+        this.temperatureMax = temperatureMax
+        this.cooling = cooling
+        this.swapInterval = Math.max(1, swapInterval)
+        this.rotationStep = rotationStep
+        this.stressRatioStep = stressRatioStep
+        this.seed = seed
+    }
+
+    setNbIter(n: number) {
+        this.nbSteps = n
+    }
+
+    /**
+     * Number of accepted exchanges between chains during the last run
+     */
+    get nbSwaps(): number {
+        return this.nbSwaps_
+    }
+
+    /**
+     * Number of misfit evaluations of the last run: the steps minus the proposals rejected without evaluation
+     */
+    get nbEvaluations(): number {
+        return this.nbEvaluations_
+    }
+
+    /**
+     * @brief Run the segments of the chains with workers (undefined to run them in the calling thread).
+     * The dataset must then be packed with the shared option, and the engine must be homogeneous.
+     */
+    setWorkers(workers: SearchWorkers): void {
+        this.workers = workers
+    }
+
+    getEngine(): Engine {
+        return this.engine
+    }
+
+    setEngine(engine: Engine): void {
+        this.engine = engine
+    }
+
+    setInteractiveSolution({rot, stressRatio}:{rot: Matrix3x3, stressRatio: number}): void {
+        this.Rrot = rot
+        this.RTrot = transposeTensor(rot)
+        this.stressRatio0 = stressRatio
+    }
+
+    run(data: Data[], misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        return this.runPacked(new PackedDataset(data, { shared: this.workers !== undefined }), misfitCriteriaSolution)
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        if (this.workers !== undefined && !(this.engine instanceof HomogeneousEngine)) {
+            throw new Error('The workers of the parallel tempering search only support the homogeneous engine')
+        }
+        const stressRatioMin = Math.max(0, Math.abs(this.stressRatio0) - this.stressRatioHalfInterval)
+        const stressRatioMax = Math.min(1, Math.abs(this.stressRatio0) + this.stressRatioHalfInterval)
+
+        console.log('Starting the parallel tempering search...')
+
+        // Draws the initial states, the seeds of the chains and the exchanges
+        const random = new Random(this.seed)
+
+        const solution = cloneMisfitCriteriunSolution(misfitCriteriaSolution)
+        const n = this.nbChains
+        const qR = new Float64Array(4)
+        matrixToQuaternion(this.Rrot, qR, 0)
+        const params: SegmentParams = {
+            qR: Array.from(qR),
+            // Cosine of half the maximum rotation from Rrot, compared with |q . qR| = cos(angle / 2)
+            minCosHalfAngle: Math.cos(Math.min(Math.PI, this.rotAngleHalfInterval) / 2),
+            stressRatioMin,
+            stressRatioMax,
+            coolingPerStep: Math.pow(this.cooling, n / Math.max(1, this.nbSteps - n))
+        }
+
+        // State of the chains, one segment each (see runSegment)
+        const chains = new Float64Array(CHAIN * n)
+        const results = new Float64Array(RESULT * n)
+        const temperature = new Float64Array(n)
+        for (let c = 0; c < n; ++c) {
+            const chain = chains.subarray(CHAIN * c, CHAIN * c + CHAIN)
+            const t = n === 1 ? 0 : c / (n - 1)
+            temperature[c] = this.temperatureMin * Math.pow(this.temperatureMax / this.temperatureMin, t)
+            // Colder chains use smaller steps
+            const scale = Math.sqrt(temperature[c] / this.temperatureMax)
+            chain.set(qR, Q)
+            chain[RATIO] = stressRatioMin + random.next() * (stressRatioMax - stressRatioMin)
+            // The first step of a chain evaluates its initial state
+            chain[ENERGY] = Number.NaN
+            chain[SEED] = Math.floor(random.next() * 0x100000000)
+            chain[ROT_STEP] = this.rotationStep * scale
+            chain[RATIO_STEP] = this.stressRatioStep * scale
+        }
+
+        let steps = 0
+        let coolingFactor = 1
+        let parity = 0
+        let first = true
+        this.nbSwaps_ = 0
+        this.nbEvaluations_ = 0
+
+        while (steps < this.nbSteps) {
+            // The first segment only evaluates the initial states. The last one shares the remaining steps between the chains
+            const remaining = this.nbSteps - steps
+            const length = first ? 1 : Math.min(this.swapInterval, Math.floor(remaining / n))
+            for (let c = 0; c < n; ++c) {
+                const chain = chains.subarray(CHAIN * c, CHAIN * c + CHAIN)
+                chain[TEMPERATURE] = temperature[c] * coolingFactor
+                chain[STEPS] = length === 0 ? (c < remaining ? 1 : 0) : (first && c >= remaining ? 0 : length)
+                steps += chain[STEPS]
+            }
+            this.runSegments(packed, params, chains, results)
+
+            for (let c = 0; c < n; ++c) {
+                const result = results.subarray(RESULT * c, RESULT * c + RESULT)
+                chains.set(result.subarray(0, CHAIN_STATE), CHAIN * c)
+                this.nbEvaluations_ += result[R_EVALUATIONS]
+                if (result[R_BEST] < solution.misfit) {
+                    const W = newMatrix3x3()
+                    quaternionToMatrix(result, R_BEST_Q, W)
+                    this.engine.setHypotheticalStress(W, result[R_BEST_RATIO])
+                    solution.misfit = result[R_BEST]
+                    solution.rotationMatrixW = W
+                    // Wrot = Drot Rrot
+                    solution.rotationMatrixD = multiplyTensors({ A: W, B: this.RTrot })
+                    solution.stressRatio = result[R_BEST_RATIO]
+                    solution.stressTensorSolution = this.engine.S()
+                }
+            }
+            if (first) {
+                first = false
+                continue
+            }
+            coolingFactor *= Math.pow(params.coolingPerStep, length)
+
+            // Exchange attempts between adjacent chains, alternating the even and odd pairs
+            for (let c = parity; c + 1 < n; c += 2) {
+                const i = CHAIN * c, j = CHAIN * (c + 1)
+                const delta = (chains[i + ENERGY] - chains[j + ENERGY]) * (1 / temperature[c] - 1 / temperature[c + 1]) / coolingFactor
+                if (delta >= 0 || random.next() < Math.exp(delta)) {
+                    swapStates(chains, i, j)
+                    this.nbSwaps_++
+                }
+            }
+            parity = 1 - parity
+        }
+
+        return solution
+    }
+
+    /**
+     * Run the segments of all the chains, in the workers or in the calling thread
+     */
+    protected runSegments(packed: PackedDataset, params: SegmentParams, chains: Float64Array, results: Float64Array): void {
+        const n = chains.length / CHAIN
+        if (this.workers !== undefined) {
+            this.workers.run(packed, 'Parallel Tempering', params, chains, n, results)
+            return
+        }
+        for (let c = 0; c < n; ++c) {
+            runSegment(this.engine, packed, params, chains.subarray(CHAIN * c, CHAIN * c + CHAIN), results.subarray(RESULT * c, RESULT * c + RESULT))
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+function reflect(v: number, min: number, max: number): number {
+    if (max <= min) {
+        return min
+    }
+    while (v < min || v > max) {
+        v = v < min ? 2 * min - v : 2 * max - v
+    }
+    return v
+}
+
+// Values of a chain given to a segment: its state (quaternion, stress ratio, misfit, state of its random generator), then
+// its temperature, its maximum steps and the number of steps of the segment
+const Q = 0
+const RATIO = 4
+const ENERGY = 5
+const SEED = 6
+const CHAIN_STATE = 7
+const TEMPERATURE = 7
+const ROT_STEP = 8
+const RATIO_STEP = 9
+const STEPS = 10
+const CHAIN = 11
+
+// Values of the result of a segment: the state of the chain, then the best misfit of the segment with its quaternion
+// and its stress ratio, and the number of misfit evaluations
+const R_BEST = 7
+const R_BEST_Q = 8
+const R_BEST_RATIO = 12
+const R_EVALUATIONS = 13
+const RESULT = 14
+
+type SegmentParams = {
+    qR: number[],
+    minCosHalfAngle: number,
+    stressRatioMin: number,
+    stressRatioMax: number,
+    // Factor applied to the temperature after each step
+    coolingPerStep: number
+}
+
+/**
+ * Run the steps of a segment of one chain (the task of the workers, see SearchTasks)
+ */
+export function runSegmentTask(packed: PackedDataset, params: SegmentParams, chain: Float64Array, result: Float64Array): void {
+    runSegment(new HomogeneousEngine(), packed, params, chain, result)
+}
+
+function runSegment(engine: Engine, packed: PackedDataset, params: SegmentParams, chain: Float64Array, result: Float64Array): void {
+    const { qR, minCosHalfAngle, stressRatioMin, stressRatioMax, coolingPerStep } = params
+    const random = new Random(chain[SEED])
+    const W = newMatrix3x3()
+    const q = new Float64Array(4)
+    const qp = new Float64Array(4)
+    q.set(chain.subarray(Q, Q + 4))
+    let ratio = chain[RATIO]
+    let energy = chain[ENERGY]
+    let T = chain[TEMPERATURE]
+    let best = Number.POSITIVE_INFINITY
+    let evaluations = 0
+    result[R_BEST] = best
+
+    const evaluate = (quat: Float64Array, stressRatio: number): number => {
+        quaternionToMatrix(quat, 0, W)
+        engine.setHypotheticalStress(W, stressRatio)
+        const misfit = packed.cost(engine)
+        evaluations++
+        if (misfit < best) {
+            best = misfit
+            result.set(quat, R_BEST_Q)
+            result[R_BEST_RATIO] = stressRatio
+        }
+        return misfit
+    }
+
+    for (let step = 0; step < chain[STEPS]; ++step) {
+        if (Number.isNaN(energy)) {
+            energy = evaluate(q, ratio)
+            continue
+        }
+        // Quaternion proposal qp = dq * q, where dq is a rotation around a random axis
+        perturbQuaternion(random, q, 0, chain[ROT_STEP] * random.next(), qp)
+        if (Math.abs(qp[0] * qR[0] + qp[1] * qR[1] + qp[2] * qR[2] + qp[3] * qR[3]) >= minCosHalfAngle) {
+            const stressRatio = reflect(ratio + chain[RATIO_STEP] * (2 * random.next() - 1), stressRatioMin, stressRatioMax)
+            const e = evaluate(qp, stressRatio)
+            if (e <= energy || random.next() < Math.exp((energy - e) / T)) {
+                q.set(qp)
+                ratio = stressRatio
+                energy = e
+            }
+        }
+        // Otherwise, outside of the allowed rotations: rejected
+        T *= coolingPerStep
+    }
+
+    result.set(q, Q)
+    result[RATIO] = ratio
+    result[ENERGY] = energy
+    result[SEED] = random.state
+    result[R_BEST] = best
+    result[R_EVALUATIONS] = evaluations
+}
+
+// Exchange the states of two chains, given by their offsets in chains (their random generators stay in place)
+function swapStates(chains: Float64Array, i: number, j: number): void {
+    for (let k = 0; k <= ENERGY; ++k) {
+        const t = chains[i + k]
+        chains[i + k] = chains[j + k]
+        chains[j + k] = t
+    }
+}
+
+// out = dq * q[offset..offset+4], dq being the rotation of the given angle around a uniformly distributed axis
+function perturbQuaternion(random: Random, q: Float64Array, offset: number, angle: number, out: Float64Array): void {
+    const z = 2 * random.next() - 1
+    const phi = 2 * Math.PI * random.next()
+    const r = Math.sqrt(1 - z * z)
+    const s = Math.sin(angle / 2)
+    const dw = Math.cos(angle / 2), dx = s * r * Math.cos(phi), dy = s * r * Math.sin(phi), dz = s * z
+
+    const w = q[offset], x = q[offset + 1], y = q[offset + 2], k = q[offset + 3]
+    out[0] = dw * w - dx * x - dy * y - dz * k
+    out[1] = dw * x + dx * w + dy * k - dz * y
+    out[2] = dw * y - dx * k + dy * w + dz * x
+    out[3] = dw * k + dx * y - dy * x + dz * w
+
+    // Avoid the drift of the norm
+    const norm = Math.hypot(out[0], out[1], out[2], out[3])
+    out[0] /= norm; out[1] /= norm; out[2] /= norm; out[3] /= norm
+}
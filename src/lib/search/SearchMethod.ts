@@ -1,5 +1,6 @@
-import { Data } from "../data"
-import { Engine } from "../geomeca"
+import { Data } from "../data/Data"
+import { PackedDataset } from "../data/PackedDataset"
+import { Engine } from "../geomeca/Engine"
 import { MisfitCriteriunSolution } from "../InverseMethod"
 import { Matrix3x3} from "../types/math"
 
@@ -20,4 +21,9 @@ export interface SearchMethod {
      * since we cannot parallelize the code
      */
     run(data: Data[], misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution
+
+    /**
+     * Same as run, but for data already packed (possibly weighted). Optional.
+     */
+    runPacked?(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution
 }
@@ -0,0 +1,89 @@
+import { PackedDataset } from "../data/PackedDataset"
+
+/**
+ * @brief A task of a search run by the workers on their copy of the dataset: read one input, write one output.
+ * @param packed The dataset, attached to the shared dataset of the search
+ * @param params The parameters of the run, the same for all the inputs
+ * @param input The values of one input (e.g., a cell of BranchAndBound)
+ * @param output The values of its output, to be written by the task
+ * @category Search-Method
+ */
+export type SearchTask = (packed: PackedDataset, params: any, input: Float64Array, output: Float64Array) => void
+
+/**
+ * @brief Workers running the independent evaluations of a search (e.g., the cells of a refinement step of BranchAndBound)
+ * on a dataset shared without copy (see PackedDataset.share).
+ *
+ * run() blocks until all the inputs are done, since the search methods are synchronous. The tasks are registered
+ * by name in SearchTasks, so that a worker only loads the modules of the searches it serves.
+ * A Node.js implementation is SearchWorkerPool (lib/server).
+ * @example
+ * ```ts
+ * const packed = new PackedDataset(data, { shared: true })
+ * const search = new BranchAndBound({ tolerance: 0.01 })
+ * search.setWorkers(new SearchWorkerPool({ workers: 8, workerScript: 'worker.js' }))
+ * const solution = search.runPacked(packed, createDefaultSolution())
+ * ```
+ * @category Search-Method
+ */
+export interface SearchWorkers {
+    /**
+     * Number of workers
+     */
+    readonly size: number
+
+    /**
+     * Run a task on count inputs, in parallel
+     * @param packed The dataset, packed with the shared option
+     * @param task The name of the task (see SearchTasks)
+     * @param params The parameters of the task, posted once to each worker
+     * @param inputs The inputs, inputs.length / count values each
+     * @param count The number of inputs
+     * @param outputs Receives the outputs, outputs.length / count values each
+     */
+    run(packed: PackedDataset, task: string, params: any, inputs: Float64Array, count: number, outputs: Float64Array): void
+}
+
+/* eslint @typescript-eslint/no-explicit-any: off -- need to have any here for the parameters of the tasks */
+/**
+ * @brief Registry of the tasks run by SearchWorkers, by name.
+ *
+ * As for SearchMethodFactory, the built-in tasks are bound lazily at the end of this module.
+ * @category Search-Method
+ */
+export namespace SearchTasks {
+
+    // The function of each task, or its loader until the task is requested
+    const map_: Map<string, { task?: SearchTask, loader?: () => SearchTask }> = new Map()
+
+    export const bind = (name: string, task: SearchTask) => {
+        map_.set(name, { task })
+    }
+
+    /**
+     * Register a task whose function is given by loader on first request
+     */
+    export const bindLazy = (name: string, loader: () => SearchTask) => {
+        map_.set(name, { loader })
+    }
+
+    export const get = (name: string): SearchTask => {
+        const entry = map_.get(name)
+        if (entry === undefined) {
+            return undefined
+        }
+        if (entry.task === undefined) {
+            entry.task = entry.loader()
+            entry.loader = undefined
+        }
+        return entry.task
+    }
+
+}
+
+// --------------- Hidden to users
+
+SearchTasks.bindLazy('Branch And Bound', () => require('./BranchAndBound').evaluateCellTask)
+SearchTasks.bindLazy('Parallel Tempering', () => require('./ParallelTempering').runSegmentTask)
+SearchTasks.bindLazy('CMA-ES', () => require('./CMAES').evaluatePointTask)
+SearchTasks.bindLazy('Sliding Window', () => require('../SlidingWindowInversion').runWindowsTask)
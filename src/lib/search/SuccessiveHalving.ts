@@ -0,0 +1,152 @@
+import { PackedDataset } from "../data/PackedDataset"
+import { MisfitCriteriunSolution, cloneMisfitCriteriunSolution } from "../InverseMethod"
+import { cloneMatrix3x3, Matrix3x3, multiplyTensors } from "../types"
+import { Random } from "../utils/Random"
+import { MonteCarlo, MonteCarloParams } from "./MonteCarlo"
+import { rotationVectorTensor } from "./utils"
+
+export type SuccessiveHalvingParams = MonteCarloParams & {
+    // Number of random data used to evaluate all the candidates (first rung)
+    initialSubsetSize?: number,
+    // At each rung, the number of candidates is divided by reduction and the size of the subset multiplied by reduction
+    reduction?: number,
+    // Minimum number of candidates evaluated on the full dataset
+    finalists?: number
+}
+
+/**
+ * @brief Multi-fidelity version of MonteCarlo, in the successive-halving style.
+ *
+ * The nbRandomTrials candidates are sampled as in MonteCarlo, then evaluated on a random subset of initialSubsetSize data.
+ * The best 1/reduction of the candidates are promoted to a subset reduction times larger (the subsets are nested),
+ * and so on until the subset is the full dataset. Only the finalists are evaluated on all the data,
+ * so the misfit of the solution is exact (in double precision if the dataset is in single precision), while most of the candidates cost a few hundred datum evaluations.
+ *
+ * The data must be packed from Data objects (see PackedDataset.subset).
+ *
+ * @example
+ * ```ts
+ * const search = new SuccessiveHalving({ nbRandomTrials: 10000, initialSubsetSize: 256 })
+ * inv.setSearchMethod(search)
+ * const sol = inv.run()
+ * ```
+ * @category Search-Method
+ */
+export class SuccessiveHalving extends MonteCarlo {
+    protected initialSubsetSize: number
+    protected reduction: number
+    protected finalists: number
+    private nbDatumEvaluations_ = 0
+
+    constructor(params: SuccessiveHalvingParams = {}) {
+        super(params)
+        const { initialSubsetSize = 256, reduction = 2, finalists = 4 } = params
+        if (initialSubsetSize < 1 || reduction <= 1 || finalists < 1) {
+            throw new Error('For successive halving choose initialSubsetSize >= 1, reduction > 1 and finalists >= 1')
+        }
+        this.initialSubsetSize = initialSubsetSize
+        this.reduction = reduction
+        this.finalists = finalists
+    }
+
+    /**
+     * Number of datum evaluations of the last run (a candidate evaluated on a subset of n data counts for n)
+     */
+    get nbDatumEvaluations(): number {
+        return this.nbDatumEvaluations_
+    }
+
+    runPacked(packed: PackedDataset, misfitCriteriaSolution: MisfitCriteriunSolution): MisfitCriteriunSolution {
+        const stressRatioMin = Math.max(0, Math.abs(this.stressRatio0) - this.stressRatioHalfInterval)
+        const stressRatioMax = Math.min(1, Math.abs(this.stressRatio0) + this.stressRatioHalfInterval)
+
+        console.log('Starting the successive halving search...')
+
+        const random = new Random(this.seed)
+
+        // The candidates, sampled as in MonteCarlo
+        let candidates: Candidate[] = []
+        for (let i = 0; i <= this.nbRandomTrials; i++) {
+            const phi = random.next() * 2 * Math.PI
+            const z = 2 * random.next() - 1
+            const r = Math.sqrt(1 - z * z)
+            const angle = random.next() * this.rotAngleHalfInterval
+            const Drot = rotationVectorTensor([angle * r * Math.cos(phi), angle * r * Math.sin(phi), angle * z])
+            candidates.push({
+                Drot,
+                Wrot: multiplyTensors({ A: Drot, B: this.Rrot }),
+                stressRatio: stressRatioMin + random.next() * (stressRatioMax - stressRatioMin),
+                misfit: 0
+            })
+        }
+
+        // Nested random subsets: the subset of a rung is the first data of a random permutation
+        const n = packed.size
+        const permutation = randomPermutation(random, n)
+        let size = Math.min(n, this.initialSubsetSize)
+        this.nbDatumEvaluations_ = 0
+
+        for (;;) {
+            const subset = size >= n ? packed : packed.subset(permutation.subarray(0, size))
+            for (const c of candidates) {
+                this.engine.setHypotheticalStress(c.Wrot, c.stressRatio)
+                c.misfit = subset.cost(this.engine)
+            }
+            this.nbDatumEvaluations_ += candidates.length * size
+            if (size >= n) {
+                if (packed.singlePrecision) {
+                    // The single precision is enough to rank the candidates, not for the misfit of the solution
+                    for (const c of candidates) {
+                        this.engine.setHypotheticalStress(c.Wrot, c.stressRatio)
+                        c.misfit = packed.exactCost(this.engine)
+                    }
+                }
+                break
+            }
+
+            // Promotion of the best candidates to a larger subset
+            candidates.sort((a, b) => a.misfit - b.misfit)
+            const promoted = Math.min(candidates.length, Math.max(this.finalists, Math.ceil(candidates.length / this.reduction)))
+            candidates = candidates.slice(0, promoted)
+            size = Math.min(n, Math.ceil(size * this.reduction))
+        }
+
+        // The misfits of the finalists are computed on the full dataset
+        const newSolution = cloneMisfitCriteriunSolution(misfitCriteriaSolution)
+        for (const c of candidates) {
+            if (c.misfit < newSolution.misfit) {
+                this.engine.setHypotheticalStress(c.Wrot, c.stressRatio)
+                newSolution.misfit = c.misfit
+                newSolution.rotationMatrixD = cloneMatrix3x3(c.Drot)
+                newSolution.rotationMatrixW = cloneMatrix3x3(c.Wrot)
+                newSolution.stressRatio = c.stressRatio
+                newSolution.stressTensorSolution = this.engine.S()
+            }
+        }
+        return newSolution
+    }
+}
+
+// --------------- Hidden to users
+
+type Candidate = {
+    Drot: Matrix3x3,
+    Wrot: Matrix3x3,
+    stressRatio: number,
+    misfit: number
+}
+
+// Fisher-Yates shuffle of 0..n-1
+function randomPermutation(random: Random, n: number): Int32Array {
+    const p = new Int32Array(n)
+    for (let i = 0; i < n; ++i) {
+        p[i] = i
+    }
+    for (let i = n - 1; i > 0; --i) {
+        const j = Math.floor(random.next() * (i + 1))
+        const t = p[i]
+        p[i] = p[j]
+        p[j] = t
+    }
+    return p
+}
@@ -1,6 +1,13 @@
 export * from './SearchMethod'
 export * from './Factory'
+export * from './SearchWorkers'
 export * from './utils'
 
 // export * from './GridSearch'
 export * from './MonteCarlo'
+export * from './MonteCarloFriction'
+export * from './BranchAndBound'
+export * from './ParallelTempering'
+export * from './CMAES'
+export * from './SuccessiveHalving'
+export * from './ConfidenceRegion'
@@ -1,4 +1,74 @@
-import { Matrix3x3, multiplyTensors, newMatrix3x3, stressTensorPrincipalAxes, Vector3 } from "../types/math"
+import { Matrix3x3, multiplyTensors, newMatrix3x3, newMatrix3x3Identity, properRotationTensor, stressTensorPrincipalAxes, transposeTensor, Vector3 } from "../types/math"
+
+/**
+ * @brief Rotation tensor Drot of a rotation vector (axis times angle), such that Wrot = Drot Rrot (see MonteCarlo).
+ * The angle between the rotations of two vectors r1 and r2 is at most |r1 - r2|.
+ * @category Search-Method
+ */
+export function rotationVectorTensor(r: ArrayLike<number>): Matrix3x3 {
+    const angle = Math.hypot(r[0], r[1], r[2])
+    if (angle === 0) {
+        return newMatrix3x3Identity()
+    }
+    const nRot: Vector3 = [r[0] / angle, r[1] / angle, r[2] / angle]
+    return transposeTensor(properRotationTensor({ nRot, angle }))
+}
+
+/**
+ * @brief Rotation matrix of the unit quaternion (w, x, y, z) stored at q[offset] (same convention as properRotationTensor)
+ * @category Search-Method
+ */
+export function quaternionToMatrix(q: ArrayLike<number>, offset: number, m: Matrix3x3): void {
+    const w = q[offset], x = q[offset + 1], y = q[offset + 2], z = q[offset + 3]
+    m[0][0] = 1 - 2 * (y * y + z * z)
+    m[0][1] = 2 * (x * y - z * w)
+    m[0][2] = 2 * (x * z + y * w)
+    m[1][0] = 2 * (x * y + z * w)
+    m[1][1] = 1 - 2 * (x * x + z * z)
+    m[1][2] = 2 * (y * z - x * w)
+    m[2][0] = 2 * (x * z - y * w)
+    m[2][1] = 2 * (y * z + x * w)
+    m[2][2] = 1 - 2 * (x * x + y * y)
+}
+
+/**
+ * @brief Unit quaternion (w, x, y, z) of a rotation matrix, written at q[offset] (Shepperd's method)
+ * @category Search-Method
+ */
+export function matrixToQuaternion(m: Matrix3x3, q: Float64Array, offset: number): void {
+    const trace = m[0][0] + m[1][1] + m[2][2]
+    let w: number, x: number, y: number, z: number
+    if (trace > 0) {
+        const s = 2 * Math.sqrt(1 + trace)
+        w = s / 4
+        x = (m[2][1] - m[1][2]) / s
+        y = (m[0][2] - m[2][0]) / s
+        z = (m[1][0] - m[0][1]) / s
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        const s = 2 * Math.sqrt(1 + m[0][0] - m[1][1] - m[2][2])
+        w = (m[2][1] - m[1][2]) / s
+        x = s / 4
+        y = (m[0][1] + m[1][0]) / s
+        z = (m[0][2] + m[2][0]) / s
+    } else if (m[1][1] > m[2][2]) {
+        const s = 2 * Math.sqrt(1 + m[1][1] - m[0][0] - m[2][2])
+        w = (m[0][2] - m[2][0]) / s
+        x = (m[0][1] + m[1][0]) / s
+        y = s / 4
+        z = (m[1][2] + m[2][1]) / s
+    } else {
+        const s = 2 * Math.sqrt(1 + m[2][2] - m[0][0] - m[1][1])
+        w = (m[1][0] - m[0][1]) / s
+        x = (m[0][2] + m[2][0]) / s
+        y = (m[1][2] + m[2][1]) / s
+        z = s / 4
+    }
+    const norm = Math.hypot(w, x, y, z)
+    q[offset] = w / norm
+    q[offset + 1] = x / norm
+    q[offset + 2] = y / norm
+    q[offset + 3] = z / norm
+}
 
 /**
  * @category Search-Method
@@ -0,0 +1,604 @@
+import { createHash } from "crypto"
+import { readFileSync, realpathSync } from "fs"
+import { createServer, Server } from "net"
+import { isAbsolute, relative, resolve, sep } from "path"
+import { createInterface } from "readline"
+import { Readable, Writable } from "stream"
+import { MessagePort, parentPort, Worker, WorkerOptions } from "worker_threads"
+import { Sigma1Landscape } from "../analysis/Sigma1Landscape"
+import { Data } from "../data/Data"
+import { MisfitObjective } from "../data/MisfitObjective"
+import { PackedDataset, SharedDatasetHandle } from "../data/PackedDataset"
+import { createDefaultSolution, MisfitCriteriunSolution } from "../InverseMethod"
+import { readDataset } from "../io/DatasetReader"
+import { SearchMethodFactory } from "../search/Factory"
+import { JobQueue, LruCache } from "./JobQueue"
+import { LandscapeJob, runLandscapeJob } from "./LandscapePool"
+import { runSearchJob, SearchInit, SearchJob, watchSearchWorker } from "./SearchWorkerPool"
+
+/**
+ * @brief Search method of a job (see SearchMethodFactory)
+ * @category Inversion
+ */
+export type InversionSearchConfig = {
+    // Name of the search method (default 'Monte Carlo')
+    method?: string,
+    // Parameters given to the search method
+    params?: any,
+    // Reduction of the per-datum misfits (weighted mean by default)
+    objective?: MisfitObjective
+}
+
+/**
+ * @brief A job, received as one JSON line
+ * @example
+ * ```json
+ * {"id": "site-12", "priority": 1, "path": "site-12.csv", "search": {"method": "Monte Carlo", "params": {"nbRandomTrials": 5000}}}
+ * {"id": "site-13", "path": "sites/site-13.csv", "byPhase": true}
+ * ```
+ * @category Inversion
+ */
+export type InversionJobRequest = {
+    id: string | number,
+    // Jobs with a higher priority run first (default 0)
+    priority?: number,
+    // Inline content of a CSV data file (see readDataset)...
+    data?: string,
+    // ... or path of a CSV data file, relative to the data root of the server (see InversionServerParams)
+    path?: string,
+    // Parameters of the data file, given to each datum (e.g., the rock friction parameters, see readDataset)
+    params?: { [key: string]: any },
+    // Run one independent inversion per deformation phase of the data (column 11, see readDataset)
+    byPhase?: boolean,
+    search?: InversionSearchConfig
+}
+
+/**
+ * @brief Solution of one deformation phase of a job (see InversionJobRequest.byPhase)
+ * @category Inversion
+ */
+export type InversionPhaseResult = {
+    phase: number,
+    nbData: number,
+    solution: MisfitCriteriunSolution
+}
+
+/**
+ * @brief Progress of a job, sent back as one JSON line per event: 'queued', 'running', then 'done' or 'error'
+ * @category Inversion
+ */
+export type InversionJobEvent = {
+    id: string | number,
+    status: 'queued' | 'running' | 'done' | 'error',
+    // Number of jobs in the queue ('queued')
+    position?: number,
+    // 'done' only
+    solution?: MisfitCriteriunSolution,
+    // 'done' with byPhase only, instead of solution: the solution of each phase, by increasing phase
+    phases?: InversionPhaseResult[],
+    nbData?: number,
+    // True if the dataset was found in the cache (not read again)
+    cached?: boolean,
+    // The lines of the dataset which could not be read
+    messages?: string[],
+    // Duration of the job in milliseconds, from the start of the job
+    ms?: number,
+    // 'error' only
+    message?: string
+}
+
+/**
+ * @category Inversion
+ */
+export type InversionServerParams = {
+    // Number of worker threads (default 0: the jobs run in the server thread)
+    workers?: number,
+    // Script run by each worker, which must call runInversionWorker()
+    workerScript?: string | URL,
+    workerOptions?: WorkerOptions,
+    // Number of datasets kept in the cache (default 32)
+    cacheSize?: number,
+    // Directory of the data files of the jobs (default: the current directory). The paths of the jobs are resolved
+    // against it, and the files outside of it (including through symbolic links) are rejected
+    dataRoot?: string
+}
+
+/**
+ * @brief Run the search of one job on a packed dataset (in the server thread or in a worker)
+ * @category Inversion
+ */
+export function runInversionJob(packed: PackedDataset, { method = 'Monte Carlo', params = undefined, objective = undefined }: InversionSearchConfig = {}): MisfitCriteriunSolution {
+    const searchMethod = SearchMethodFactory.create(method, params)
+    if (searchMethod === undefined) {
+        throw new Error(`Unknown search method "${method}"`)
+    }
+    if (searchMethod.runPacked !== undefined) {
+        // The dataset is cached and shared by the jobs, so the objective is only set for this job
+        const previous = packed.objective
+        packed.setObjective(objective ?? previous)
+        try {
+            return searchMethod.runPacked(packed, createDefaultSolution())
+        } finally {
+            packed.setObjective(previous)
+        }
+    }
+    if (objective !== undefined) {
+        throw new Error(`The search method "${method}" does not support robust objectives`)
+    }
+    if (packed.data.length !== packed.size) {
+        throw new Error(`The search method "${method}" cannot run on a shared dataset`)
+    }
+    return searchMethod.run(packed.data, createDefaultSolution())
+}
+
+/**
+ * @brief Long-lived inversion server: jobs are received as JSON lines (stdin or local socket), queued by priority, and their
+ * progress is streamed back as JSON lines (see InversionJobRequest and InversionJobEvent).
+ *
+ * The server is started once, so the data types and search methods are registered and the JIT is warm for all the jobs.
+ * The datasets are read and packed once, and cached by content hash: a job on the same data (inline or file) reuses them.
+ *
+ * A job with byPhase splits its data by deformation phase, so that a file holding several phases is read once and each phase
+ * is packed once. The inversions of the phases are independent: they run concurrently on the workers, and the 'done' event
+ * gives the solution of each phase.
+ *
+ * With workers, the jobs run in a pool of worker threads started with the server. The packed datasets are shared with
+ * the workers without copy (see PackedDataset.share), and each worker keeps its own cache of attached datasets.
+ * Datasets with data types which cannot be shared run in the server thread.
+ *
+ * The data files of the jobs are read from the data root only (see InversionServerParams.dataRoot), and the socket server
+ * only accepts local connections by default (see listen).
+ *
+ * @note This module uses Node.js APIs. It is not exported by the library index, import it from 'lib/server'.
+ * The events are only written on the given streams. The search methods log their progress with console.log: when the
+ * events are written on stdout, the application should send these logs elsewhere (see src/server.ts).
+ *
+ * @example
+ * ```ts
+ * // server.ts
+ * import { InversionServer, runInversionWorker } from './lib/server'
+ * import { isMainThread } from 'worker_threads'
+ * if (isMainThread) {
+ *     new InversionServer({ workers: 4, workerScript: __filename }).serveStdio()
+ * } else {
+ *     runInversionWorker()
+ * }
+ * ```
+ * @category Inversion
+ */
+export class InversionServer {
+    private queue = new JobQueue<PendingJob>()
+    private cache: LruCache<CachedDataset>
+    private workers: Worker[] = []
+    private idle: Worker[] = []
+    // The tasks of the started jobs, waiting for a worker
+    private tasks: Task[] = []
+    private running = new Map<Worker, Task>()
+    private nbRunning = 0
+    private scheduled = false
+    private drained: (() => void)[] = []
+    private workerScript: string | URL
+    private workerOptions: WorkerOptions
+    private dataRoot: string
+
+    constructor({ workers = 0, workerScript = undefined, workerOptions = undefined, cacheSize = 32, dataRoot = process.cwd() }: InversionServerParams = {}) {
+        if (workers > 0 && workerScript === undefined) {
+            throw new Error('A worker script is required to start a pool of workers (see runInversionWorker)')
+        }
+        this.dataRoot = realpathSync(dataRoot)
+        this.cache = new LruCache(cacheSize)
+        this.workerScript = workerScript
+        this.workerOptions = workerOptions
+        for (let i = 0; i < workers; ++i) {
+            this.startWorker()
+        }
+    }
+
+    /**
+     * Number of jobs queued or running
+     */
+    get pending(): number {
+        return this.queue.size + this.nbRunning
+    }
+
+    /**
+     * Queue a job
+     * @param request The job
+     * @param sink Receives the progress of the job
+     */
+    submit(request: InversionJobRequest, sink: (event: InversionJobEvent) => void): void {
+        if (request === null || typeof request !== 'object' || request.id === undefined) {
+            sink({ id: undefined, status: 'error', message: 'A job must have an id' })
+            return
+        }
+        if (request.data === undefined && request.path === undefined) {
+            sink({ id: request.id, status: 'error', message: 'A job must have data or a path' })
+            return
+        }
+        this.queue.push({ request, sink }, request.priority === undefined ? 0 : request.priority)
+        sink({ id: request.id, status: 'queued', position: this.queue.size })
+        this.schedule()
+    }
+
+    /**
+     * Queue the job of one JSON line (empty lines are ignored)
+     */
+    submitLine(line: string, sink: (event: InversionJobEvent) => void): void {
+        const text = line.trim()
+        if (text.length === 0) {
+            return
+        }
+        let request: InversionJobRequest
+        try {
+            request = JSON.parse(text)
+        } catch (e) {
+            sink({ id: undefined, status: 'error', message: `Invalid JSON: ${e.message}` })
+            return
+        }
+        this.submit(request, sink)
+    }
+
+    /**
+     * Resolve when all the submitted jobs are done
+     */
+    drain(): Promise<void> {
+        if (this.pending === 0) {
+            return Promise.resolve()
+        }
+        return new Promise(resolve => this.drained.push(resolve))
+    }
+
+    /**
+     * Read the jobs from input and write the events on output, one JSON per line.
+     * Resolve when the input is closed and all its jobs are done.
+     */
+    serveStdio(input: Readable = process.stdin, output: Writable = process.stdout): Promise<void> {
+        const rl = createInterface({ input, crlfDelay: Infinity })
+        rl.on('line', line => this.submitLine(line, e => output.write(JSON.stringify(e) + '\n')))
+        return new Promise(resolve => rl.on('close', () => this.drain().then(resolve)))
+    }
+
+    /**
+     * Accept connections on a local socket (path) or port. Each connection sends jobs and receives the events of its own jobs,
+     * one JSON per line.
+     * @param pathOrPort The path of a unix socket (or windows pipe), or a TCP port
+     * @param host The interface of the TCP port (default: the loopback interface, i.e., local connections only)
+     */
+    listen(pathOrPort: string | number, host: string = '127.0.0.1'): Server {
+        const server = createServer(socket => {
+            const write = (e: InversionJobEvent) => {
+                if (!socket.destroyed) {
+                    socket.write(JSON.stringify(e) + '\n')
+                }
+            }
+            socket.on('error', () => socket.destroy())
+            createInterface({ input: socket, crlfDelay: Infinity }).on('line', line => this.submitLine(line, write))
+        })
+        if (typeof pathOrPort === 'number') {
+            server.listen(pathOrPort, host)
+        } else {
+            server.listen(pathOrPort)
+        }
+        return server
+    }
+
+    /**
+     * Wait for the pending jobs, then stop the workers
+     */
+    async close(): Promise<void> {
+        await this.drain()
+        const workers = this.workers
+        this.workers = []
+        this.idle = []
+        await Promise.all(workers.map(w => w.terminate()))
+    }
+
+    private startWorker(): void {
+        const w = new Worker(this.workerScript, this.workerOptions)
+        w.on('message', (r: WorkerResult) => this.onWorkerResult(w, r))
+        w.on('error', e => this.onWorkerStopped(w, e))
+        // A worker may also exit without an error (process.exit, terminate)
+        w.on('exit', code => this.onWorkerStopped(w, new Error(`The worker exited with code ${code}`)))
+        this.workers.push(w)
+        this.idle.push(w)
+    }
+
+    private schedule(): void {
+        if (this.scheduled) {
+            return
+        }
+        this.scheduled = true
+        // Let the pending input lines be queued first, so that the priorities apply
+        setImmediate(() => {
+            this.scheduled = false
+            this.dispatch()
+        })
+    }
+
+    private dispatch(): void {
+        while (this.tasks.length > 0 || this.queue.size > 0) {
+            if (this.workers.length > 0 && this.idle.length === 0) {
+                return
+            }
+            if (this.tasks.length === 0) {
+                this.start(this.queue.pop())
+                continue
+            }
+
+            const task = this.tasks.shift()
+            if (this.idle.length > 0 && task.part.handle !== undefined) {
+                const w = this.idle.pop()
+                this.running.set(w, task)
+                w.postMessage({ id: task.job.request.id, hash: task.key, handle: task.part.handle, search: task.job.request.search } as WorkerJob)
+                continue
+            }
+
+            try {
+                this.complete(task, runInversionJob(task.part.packed, task.job.request.search), undefined)
+            } catch (e) {
+                this.complete(task, undefined, e.message)
+            }
+            // One task per turn of the event loop in the server thread, so that new jobs can be queued meanwhile
+            this.schedule()
+            return
+        }
+    }
+
+    /**
+     * Load the dataset of a job and queue its tasks (one per deformation phase with byPhase, one otherwise)
+     */
+    private start({ request, sink }: PendingJob): void {
+        const start = performance.now()
+        let loaded: LoadedDataset
+        try {
+            loaded = this.load(request)
+        } catch (e) {
+            sink({ id: request.id, status: 'error', message: e.message })
+            this.checkDrained()
+            return
+        }
+
+        sink({ id: request.id, status: 'running' })
+        const { dataset, hash, cached } = loaded
+        const job: RunningJob = { request, sink, start, dataset, cached, remaining: dataset.parts.length, solutions: [], error: undefined }
+        this.nbRunning++
+        dataset.parts.forEach((part, index) => this.tasks.push({ job, part, index, key: `${hash}/${index}` }))
+    }
+
+    private load(request: InversionJobRequest): LoadedDataset {
+        const text = request.data !== undefined ? request.data : readFileSync(this.resolvePath(request.path), 'utf8')
+        const byPhase = request.byPhase === true
+        // The same file gives other data with other parameters, and is packed differently when it is split by phase
+        const hash = createHash('sha1').update(text).update(JSON.stringify(request.params ?? {})).digest('hex') + (byPhase ? '-phases' : '')
+
+        let dataset = this.cache.get(hash)
+        const cached = dataset !== undefined
+        if (!cached) {
+            const { data, phases, messages } = readDataset(text, request.params)
+            if (data.length === 0) {
+                throw new Error(['No data could be read', ...messages].join('\n'))
+            }
+            const groups = byPhase ? splitByPhase(data, phases) : [{ phase: undefined, data }]
+            dataset = { parts: groups.map(g => this.pack(g.phase, g.data)), messages }
+            this.cache.set(hash, dataset)
+        }
+        return { dataset, hash, cached }
+    }
+
+    /**
+     * The real path of a data file, which must be inside the data root
+     */
+    private resolvePath(path: string): string {
+        if (typeof path !== 'string') {
+            throw new Error('The path of a job must be a string')
+        }
+        let real: string
+        try {
+            real = realpathSync(resolve(this.dataRoot, path))
+        } catch (e) {
+            throw new Error(`Cannot read the data file "${path}"`)
+        }
+        const r = relative(this.dataRoot, real)
+        if (r === '..' || r.startsWith('..' + sep) || isAbsolute(r)) {
+            throw new Error(`The data file "${path}" is outside of the data root of the server`)
+        }
+        return real
+    }
+
+    private pack(phase: number, data: Data[]): DatasetPart {
+        const shared = this.workers.length > 0
+        const packed = new PackedDataset(data, { shared })
+        let handle: SharedDatasetHandle = undefined
+        if (shared) {
+            try {
+                handle = packed.share()
+            } catch (e) {
+                // Some data types cannot be shared: the jobs on this dataset run in the server thread
+            }
+        }
+        return { phase, packed, handle }
+    }
+
+    /**
+     * Record the result of a task, and report its job when all its tasks are done
+     */
+    private complete(task: Task, solution: MisfitCriteriunSolution, error: string): void {
+        const job = task.job
+        if (error !== undefined) {
+            job.error = job.error ?? error
+        } else {
+            job.solutions[task.index] = solution
+        }
+        if (--job.remaining > 0) {
+            return
+        }
+
+        this.nbRunning--
+        const { request, sink, dataset } = job
+        if (job.error !== undefined) {
+            sink({ id: request.id, status: 'error', message: job.error })
+        } else {
+            const event: InversionJobEvent = {
+                id: request.id, status: 'done', nbData: dataset.parts.reduce((n, p) => n + p.packed.size, 0), cached: job.cached,
+                messages: dataset.messages, ms: performance.now() - job.start
+            }
+            if (request.byPhase === true) {
+                event.phases = dataset.parts.map((p, i) => ({ phase: p.phase, nbData: p.packed.size, solution: job.solutions[i] }))
+            } else {
+                event.solution = job.solutions[0]
+            }
+            sink(event)
+        }
+        this.checkDrained()
+    }
+
+    private onWorkerResult(w: Worker, r: WorkerResult): void {
+        const task = this.running.get(w)
+        if (task === undefined) {
+            // The worker was replaced after an error
+            return
+        }
+        this.running.delete(w)
+        this.idle.push(w)
+        this.complete(task, r.solution, r.error)
+        this.schedule()
+    }
+
+    private onWorkerStopped(w: Worker, e: Error): void {
+        if (!this.workers.includes(w)) {
+            // Already replaced (an error is followed by an exit), or the server is closed
+            return
+        }
+        // The worker is dead (or in an unknown state): report its task and replace it
+        const task = this.running.get(w)
+        w.terminate()
+        this.workers = this.workers.filter(x => x !== w)
+        this.idle = this.idle.filter(x => x !== w)
+        this.startWorker()
+        if (task !== undefined) {
+            this.running.delete(w)
+            this.complete(task, undefined, e.message)
+        }
+        this.schedule()
+    }
+
+    private checkDrained(): void {
+        if (this.pending === 0) {
+            const drained = this.drained
+            this.drained = []
+            drained.forEach(resolve => resolve())
+        }
+    }
+}
+
+/**
+ * @brief Serve the jobs sent by an InversionServer, the blocks of cells sent by a Sigma1LandscapePool, or the tasks
+ * of the searches sent by a SearchWorkerPool.
+ * To be called by the worker script (see InversionServer)
+ * @param cacheSize Number of attached datasets kept by the worker (default 32)
+ * @category Inversion
+ */
+export function runInversionWorker(cacheSize: number = 32): void {
+    if (parentPort === null) {
+        throw new Error('runInversionWorker must be called from a worker thread')
+    }
+    const cache = new LruCache<PackedDataset>(cacheSize)
+    const landscapes = new LruCache<Sigma1Landscape>(4)
+    let searchPort: MessagePort = undefined
+    parentPort.on('message', (job: WorkerJob | LandscapeJob | SearchInit | SearchJob) => {
+        if ('raster' in job) {
+            parentPort.postMessage(runLandscapeJob(job, cache, landscapes))
+            return
+        }
+        if ('searchPort' in job) {
+            searchPort = job.searchPort
+            watchSearchWorker(job)
+            return
+        }
+        if ('task' in job) {
+            runSearchJob(job, cache, searchPort)
+            return
+        }
+        try {
+            let packed = cache.get(job.hash)
+            if (packed === undefined) {
+                packed = new PackedDataset(job.handle)
+                cache.set(job.hash, packed)
+            }
+            parentPort.postMessage({ id: job.id, solution: runInversionJob(packed, job.search) } as WorkerResult)
+        } catch (e) {
+            parentPort.postMessage({ id: job.id, error: e.message } as WorkerResult)
+        }
+    })
+}
+
+// --------------- Hidden to users
+
+type PendingJob = {
+    request: InversionJobRequest,
+    sink: (event: InversionJobEvent) => void
+}
+
+type RunningJob = PendingJob & {
+    start: number,
+    dataset: CachedDataset,
+    cached: boolean,
+    // Number of tasks not done yet, the solution of each task and the first error
+    remaining: number,
+    solutions: MisfitCriteriunSolution[],
+    error: string
+}
+
+// The inversion of one part of the dataset of a job
+type Task = {
+    job: RunningJob,
+    part: DatasetPart,
+    index: number,
+    // Key of the part in the caches of the workers
+    key: string
+}
+
+type DatasetPart = {
+    // Undefined if the dataset is not split by phase
+    phase: number,
+    packed: PackedDataset,
+    // Undefined if the part cannot be shared with the workers
+    handle: SharedDatasetHandle
+}
+
+type CachedDataset = {
+    parts: DatasetPart[],
+    messages: string[]
+}
+
+type LoadedDataset = {
+    dataset: CachedDataset,
+    hash: string,
+    cached: boolean
+}
+
+type WorkerJob = {
+    id: string | number,
+    // Key of the dataset in the cache of the worker
+    hash: string,
+    handle: SharedDatasetHandle,
+    search: InversionSearchConfig
+}
+
+type WorkerResult = {
+    id: string | number,
+    solution?: MisfitCriteriunSolution,
+    error?: string
+}
+
+// The data of each phase, by increasing phase
+function splitByPhase(data: Data[], phases: number[]): { phase: number, data: Data[] }[] {
+    const groups = new Map<number, Data[]>()
+    data.forEach((d, i) => {
+        if (!groups.has(phases[i])) {
+            groups.set(phases[i], [])
+        }
+        groups.get(phases[i]).push(d)
+    })
+    return Array.from(groups.keys()).sort((a, b) => a - b).map(phase => ({ phase, data: groups.get(phase) }))
+}
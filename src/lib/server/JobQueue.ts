@@ -0,0 +1,96 @@
+/**
+ * @brief Queue of jobs ordered by decreasing priority, then by submission order for equal priorities.
+ * @category Inversion
+ */
+export class JobQueue<T> {
+    private heap: { priority: number, seq: number, value: T }[] = []
+    private seq = 0
+
+    get size(): number {
+        return this.heap.length
+    }
+
+    push(value: T, priority: number = 0): void {
+        this.heap.push({ priority, seq: this.seq++, value })
+        let i = this.heap.length - 1
+        while (i > 0) {
+            const parent = (i - 1) >> 1
+            if (!this.before(i, parent)) {
+                break
+            }
+            this.swap(i, parent)
+            i = parent
+        }
+    }
+
+    /**
+     * Remove and return the job with the highest priority (undefined if the queue is empty)
+     */
+    pop(): T {
+        if (this.heap.length === 0) {
+            return undefined
+        }
+        const top = this.heap[0].value
+        const last = this.heap.pop()
+        if (this.heap.length > 0) {
+            this.heap[0] = last
+            let i = 0
+            for (;;) {
+                const l = 2 * i + 1, r = l + 1
+                let best = i
+                if (l < this.heap.length && this.before(l, best)) best = l
+                if (r < this.heap.length && this.before(r, best)) best = r
+                if (best === i) {
+                    break
+                }
+                this.swap(i, best)
+                i = best
+            }
+        }
+        return top
+    }
+
+    private before(i: number, j: number): boolean {
+        const a = this.heap[i], b = this.heap[j]
+        return a.priority > b.priority || (a.priority === b.priority && a.seq < b.seq)
+    }
+
+    private swap(i: number, j: number): void {
+        const t = this.heap[i]
+        this.heap[i] = this.heap[j]
+        this.heap[j] = t
+    }
+}
+
+/**
+ * @brief Cache keeping the most recently used entries
+ * @category Inversion
+ */
+export class LruCache<T> {
+    private map = new Map<string, T>()
+
+    constructor(private maxSize: number) {
+    }
+
+    get size(): number {
+        return this.map.size
+    }
+
+    get(key: string): T {
+        const v = this.map.get(key)
+        if (v !== undefined) {
+            // Move to the most recent position
+            this.map.delete(key)
+            this.map.set(key, v)
+        }
+        return v
+    }
+
+    set(key: string, value: T): void {
+        this.map.delete(key)
+        this.map.set(key, value)
+        while (this.map.size > this.maxSize) {
+            this.map.delete(this.map.keys().next().value)
+        }
+    }
+}
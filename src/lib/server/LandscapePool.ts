@@ -0,0 +1,220 @@
+import { Worker, WorkerOptions } from "worker_threads"
+import { Sigma1Landscape, Sigma1LandscapeParams, Sigma1Raster } from "../analysis/Sigma1Landscape"
+import { PackedDataset, SharedDatasetHandle } from "../data/PackedDataset"
+import { LruCache } from "./JobQueue"
+
+/**
+ * @category Domain
+ */
+export type Sigma1LandscapePoolParams = {
+    // Number of worker threads
+    workers: number,
+    // Script run by each worker, which must call runInversionWorker() (the same script as the workers of InversionServer)
+    workerScript: string | URL,
+    workerOptions?: WorkerOptions,
+    // Number of blocks of cells per worker, so that the workers stay busy when the blocks have different costs (default 4)
+    blocksPerWorker?: number
+}
+
+/**
+ * @brief Compute the rasters of Sigma1Landscape with a pool of worker threads.
+ *
+ * The raster is split in blocks of rows, dispatched to the workers as they become idle. The dataset and the raster are
+ * shared with the workers without copy (see PackedDataset.share and Sigma1Landscape.createRaster), and each worker keeps
+ * the landscapes of the last datasets, so that a refresh with the same parameters only recomputes the cells.
+ *
+ * @note This module uses Node.js APIs. It is not exported by the library index, import it from 'lib/server'.
+ * One raster is computed at a time.
+ *
+ * @example
+ * ```ts
+ * const pool = new Sigma1LandscapePool({ workers: 8, workerScript: 'worker.js' })
+ * const packed = new PackedDataset(data, { shared: true })
+ * const raster = await pool.run(packed, { resolution: 2 })
+ * await pool.close()
+ * ```
+ * @category Domain
+ */
+export class Sigma1LandscapePool {
+    private workers: Worker[] = []
+    private workerScript: string | URL
+    private workerOptions: WorkerOptions
+    private blocksPerWorker: number
+    private keys = new WeakMap<PackedDataset, string>()
+    private nbKeys = 0
+    private nbRuns = 0
+    // The raster being computed
+    private current: RunningLandscape = undefined
+
+    constructor({ workers, workerScript, workerOptions = undefined, blocksPerWorker = 4 }: Sigma1LandscapePoolParams) {
+        if (!(workers > 0) || workerScript === undefined) {
+            throw new Error('A landscape pool requires at least one worker and a worker script (see runInversionWorker)')
+        }
+        this.workerScript = workerScript
+        this.workerOptions = workerOptions
+        this.blocksPerWorker = Math.max(1, Math.floor(blocksPerWorker))
+        for (let i = 0; i < workers; ++i) {
+            this.startWorker()
+        }
+    }
+
+    /**
+     * Compute the raster of the landscape of a dataset packed with the shared option
+     */
+    run(packed: PackedDataset, params: Sigma1LandscapeParams = {}): Promise<Sigma1Raster> {
+        if (this.current !== undefined) {
+            return Promise.reject(new Error('A landscape is already being computed by the pool'))
+        }
+        let handle: SharedDatasetHandle
+        let raster: Sigma1Raster
+        try {
+            handle = packed.share()
+            raster = new (landscapeClass())(packed, params).createRaster(true)
+        } catch (e) {
+            return Promise.reject(e)
+        }
+        if (!this.keys.has(packed)) {
+            this.keys.set(packed, `landscape-${this.nbKeys++}`)
+        }
+        const key = this.keys.get(packed)
+        const run = this.nbRuns++
+
+        // Blocks of whole rows
+        const size = raster.size
+        const rows = Math.max(1, Math.ceil(size / (this.workers.length * this.blocksPerWorker)))
+        const blocks: LandscapeJob[] = []
+        for (let j = 0; j < size; j += rows) {
+            blocks.push({ run, key, handle, params, first: j * size, count: Math.min(rows, size - j) * size, raster })
+        }
+
+        return new Promise<Sigma1Raster>((resolve, reject) => {
+            this.current = { run, blocks, next: 0, remaining: blocks.length, raster, resolve, reject }
+            this.workers.forEach(w => this.post(w))
+        })
+    }
+
+    /**
+     * Stop the workers
+     */
+    async close(): Promise<void> {
+        const workers = this.workers
+        this.workers = []
+        await Promise.all(workers.map(w => w.terminate()))
+    }
+
+    private startWorker(): void {
+        const w = new Worker(this.workerScript, this.workerOptions)
+        w.on('message', (r: LandscapeResult) => this.onResult(w, r))
+        w.on('error', e => this.onWorkerStopped(w, e))
+        // A worker may also exit without an error (process.exit, terminate)
+        w.on('exit', code => this.onWorkerStopped(w, new Error(`The worker exited with code ${code}`)))
+        this.workers.push(w)
+    }
+
+    private post(w: Worker): void {
+        const current = this.current
+        if (current !== undefined && current.next < current.blocks.length) {
+            w.postMessage(current.blocks[current.next++])
+        }
+    }
+
+    private onResult(w: Worker, r: LandscapeResult): void {
+        const current = this.current
+        if (current === undefined || r.run !== current.run) {
+            // A block of a failed run: the worker still has a block of the current run, if any
+            return
+        }
+        if (r.error !== undefined) {
+            this.finish(new Error(r.error))
+        } else if (--current.remaining === 0) {
+            this.finish(undefined)
+        } else {
+            this.post(w)
+        }
+    }
+
+    private onWorkerStopped(w: Worker, e: Error): void {
+        if (!this.workers.includes(w)) {
+            // Already replaced (an error is followed by an exit), or the pool is closed
+            return
+        }
+        // The worker is dead: replace it. The blocks of the other workers are ignored
+        w.terminate()
+        this.workers = this.workers.filter(x => x !== w)
+        this.startWorker()
+        if (this.current !== undefined) {
+            this.finish(e)
+        }
+    }
+
+    private finish(error: Error): void {
+        const { raster, resolve, reject } = this.current
+        this.current = undefined
+        if (error !== undefined) {
+            reject(error)
+        } else {
+            resolve(raster)
+        }
+    }
+}
+
+// --------------- Hidden to users
+
+export type LandscapeJob = {
+    run: number,
+    // Key of the dataset in the cache of the worker
+    key: string,
+    handle: SharedDatasetHandle,
+    params: Sigma1LandscapeParams,
+    first: number,
+    count: number,
+    raster: Sigma1Raster
+}
+
+type RunningLandscape = {
+    run: number,
+    blocks: LandscapeJob[],
+    // Index of the next block to post, and number of blocks not done yet
+    next: number,
+    remaining: number,
+    raster: Sigma1Raster,
+    resolve: (raster: Sigma1Raster) => void,
+    reject: (error: Error) => void
+}
+
+type LandscapeResult = {
+    run: number,
+    first: number,
+    error?: string
+}
+
+/**
+ * The analysis modules are only loaded by the processes that compute a landscape: the workers that only run
+ * inversion jobs never load them
+ */
+function landscapeClass(): typeof Sigma1Landscape {
+    return require('../analysis/Sigma1Landscape').Sigma1Landscape
+}
+
+/**
+ * Compute a block of cells in a worker (see runInversionWorker)
+ */
+export function runLandscapeJob(job: LandscapeJob, datasets: LruCache<PackedDataset>, landscapes: LruCache<Sigma1Landscape>): LandscapeResult {
+    try {
+        const id = `${job.key}/${JSON.stringify(job.params)}`
+        let landscape = landscapes.get(id)
+        if (landscape === undefined) {
+            let packed = datasets.get(job.key)
+            if (packed === undefined) {
+                packed = new PackedDataset(job.handle)
+                datasets.set(job.key, packed)
+            }
+            landscape = new (landscapeClass())(packed, job.params)
+            landscapes.set(id, landscape)
+        }
+        landscape.runCells(job.first, job.count, job.raster)
+        return { run: job.run, first: job.first }
+    } catch (e) {
+        return { run: job.run, first: job.first, error: e.message }
+    }
+}
@@ -0,0 +1,283 @@
+import { MessageChannel, MessagePort, receiveMessageOnPort, Worker, WorkerOptions } from "worker_threads"
+import { MisfitObjective } from "../data/MisfitObjective"
+import { PackedDataset, SharedDatasetHandle } from "../data/PackedDataset"
+import { SearchTask, SearchTasks, SearchWorkers } from "../search/SearchWorkers"
+import { LruCache } from "./JobQueue"
+
+/**
+ * @category Search-Method
+ */
+export type SearchWorkerPoolParams = {
+    // Number of worker threads
+    workers: number,
+    // Script run by each worker, which must call runInversionWorker() (the same script as the workers of InversionServer)
+    workerScript: string | URL,
+    workerOptions?: WorkerOptions,
+    // Maximum time in ms that a run waits for the next input to be done (no limit by default)
+    timeout?: number
+}
+
+/**
+ * @brief Run the tasks of the search methods with a pool of worker threads (see SearchWorkers).
+ *
+ * The dataset is shared with the workers without copy (see PackedDataset.share), and each worker keeps it attached
+ * between two runs. The inputs and the outputs of a run are copied once into SharedArrayBuffers: the workers take the
+ * inputs one by one through an atomic counter, so that the faster workers take more inputs, and the calling thread
+ * waits on the counter of the done inputs (Atomics.wait) until the run is done.
+ *
+ * A worker that stops (process.exit, uncaught error) fails the run in progress, and is replaced by a new worker. A worker
+ * stopped by its resource limits does not report it while the calling thread is blocked: give a timeout in that case.
+ *
+ * @note This module uses Node.js APIs. It is not exported by the library index, import it from 'lib/server'.
+ * Since run() blocks the calling thread, the pool is meant for the synchronous searches (e.g., in a worker of
+ * InversionServer or in a command line tool), not for the thread of a server that must stay responsive.
+ *
+ * @example
+ * ```ts
+ * const pool = new SearchWorkerPool({ workers: 8, workerScript: 'worker.js' })
+ * const search = new BranchAndBound({ tolerance: 0.01 })
+ * search.setWorkers(pool)
+ * const solution = search.runPacked(new PackedDataset(data, { shared: true }), createDefaultSolution())
+ * await pool.close()
+ * ```
+ * @category Search-Method
+ */
+export class SearchWorkerPool implements SearchWorkers {
+    private workers: Worker[] = []
+    // The port of each worker on which its errors are received
+    private ports: MessagePort[] = []
+    private keys = new WeakMap<PackedDataset, string>()
+    private nbKeys = 0
+    private nbRuns = 0
+    private inputs = new Float64Array(new SharedArrayBuffer(0))
+    private outputs = new Float64Array(new SharedArrayBuffer(0))
+    // 1 for each worker that has stopped, set by the worker itself (see watchSearchWorker)
+    private stopped: Int32Array
+    private workerScript: string | URL
+    private workerOptions: WorkerOptions
+    private timeout: number
+
+    constructor({ workers, workerScript, workerOptions = undefined, timeout = Infinity }: SearchWorkerPoolParams) {
+        if (!(workers > 0) || workerScript === undefined) {
+            throw new Error('A search pool requires at least one worker and a worker script (see runInversionWorker)')
+        }
+        this.workerScript = workerScript
+        this.workerOptions = workerOptions
+        this.timeout = timeout
+        this.stopped = new Int32Array(new SharedArrayBuffer(4 * workers))
+        for (let i = 0; i < workers; ++i) {
+            this.startWorker(i)
+        }
+    }
+
+    get size(): number {
+        return this.workers.length
+    }
+
+    run(packed: PackedDataset, task: string, params: any, inputs: Float64Array, count: number, outputs: Float64Array): void {
+        if (this.workers.length === 0) {
+            throw new Error('The search pool is closed')
+        }
+        if (count === 0) {
+            return
+        }
+        const handle = packed.share()
+        if (!this.keys.has(packed)) {
+            this.keys.set(packed, `search-${this.nbKeys++}`)
+        }
+        // The single precision columns may be built after the first run
+        const key = this.keys.get(packed) + (handle.striatedPlanes32 === undefined ? '' : '-32')
+
+        if (this.inputs.length < inputs.length) {
+            this.inputs = new Float64Array(new SharedArrayBuffer(8 * inputs.length))
+        }
+        if (this.outputs.length < outputs.length) {
+            this.outputs = new Float64Array(new SharedArrayBuffer(8 * outputs.length))
+        }
+        this.inputs.set(inputs)
+        const ctrl = new Int32Array(new SharedArrayBuffer(8))
+        const job: SearchJob = {
+            run: this.nbRuns++, key, handle, objective: packed.objective, singlePrecision: packed.singlePrecision, task, params,
+            count, inputStride: inputs.length / count, outputStride: outputs.length / count,
+            inputs: this.inputs.buffer as SharedArrayBuffer, outputs: this.outputs.buffer as SharedArrayBuffer, ctrl: ctrl.buffer as SharedArrayBuffer
+        }
+        this.workers.forEach(w => w.postMessage(job))
+
+        // The events of the workers are not received while this thread is blocked: the wait is split into slices, after
+        // which the flags of the stopped workers and the time since the last done input are checked
+        const stopped = this.nbStopped()
+        if (stopped === this.workers.length) {
+            throw new Error('All the workers of the search pool have stopped')
+        }
+        let last = 0
+        let lastTime = Date.now()
+        for (;;) {
+            const done = Atomics.load(ctrl, DONE)
+            if (done >= count) {
+                break
+            }
+            if (this.nbStopped() !== stopped) {
+                this.abort(ctrl, count)
+                throw new Error('A worker of the search pool stopped during the run')
+            }
+            const now = Date.now()
+            if (done !== last) {
+                last = done
+                lastTime = now
+            } else if (now - lastTime > this.timeout) {
+                this.abort(ctrl, count)
+                throw new Error(`No input of the search pool was done for ${this.timeout} ms`)
+            }
+            Atomics.wait(ctrl, DONE, done, Math.min(WAIT_SLICE, this.timeout))
+        }
+
+        let error: string = undefined
+        for (const port of this.ports) {
+            for (let m = receiveMessageOnPort(port); m !== undefined; m = receiveMessageOnPort(port)) {
+                const r = m.message as SearchError
+                if (r.run === job.run && error === undefined) {
+                    error = r.error
+                }
+            }
+        }
+        if (error !== undefined) {
+            throw new Error(error)
+        }
+        outputs.set(this.outputs.subarray(0, outputs.length))
+    }
+
+    /**
+     * Stop the workers
+     */
+    async close(): Promise<void> {
+        const workers = this.workers
+        this.workers = []
+        this.ports.forEach(p => p.close())
+        this.ports = []
+        await Promise.all(workers.map(w => w.terminate()))
+    }
+
+    // The remaining inputs of a failed run are not taken, and the buffers still used by its inputs in progress are left to them
+    private abort(ctrl: Int32Array, count: number): void {
+        Atomics.store(ctrl, NEXT, count)
+        this.inputs = new Float64Array(new SharedArrayBuffer(0))
+        this.outputs = new Float64Array(new SharedArrayBuffer(0))
+    }
+
+    private nbStopped(): number {
+        let n = 0
+        for (let i = 0; i < this.stopped.length; ++i) {
+            n += Atomics.load(this.stopped, i)
+        }
+        return n
+    }
+
+    private startWorker(i: number): void {
+        Atomics.store(this.stopped, i, 0)
+        const w = new Worker(this.workerScript, this.workerOptions)
+        const { port1, port2 } = new MessageChannel()
+        w.postMessage({ searchPort: port2, stopped: this.stopped.buffer as SharedArrayBuffer, index: i } as SearchInit, [port2])
+        // The failure is reported by the run in progress, if any, and the worker is replaced
+        w.on('error', () => {})
+        w.on('exit', () => {
+            if (this.workers[i] !== w) {
+                // Closed
+                return
+            }
+            this.ports[i].close()
+            this.startWorker(i)
+        })
+        this.workers[i] = w
+        this.ports[i] = port1
+    }
+}
+
+// --------------- Hidden to users
+
+// Indices in the control buffer of a run: the next input to take, and the number of inputs done
+const NEXT = 0
+const DONE = 1
+// Time in ms between two checks of the workers during a run
+const WAIT_SLICE = 50
+
+export type SearchInit = {
+    searchPort: MessagePort,
+    // Flags of the stopped workers, and the index of the flag of this worker
+    stopped: SharedArrayBuffer,
+    index: number
+}
+
+export type SearchJob = {
+    run: number,
+    // Key of the dataset in the cache of the worker
+    key: string,
+    handle: SharedDatasetHandle,
+    objective: MisfitObjective,
+    singlePrecision: boolean,
+    task: string,
+    params: any,
+    count: number,
+    inputStride: number,
+    outputStride: number,
+    inputs: SharedArrayBuffer,
+    outputs: SharedArrayBuffer,
+    ctrl: SharedArrayBuffer
+}
+
+type SearchError = {
+    run: number,
+    error: string
+}
+
+/**
+ * Flag the worker as stopped when it exits (process.exit, uncaught error), so that a run waiting for it fails
+ */
+export function watchSearchWorker(init: SearchInit): void {
+    const stopped = new Int32Array(init.stopped)
+    process.on('exit', () => Atomics.store(stopped, init.index, 1))
+}
+
+/**
+ * Take the inputs of a run until there is none left, in a worker (see runInversionWorker)
+ */
+export function runSearchJob(job: SearchJob, datasets: LruCache<PackedDataset>, port: MessagePort): void {
+    const ctrl = new Int32Array(job.ctrl)
+    const inputs = new Float64Array(job.inputs)
+    const outputs = new Float64Array(job.outputs)
+    let failed = false
+    let packed: PackedDataset = undefined
+    let task: SearchTask = undefined
+    try {
+        packed = datasets.get(job.key)
+        if (packed === undefined) {
+            packed = new PackedDataset(job.handle)
+            datasets.set(job.key, packed)
+        }
+        packed.setObjective(job.objective)
+        if (packed.singlePrecision !== job.singlePrecision) {
+            packed.setSinglePrecision(job.singlePrecision)
+        }
+        task = SearchTasks.get(job.task)
+        if (task === undefined) {
+            throw new Error(`Unknown search task "${job.task}"`)
+        }
+    } catch (e) {
+        failed = true
+        port.postMessage({ run: job.run, error: e.message } as SearchError)
+    }
+
+    for (let i = Atomics.add(ctrl, NEXT, 1); i < job.count; i = Atomics.add(ctrl, NEXT, 1)) {
+        // After an error, the remaining inputs are only counted, so that the calling thread is released
+        if (!failed) {
+            try {
+                const { inputStride: a, outputStride: b } = job
+                task(packed, job.params, inputs.subarray(a * i, a * i + a), outputs.subarray(b * i, b * i + b))
+            } catch (e) {
+                failed = true
+                port.postMessage({ run: job.run, error: e.message } as SearchError)
+            }
+        }
+        Atomics.add(ctrl, DONE, 1)
+        Atomics.notify(ctrl, DONE)
+    }
+}
@@ -0,0 +1,5 @@
+export * from './JobQueue'
+export * from './InversionServer'
+export * from './LandscapePool'
+export * from './SearchWorkerPool'
+export * from './snapshot'
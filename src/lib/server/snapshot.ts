@@ -0,0 +1,55 @@
+import * as v8 from "v8"
+import { DataFactory } from "../data/Factory"
+import { PackedDataset } from "../data/PackedDataset"
+import { HomogeneousEngine } from "../geomeca/HomogeneousEngine"
+import { readDataset } from "../io/DatasetReader"
+import { SearchMethodFactory } from "../search/Factory"
+import { newMatrix3x3Identity } from "../types"
+
+/**
+ * @brief Run main, or make it the entry point of a Node.js startup snapshot when the script is run with --build-snapshot.
+ *
+ * When building the snapshot, the library is warmed up first (see warmUp), so that a process started from the snapshot
+ * begins with the modules evaluated and the factories filled, without loading nor evaluating the bundle.
+ *
+ * @note Only the main thread starts from the snapshot. The workers of InversionServer are started with new Worker(script),
+ * which loads the worker script as usual. They only evaluate the modules they use, since the data types, the search
+ * methods and the landscape are loaded on first request (see DataFactory and SearchMethodFactory).
+ * @example
+ * ```sh
+ * node --snapshot-blob stress-server.blob --build-snapshot stress-server.js
+ * node --snapshot-blob stress-server.blob -- --workers 4 --worker-script stress-server.js
+ * ```
+ * @category Inversion
+ */
+export function withStartupSnapshot(main: () => void): void {
+    const snapshot = (v8 as any).startupSnapshot
+    if (snapshot === undefined || !snapshot.isBuildingSnapshot()) {
+        main()
+        return
+    }
+    warmUp()
+    snapshot.setDeserializeMainFunction(main)
+}
+
+/**
+ * @brief Load all the data types and search methods, which are otherwise loaded on first request (see DataFactory),
+ * and exercise the read and evaluation paths once.
+ * No random number is drawn, so the random generator is not part of a snapshot.
+ * @category Inversion
+ */
+export function warmUp(): void {
+    DataFactory.preload()
+    SearchMethodFactory.preload()
+    const packed = new PackedDataset(readDataset(WARM_UP_DATA).data)
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(newMatrix3x3Identity(), 0.5)
+    packed.cost(engine)
+}
+
+// --------------- Hidden to users
+
+const WARM_UP_DATA = [
+    '1;Striated Plane;45;60;SE;0;NE;;RL',
+    '2;Striated Plane;135;60;NE;6;SE;;LL'
+].join('\n')
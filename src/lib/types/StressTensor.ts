@@ -1,13 +1,9 @@
 import {
     lineSphericalCoords,
     Matrix3x3,
-    multiplyTensors,
     newMatrix3x3,
     PoleCoords,
     rad2deg,
-    SphericalCoords,
-    stressTensorPrincipalAxes,
-    transposeTensor,
     trend2phi,
     Vector3
 } from "../types"
@@ -25,6 +21,41 @@ export type StressTensorParams = {
     masterStress: MasterStress,
     stressRatio: number }
 
+/**
+ * @brief Packed parameters for building many stress tensors at once (see StressTensor.createBatch).
+ * Row i of each array defines the i-th tensor. The plunges of the slave stress axes are not used.
+ */
+export type StressTensorBatchParams = {
+    trendS1: ArrayLike<number>,
+    plungeS1?: ArrayLike<number>,
+    trendS3: ArrayLike<number>,
+    plungeS3?: ArrayLike<number>,
+    stressRatio: ArrayLike<number>,
+    masterStress: MasterStress
+}
+
+/**
+ * @brief Packed stress tensors built at once (see StressTensor.createBatch).
+ * The matrices of the i-th tensor are stored row by row at [9i, 9i + 9).
+ */
+export type StressTensorBatch = {
+    count: number,
+    // The rotation tensors Rrot
+    Rrot: Float64Array,
+    // The stress tensors ST in the geographic reference frame
+    ST: Float64Array,
+    // The computed plunge of the slave stress axis of each tensor
+    plunge: Float64Array
+}
+
+/**
+ * @brief Rough stress tensor defined interactively by the trend and plunge of the master stress axis,
+ * the trend of the slave stress axis and the stress ratio.
+ *
+ * Changing a parameter only marks the tensor as modified. The derived quantities (plunge of the slave axis, Rrot, RTrot,
+ * STP and ST) are recomputed once, on the first read after a change, into the same matrices.
+ * @note The returned matrices are updated in place by the next recomputation
+ */
 export class StressTensor {
     constructor(
         { trendS1, plungeS1, trendS3, plungeS3, masterStress, stressRatio }: StressTensorParams
@@ -36,48 +67,114 @@ export class StressTensor {
         this.sigma = [-1, -stressRatio, 0]
 
         this.changeMasterStress(masterStress)
+    }
 
-        // Perfom the computations...
-        this.masterSlave()
-        this.rotationTensor_Rrot(
-            new SphericalCoords({phi: this.phiS1, theta: this.thetaS1}),
-            new SphericalCoords({phi: this.phiS3, theta: this.thetaS3})
-        )
+    /**
+     * Build many stress tensors from packed arrays into packed matrices, without creating a StressTensor per row:
+     * a single tensor is updated row by row, so each row costs the same computations as a StressTensor and no allocation.
+     * @param params The packed parameters
+     * @param out Optional batch to fill (reused when large enough)
+     * @example
+     * ```ts
+     * const batch = StressTensor.createBatch({
+     *     trendS1: new Float64Array([0, 30, 60]),
+     *     plungeS1: new Float64Array([10, 10, 10]),
+     *     trendS3: new Float64Array([90, 120, 150]),
+     *     stressRatio: new Float64Array([0.2, 0.5, 0.8]),
+     *     masterStress: MasterStress.Sigma1
+     * })
+     * const ST1 = batch.ST.subarray(9, 18)
+     * ```
+     */
+    static createBatch(
+        { trendS1, plungeS1, trendS3, plungeS3, stressRatio, masterStress }: StressTensorBatchParams,
+        out: StressTensorBatch = undefined): StressTensorBatch
+    {
+        const n = stressRatio.length
+        if (trendS1.length !== n || trendS3.length !== n ||
+            (plungeS1 !== undefined && plungeS1.length !== n) || (plungeS3 !== undefined && plungeS3.length !== n)) {
+            throw new Error('All the packed parameters of the stress tensors must have the same length')
+        }
+        if (out === undefined || out.plunge.length < n) {
+            out = { count: n, Rrot: new Float64Array(9 * n), ST: new Float64Array(9 * n), plunge: new Float64Array(n) }
+        }
+        out.count = n
+
+        const st = new StressTensor({ trendS1: 0, plungeS1: 0, trendS3: 0, plungeS3: 0, masterStress, stressRatio: 0 })
+        for (let i = 0; i < n; ++i) {
+            st.poleS1.trend = trendS1[i]
+            st.poleS1.plunge = plungeS1 === undefined ? 0 : plungeS1[i]
+            st.poleS3.trend = trendS3[i]
+            st.poleS3.plunge = plungeS3 === undefined ? 0 : plungeS3[i]
+            st.sigma[1] = -stressRatio[i]
+            st.dirty = true
+            st.update()
+            for (let j = 0; j < 3; ++j) {
+                for (let k = 0; k < 3; ++k) {
+                    out.Rrot[9 * i + 3 * j + k] = st.Rrot_[j][k]
+                    out.ST[9 * i + 3 * j + k] = st.ST_[j][k]
+                }
+            }
+            out.plunge[i] = st.plunge
+        }
+        return out
     }
 
     changeMasterStress(masterStress: MasterStress) {
         this.masterStress = masterStress
+        this.dirty = true
     }
 
     get ST() {
+        this.update()
         return this.ST_
     }
 
     get STP() {
+        this.update()
         return this.STP_
     }
 
     get stressRatio() {
-        return this.sigma[1]
+        return -this.sigma[1]
+    }
+    set stressRatio(v: number) {
+        this.sigma[1] = -v
+        this.dirty = true
     }
 
+    get plungeS1() {
+        this.update()
+        return this.poleS1.plunge
+    }
     set plungeS1(v: number) {
         this.poleS1.plunge = v
-        this.masterSlave()
+        this.dirty = true
+    }
+    get trendS1() {
+        return this.poleS1.trend
     }
     set trendS1(v: number) {
         this.poleS1.trend = v
-        this.masterSlave()
+        this.dirty = true
+    }
+    get plungeS3() {
+        this.update()
+        return this.poleS3.plunge
     }
     set plungeS3(v: number) {
         this.poleS3.plunge = v
-        this.masterSlave()
+        this.dirty = true
+    }
+    get trendS3() {
+        return this.poleS3.trend
     }
     set trendS3(v: number) {
         this.poleS3.trend = v
-        this.masterSlave()
+        this.dirty = true
     }
     get plunge() {
+        this.update()
         if (this.masterStress === MasterStress.Sigma1) {
             return this.poleS3.plunge
         }
@@ -87,18 +184,39 @@ export class StressTensor {
     }
 
     /**
+     * The rotation tensor from the geographic reference frame S to the principal reference frame Sr.
+     * @note The returned matrix is live: it is the storage of the tensor, overwritten in place after the next change
+     * of a parameter. Copy it (see cloneMatrix3x3) to keep it.
      * Example:
      * ```ts
      * const s = new StressTensor({trendS1, plungeS1, trendS3, plungeS3, masterStress, sigma})
-     * const r = s.Rrot
+     * const r = cloneMatrix3x3(s.Rrot)
      * ```
      */
     get Rrot(): Matrix3x3 {
+        this.update()
         return this.Rrot_
     }
 
+    /**
+     * The transpose of Rrot.
+     * @note As for Rrot, the returned matrix is live
+     */
     get RTrot(): Matrix3x3 {
-        return transposeTensor(this.Rrot_)
+        this.update()
+        return this.RTrot_
+    }
+
+    /**
+     * Recompute the derived quantities if a parameter has changed since the last computation
+     */
+    private update() {
+        if (!this.dirty) {
+            return
+        }
+        this.dirty = false
+        this.masterSlave()
+        this.rotationTensor_Rrot(this.phiS1, this.thetaS1, this.phiS3, this.thetaS3)
     }
 
     masterSlave() {
@@ -109,6 +227,8 @@ export class StressTensor {
                 trend: this.poleS1.trend,
                 plunge: this.poleS1.plunge
             })
+            this.phiS1 = sigma.phi
+            this.thetaS1 = sigma.theta
 
             // The trend of sigma 3 is set by the user while the plunge of sigma 3 has to be calculated
             this.phiS3 = trend2phi(this.poleS3.trend)
@@ -121,6 +241,8 @@ export class StressTensor {
                 trend: this.poleS3.trend,
                 plunge: this.poleS3.plunge
             })
+            this.phiS3 = sigma.phi
+            this.thetaS3 = sigma.theta
 
             // The trend of sigma 1 is set by the user while the plunge of sigma 3 has to be calculated
             this.phiS1 = trend2phi(this.poleS1.trend)
@@ -175,7 +297,7 @@ export class StressTensor {
         return thetaSlave
     }
 
-    private rotationTensor_Rrot(sigma_1_sphere: SphericalCoords, sigma_3_sphere: SphericalCoords) {
+    private rotationTensor_Rrot(phiS1: number, thetaS1: number, phiS3: number, thetaS3: number) {
         // This method implements the rotation tensor Rrot between the geographic reference frame S 
         //      and the interactive search reference frame  Sr ('r' stands for 'rough' solution):
 
@@ -189,17 +311,17 @@ export class StressTensor {
         //      Vr = R V,  where V and Vr are the same vector defined in reference frames S and Sr, respectively
 
         // The lines of matrix R are given by the unit vectors (nSigma_1_Sr,nSigma_3_Sr,nSigma_2_Sr) parallel to (Xr,Yr,Zr) defined in reference system S:
-        const Rrot: Matrix3x3 = newMatrix3x3()
+        const Rrot = this.Rrot_
 
         // 1st line of matrix Rrot (Sigma_1_Sr axis): Unit vector nSigma_1_Sr. The scalar product: nSigma_1_Sr.V = Vr(1)
-        Rrot[0][0] = Math.sin(sigma_1_sphere.theta) * Math.cos(sigma_1_sphere.phi)
-        Rrot[0][1] = Math.sin(sigma_1_sphere.theta) * Math.sin(sigma_1_sphere.phi)
-        Rrot[0][2] = Math.cos(sigma_1_sphere.theta)
+        Rrot[0][0] = Math.sin(thetaS1) * Math.cos(phiS1)
+        Rrot[0][1] = Math.sin(thetaS1) * Math.sin(phiS1)
+        Rrot[0][2] = Math.cos(thetaS1)
 
         // 2nd line of matrix Rrot (Sigma_3_Sr axis): Unit vector nSigma_3_Sr. The scalar product: nSigma_3_Sr.V = Vr(2)
-        Rrot[1][0] = Math.sin(sigma_3_sphere.theta) * Math.cos(sigma_3_sphere.phi)
-        Rrot[1][1] = Math.sin(sigma_3_sphere.theta) * Math.sin(sigma_3_sphere.phi)
-        Rrot[1][2] = Math.cos(sigma_3_sphere.theta)
+        Rrot[1][0] = Math.sin(thetaS3) * Math.cos(phiS3)
+        Rrot[1][1] = Math.sin(thetaS3) * Math.sin(phiS3)
+        Rrot[1][2] = Math.cos(thetaS3)
 
         // 3rd line of matrix Rrot (Sigma_2_Sr axis): Unit vector nSigma_2_Sr. The scalar product: nSigma_2_Sr.V = Vr(3)
         // nSigma_2_Sr is calculated from the cross product e3_Sr = e1_Sr x e2_Sr :
@@ -209,7 +331,11 @@ export class StressTensor {
 
         // Let RTrot be the rotation tensor R between reference systems Sr and S, such that:
         //      V = RTrot Vr,  where V and Vr are the same vector defined in reference frames S and Sr, respectively
-        this.Rrot_ = Rrot
+        for (let i = 0; i < 3; ++i) {
+            for (let j = 0; j < 3; ++j) {
+                this.RTrot_[i][j] = Rrot[j][i]
+            }
+        }
 
         this.stressTensor_Sr_S()
     }
@@ -224,9 +350,17 @@ export class StressTensor {
         //      S =  (X, Y, Z ) is the geographic reference frame  oriented in (East, North, Up) directions.
         //      STP = Stress tensor in the principal stress reference frame.
 
-        this.STP_ = stressTensorPrincipalAxes(this.sigma.map(v => -v) as Vector3)
-        const T1 = multiplyTensors({ A: transposeTensor(this.Rrot_), B: this.STP })
-        this.ST_  = multiplyTensors({ A: T1, B: this.Rrot_ })
+        // The principal stresses (sigma_1, sigma_2, sigma_3) are stored in this.sigma. STP is diagonal in the
+        // order of the axes of Sr, i.e., (sigma_1, sigma_3, sigma_2), with the rock mechanics sign convention (compression > 0)
+        const d: Vector3 = [-this.sigma[0], -this.sigma[2], -this.sigma[1]]
+        const R = this.Rrot_
+        for (let i = 0; i < 3; ++i) {
+            for (let j = 0; j < 3; ++j) {
+                this.STP_[i][j] = i === j ? d[i] : 0
+                // ST = RTrot STP Rrot, STP being diagonal
+                this.ST_[i][j] = d[0] * R[0][i] * R[0][j] + d[1] * R[1][i] * R[1][j] + d[2] * R[2][i] * R[2][j]
+            }
+        }
     }
 
     // ========================================================
@@ -263,7 +397,9 @@ export class StressTensor {
     private masterStress = MasterStress.Sigma1
     private sigma: Vector3 = [0, 0, 0]
 
+    private dirty = true
     private Rrot_: Matrix3x3 = newMatrix3x3()
+    private RTrot_: Matrix3x3 = newMatrix3x3()
     private STP_: Matrix3x3 = newMatrix3x3()
     private ST_: Matrix3x3 = newMatrix3x3()
 }
@@ -0,0 +1,477 @@
+import { Direction, FaultHelper, TypeOfMovement } from "./FaultHelper"
+import { deg2rad } from "../types/math"
+
+/**
+ * @brief Error code of a row converted by fromAnglesToVectorsBatch or fromAnglesToNormalBatch
+ * (see faultBatchErrorMessage for the message of the row).
+ * @category Data
+ */
+export const enum FaultBatchError {
+    NONE = 0,
+    STRIKE,
+    DIP,
+    DIP_DIRECTION,
+    RAKE,
+    STRIKE_DIRECTION,
+    TYPE_OF_MOVEMENT,
+    UPLIFTED_BLOCK,
+    HORIZONTAL_PLANE_RAKE
+}
+
+/**
+ * @brief Packed columns of field angles, one row per fault plane.
+ *
+ * Angles are in degrees. Directions and types of movement are stored with the values of enums Direction and TypeOfMovement.
+ * The striation is defined either by the rake and the strike direction, or by the striation trend:
+ * trend[i] is NaN when the striation of row i is defined by the rake.
+ * @category Data
+ */
+export type FaultAngleColumns = {
+    strike: Float64Array,
+    dip: Float64Array,
+    dipDirection: Uint8Array,
+    rake: Float64Array,
+    strikeDirection: Uint8Array,
+    trend: Float64Array,
+    typeOfMovement: Uint8Array
+}
+
+/**
+ * @brief Packed unit vectors of the fault planes, by triplets (x, y, z) in reference system S = (X,Y,Z) = (E,N,Up).
+ *
+ * PackedStriatedPlanes has the same columns and can be filled directly.
+ * @category Data
+ */
+export type FaultVectorColumns = {
+    normals: Float64Array,
+    striations: Float64Array,
+    perpStriations: Float64Array
+}
+
+/**
+ * @category Data
+ */
+export function createFaultAngleColumns(n: number): FaultAngleColumns {
+    const trend = new Float64Array(n)
+    trend.fill(NaN)
+    return {
+        strike: new Float64Array(n),
+        dip: new Float64Array(n),
+        dipDirection: new Uint8Array(n).fill(Direction.UND),
+        rake: new Float64Array(n),
+        strikeDirection: new Uint8Array(n).fill(Direction.UND),
+        trend,
+        typeOfMovement: new Uint8Array(n).fill(TypeOfMovement.UND)
+    }
+}
+
+/**
+ * @brief Compute in one pass the unit normals of planes defined by (strike, dip, dip direction).
+ *
+ * This is the batched version of fromAnglesToNormal: instead of throwing, the error code of each row is written in errors[i],
+ * and the normal of a wrong row is set to (0, 0, 0).
+ * @param strike Strikes in degrees [0, 360]
+ * @param dip Dips in degrees [0, 90]
+ * @param dipDirection Dip directions (enum Direction)
+ * @param normals The packed normals to fill (3 values per row)
+ * @param errors The error code of each row (FaultBatchError.NONE if the row is correct)
+ * @param count The number of rows (default is strike.length)
+ * @returns The number of wrong rows
+ * @category Data
+ */
+export function fromAnglesToNormalBatch(
+    strike: Float64Array, dip: Float64Array, dipDirection: Uint8Array,
+    normals: Float64Array, errors: Uint8Array, count: number = strike.length): number
+{
+    let nbErrors = 0
+    for (let i = 0, j = 0; i < count; ++i, j += 3) {
+        const err = planeFrame(strike[i], dip[i], dipDirection[i], frame)
+        errors[i] = err
+        if (err !== FaultBatchError.NONE) {
+            normals[j] = normals[j + 1] = normals[j + 2] = 0
+            ++nbErrors
+            continue
+        }
+        normals[j] = frame.nx
+        normals[j + 1] = frame.ny
+        normals[j + 2] = frame.nz
+    }
+    return nbErrors
+}
+
+/**
+ * @brief Compute in one pass the unit normals, striations and perpendicular striations of striated planes from field angles.
+ *
+ * This is the batched version of FaultHelper.create, without any allocation per row. The conventions are the same:
+ * - the normal points upward (toward the outward block)
+ * - the striation indicates the movement of the outward block relative to the inner block, according to the type of movement
+ * - the local reference frame (striation, perpendicular striation, normal) is right handed
+ *
+ * Instead of throwing, the error code of each row is written in errors[i] (see faultBatchErrorMessage),
+ * and the vectors of a wrong row are set to (0, 0, 0).
+ *
+ * @example
+ * ```ts
+ * const angles = createFaultAngleColumns(n)
+ * // ... fill the columns while reading the file
+ * const planes = new PackedStriatedPlanes(data)
+ * const errors = new Uint8Array(n)
+ * if (fromAnglesToVectorsBatch(angles, planes, errors) > 0) {
+ *     errors.forEach( (e, i) => e !== FaultBatchError.NONE && console.warn(`Data number ${i}: ${faultBatchErrorMessage(angles, i)}`) )
+ * }
+ * ```
+ * @param angles The field angles
+ * @param out The vectors to fill
+ * @param errors The error code of each row (FaultBatchError.NONE if the row is correct)
+ * @param count The number of rows (default is angles.strike.length)
+ * @returns The number of wrong rows
+ * @category Data
+ */
+export function fromAnglesToVectorsBatch(
+    angles: FaultAngleColumns, out: FaultVectorColumns, errors: Uint8Array, count: number = angles.strike.length): number
+{
+    const { normals, striations, perpStriations } = out
+    let nbErrors = 0
+
+    for (let i = 0, j = 0; i < count; ++i, j += 3) {
+        const err = striatedPlaneFrame(angles, i, frame)
+        errors[i] = err
+
+        if (err !== FaultBatchError.NONE) {
+            for (let k = 0; k < 3; ++k) {
+                normals[j + k] = striations[j + k] = perpStriations[j + k] = 0
+            }
+            ++nbErrors
+            continue
+        }
+
+        const { nx, ny, nz, sx, sy, sz } = frame
+        normals[j] = nx
+        normals[j + 1] = ny
+        normals[j + 2] = nz
+        striations[j] = sx
+        striations[j + 1] = sy
+        striations[j + 2] = sz
+        // e_perp_striation = normal x striation
+        perpStriations[j] = ny * sz - nz * sy
+        perpStriations[j + 1] = nz * sx - nx * sz
+        perpStriations[j + 2] = nx * sy - ny * sx
+    }
+
+    return nbErrors
+}
+
+/**
+ * @brief The message of a wrong row, as thrown by FaultHelper.create for the same angles (empty if the row is correct).
+ *
+ * Wrong rows are rare, so the message is taken from the scalar path instead of being rebuilt from the error code:
+ * the batch and FaultHelper report exactly the same text.
+ * @param angles The field angles
+ * @param i The row
+ * @category Data
+ */
+export function faultBatchErrorMessage(angles: FaultAngleColumns, i: number): string {
+    const trendIsDefined = !Number.isNaN(angles.trend[i])
+    try {
+        FaultHelper.create(
+            { strike: angles.strike[i], dip: angles.dip[i], dipDirection: angles.dipDirection[i] },
+            {
+                rake: angles.rake[i], strikeDirection: angles.strikeDirection[i], typeOfMovement: angles.typeOfMovement[i],
+                trend: trendIsDefined ? angles.trend[i] : 0, trendIsDefined
+            }
+        )
+    } catch (e) {
+        return e.message
+    }
+    return ''
+}
+
+// --------------- Hidden to users
+
+const EPS = 1e-7
+
+const bit = (d: Direction) => 1 << d
+const E = bit(Direction.E), W = bit(Direction.W), N = bit(Direction.N), S = bit(Direction.S)
+const NE = bit(Direction.NE), SE = bit(Direction.SE), SW = bit(Direction.SW), NW = bit(Direction.NW)
+
+// The strike is split in 9 sectors: 0, (0,90), 90, (90,180), 180, (180,270), 270, (270,360), 360.
+// For each sector, the tables give the allowed geographic directions (bit masks), as in FaultHelper.faultSphericalCoords
+// and FaultHelper.checkStrikeDir_CalcAlphaStria.
+
+// Dip directions for which phi = 2 PI - strike (e_phi points toward the strike azimuth)
+const SIDE_A = [E, S | E | SE, S, S | W | SW, W, N | W | NW, N, N | E | NE, E]
+// Dip directions for which phi = PI - strike (e_phi points toward the strike azimuth + 180)
+const SIDE_B = [W, N | W | NW, N, N | E | NE, E, S | E | SE, S, S | W | SW, W]
+// phi for the strikes along the axes (sectors 0, 2, 4, 6 and 8), for SIDE_A and SIDE_B
+const AXIS_PHI_A = [0, 0, 3 * Math.PI / 2, 0, Math.PI, 0, Math.PI / 2, 0, 0]
+const AXIS_PHI_B = [Math.PI, 0, Math.PI / 2, 0, 0, 0, 3 * Math.PI / 2, 0, Math.PI]
+// Strike directions pointing toward the strike azimuth
+const TOWARD_STRIKE = [N, N | E | NE, E, S | E | SE, S, S | W | SW, W, N | W | NW, N]
+// Strike directions pointing toward the strike azimuth + 180
+const OPPOSITE_STRIKE = [S, S | W | SW, W, N | W | NW, N, N | E | NE, E, S | E | SE, S]
+
+type Frame = {
+    nx: number, ny: number, nz: number,
+    // e_phi (parallel to the strike) and e_theta (parallel to the dip)
+    px: number, py: number, pz: number,
+    tx: number, ty: number, tz: number,
+    // striation
+    sx: number, sy: number, sz: number,
+    // true if phi = 2 PI - strike, false if phi = PI - strike
+    sideA: boolean
+}
+
+// Scratch frame reused by all the rows
+const frame: Frame = {
+    nx: 0, ny: 0, nz: 0, px: 0, py: 0, pz: 0, tx: 0, ty: 0, tz: 0, sx: 0, sy: 0, sz: 0, sideA: true
+}
+
+function strikeSector(strike: number): number {
+    if (!(strike >= 0 && strike <= 360)) return -1
+    if (strike === 360) return 8
+    const q = Math.floor(strike / 90)
+    return strike === q * 90 ? 2 * q : 2 * q + 1
+}
+
+function has(masks: number[], k: number, d: number): boolean {
+    return d <= Direction.NW && (masks[k] & bit(d)) !== 0
+}
+
+/**
+ * Normal, e_phi and e_theta of a plane (see FaultHelper.faultSphericalCoords)
+ */
+function planeFrame(strike: number, dip: number, dipDirection: number, f: Frame): FaultBatchError {
+    const k = strikeSector(strike)
+    if (k < 0) {
+        return FaultBatchError.STRIKE
+    }
+    if (!(dip >= 0 && dip <= 90)) {
+        return FaultBatchError.DIP
+    }
+
+    // phi is computed with the same expressions as in FaultHelper, so that both give the same vectors to the last bit
+    let phi = 0
+    f.sideA = false
+    if (dip === 0) {
+        // The fault plane is horizontal: the azimuthal angle can take any value
+        phi = 0
+        f.sideA = true
+    } else if (dip === 90) {
+        // The fault plane is vertical: phi = PI - strike (mod 2 PI), the dip direction is not used
+        phi = strike <= 180 ? Math.PI - deg2rad(strike) : 3 * Math.PI - deg2rad(strike)
+    } else if (has(SIDE_A, k, dipDirection)) {
+        phi = k % 2 === 0 ? AXIS_PHI_A[k] : 2 * Math.PI - deg2rad(strike)
+        f.sideA = true
+    } else if (has(SIDE_B, k, dipDirection)) {
+        phi = k % 2 === 0 ? AXIS_PHI_B[k] : (k < 4 ? Math.PI - deg2rad(strike) : 3 * Math.PI - deg2rad(strike))
+    } else {
+        return FaultBatchError.DIP_DIRECTION
+    }
+
+    const theta = deg2rad(dip)
+    const cp = Math.cos(phi), sp = Math.sin(phi)
+    const ct = Math.cos(theta), st = Math.sin(theta)
+
+    f.nx = st * cp
+    f.ny = st * sp
+    f.nz = ct
+    f.px = -sp
+    f.py = cp
+    f.pz = 0
+    f.tx = ct * cp
+    f.ty = ct * sp
+    f.tz = -st
+
+    return FaultBatchError.NONE
+}
+
+/**
+ * Strike-slip component of a type of movement: 1 = left-lateral, -1 = right-lateral, 0 = none
+ */
+function strikeSlipSign(m: number): number {
+    switch (m) {
+        case TypeOfMovement.LL: case TypeOfMovement.N_LL: case TypeOfMovement.I_LL: return 1
+        case TypeOfMovement.RL: case TypeOfMovement.N_RL: case TypeOfMovement.I_RL: return -1
+    }
+    return 0
+}
+
+/**
+ * Dip-slip component of a type of movement: 1 = normal, -1 = inverse, 0 = none
+ */
+function dipSlipSign(m: number): number {
+    switch (m) {
+        case TypeOfMovement.N: case TypeOfMovement.N_LL: case TypeOfMovement.N_RL: return 1
+        case TypeOfMovement.I: case TypeOfMovement.I_LL: case TypeOfMovement.I_RL: return -1
+    }
+    return 0
+}
+
+/**
+ * Orientation (1 or -1) of a striation such that it matches the type of movement, or 0 if the type of movement is not consistent.
+ * @param strikeSlip Sign of the strike-slip component of the striation (1 = left-lateral, 0 = negligible)
+ * @param dipSlip Sign of the dip-slip component of the striation (1 = normal, 0 = negligible)
+ * @param m The type of movement
+ * @param allowUndefined True if the type of movement can be undefined (UND), in which case the striation is not inverted
+ */
+function orientation(strikeSlip: number, dipSlip: number, m: number, allowUndefined: boolean): number {
+    if (m === TypeOfMovement.UND) {
+        return allowUndefined ? 1 : 0
+    }
+    const mss = strikeSlipSign(m)
+    const mds = dipSlipSign(m)
+
+    // A pure strike-slip (resp. dip-slip) striation requires a pure strike-slip (resp. dip-slip) type of movement
+    if (dipSlip === 0 && mds !== 0) return 0
+    if (strikeSlip === 0 && mss !== 0) return 0
+
+    let o = 0
+    if (strikeSlip !== 0 && mss !== 0) {
+        o = strikeSlip * mss
+    }
+    if (dipSlip !== 0 && mds !== 0) {
+        const od = dipSlip * mds
+        if (o !== 0 && o !== od) {
+            // The strike-slip and dip-slip components are located in opposite quadrants
+            return 0
+        }
+        o = od
+    }
+    return o
+}
+
+/**
+ * Normal and striation of a striated plane (see FaultHelper.create)
+ */
+function striatedPlaneFrame(angles: FaultAngleColumns, i: number, f: Frame): FaultBatchError {
+    const strike = angles.strike[i]
+    const dip = angles.dip[i]
+    const dipDirection = angles.dipDirection[i]
+    const typeOfMovement = angles.typeOfMovement[i]
+    const trend = angles.trend[i]
+
+    const verticalStriation = dip === 90 && angles.rake[i] === 90 && Number.isNaN(trend)
+
+    // For a vertical plane with vertical striation the dip direction points toward the uplifted block, and is not used for the normal
+    const err = planeFrame(strike, dip, dipDirection, f)
+    if (err !== FaultBatchError.NONE) {
+        return err
+    }
+    const k = strikeSector(strike)
+
+    if (!Number.isNaN(trend)) {
+        // The striation is defined by the trend (see FaultHelper.setStriationFromTrend)
+        if (dip === 0) {
+            // The striation trend points toward the direction of movement of the top block relative to the bottom block
+            let phiTrend = Math.PI / 2 - deg2rad(trend)
+            if (phiTrend < 0) {
+                phiTrend += 2 * Math.PI
+            }
+            f.sx = Math.cos(phiTrend)
+            f.sy = Math.sin(phiTrend)
+            f.sz = 0
+            return FaultBatchError.NONE
+        }
+
+        // The striation lies in the fault plane and in the vertical plane parallel to the trend:
+        // striation = normal x nTrend / |normal x nTrend|, with nTrend = (cos(phi), sin(phi), 0) and phi = 2 PI - trend.
+        // nTrend is computed as in FaultHelper, so that the nearly degenerate rows (trend parallel to the strike of a steep plane)
+        // give the same vectors
+        const phiTrend = 2 * Math.PI - trend * Math.PI / 180
+        const ux = Math.cos(phiTrend), uy = Math.sin(phiTrend)
+        let sx = -f.nz * uy
+        let sy = f.nz * ux
+        let sz = f.nx * uy - f.ny * ux
+        const l = Math.sqrt(sx * sx + sy * sy + sz * sz)
+        sx /= l
+        sy /= l
+        sz /= l
+
+        const strikeSlip = sx * f.px + sy * f.py + sz * f.pz
+        const dipSlip = sx * f.tx + sy * f.ty + sz * f.tz
+        const o = orientation(
+            Math.abs(strikeSlip) < EPS ? 0 : Math.sign(strikeSlip),
+            Math.abs(dipSlip) < EPS ? 0 : Math.sign(dipSlip),
+            typeOfMovement, true)
+        if (o === 0) {
+            return FaultBatchError.TYPE_OF_MOVEMENT
+        }
+        f.sx = o * sx
+        f.sy = o * sy
+        f.sz = o * sz
+        return FaultBatchError.NONE
+    }
+
+    // The striation is defined by the rake and the strike direction
+    const rake = angles.rake[i]
+    const strikeDirection = angles.strikeDirection[i]
+
+    if (!(rake >= 0 && rake <= 90)) {
+        return FaultBatchError.RAKE
+    }
+    if (dip === 0) {
+        return FaultBatchError.HORIZONTAL_PLANE_RAKE
+    }
+
+    const toward = has(TOWARD_STRIKE, k, strikeDirection)
+    const opposite = has(OPPOSITE_STRIKE, k, strikeDirection)
+
+    if (verticalStriation) {
+        // Special case: vertical plane with vertical striation (see FaultHelper.setStriationForVerticalPlaneAndRake)
+        if (k === 8) {
+            // FaultHelper only accepts strikes in [0, 360) for this case
+            return FaultBatchError.STRIKE
+        }
+        if (!toward && !opposite && strikeDirection !== Direction.UND) {
+            return FaultBatchError.STRIKE_DIRECTION
+        }
+        // The normal points toward SIDE_B (phi = PI - strike)
+        let sz = 0
+        if (has(SIDE_B, k, dipDirection)) {
+            // The uplifted block is the outward block: the striation points upward
+            sz = 1
+        } else if (has(SIDE_A, k, dipDirection) || k >= 5) {
+            // As in FaultHelper, the dip direction is not checked for strikes in (180, 360): any other direction is the inner block
+            sz = -1
+        } else {
+            return FaultBatchError.UPLIFTED_BLOCK
+        }
+        f.sx = 0
+        f.sy = 0
+        f.sz = sz
+        return FaultBatchError.NONE
+    }
+
+    // alphaStria: striation angle measured clockwise from e_phi in the plane (e_phi, e_theta) (see FaultHelper.faultStriationAngle_A)
+    let alphaStria = 0
+    if (strikeDirection === Direction.UND && (rake === 0 || (rake === 90 && dip !== 90))) {
+        alphaStria = deg2rad(rake)
+    } else if (toward || opposite) {
+        // The rake is measured from the strike direction, and e_phi points toward the strike azimuth for side A
+        alphaStria = toward === f.sideA ? deg2rad(rake) : Math.PI - deg2rad(rake)
+    } else {
+        return FaultBatchError.STRIKE_DIRECTION
+    }
+
+    // Orientation of the striation according to the type of movement (see FaultHelper.faultStriationAngle_B)
+    const ca = Math.cos(alphaStria), sa = Math.sin(alphaStria)
+    const strikeSlip = rake === 90 ? 0 : Math.sign(ca)
+    let o = 0
+    if (dip === 90) {
+        // The fault plane is vertical and only the strike-slip component of motion is defined
+        o = strikeSlipSign(typeOfMovement) * strikeSlip
+        if (dipSlipSign(typeOfMovement) !== 0) {
+            o = 0
+        }
+    } else {
+        o = orientation(strikeSlip, rake === 0 ? 0 : 1, typeOfMovement, false)
+    }
+    if (o === 0) {
+        return FaultBatchError.TYPE_OF_MOVEMENT
+    }
+
+    f.sx = o * (ca * f.px + sa * f.tx)
+    f.sy = o * (ca * f.py + sa * f.ty)
+    f.sz = o * (ca * f.pz + sa * f.tz)
+    return FaultBatchError.NONE
+}
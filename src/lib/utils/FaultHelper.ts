@@ -3,7 +3,7 @@
 import { constant_x_Vector, crossProduct, Matrix3x3, newMatrix3x3, newVector3D, normalizedCrossProduct, Vector3 } from "../types/math"
 import { deg2rad, tensor_x_Vector, spherical2unitVectorCartesian } from "../types/math"
 import { SphericalCoords } from "../types/SphericalCoords"
-import { Plane, Striation } from "../data"
+import { Plane, Striation } from "../data/types"
 import { scalarProduct } from "../types"
 
 /**
@@ -447,6 +447,8 @@ export class FaultHelper {
                 }
             }
         }
+        this.e_striation_ = this.nStriation
+
         // Calculate in reference system S the unit vector e_perp_striation_ located on the fault plane and perpendicular to the striation.
         // This vector is necessary for calculating the misfit angle for criteria involving friction.
         // The local coord system (e_striation_, e_perp_striation_, normal) is right handed
@@ -1860,7 +1862,7 @@ export class FaultHelper {
                 if ((this.typeMov === TypeOfMovement.LL) || (this.typeMov === TypeOfMovement.I) || (this.typeMov === TypeOfMovement.I_LL)) {
                     this.alphaStriaDeg += 180
                     this.alphaStria += Math.PI
-                } else if ((this.typeMov !== TypeOfMovement.RL) && (this.typeMov !== TypeOfMovement.N) && (this.typeMov === TypeOfMovement.N_RL)) {
+                } else if ((this.typeMov !== TypeOfMovement.RL) && (this.typeMov !== TypeOfMovement.N) && (this.typeMov !== TypeOfMovement.N_RL)) {
                     throw new Error(`type of mouvement is not consistent with fault data. Should be LL or I or I-LL or RL or N or N-RL`)
                 }
             } else if (this.alphaStriaDeg === 180) {   // Pure strike-slip mouvement
@@ -1,4 +1,5 @@
-import { DataDescription, Tokens, createDataArgument } from "../data"
+import { DataDescription, createDataArgument } from "../data/DataDescription"
+import { Tokens } from "../data/types"
 import { Direction, isGeographicDirection } from "./FaultHelper"
 import { isDefined, toInt } from "./numberUtils"
 
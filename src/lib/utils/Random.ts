@@ -0,0 +1,30 @@
+/**
+ * @brief Seeded pseudo-random generator (mulberry32), so that a search draws the same trials for the same seed.
+ *
+ * Without seed, the generator is seeded from Math.random. The state is a single 32 bits integer, which can be saved
+ * and restored (e.g., to continue a Markov chain later or in another thread).
+ * @example
+ * ```ts
+ * const random = new Random(42)
+ * const x = random.next() // in [0, 1)
+ * ```
+ * @category Utils
+ */
+export class Random {
+    state: number
+
+    constructor(seed: number = undefined) {
+        this.state = (seed === undefined ? Math.floor(Math.random() * 0x100000000) : seed) >>> 0
+    }
+
+    /**
+     * A number uniformly distributed in [0, 1)
+     */
+    next(): number {
+        this.state = (this.state + 0x6D2B79F5) >>> 0
+        let t = this.state
+        t = Math.imul(t ^ (t >>> 15), t | 1)
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61)
+        return ((t ^ (t >>> 14)) >>> 0) / 0x100000000
+    }
+}
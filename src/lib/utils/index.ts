@@ -5,3 +5,5 @@ export * from './CompactionShearBandsHelper'
 export * from './numberUtils'
 export * from './fromAnglesToNormal'
 export * from './fromDipAzimToNormal'
+export * from './FaultBatchHelper'
+export * from './Random'
@@ -0,0 +1,54 @@
+import { isMainThread } from "worker_threads"
+import { InversionServer, runInversionWorker, withStartupSnapshot } from "./lib/core"
+
+/*
+ * Command line entry of the inversion server (see InversionServer), bundled as dist/stress-server.js (see webpack.config.js).
+ *
+ *   node stress-server.js [--workers n] [--worker-script path] [--socket path|port] [--host address] [--data-root path] [--cache n]
+ *
+ * Without --socket, the jobs are read on stdin and the events written on stdout (JSON lines). The logs of the library are
+ * then written on stderr, so that stdout only contains the events.
+ * A TCP port only accepts local connections, unless --host gives another interface. The data files of the jobs are read
+ * from --data-root (default: the current directory).
+ * To start from a startup snapshot (see withStartupSnapshot), the options follow '--' and the worker script must be given explicitly:
+ *
+ *   node --snapshot-blob stress-server.blob -- --workers n --worker-script stress-server.js
+ *
+ * Only the server thread starts from the snapshot: the workers load the worker script, and only evaluate the modules
+ * used by their jobs (the data types, the search methods and the landscape are loaded on first request).
+ */
+
+function option(args: string[], name: string): string {
+    const i = args.indexOf(name)
+    return i === -1 ? undefined : args[i + 1]
+}
+
+function main() {
+    const args = process.argv.slice(1)
+    const workers = parseInt(option(args, '--workers') || '0')
+    const socket = option(args, '--socket')
+    const workerScript = option(args, '--worker-script') || (process.argv[1] !== undefined && process.argv[1].endsWith('.js') ? process.argv[1] : undefined)
+
+    const server = new InversionServer({
+        workers,
+        workerScript,
+        cacheSize: parseInt(option(args, '--cache') || '32'),
+        dataRoot: option(args, '--data-root')
+    })
+
+    if (socket !== undefined) {
+        server.listen(/^\d+$/.test(socket) ? parseInt(socket) : socket, option(args, '--host'))
+    } else {
+        // Keep stdout for the events
+        console.log = console.error
+        server.serveStdio().then(() => server.close())
+    }
+}
+
+if (isMainThread) {
+    withStartupSnapshot(main)
+} else {
+    // The stdout of the workers is the one of the server
+    console.log = console.error
+    runInversionWorker()
+}
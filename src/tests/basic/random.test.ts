@@ -0,0 +1,43 @@
+import { PackedDataset } from "../../lib/data"
+import { createDefaultSolution } from "../../lib/InverseMethod"
+import { CMAES, MonteCarlo, ParallelTempering, SuccessiveHalving } from "../../lib/search"
+import { normalizeVector, properRotationTensor } from "../../lib/types"
+import { Random } from "../../lib/utils"
+import { createPlanes } from "../synthetic-data"
+
+test('seeded generator', () => {
+    const a = new Random(7), b = new Random(7)
+    let sum = 0
+    for (let i = 0; i < 10000; ++i) {
+        const x = a.next()
+        expect(x).toBe(b.next())
+        expect(x >= 0 && x < 1).toBe(true)
+        sum += x
+    }
+    expect(sum / 10000).toBeCloseTo(0.5, 1)
+
+    // The state can be saved and restored
+    const state = a.state
+    const x = a.next()
+    a.state = state
+    expect(a.next()).toBe(x)
+})
+
+test('seeded searches are reproducible', () => {
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 }), 0.3, 30))
+    const searches = [
+        () => new MonteCarlo({ nbRandomTrials: 200, seed: 3 }),
+        () => new SuccessiveHalving({ nbRandomTrials: 200, initialSubsetSize: 10, seed: 3 }),
+        () => new CMAES({ nbEvaluations: 300, seed: 3 }),
+        () => new ParallelTempering({ nbSteps: 300, nbChains: 3, seed: 3 })
+    ]
+    for (const create of searches) {
+        const search = create()
+        const first = search.runPacked(packed, createDefaultSolution())
+        // Same search again, and a new search with the same seed
+        expect(search.runPacked(packed, createDefaultSolution()).misfit).toBe(first.misfit)
+        const second = create().runPacked(packed, createDefaultSolution())
+        expect(second.misfit).toBe(first.misfit)
+        expect(second.stressRatio).toBe(first.stressRatio)
+    }
+})
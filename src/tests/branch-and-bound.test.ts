@@ -0,0 +1,100 @@
+/**
+ * @jest-environment node
+ */
+import { join } from "path"
+import { PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { createDefaultSolution, MisfitCriteriunSolution } from "../lib/InverseMethod"
+import { BranchAndBound } from "../lib/search"
+import { multiplyTensors, normalizeVector, properRotationTensor, Vector3 } from "../lib/types"
+import { SearchWorkerPool } from "../lib/server"
+import { createPlanes } from "./synthetic-data"
+
+const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+
+test('lower bound of a cell', () => {
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 50))
+    const engine = new HomogeneousEngine()
+    const radius = 0.1, ratioRadius = 0.05
+
+    for (let c = 0; c < 10; ++c) {
+        const center = multiplyTensors({ A: properRotationTensor({ nRot: normalizeVector([Math.cos(c), Math.sin(c), 0.5]), angle: 0.5 * c }), B: Wtrue })
+        const ratio = 0.1 + 0.08 * c
+        engine.setHypotheticalStress(center, ratio)
+        const [misfit, bound] = packed.costWithLowerBound(engine, radius, ratioRadius)
+        expect(bound).toBeLessThan(misfit + 1e-12)
+
+        // Any tensor of the cell has a misfit above the bound
+        for (let k = 0; k < 20; ++k) {
+            const Q = properRotationTensor({ nRot: normalizeVector([Math.sin(k), Math.cos(5 * k), Math.sin(2 * k + 1)] as Vector3), angle: radius * (k % 5) / 4 })
+            engine.setHypotheticalStress(multiplyTensors({ A: Q, B: center }), ratio + ratioRadius * Math.cos(k))
+            expect(packed.cost(engine)).toBeGreaterThan(bound - 1e-12)
+        }
+    }
+})
+
+test('branch-and-bound finds the optimum with a proven gap', () => {
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 30))
+    const search = new BranchAndBound({ tolerance: 0.05, maxEvaluations: 200000 })
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    expect(solution.misfit - solution.lowerBound).toBeLessThan(0.05 + 1e-12)
+    expect(solution.misfit).toBeLessThan(0.05)
+    expect(search.nbEvaluations).toBeLessThan(200000)
+
+    // The solution is equivalent to the true stress tensor
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(Wtrue, 0.3)
+    const S = engine.S()
+    let d = 0
+    for (let i = 0; i < 3; ++i) for (let j = 0; j < 3; ++j) d = Math.max(d, Math.abs(S[i][j] - solution.stressTensorSolution[i][j]))
+    expect(d).toBeLessThan(0.2)
+})
+
+test('branch-and-bound evaluates each refinement step as one batch', () => {
+    // Records the batches
+    class RecordingBranchAndBound extends BranchAndBound {
+        batches: number[] = []
+        protected evaluateCells(packed: PackedDataset, cells: Float64Array, count: number, bounds: Float64Array, solution: MisfitCriteriunSolution): void {
+            this.batches.push(count)
+            super.evaluateCells(packed, cells, count, bounds, solution)
+        }
+    }
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 30))
+    const params = { tolerance: 0.05, maxEvaluations: 200000, batchSize: 16 }
+    const search = new RecordingBranchAndBound(params)
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    // The initial cells, then up to 8 children of each of the batchSize cells of a step
+    expect(search.batches.reduce((a, b) => a + b, 0)).toBe(search.nbEvaluations)
+    expect(search.batches[0]).toBeGreaterThan(1)
+    expect(Math.max(...search.batches.slice(1))).toBeGreaterThan(16)
+    expect(Math.max(...search.batches.slice(1))).toBeLessThanOrEqual(8 * 16)
+    expect(solution.misfit - solution.lowerBound).toBeLessThan(0.05 + 1e-12)
+
+    // Same search as without the subclass
+    const plain = new BranchAndBound(params).runPacked(packed, createDefaultSolution())
+    expect(plain.misfit).toBe(solution.misfit)
+    expect(plain.lowerBound).toBe(solution.lowerBound)
+})
+
+test('branch-and-bound evaluates the batches of cells in workers', async () => {
+    const data = createPlanes(Wtrue, 0.3, 30)
+    const params = { tolerance: 0.05, maxEvaluations: 200000, batchSize: 16 }
+    const expected = new BranchAndBound(params).runPacked(new PackedDataset(data), createDefaultSolution())
+
+    const pool = new SearchWorkerPool({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    try {
+        const search = new BranchAndBound(params)
+        search.setWorkers(pool)
+        const solution = search.runPacked(new PackedDataset(data, { shared: true }), createDefaultSolution())
+        expect(solution.misfit).toBe(expected.misfit)
+        expect(solution.lowerBound).toBe(expected.lowerBound)
+        expect(solution.stressRatio).toBe(expected.stressRatio)
+
+        // Not shared
+        expect(() => search.runPacked(new PackedDataset(data), createDefaultSolution())).toThrow()
+    } finally {
+        await pool.close()
+    }
+})
@@ -0,0 +1,51 @@
+/**
+ * @jest-environment node
+ */
+import { join } from "path"
+import { PackedDataset } from "../lib/data"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { CMAES, MonteCarlo, SearchMethodFactory } from "../lib/search"
+import { normalizeVector, properRotationTensor } from "../lib/types"
+import { SearchWorkerPool } from "../lib/server"
+import { createPlanes } from "./synthetic-data"
+
+test('CMA-ES converges with few evaluations', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 40))
+
+    const search = SearchMethodFactory.create('CMA-ES', { nbEvaluations: 1500, seed: 1 }) as CMAES
+    expect(search).toBeInstanceOf(CMAES)
+    const solution = search.runPacked(packed, createDefaultSolution())
+    expect(solution.misfit).toBeLessThan(1e-3)
+    expect(solution.stressRatio).toBeCloseTo(0.3, 2)
+
+    // MonteCarlo does not reach the same misfit with the same budget
+    const mc = new MonteCarlo({ nbRandomTrials: 1500, seed: 1 }).runPacked(packed, createDefaultSolution())
+    expect(mc.misfit).toBeGreaterThan(solution.misfit)
+})
+
+test('CMA-ES restarts with a larger population', () => {
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: [1, 0, 0], angle: 2.5 }), 0.5, 20))
+    const search = new CMAES({ nbEvaluations: 5000, tolerance: 1e-6, seed: 1 })
+    search.runPacked(packed, createDefaultSolution())
+    expect(search.nbRestarts).toBeGreaterThan(0)
+
+    expect(() => new CMAES({ sigma: 0 })).toThrow()
+})
+
+test('CMA-ES evaluates the populations in workers', async () => {
+    const data = createPlanes(properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 }), 0.3, 40)
+    const params = { nbEvaluations: 1000, seed: 2 }
+    const expected = new CMAES(params).runPacked(new PackedDataset(data), createDefaultSolution())
+
+    const pool = new SearchWorkerPool({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    try {
+        const search = new CMAES(params)
+        search.setWorkers(pool)
+        const solution = search.runPacked(new PackedDataset(data, { shared: true }), createDefaultSolution())
+        expect(solution.misfit).toBe(expected.misfit)
+        expect(solution.stressRatio).toBe(expected.stressRatio)
+    } finally {
+        await pool.close()
+    }
+})
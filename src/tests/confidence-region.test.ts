@@ -0,0 +1,93 @@
+import { GenericData, GenericKernel, MisfitObjectiveType, PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { confidenceCone, ConfidenceRegion, MonteCarlo, PrincipalAxis, stressRatioInterval } from "../lib/search"
+import { Matrix3x3, normalizeVector, properRotationTensor } from "../lib/types"
+import { createPlanes } from "./synthetic-data"
+
+test('confidence region stores compressed samples and filters them', () => {
+    const region = new ConfidenceRegion(0.1, 4)
+    const rotations: Matrix3x3[] = []
+    for (let i = 0; i < 100; ++i) {
+        const W = properRotationTensor({ nRot: normalizeVector([Math.sin(i), Math.cos(3 * i), 0.5]), angle: 0.05 * i })
+        rotations.push(W)
+        // Decreasing misfits: the region only keeps the last samples
+        region.add(W, i / 100, 1 - i / 100)
+    }
+    region.compact()
+    expect(region.best).toBeCloseTo(0.01, 12)
+    expect(region.size).toBe(11)
+    // The buffer did not grow with the number of samples
+    expect(region.byteLength).toBeLessThanOrEqual(12 * 32)
+
+    region.forEach((W, stressRatio, misfit, i) => {
+        const k = 89 + i
+        expect(stressRatio).toBeCloseTo(k / 100, 4)
+        expect(misfit).toBeCloseTo(1 - k / 100, 6)
+        for (let r = 0; r < 3; ++r) {
+            for (let c = 0; c < 3; ++c) {
+                expect(W[r][c]).toBeCloseTo(rotations[k][r][c], 3)
+            }
+        }
+    })
+})
+
+test('MonteCarlo captures the near optimal samples', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 200))
+
+    const region = new ConfidenceRegion(0.05)
+    const search = new MonteCarlo({ nbRandomTrials: 5000, Rrot: Wtrue, rotAngleHalfInterval: 0.5, stressRatio: 0.3, stressRatioHalfInterval: 0.3, seed: 1 })
+    search.setConfidenceRegion(region)
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    expect(region.best).toBeCloseTo(solution.misfit, 6)
+    const engine = new HomogeneousEngine()
+    let count = 0
+    region.forEach((W, stressRatio, misfit) => {
+        expect(misfit).toBeLessThanOrEqual(solution.misfit + 0.05 + 1e-6)
+        engine.setHypotheticalStress(W, stressRatio)
+        expect(packed.cost(engine)).toBeCloseTo(misfit, 3)
+        count++
+    })
+    expect(count).toBeGreaterThan(1)
+    expect(count).toBeLessThan(5000)
+
+    // The cone of sigma_1 contains the true axis, and the interval of R the true ratio
+    const cone = confidenceCone(region, PrincipalAxis.SIGMA_1)
+    const a = Wtrue[PrincipalAxis.SIGMA_1]
+    const angle = Math.acos(Math.min(1, Math.abs(a[0] * cone.axis[0] + a[1] * cone.axis[1] + a[2] * cone.axis[2])))
+    expect(angle).toBeLessThanOrEqual(cone.halfAngle)
+    expect(cone.outline.length).toBeGreaterThan(2)
+    cone.outline.forEach(p => expect(Math.hypot(...p)).toBeCloseTo(1, 12))
+    const [Rmin, Rmax] = stressRatioInterval(region)
+    expect(Rmin).toBeLessThanOrEqual(0.3)
+    expect(Rmax).toBeGreaterThanOrEqual(0.3)
+})
+
+test('MonteCarlo only captures the samples whose exact misfit is in the region', () => {
+    // With the quantile objective, an abandoned evaluation returns the bound itself: such trials are not in the region
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const kernel = GenericKernel.compile('c', ['c'])
+    const data = [
+        ...createPlanes(Wtrue, 0.3, 100, { reversed: i => i % 10 === 0 }),
+        ...[0, 0.1, 0.2].map(c => new GenericData(kernel, { c }))
+    ]
+    const packed = new PackedDataset(data, { objective: { type: MisfitObjectiveType.QUANTILE, quantile: 0.5 } })
+    expect(packed.nbOthers).toBe(3)
+
+    const region = new ConfidenceRegion(0.1)
+    const search = new MonteCarlo({ nbRandomTrials: 2000, Rrot: Wtrue, rotAngleHalfInterval: 0.5, stressRatio: 0.3, stressRatioHalfInterval: 0.3, seed: 1 })
+    search.setConfidenceRegion(region)
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    const engine = new HomogeneousEngine()
+    let count = 0
+    region.forEach((W, stressRatio, misfit) => {
+        engine.setHypotheticalStress(W, stressRatio)
+        expect(packed.cost(engine)).toBeCloseTo(misfit, 3)
+        expect(misfit).toBeLessThanOrEqual(solution.misfit + 0.1 + 1e-6)
+        count++
+    })
+    expect(count).toBeGreaterThan(1)
+})
@@ -0,0 +1,45 @@
+import { CompressedDataset, PackedDataset, StriatedPlaneKin } from "../../lib/data"
+import { HomogeneousEngine } from "../../lib/geomeca"
+import { createDefaultSolution } from "../../lib/InverseMethod"
+import { MonteCarlo } from "../../lib/search"
+import { normalizeVector, properRotationTensor, tensor_x_Vector } from "../../lib/types"
+import { createPlane, sequenceNormal, shearDirection } from "../synthetic-data"
+
+// Families of striated planes, each plane being rotated by a small random angle from the plane of its family
+function createCatalog(nbFamilies: number, nbPerFamily: number, spread: number): StriatedPlaneKin[] {
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 }), 0.3)
+    const S = engine.S()
+    const planes = []
+    for (let f = 0; f < nbFamilies; ++f) {
+        const normal = sequenceNormal(f)
+        const striation = shearDirection(S, normal)
+        for (let i = 0; i < nbPerFamily; ++i) {
+            const R = properRotationTensor({ nRot: normalizeVector([Math.random() - 0.5, Math.random() - 0.5, Math.random() - 0.5]), angle: spread * Math.random() })
+            planes.push(createPlane(tensor_x_Vector({ T: R, V: normal }), tensor_x_Vector({ T: R, V: striation })))
+        }
+    }
+    return planes
+}
+
+test('compressed dataset bounds the error on the misfit', () => {
+    const data = createCatalog(20, 500, 0.2 * Math.PI / 180)
+    const compressed = new CompressedDataset(data, { resolution: Math.PI / 180 })
+    expect(compressed.nbRepresentatives).toBeLessThan(400)
+    expect(compressed.packed.size).toBe(compressed.nbRepresentatives)
+    expect(compressed.packed.totalWeight).toBe(10000)
+    expect(compressed.maxDeviation).toBeLessThan(2 * Math.PI / 180)
+
+    const engine = new HomogeneousEngine()
+    for (let i = 0; i < 50; ++i) {
+        engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([Math.sin(i), Math.cos(2 * i), 1]), angle: 0.1 * i }), (i % 10) / 10)
+        const error = Math.abs(compressed.packed.cost(engine) - compressed.full.cost(engine))
+        expect(error).toBeLessThanOrEqual(compressed.misfitErrorBound(engine) + 1e-12)
+    }
+
+    // A search on the representatives, evaluated on the full dataset
+    const solution = new MonteCarlo({ nbRandomTrials: 2000, seed: 1 }).runPacked(compressed.packed, createDefaultSolution())
+    engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+    expect(Math.abs(solution.misfit - compressed.full.cost(engine))).toBeLessThanOrEqual(compressed.misfitErrorBound(engine) + 1e-12)
+    expect(compressed.full.cost(engine)).toBe(new PackedDataset(data).cost(engine))
+})
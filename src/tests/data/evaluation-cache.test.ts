@@ -0,0 +1,42 @@
+import { EvaluationCache, PackedDataset } from "../../lib/data"
+import { HomogeneousEngine } from "../../lib/geomeca"
+import { normalizeVector, properRotationTensor } from "../../lib/types"
+import { createPlanes } from "../synthetic-data"
+
+const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+
+test('revisited stress tensors are looked up in the cache', () => {
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 500))
+    const cache = new EvaluationCache({ capacity: 4 })
+    packed.setCache(cache)
+    const engine = new HomogeneousEngine()
+
+    const W = properRotationTensor({ nRot: normalizeVector([0, 1, 1]), angle: 0.4 })
+    engine.setHypotheticalStress(W, 0.6)
+    const misfit = packed.cost(engine)
+    // Same rotation, and a rotation within the resolution
+    expect(packed.cost(engine)).toBe(misfit)
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([0, 1, 1]), angle: 0.4 + 1e-6 }), 0.6)
+    expect(packed.cost(engine)).toBe(misfit)
+    expect(cache.stats()).toEqual({ hits: 2, misses: 1, evictions: 0, size: 1, hitRate: 2 / 3 })
+
+    // An abandoned evaluation is only a lower bound
+    engine.setHypotheticalStress(W, 0.1)
+    const abandoned = packed.cost(engine, 1e-3)
+    expect(abandoned).toBeGreaterThanOrEqual(1e-3)
+    expect(packed.cost(engine, 1e-4)).toBe(abandoned)
+    packed.setCache(undefined)
+    const exact = packed.cost(engine)
+    packed.setCache(cache)
+    expect(cache.size).toBe(0)
+    packed.cost(engine, 1e-3)
+    expect(packed.cost(engine)).toBeCloseTo(exact, 12)
+
+    // Bounded memory
+    for (let i = 0; i < 10; ++i) {
+        engine.setHypotheticalStress(W, i / 10)
+        packed.cost(engine)
+    }
+    expect(cache.size).toBe(4)
+    expect(cache.stats().evictions).toBeGreaterThan(0)
+})
@@ -0,0 +1,42 @@
+import { DataFactory, StriatedPlaneKin } from "../../lib/data"
+import { SearchMethodFactory } from "../../lib/search"
+import * as core from "../../lib/core"
+
+test('factories create the registered types', () => {
+    DataFactory.bind(StriatedPlaneKin, 'Custom Striated Plane')
+    expect(DataFactory.exists('Custom Striated Plane')).toBe(true)
+    expect(DataFactory.create('Custom Striated Plane') instanceof StriatedPlaneKin).toBe(true)
+
+    // The built-in types are registered by the factory itself (see DataFactory)
+    expect(DataFactory.create('Striated Plane') instanceof StriatedPlaneKin).toBe(true)
+    expect(DataFactory.names()).toContain('Stylolite Interface')
+    expect(DataFactory.create('Unknown')).toBeUndefined()
+    expect(SearchMethodFactory.create('Monte Carlo')).toBeDefined()
+})
+
+test('lazy types are loaded on first request only', () => {
+    let loads = 0
+    DataFactory.bindLazy('Lazy Striated Plane', () => {
+        loads++
+        return StriatedPlaneKin
+    })
+    expect(DataFactory.exists('Lazy Striated Plane')).toBe(true)
+    expect(loads).toBe(0)
+
+    expect(DataFactory.create('Lazy Striated Plane') instanceof StriatedPlaneKin).toBe(true)
+    DataFactory.create('Lazy Striated Plane')
+    DataFactory.preload()
+    expect(loads).toBe(1)
+
+    SearchMethodFactory.preload()
+    expect(SearchMethodFactory.create('CMA-ES')).toBeDefined()
+})
+
+test('the slim entry only exports the server and the registries', () => {
+    expect(typeof core.runInversionWorker).toBe('function')
+    expect(core.DataFactory.exists('Striated Plane')).toBe(true)
+    expect(core.SearchMethodFactory.exists('Monte Carlo')).toBe(true)
+    expect((core as any).StriatedPlaneKin).toBeUndefined()
+    expect((core as any).PackedDataset).toBeUndefined()
+    expect((core as any).InteractiveSession).toBeUndefined()
+})
@@ -0,0 +1,181 @@
+import {
+    createFaultAngleColumns, Direction, FaultBatchError, faultBatchErrorMessage, FaultHelper,
+    fromAnglesToVectorsBatch, TypeOfMovement
+} from "../../lib"
+import { DataFactory } from "../../lib/data"
+import { readDataset } from "../../lib/io"
+import { FaultVectorBatch } from "../../lib/io/DataReader"
+
+test('batch conversion matches FaultHelper', () => {
+    const rows = [
+        { strike: 0, dip: 60, dipDirection: Direction.E, rake: 30, strikeDirection: Direction.N, typeOfMovement: TypeOfMovement.N_LL },
+        { strike: 45, dip: 30, dipDirection: Direction.NW, rake: 90, strikeDirection: Direction.UND, typeOfMovement: TypeOfMovement.I },
+        { strike: 200, dip: 90, dipDirection: Direction.UND, rake: 20, strikeDirection: Direction.S, typeOfMovement: TypeOfMovement.RL },
+        { strike: 300, dip: 45, dipDirection: Direction.NE, rake: 0, strikeDirection: Direction.UND, typeOfMovement: TypeOfMovement.RL }
+    ]
+
+    const n = rows.length
+    const angles = createFaultAngleColumns(n)
+    rows.forEach((r, i) => {
+        angles.strike[i] = r.strike
+        angles.dip[i] = r.dip
+        angles.dipDirection[i] = r.dipDirection
+        angles.rake[i] = r.rake
+        angles.strikeDirection[i] = r.strikeDirection
+        angles.typeOfMovement[i] = r.typeOfMovement
+    })
+
+    const out = { normals: new Float64Array(3 * n), striations: new Float64Array(3 * n), perpStriations: new Float64Array(3 * n) }
+    const errors = new Uint8Array(n)
+    expect(fromAnglesToVectorsBatch(angles, out, errors)).toBe(0)
+
+    rows.forEach((r, i) => {
+        const f = FaultHelper.create(
+            { strike: r.strike, dip: r.dip, dipDirection: r.dipDirection },
+            { rake: r.rake, strikeDirection: r.strikeDirection, trendIsDefined: false, trend: 0, typeOfMovement: r.typeOfMovement }
+        )
+        expect(errors[i]).toBe(FaultBatchError.NONE)
+        for (let k = 0; k < 3; ++k) {
+            expect(out.normals[3 * i + k]).toBeCloseTo(f.normal[k])
+            expect(out.striations[3 * i + k]).toBeCloseTo(f.striation[k])
+            expect(out.perpStriations[3 * i + k]).toBeCloseTo(f.e_perp_striation[k])
+        }
+    })
+})
+
+test('batch conversion reports wrong rows', () => {
+    const angles = createFaultAngleColumns(1)
+    angles.strike[0] = 30
+    angles.dip[0] = 50
+    angles.dipDirection[0] = Direction.NE
+    const out = { normals: new Float64Array(3), striations: new Float64Array(3), perpStriations: new Float64Array(3) }
+    const errors = new Uint8Array(1)
+    expect(fromAnglesToVectorsBatch(angles, out, errors)).toBe(1)
+    expect(errors[0]).toBe(FaultBatchError.DIP_DIRECTION)
+})
+
+test('batch conversion matches FaultHelper on a grid of angles', () => {
+    // Every strike sector, dip direction, strike direction and type of movement (UND included), with the striation
+    // defined either by the rake or by the trend
+    const rows: { strike: number, dip: number, dipDirection: number, rake: number, strikeDirection: number, trend: number, typeOfMovement: number }[] = []
+    for (let strike = 0; strike <= 360; strike += 30) {
+        for (const dip of [0, 10, 45, 80, 90]) {
+            for (let dipDirection = Direction.E; dipDirection <= Direction.UND; ++dipDirection) {
+                for (let typeOfMovement = TypeOfMovement.N; typeOfMovement <= TypeOfMovement.UND; ++typeOfMovement) {
+                    for (const rake of [0, 30, 60, 90]) {
+                        for (let strikeDirection = Direction.E; strikeDirection <= Direction.UND; ++strikeDirection) {
+                            rows.push({ strike, dip, dipDirection, rake, strikeDirection, trend: NaN, typeOfMovement })
+                        }
+                    }
+                    for (let trend = 0; trend < 360; trend += 45) {
+                        rows.push({ strike, dip, dipDirection, rake: 0, strikeDirection: Direction.UND, trend, typeOfMovement })
+                    }
+                }
+            }
+        }
+    }
+
+    const n = rows.length
+    const angles = createFaultAngleColumns(n)
+    rows.forEach((r, i) => {
+        angles.strike[i] = r.strike
+        angles.dip[i] = r.dip
+        angles.dipDirection[i] = r.dipDirection
+        angles.rake[i] = r.rake
+        angles.strikeDirection[i] = r.strikeDirection
+        angles.trend[i] = r.trend
+        angles.typeOfMovement[i] = r.typeOfMovement
+    })
+    const out = { normals: new Float64Array(3 * n), striations: new Float64Array(3 * n), perpStriations: new Float64Array(3 * n) }
+    const errors = new Uint8Array(n)
+    fromAnglesToVectorsBatch(angles, out, errors)
+
+    // The rows where the batch and FaultHelper differ (outcome, message or vectors)
+    const differ: string[] = []
+    let nbAccepted = 0, nbRejected = 0
+    rows.forEach((r, i) => {
+        let f: FaultHelper = undefined
+        let message = ''
+        try {
+            f = FaultHelper.create(
+                { strike: r.strike, dip: r.dip, dipDirection: r.dipDirection },
+                { rake: r.rake, strikeDirection: r.strikeDirection, trendIsDefined: !Number.isNaN(r.trend), trend: r.trend, typeOfMovement: r.typeOfMovement }
+            )
+        } catch (e) {
+            message = e.message
+        }
+
+        const row = JSON.stringify(r)
+        if ((errors[i] !== FaultBatchError.NONE) !== (f === undefined)) {
+            differ.push(`${row}: batch error ${errors[i]}, FaultHelper ${f === undefined ? `throws "${message}"` : 'accepts'}`)
+        } else if (faultBatchErrorMessage(angles, i) !== message) {
+            differ.push(`${row}: message "${faultBatchErrorMessage(angles, i)}" instead of "${message}"`)
+        } else if (f !== undefined) {
+            ++nbAccepted
+            for (let k = 0; k < 3; ++k) {
+                // The normals are computed with the same expressions, the striations are rotated in another way
+                if (out.normals[3 * i + k] !== f.normal[k] ||
+                    Math.abs(out.striations[3 * i + k] - f.striation[k]) > 1e-12 ||
+                    Math.abs(out.perpStriations[3 * i + k] - f.e_perp_striation[k]) > 1e-12) {
+                    differ.push(`${row}: vectors differ`)
+                    break
+                }
+            }
+        } else {
+            ++nbRejected
+        }
+    })
+
+    expect(differ.slice(0, 10)).toEqual([])
+    // Both outcomes are covered by the grid
+    expect(nbAccepted).toBeGreaterThan(10000)
+    expect(nbRejected).toBeGreaterThan(10000)
+})
+
+test('data files are converted in one batch', () => {
+    const lines = [
+        '1;Striated Plane;45;60;SE;0;NE;;RL',
+        '2;Striated Plane;45;30;SE;4;SW;;RL',
+        '3;Striated Plane;135;60;NE;6;SE;;LL',
+        '4;Striated Plane;30;20;SE;;;100;N',
+        '5;Striated Plane;30;60;SE;40;N;;N_RL',
+        '6;Extension Fracture;120;90;W'
+    ]
+    const toks = lines.map(l => l.split(';'))
+    const batch = new FaultVectorBatch(toks)
+    const inBatch = toks.map((t, i) => {
+        batch.seek(i)
+        return batch.get(t) !== undefined
+    })
+    // Wrong type of movement, and not a striated plane
+    expect(inBatch).toEqual([true, true, true, true, false, false])
+    // Only the current line is given
+    expect(batch.get(toks[0])).toBeUndefined()
+
+    // The datum of a line in the batch does not read the line again
+    const line = lines[0].split(';')
+    const single = new FaultVectorBatch([line])
+    line[2] = line[3] = 'not read'
+    single.seek(0)
+    const d = DataFactory.create('Striated Plane')
+    expect(d.initialize([line], single).status).toBe(true)
+    expect((d as any).nPlane).toEqual(single.get(line).normal)
+    // Without the batch, the datum reads the line (and fails on its strike)
+    expect(() => DataFactory.create('Striated Plane').initialize([line])).toThrow()
+
+    // Same data and messages as with FaultHelper, datum by datum
+    const { data, messages } = readDataset(lines.slice(0, 5).join('\n'))
+    expect(data.length).toBe(4)
+    expect(messages.length).toBe(1)
+    expect(messages[0]).toContain('Data number 5')
+    for (let i = 0; i < 4; ++i) {
+        const d = DataFactory.create(toks[i][1])
+        d.initialize([toks[i]])
+        const a = d as any, b = data[i] as any
+        for (let k = 0; k < 3; ++k) {
+            expect(b.nPlane[k]).toBeCloseTo(a.nPlane[k], 12)
+            expect(b.nStriation[k]).toBeCloseTo(a.nStriation[k], 12)
+            expect(b.nPerpStriation[k]).toBeCloseTo(a.nPerpStriation[k], 12)
+        }
+    }
+})
@@ -0,0 +1,75 @@
+import { computeTractions, createTractionColumns, HomogeneousEngine } from "../../lib/geomeca"
+import { newMatrix3x3Identity, Vector3 } from "../../lib"
+import { faultStressComponents } from "../../lib"
+import { PackedDataset, PackedStriatedPlanes, StriatedPlaneFriction1, StriatedPlaneKin, StriatedPlaneMisfit, striatedPlaneMisfit } from "../../lib/data"
+import { readDataset } from "../../lib/io"
+
+test('batched tractions match faultStressComponents', () => {
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(newMatrix3x3Identity(), 0.3)
+
+    const c = Math.SQRT1_2
+    const n: Vector3 = [c, 0, c]
+    const s: Vector3 = [c, 0, -c]
+    const p: Vector3 = [0, 1, 0]
+
+    const out = createTractionColumns(1)
+    computeTractions(engine.S(), new Float64Array(n), new Float64Array(s), new Float64Array(p), out)
+
+    const { shearStress, normalStress, shearStressMag } = faultStressComponents({ stressTensor: engine.S(), normal: n })
+    expect(out.normalStress[0]).toBeCloseTo(normalStress)
+    expect(out.shearMag[0]).toBeCloseTo(shearStressMag)
+    expect(out.shearStriation[0]).toBeCloseTo(shearStress[0] * s[0] + shearStress[1] * s[1] + shearStress[2] * s[2])
+    expect(out.shearPerp[0]).toBeCloseTo(0)
+})
+
+const faults = [
+    '1;Striated Plane;45;60;SE;0;NE;;RL',
+    '2;Striated Plane;45;30;SE;4;SW;;RL',
+    '3;Striated Plane;135;60;NE;6;SE;;LL',
+    '4;Striated Plane;135;40;SW;1;SE;;LL'
+].join('\n')
+
+test('friction data are read with the rock parameters of the file', () => {
+    const { data, messages } = readDataset(faults, { type: 'Striated Plane Friction1', friction: 0.5, cohesion: 0.1, weightFriction: 2 })
+    expect(messages.length).toBe(0)
+    expect(data.length).toBe(4)
+    data.forEach(d => {
+        expect(d).toBeInstanceOf(StriatedPlaneFriction1)
+        const f = d as StriatedPlaneFriction1
+        expect(f.frictionAngleRock).toBe(0.5)
+        expect(f.cohesionRock).toBe(0.1)
+        expect(f.weightFriction).toBe(2)
+    })
+
+    // Without friction angle the data are packed (see MonteCarloFriction), but cannot be evaluated
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(newMatrix3x3Identity(), 0.5)
+    const unset = new PackedDataset(readDataset(faults, { type: 'Striated Plane Friction1' }).data)
+    expect(() => unset.cost(engine)).toThrow()
+    expect(new PackedDataset(data).cost(engine)).toBeGreaterThanOrEqual(0)
+})
+
+test('friction misfits match the batched kernel', () => {
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress([[0.8, 0.6, 0], [-0.6, 0.8, 0], [0, 0, 1]], 0.4)
+    const stress = engine.stress(undefined)
+
+    const cases: [string, StriatedPlaneMisfit][] = [['Striated Plane Friction1', StriatedPlaneMisfit.FRICTION_1], ['Striated Plane Friction2', StriatedPlaneMisfit.FRICTION_2]]
+    for (const [type, kind] of cases) {
+        const { data } = readDataset(faults, { type, friction: 0.6, cohesion: 0.2, weightFriction: 1.5 })
+        const planes = PackedStriatedPlanes.pack(data as StriatedPlaneKin[])
+        const t = createTractionColumns(planes.count)
+        computeTractions(stress.S, planes.normals, planes.striations, planes.perpStriations, t)
+
+        let sum = 0
+        data.forEach((d, i) => {
+            expect(planes.kind[i]).toBe(kind)
+            const expected = striatedPlaneMisfit(kind, planes.oriented[i] === 1, t.normalStress[i], t.shearStriation[i], t.shearPerp[i], t.shearMag[i], 0.2, 0.6, 1.5)
+            expect(d.cost({ stress })).toBeCloseTo(expected, 12)
+            sum += expected
+        })
+        expect(planes.sumCosts(stress)).toBeCloseTo(sum, 12)
+        expect(new PackedDataset(data).cost(engine)).toBeCloseTo(sum / data.length, 12)
+    }
+})
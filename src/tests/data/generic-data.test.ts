@@ -0,0 +1,68 @@
+import { GenericData, GenericKernel, PackedDataset } from "../../lib/data"
+import { GradientEngine, HomogeneousEngine } from "../../lib/geomeca"
+import { normalizeVector, properRotationTensor, Vector3 } from "../../lib/types"
+
+function makeData(kernel: GenericKernel, n: number): GenericData[] {
+    const data: GenericData[] = []
+    for (let i = 0; i < n; ++i) {
+        const v = normalizeVector([Math.sin(i), Math.cos(3 * i), Math.sin(5 * i + 1)] as Vector3)
+        data.push(new GenericData(kernel, { nx: v[0], ny: v[1], nz: v[2], measured: -0.5 + 0.1 * Math.cos(i) }))
+    }
+    return data
+}
+
+test('compiled expression matches a plain function', () => {
+    const columns = ['nx', 'ny', 'nz', 'measured']
+    const compiled = GenericKernel.compile('abs(sn(nx, ny, nz) - measured) + 0.5 * tau(nx, ny, nz)^2', columns)
+    const plain = GenericKernel.fromFunction(columns, (v, stress) => {
+        const S = stress.S
+        const t = [0, 1, 2].map(k => S[k][0] * v[0] + S[k][1] * v[1] + S[k][2] * v[2])
+        const sn = t[0] * v[0] + t[1] * v[1] + t[2] * v[2]
+        return Math.abs(sn - v[3]) + 0.5 * (t[0] ** 2 + t[1] ** 2 + t[2] ** 2 - sn * sn)
+    })
+    expect(compiled.compiled).toBe(true)
+    expect(plain.compiled).toBe(false)
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 }), 0.3)
+    const stress = engine.stress(undefined)
+
+    const a = makeData(compiled, 50)
+    const b = makeData(plain, 50)
+    a.forEach((d, i) => expect(d.cost({ stress })).toBeCloseTo(b[i].cost({ stress }), 10))
+
+    const mean = a.reduce((s, d) => s + d.cost({ stress }), 0) / a.length
+    const packed = new PackedDataset(a)
+    expect(packed.genericData.length).toBe(1)
+    expect(packed.cost(engine)).toBeCloseTo(mean, 10)
+    expect(new PackedDataset(b).cost(engine)).toBeCloseTo(mean, 10)
+})
+
+test('invalid expressions are rejected', () => {
+    expect(() => GenericKernel.compile('nx + foo', ['nx'])).toThrow()
+    expect(() => GenericKernel.compile('alert(nx)', ['nx'])).toThrow()
+    expect(() => GenericKernel.compile('nx +', ['nx'])).toThrow()
+    expect(() => GenericKernel.compile('nx', ['sxx'])).toThrow()
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: [0, 0, 1], angle: 0 }), 0.3)
+    const stress = engine.stress(undefined)
+    expect(GenericKernel.compile('-2^2 - s1', ['nx']).cost(new Float64Array(1), stress)).toBeCloseTo(-4 - stress.s1_X)
+})
+
+test('principal stresses of the expressions with both engines', () => {
+    const Hrot = properRotationTensor({ nRot: normalizeVector([0.3, 1.1, 0.7]), angle: 0.8 })
+    const kernel = GenericKernel.compile('s1 + 10 * s2 + 100 * s3', ['nx'])
+    const homogeneous = new HomogeneousEngine()
+    const field = new GradientEngine()
+    homogeneous.setHypotheticalStress(Hrot, 0.4)
+    field.setHypotheticalStress(Hrot, 0.4)
+
+    // sigma_1 = -1, sigma_2 = -R and sigma_3 = 0
+    for (const engine of [homogeneous, field]) {
+        const stress = engine.stress([0, 0, 0])
+        expect(stress.s2_Z).toBeCloseTo(-0.4)
+        expect(stress.s3_Y).toBeCloseTo(0)
+        expect(kernel.cost(new Float64Array(1), stress)).toBeCloseTo(-1 - 10 * 0.4)
+    }
+})
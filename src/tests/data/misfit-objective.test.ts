@@ -0,0 +1,106 @@
+import { MisfitObjectiveType, PackedDataset, reduceMisfits } from "../../lib/data"
+import { HomogeneousEngine } from "../../lib/geomeca"
+import { normalizeVector, properRotationTensor } from "../../lib/types"
+import { createPlanes } from "../synthetic-data"
+
+// Reference implementations with a sort
+function sortedTrimmedMean(m: number[], w: number[], trim: number): number {
+    const idx = m.map((_, i) => i).sort((a, b) => m[a] - m[b])
+    const target = (1 - trim) * w.reduce((a, v) => a + v, 0)
+    let acc = 0, sum = 0
+    for (const i of idx) {
+        const take = Math.min(w[i], target - acc)
+        if (take <= 0) break
+        sum += take * m[i]
+        acc += take
+    }
+    return sum / target
+}
+
+function sortedQuantile(m: number[], w: number[], q: number): number {
+    const idx = m.map((_, i) => i).sort((a, b) => m[a] - m[b])
+    const target = q * w.reduce((a, v) => a + v, 0)
+    let acc = 0
+    for (const i of idx) {
+        acc += w[i]
+        if (acc >= target) return m[i]
+    }
+    return m[idx[idx.length - 1]]
+}
+
+test('robust reductions match the sorted references', () => {
+    for (const n of [1, 2, 7, 100, 1001]) {
+        const m: number[] = [], w: number[] = []
+        for (let i = 0; i < n; ++i) {
+            // A few ties
+            m.push(i % 5 === 0 ? 0.5 : Math.abs(Math.sin(17.3 * i)))
+            w.push(1 + (i % 3))
+        }
+        const misfits = Float64Array.from(m), weights = Float64Array.from(w)
+        const total = w.reduce((a, v) => a + v, 0)
+        const order = new Int32Array(n)
+
+        for (const trim of [0, 0.1, 0.5, 0.9]) {
+            expect(reduceMisfits({ type: MisfitObjectiveType.TRIMMED_MEAN, trim }, misfits, weights, n, total, order)).toBeCloseTo(sortedTrimmedMean(m, w, trim), 12)
+        }
+        for (const quantile of [0, 0.25, 0.5, 1]) {
+            expect(reduceMisfits({ type: MisfitObjectiveType.QUANTILE, quantile }, misfits, weights, n, total, order)).toBeCloseTo(sortedQuantile(m, w, quantile), 12)
+        }
+        const delta = 0.3
+        const huber = m.reduce((a, v, i) => a + w[i] * (v <= delta ? v * v / 2 : delta * (v - delta / 2)), 0) / total
+        expect(reduceMisfits({ type: MisfitObjectiveType.HUBER, delta }, misfits, weights, n, total, order)).toBeCloseTo(huber, 12)
+        // The misfits are unchanged
+        expect(Array.from(misfits)).toEqual(m)
+    }
+})
+
+test('robust objectives of a packed dataset with outliers', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(Wtrue, 0.3)
+    // Outliers: the striation of every tenth plane is reversed
+    const data = createPlanes(Wtrue, 0.3, 200, { reversed: i => i % 10 === 0 })
+
+    const packed = new PackedDataset(data)
+    const mean = packed.cost(engine)
+    expect(mean).toBeCloseTo(Math.PI / 10, 6)
+
+    packed.setObjective({ type: MisfitObjectiveType.TRIMMED_MEAN, trim: 0.15 })
+    expect(packed.cost(engine)).toBeCloseTo(0, 6)
+    packed.setObjective({ type: MisfitObjectiveType.QUANTILE, quantile: 0.5 })
+    expect(packed.cost(engine)).toBeCloseTo(0, 6)
+
+    // Early abandon: any value above the bound when the misfit is not below it, the exact misfit otherwise
+    packed.setObjective({ type: MisfitObjectiveType.MEAN })
+    expect(packed.cost(engine, 0.1)).toBeGreaterThan(0.1 - 1e-12)
+    expect(packed.cost(engine, 1)).toBeCloseTo(mean, 12)
+
+    expect(() => packed.setObjective({ type: MisfitObjectiveType.TRIMMED_MEAN, trim: 1 })).toThrow()
+    expect(() => new PackedDataset(data, { objective: { type: MisfitObjectiveType.HUBER, delta: 0 } })).toThrow()
+})
+
+test('robust objectives of striated planes abandon by chunks', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const Wfar = properRotationTensor({ nRot: normalizeVector([-2, 1, 1]), angle: 2.3 })
+    const engine = new HomogeneousEngine()
+    const data = createPlanes(Wtrue, 0.3, 2000)
+
+    for (const objective of [
+        { type: MisfitObjectiveType.QUANTILE, quantile: 0.5 },
+        { type: MisfitObjectiveType.HUBER, delta: 0.1 }
+    ]) {
+        const packed = new PackedDataset(data, { objective })
+        engine.setHypotheticalStress(Wfar, 0.3)
+        const exact = packed.cost(engine)
+        expect(packed.cost(engine, exact + 1e-6)).toBeCloseTo(exact, 12)
+
+        // The misfits of the true stress are 0: only the first chunks are overwritten by the abandoned evaluation
+        engine.setHypotheticalStress(Wtrue, 0.3)
+        expect(packed.cost(engine)).toBeCloseTo(0, 6)
+        engine.setHypotheticalStress(Wfar, 0.3)
+        expect(packed.cost(engine, exact / 10)).toBeGreaterThan(exact / 10 - 1e-12)
+        const misfits = (packed as any).misfits_ as Float64Array
+        expect(misfits[0]).toBeGreaterThan(0)
+        expect(misfits[misfits.length - 1]).toBeCloseTo(0, 6)
+    }
+})
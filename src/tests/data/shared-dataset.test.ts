@@ -0,0 +1,86 @@
+import { EvaluationCache, GenericData, GenericKernel, MisfitObjectiveType, PackedDataset } from "../../lib/data"
+import { HomogeneousEngine } from "../../lib/geomeca"
+import { crossProduct, normalizeVector, properRotationTensor, Vector3 } from "../../lib/types"
+import { createPlane, createPlanes } from "../synthetic-data"
+
+test('attached dataset shares the columns and gives the same misfit', () => {
+    const kernel = GenericKernel.compile('abs(sn(nx, ny, nz) - measured)', ['nx', 'ny', 'nz', 'measured'])
+    const data = []
+    for (let i = 0; i < 100; ++i) {
+        const n = normalizeVector([Math.sin(i), Math.cos(3 * i), Math.sin(7 * i + 1)] as Vector3)
+        const s = normalizeVector(crossProduct({ U: n, V: [0, 0, 1] }))
+        data.push(createPlane(n, s))
+        data.push(new GenericData(kernel, [n[0], n[1], n[2], -0.5]))
+    }
+
+    const packed = new PackedDataset(data, { shared: true })
+    const handle = packed.share()
+    const attached = new PackedDataset(handle)
+    expect(attached.size).toBe(data.length)
+    expect(attached.striatedPlanes.normals.buffer).toBe(packed.striatedPlanes.normals.buffer)
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 }), 0.3)
+    expect(attached.cost(engine)).toBeCloseTo(packed.cost(engine), 12)
+
+    // Not packed with the shared option
+    expect(() => new PackedDataset(data).share()).toThrow()
+})
+
+test('attached dataset sees the weights set on the shared dataset', () => {
+    const data = createPlanes(properRotationTensor({ nRot: [0, 0, 1], angle: 0.4 }), 0.6, 50, { reversed: i => i % 5 === 0 })
+    const packed = new PackedDataset(data, { shared: true })
+    const attached = new PackedDataset(packed.share())
+    attached.setCache(new EvaluationCache())
+    const robust = new PackedDataset(packed.share(), { objective: { type: MisfitObjectiveType.QUANTILE, quantile: 0.5 } })
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 }), 0.3)
+    expect(attached.cost(engine)).toBeCloseTo(packed.cost(engine), 12)
+    robust.cost(engine)
+
+    // Only the outliers keep a weight: the sum of the weights, the cache and the robust scratch follow the shared dataset
+    packed.setWeights(data.map((_, i) => i % 5 === 0 ? 2 : 0))
+    expect(attached.totalWeight).toBe(20)
+    expect(attached.cost(engine)).toBeCloseTo(packed.cost(engine), 12)
+    packed.setObjective({ type: MisfitObjectiveType.QUANTILE, quantile: 0.5 })
+    expect(robust.cost(engine)).toBeCloseTo(packed.cost(engine), 12)
+
+    // The attached datasets cannot change the shared weights
+    expect(() => attached.setWeights(data.map(() => 1))).toThrow()
+})
+
+test('rows of an attached dataset are copied with their own weights', () => {
+    const kernel = GenericKernel.compile('abs(sn(nx, ny, nz) - measured)', ['nx', 'ny', 'nz', 'measured'])
+    const data = []
+    for (let i = 0; i < 100; ++i) {
+        const n = normalizeVector([Math.sin(i), Math.cos(3 * i), Math.sin(7 * i + 1)] as Vector3)
+        const s = normalizeVector(crossProduct({ U: n, V: [0, 0, 1] }))
+        data.push(createPlane(n, s))
+        data.push(new GenericData(kernel, [n[0], n[1], n[2], -0.5 + 0.01 * i]))
+    }
+    const objective = { type: MisfitObjectiveType.QUANTILE, quantile: 0.5 }
+    const packed = new PackedDataset(data, { shared: true, objective })
+    const attached = new PackedDataset(packed.share(), { objective })
+
+    // Every third row, in the packed order, with a weight of its own
+    const rows = Array.from({ length: 67 }, (_, k) => (3 * k * 7) % data.length)
+    const weights = rows.map((_, k) => 1 + k % 4)
+    const sub = attached.subsetPacked(rows, weights)
+    const expected = packed.subset(rows.map(r => packed.packedOrder[r]), weights)
+    expect(sub.size).toBe(rows.length)
+    expect(sub.totalWeight).toBe(expected.totalWeight)
+    expect(sub.objective).toEqual(objective)
+    expect(Array.from(sub.positions)).toEqual(Array.from(expected.positions))
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 }), 0.3)
+    expect(sub.cost(engine)).toBeCloseTo(expected.cost(engine), 12)
+    sub.setObjective({ type: MisfitObjectiveType.MEAN })
+    expected.setObjective({ type: MisfitObjectiveType.MEAN })
+    expect(sub.cost(engine)).toBeCloseTo(expected.cost(engine), 12)
+
+    // The shared columns are left untouched
+    expect(attached.totalWeight).toBe(data.length)
+    expect(() => attached.subsetPacked(rows, [1])).toThrow()
+})
@@ -0,0 +1,67 @@
+import { PackedDataset } from "../../lib/data"
+import { GradientEngine, HomogeneousEngine } from "../../lib/geomeca"
+import { InverseMethod } from "../../lib/InverseMethod"
+import { MonteCarlo } from "../../lib/search"
+import { normalizeVector, properRotationTensor } from "../../lib/types"
+import { createPlanes } from "../synthetic-data"
+
+const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+
+test('single precision ranks the stress tensors as double precision', () => {
+    const data = createPlanes(Wtrue, 0.3, 1000)
+    const packed = new PackedDataset(data, { singlePrecision: true })
+    const engine = new HomogeneousEngine()
+
+    const stresses = []
+    for (let i = 0; i < 50; ++i) {
+        stresses.push({ rot: properRotationTensor({ nRot: normalizeVector([Math.sin(i), Math.cos(2 * i), 1]), angle: 0.05 * i }), stressRatio: (i % 10) / 10 })
+    }
+    const check = packed.checkSinglePrecision(engine, stresses)
+    expect(check.maxError).toBeLessThan(1e-6)
+    expect(check.rankCorrelation).toBe(1)
+    expect(check.sameBest).toBe(true)
+    expect(packed.singlePrecision).toBe(true)
+
+    engine.setHypotheticalStress(stresses[7].rot, stresses[7].stressRatio)
+    expect(packed.cost(engine)).toBeCloseTo(new PackedDataset(data).cost(engine), 6)
+    expect(packed.exactCost(engine)).toBe(new PackedDataset(data).cost(engine))
+})
+
+test('the solution of a single precision inversion is evaluated in double precision', () => {
+    const data = createPlanes(Wtrue, 0.3, 300)
+    const inv = new InverseMethod()
+    inv.addData(data)
+    inv.setSearchMethod(new MonteCarlo({ nbRandomTrials: 500, seed: 1 }))
+    inv.setSinglePrecision(true)
+    const solution = inv.run()
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+    expect(solution.misfit).toBe(new PackedDataset(data).cost(engine))
+})
+
+test('the single precision columns are built once and shared with the attached datasets', () => {
+    const data = createPlanes(Wtrue, 0.3, 500)
+    const packed = new PackedDataset(data, { shared: true, singlePrecision: true })
+    const handle = packed.share()
+    expect(handle.striatedPlanes32).toBe(packed.striatedPlanes.buffer32)
+
+    const attached = new PackedDataset(handle, { singlePrecision: true })
+    expect(attached.striatedPlanes.buffer32).toBe(handle.striatedPlanes32)
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(Wtrue, 0.4)
+    expect(attached.cost(engine)).toBe(packed.cost(engine))
+    expect(attached.exactCost(engine)).toBe(packed.exactCost(engine))
+
+    // The columns cannot be built by an attached dataset
+    const double = new PackedDataset(data, { shared: true })
+    expect(() => new PackedDataset(double.share(), { singlePrecision: true })).toThrow()
+})
+
+test('the field evaluations stay in double precision', () => {
+    const data = createPlanes(Wtrue, 0.3, 200)
+    const field = new GradientEngine()
+    field.setHypotheticalStress(Wtrue, 0.4)
+    const single = new PackedDataset(data, { singlePrecision: true })
+    expect(single.cost(field)).toBe(new PackedDataset(data).cost(field))
+})
@@ -0,0 +1,56 @@
+import { Data, Point3D, SpatialIndex, windowCenters } from "../../lib"
+import { readDataset } from "../../lib/io"
+
+test('spatial index radius query matches brute force', () => {
+    const data = [] as Data[]
+    for (let i = 0; i < 500; ++i) {
+        const position: Point3D = [(i * 37) % 101, (i * 53) % 97, 0]
+        data.push({ position } as Data)
+    }
+    const index = new SpatialIndex(data)
+
+    const center: Point3D = [50, 40, 0]
+    const ids = index.queryRadius(center, 20).sort((a, b) => a - b)
+    const expected = data.map((d, i) => i).filter(i => {
+        const p = data[i].position
+        return (p[0] - center[0]) ** 2 + (p[1] - center[1]) ** 2 <= 400
+    })
+    expect(ids).toEqual(expected)
+})
+
+test('window centers are ordered as a serpentine', () => {
+    const centers = windowCenters([0, 0, 0], [2, 1, 0], [3, 2, 1])
+    expect(centers.map(c => c[0])).toEqual([0, 1, 2, 2, 1, 0])
+    expect(centers.map(c => c[1])).toEqual([0, 0, 0, 1, 1, 1])
+})
+
+test('positions are read in the same columns for all the data types', () => {
+    // x, y, z in columns 21, 22 and 23 (see file-format.md)
+    const line = (start: string, x: number, y: number) => {
+        const toks = start.split(';')
+        return [...toks, ...new Array(21 - toks.length).fill(''), x, y, -10].join(';')
+    }
+    const lines = [
+        line('1;Striated Plane;45;60;SE;0;NE;;RL', 0, 0),
+        line('2;Extension Fracture;120;90;', 100, 0),
+        line('3;Stylolite Interface;30;90;', 0, 100),
+        line('4;Striated Plane;135;60;NE;6;SE;;LL', 100, 100),
+        line('5;Stylolite Interface;75;30;NW', 1000, 1000)
+    ]
+    expect(lines[0].split(';').length).toBe(24)
+    const { data, messages } = readDataset(lines.join('\n'))
+    expect(messages).toEqual([])
+    expect(data.map(d => [...d.position])).toEqual([[0, 0, -10], [100, 0, -10], [0, 100, -10], [100, 100, -10], [1000, 1000, -10]])
+
+    // One window holds the first four data, whatever their type
+    const index = new SpatialIndex(data)
+    expect(index.queryRadius([50, 50, -10], 75).sort((a, b) => a - b)).toEqual([0, 1, 2, 3])
+
+    // A wrong coordinate is reported for every type
+    const wrong = ['Striated Plane;45;60;SE;0;NE;;RL', 'Extension Fracture;120;90;', 'Stylolite Interface;30;90;']
+        .map((start, i) => readDataset(line(`${i + 6};${start}`, 0, 0).replace(';-10', ';abc')).messages)
+    wrong.forEach(messages => {
+        expect(messages.length).toBe(1)
+        expect(messages[0]).toContain('col 23')
+    })
+})
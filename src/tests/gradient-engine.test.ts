@@ -0,0 +1,40 @@
+import { GradientEngine, HomogeneousEngine } from "../lib/geomeca"
+import { Matrix3x3, normalizeVector, properRotationTensor } from "../lib"
+
+const Hrot: Matrix3x3 = properRotationTensor({ nRot: normalizeVector([0.3, 1.1, 0.7]), angle: 0.8 })
+
+test('gradient engine without gradient is the homogeneous engine', () => {
+    const homogeneous = new HomogeneousEngine()
+    const field = new GradientEngine()
+    homogeneous.setHypotheticalStress(Hrot, 0.4)
+    field.setHypotheticalStress(Hrot, 0.4)
+
+    field.evaluate(new Float64Array([1, 2, 3, -5, 0, 8]))
+    field.decompose(0, 2)
+    const a = homogeneous.stress(undefined)
+    for (let i = 0; i < 2; ++i) {
+        const b = field.stressAt(i)
+        expect(b.s1_X).toBeCloseTo(-1)
+        expect(b.s3_Y).toBeCloseTo(0)
+        expect(b.s2_Z).toBeCloseTo(-0.4)
+        for (let k = 0; k < 3; ++k) {
+            expect(Math.abs(b.S1_X[k])).toBeCloseTo(Math.abs(a.S1_X[k]))
+            expect(Math.abs(b.S3_Y[k])).toBeCloseTo(Math.abs(a.S3_Y[k]))
+            for (let l = 0; l < 3; ++l) {
+                expect(b.S[k][l]).toBeCloseTo(a.S[k][l])
+            }
+        }
+    }
+})
+
+test('gradient engine evaluates a linear field', () => {
+    const field = new GradientEngine({
+        origin: [0, 0, 10],
+        gradientZ: [[-0.1, 0, 0], [0, -0.1, 0], [0, 0, -0.1]]
+    })
+    field.setHypotheticalStress(Hrot, 0.4)
+    const s = field.stress([0, 0, 0])
+    expect(s.s1_X).toBeCloseTo(0)
+    expect(s.s3_Y).toBeCloseTo(1)
+    expect(s.s2_Z).toBeCloseTo(0.6)
+})
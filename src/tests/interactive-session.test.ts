@@ -0,0 +1,50 @@
+import { InteractiveSession } from "../lib"
+import { PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { crossProduct, normalizeVector, properRotationTensor, Vector3 } from "../lib/types"
+import { createPlane } from "./synthetic-data"
+
+test('incremental updates match a full evaluation', () => {
+    const normals: Vector3[] = [[1, 0.2, 0.5], [0.1, 1, 0.7], [-0.4, 0.3, 1], [0.8, -0.6, 0.2], [0.3, 0.5, -0.9]]
+    const planes = normals.map(v => {
+        const n = normalizeVector(v)
+        const s = normalizeVector(crossProduct({ U: n, V: [0, 0, 1] }))
+        return createPlane(n, s)
+    })
+    const packed = new PackedDataset(planes)
+    const session = new InteractiveSession(packed, { nbBins: 12 })
+    const engine = new HomogeneousEngine()
+
+    const Hrot = properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 })
+    session.update(Hrot, 0.2)
+    for (const R of [0.2, 0.5, 0.9]) {
+        session.setStressRatio(R)
+        engine.setHypotheticalStress(Hrot, R)
+        expect(session.misfit).toBeCloseTo(packed.cost(engine), 10)
+        planes.forEach((p, i) => expect(session.misfits[i]).toBeCloseTo(p.cost({ stress: engine.stress(undefined) }), 10))
+        expect(session.histogram.reduce((a, b) => a + b, 0)).toBe(planes.length)
+    }
+})
+
+test('angular misfits of unoriented striations without arccosine', () => {
+    const planes = [0, 1, 2, 3, 4, 5, 6, 7].map(i => {
+        const n = normalizeVector([Math.sin(i + 0.3), Math.cos(2 * i), 0.5 + i / 8] as Vector3)
+        const s = normalizeVector(crossProduct({ U: n, V: [0, 0, 1] }))
+        const p = createPlane(n, s)
+        // The sense of the striation is unknown for half of the planes
+        ;(p as any).oriented = i % 2 === 0
+        return p
+    })
+    const session = new InteractiveSession(planes)
+    const engine = new HomogeneousEngine()
+    const Hrot = properRotationTensor({ nRot: normalizeVector([2, 1, -1]), angle: 1.3 })
+    session.update(Hrot, 0.4)
+    for (const R of [0, 0.4, 1]) {
+        session.setStressRatio(R)
+        engine.setHypotheticalStress(Hrot, R)
+        planes.forEach((p, i) => {
+            expect(session.misfits[i]).toBeCloseTo(p.cost({ stress: engine.stress(undefined) }), 12)
+            expect(Math.abs(session.deviations[i]) * Math.PI / 180).toBeCloseTo(session.misfits[i], 12)
+        })
+    }
+})
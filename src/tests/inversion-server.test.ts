@@ -0,0 +1,190 @@
+/**
+ * @jest-environment node
+ */
+import { mkdirSync, mkdtempSync, symlinkSync, writeFileSync } from "fs"
+import { AddressInfo } from "net"
+import { tmpdir } from "os"
+import { join } from "path"
+import { PassThrough } from "stream"
+import { InversionJobEvent, InversionServer, JobQueue } from "../lib/server"
+
+const csv = [
+    '1;Striated Plane;45;60;SE;0;NE;;RL',
+    '2;Striated Plane;45;30;SE;4;SW;;RL',
+    '3;Striated Plane;135;60;NE;6;SE;;LL',
+    '4;Striated Plane;135;40;SW;1;SE;;LL'
+].join('\n')
+
+test('job queue orders by priority then submission', () => {
+    const q = new JobQueue<string>()
+    q.push('a', 0)
+    q.push('b', 2)
+    q.push('c', 0)
+    q.push('d', 2)
+    expect([q.pop(), q.pop(), q.pop(), q.pop(), q.pop()]).toEqual(['b', 'd', 'a', 'c', undefined])
+})
+
+test('server streams results and caches datasets', async () => {
+    const input = new PassThrough()
+    const output = new PassThrough()
+    const events: InversionJobEvent[] = []
+    output.on('data', chunk => chunk.toString().split('\n').filter((l: string) => l.length > 0).forEach((l: string) => events.push(JSON.parse(l))))
+
+    const server = new InversionServer()
+    const log = console.log
+    const done = server.serveStdio(input, output)
+    // The events are only written on output
+    expect(console.log).toBe(log)
+    const search = { params: { nbRandomTrials: 50 } }
+    input.write(JSON.stringify({ id: 1, data: csv, search }) + '\n')
+    input.write(JSON.stringify({ id: 2, data: csv, search, priority: 5 }) + '\n')
+    input.write('not json\n')
+    input.end()
+    await done
+    await new Promise(resolve => setImmediate(resolve))
+
+    const finished = events.filter(e => e.status === 'done')
+    expect(finished.map(e => e.id)).toEqual([2, 1])
+    expect(finished[0].cached).toBe(false)
+    expect(finished[1].cached).toBe(true)
+    expect(finished[0].nbData).toBe(4)
+    expect(finished[0].solution.misfit).toBeLessThan(Math.PI)
+    expect(events.filter(e => e.status === 'error').length).toBe(1)
+})
+
+test('server runs one inversion per deformation phase', async () => {
+    const phased = [
+        '1;Striated Plane;45;60;SE;0;NE;;RL;;;1',
+        '2;Striated Plane;45;30;SE;4;SW;;RL;;;2',
+        '3;Striated Plane;135;60;NE;6;SE;;LL;;;1',
+        '4;Striated Plane;135;40;SW;1;SE;;LL;;;2',
+        '5;Striated Plane;90;50;S;2;E;;RL;;;2',
+        '6;Striated Plane;90;50;S;2;E;;RL;;;x',
+        '7;Striated Plane;90;50;S;2;E;;RL;;;1.5',
+        '8;Striated Plane;90;50;S;2;E;;RL;;;2abc'
+    ].join('\n')
+    const events: InversionJobEvent[] = []
+    const server = new InversionServer()
+    server.submit({ id: 1, data: phased, byPhase: true, search: { params: { nbRandomTrials: 50 } } }, e => events.push(e))
+    await server.drain()
+
+    const done = events.find(e => e.status === 'done')
+    expect(done.solution).toBeUndefined()
+    expect(done.nbData).toBe(5)
+    expect(done.messages.length).toBe(3)
+    done.messages.forEach(m => expect(m).toContain('invalid deformation phase'))
+    expect(done.phases.map(p => [p.phase, p.nbData])).toEqual([[1, 2], [2, 3]])
+    done.phases.forEach(p => expect(p.solution.misfit).toBeLessThan(Math.PI))
+})
+
+test('server runs the phases of a job concurrently in the workers', async () => {
+    const phased = [
+        '1;Striated Plane;45;60;SE;0;NE;;RL;;;1',
+        '2;Striated Plane;45;30;SE;4;SW;;RL;;;2',
+        '3;Striated Plane;135;60;NE;6;SE;;LL;;;1',
+        '4;Striated Plane;135;40;SW;1;SE;;LL;;;2',
+        '5;Striated Plane;90;50;S;2;E;;RL;;;2'
+    ].join('\n')
+    const server = new InversionServer({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    const internals = server as any
+    const events: InversionJobEvent[] = []
+    try {
+        server.submit({ id: 1, data: phased, byPhase: true, search: { params: { nbRandomTrials: 50 } } }, e => events.push(e))
+        await new Promise(resolve => setImmediate(resolve))
+        // One phase per worker, at the same time
+        expect(internals.running.size).toBe(2)
+        const running = Array.from(internals.running.values()).map((task: any) => task.part.handle)
+        running.forEach(handle => expect(handle).toBeDefined())
+        await server.drain()
+
+        const done = events.filter(e => e.status === 'done')
+        expect(done.length).toBe(1)
+        expect(done[0].phases.map(p => [p.phase, p.nbData])).toEqual([[1, 2], [2, 3]])
+        done[0].phases.forEach(p => expect(p.solution.misfit).toBeLessThan(Math.PI))
+    } finally {
+        await server.close()
+    }
+})
+
+test('server only reads the files of its data root', async () => {
+    const dir = mkdtempSync(join(tmpdir(), 'stress-'))
+    const root = join(dir, 'root')
+    mkdirSync(root)
+    writeFileSync(join(root, 'faults.csv'), csv)
+    writeFileSync(join(dir, 'secret.csv'), csv)
+    symlinkSync(join(dir, 'secret.csv'), join(root, 'link.csv'))
+
+    const events: InversionJobEvent[] = []
+    const server = new InversionServer({ dataRoot: root })
+    const search = { params: { nbRandomTrials: 10 } }
+    server.submit({ id: 1, path: 'faults.csv', search }, e => events.push(e))
+    server.submit({ id: 2, path: '../secret.csv', search }, e => events.push(e))
+    server.submit({ id: 3, path: join(dir, 'secret.csv'), search }, e => events.push(e))
+    server.submit({ id: 4, path: 'link.csv', search }, e => events.push(e))
+    server.submit({ id: 5, path: 'missing.csv', search }, e => events.push(e))
+    await server.drain()
+
+    const status = (id: number) => events.filter(e => e.id === id && (e.status === 'done' || e.status === 'error'))[0].status
+    expect([1, 2, 3, 4, 5].map(status)).toEqual(['done', 'error', 'error', 'error', 'error'])
+    expect(events.find(e => e.id === 2 && e.status === 'error').message).toContain('outside')
+})
+
+test('server listens on the loopback interface by default', async () => {
+    const server = new InversionServer()
+    const socket = server.listen(0)
+    await new Promise(resolve => socket.on('listening', resolve))
+    expect((socket.address() as AddressInfo).address).toBe('127.0.0.1')
+    await new Promise(resolve => socket.close(resolve))
+})
+
+test('server runs the jobs in workers attached to the shared datasets', async () => {
+    const server = new InversionServer({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    const internals = server as any
+    const events: InversionJobEvent[] = []
+    const sink = (e: InversionJobEvent) => events.push(e)
+    const search = { params: { nbRandomTrials: 50 } }
+    try {
+        // Both jobs are dispatched to the workers, which attach the dataset (the second job hits the cache of the server)
+        server.submit({ id: 1, data: csv, search }, sink)
+        server.submit({ id: 2, data: csv, search }, sink)
+        await new Promise(resolve => setImmediate(resolve))
+        expect(internals.running.size).toBe(2)
+        internals.running.forEach((task: any) => expect(task.part.handle).toBeDefined())
+        await server.drain()
+
+        const done = events.filter(e => e.status === 'done')
+        expect(done.map(e => e.cached).sort()).toEqual([false, true])
+        done.forEach(e => {
+            expect(e.nbData).toBe(4)
+            expect(e.solution.misfit).toBeLessThan(Math.PI)
+        })
+
+        // A worker which fails while running a job is replaced, and the job reports the error
+        server.submit({ id: 3, data: csv, search }, sink)
+        await new Promise(resolve => setImmediate(resolve))
+        const [failed] = Array.from(internals.running.keys())
+        failed.emit('error', new Error('worker crashed'))
+        await server.drain()
+        expect(events.find(e => e.id === 3 && e.status === 'error').message).toBe('worker crashed')
+        expect(internals.workers.length).toBe(2)
+        expect(internals.workers.includes(failed)).toBe(false)
+
+        // Same for a worker which exits while running a job
+        server.submit({ id: 6, data: csv, search }, sink)
+        await new Promise(resolve => setImmediate(resolve))
+        const [exited] = Array.from(internals.running.keys())
+        await exited.terminate()
+        await server.drain()
+        expect(events.find(e => e.id === 6 && e.status === 'error').message).toMatch(/^The worker exited with code/)
+        expect(internals.workers.length).toBe(2)
+        expect(internals.workers.includes(exited)).toBe(false)
+
+        // The new worker runs the next jobs
+        server.submit({ id: 4, data: csv, search }, sink)
+        server.submit({ id: 5, data: csv, search }, sink)
+        await server.drain()
+        expect(events.filter(e => (e.id === 4 || e.id === 5) && e.status === 'done').length).toBe(2)
+    } finally {
+        await server.close()
+    }
+})
@@ -0,0 +1,45 @@
+import { PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { InverseMethod } from "../lib/InverseMethod"
+import { IterativeReweightedInversion, ReweightingFunction } from "../lib/IterativeReweightedInversion"
+import { MonteCarlo } from "../lib/search"
+import { normalizeVector, properRotationTensor } from "../lib/types"
+import { createPlanes } from "./synthetic-data"
+
+test('the weights of a packed dataset are changed in place', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const data = createPlanes(Wtrue, 0.3, 100, { reversed: i => i % 5 === 0 })
+    const weights = data.map((_, i) => 1 + Math.sin(i))
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([0, 1, 1]), angle: 0.4 }), 0.6)
+
+    const packed = new PackedDataset(data)
+    packed.setWeights(weights)
+    const reference = new PackedDataset(data, { weights })
+    expect(packed.totalWeight).toBeCloseTo(reference.totalWeight, 12)
+    expect(packed.cost(engine)).toBeCloseTo(reference.cost(engine), 12)
+    expect(() => packed.setWeights([1, 2])).toThrow()
+})
+
+test('iteratively reweighted inversion rejects the outliers', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const data = createPlanes(Wtrue, 0.3, 200, { reversed: i => i % 5 === 0 })
+
+    const inv = new InverseMethod()
+    inv.addData(data)
+    inv.setSearchMethod(new MonteCarlo({ nbRandomTrials: 2000, seed: 1 }))
+    const irls = new IterativeReweightedInversion(inv, { threshold: 1, weighting: ReweightingFunction.THRESHOLD, maxRounds: 6 })
+    const { solution, rounds, converged } = irls.run()
+
+    expect(converged).toBe(true)
+    expect(rounds.length).toBeGreaterThan(1)
+    // The first round uses the prior weights
+    expect(Array.from(rounds[0].weights).every(w => w === 1)).toBe(true)
+
+    // The reversed striae are rejected, (almost) all the others are kept
+    const weights = rounds[rounds.length - 1].weights
+    const kept = data.filter((_, i) => i % 5 !== 0 && weights[i] === 1).length
+    data.forEach((_, i) => i % 5 === 0 && expect(weights[i]).toBe(0))
+    expect(kept).toBeGreaterThan(150)
+    expect(solution.misfit).toBeLessThan(0.25)
+})
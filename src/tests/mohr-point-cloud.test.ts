@@ -0,0 +1,49 @@
+import { mohrPointCloud } from "../lib/analysis"
+import { DataFactory, PackedDataset, StriatedPlaneKin } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { crossProduct, normalizeVector, properRotationTensor, Vector3 } from "../lib/types"
+import { createPlane } from "./synthetic-data"
+
+test('Mohr points lie between the Mohr circles', () => {
+    const planes: StriatedPlaneKin[] = []
+    for (let i = 0; i < 200; ++i) {
+        const n = normalizeVector([Math.sin(i), Math.cos(3 * i), Math.sin(7 * i + 1)] as Vector3)
+        const s = normalizeVector(crossProduct({ U: n, V: [0, 0, 1] }))
+        planes.push(createPlane(n, s))
+    }
+
+    const engine = new HomogeneousEngine()
+    const R = 0.3
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, -2, 3]), angle: 0.7 }), R)
+    const packed = new PackedDataset(planes)
+    // The scratch of the dataset is not used
+    packed.striatedPlanes.tractions.normalStress.fill(7)
+    const cloud = mohrPointCloud({ stressTensorSolution: engine.S(), stressRatio: R }, packed)
+    expect(packed.striatedPlanes.tractions.normalStress.every(v => v === 7)).toBe(true)
+
+    expect(cloud.count).toBe(planes.length)
+    const c = cloud.circles
+    const inside = (k: number, x: number, y: number) => (x - c[2 * k]) ** 2 + y * y - c[2 * k + 1] ** 2
+    for (let i = 0; i < cloud.count; ++i) {
+        const x = cloud.points[2 * i], y = cloud.points[2 * i + 1]
+        expect(inside(0, x, y)).toBeLessThan(1e-6)
+        expect(inside(1, x, y)).toBeGreaterThan(-1e-6)
+        expect(inside(2, x, y)).toBeGreaterThan(-1e-6)
+    }
+})
+
+test('Mohr points are only computed for striated planes', () => {
+    const data = [DataFactory.create('Extension Fracture'), createPlane([0, 0, 1], [1, 0, 0]), createPlane([1, 0, 0], [0, 1, 0])]
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: [1, 0, 0], angle: 0.3 }), 0.5)
+    const solution = { stressTensorSolution: engine.S(), stressRatio: 0.5 }
+    const cloud = mohrPointCloud(solution, data)
+    expect(cloud.count).toBe(2)
+    expect(Array.from(cloud.skipped)).toEqual([0])
+
+    // The cloud is reused, and the points do not depend on the other data
+    const planes = mohrPointCloud(solution, data.slice(1))
+    expect(mohrPointCloud(solution, data, cloud)).toBe(cloud)
+    expect(Array.from(cloud.points.subarray(0, 4))).toEqual(Array.from(planes.points))
+    expect(planes.skipped.length).toBe(0)
+})
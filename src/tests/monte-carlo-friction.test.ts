@@ -0,0 +1,73 @@
+import { PackedDataset, StriatedPlaneKin } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { MonteCarloFriction } from "../lib/search"
+import { multiplyTensors, normalizeVector, properRotationTensor, tensor_x_Vector, Vector3 } from "../lib/types"
+import { createPlane, sequenceNormal, shearDirection } from "./synthetic-data"
+
+const deg = Math.PI / 180
+
+test('joint friction inversion recovers the stress tensor and the rock parameters', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const R = 0.7
+    const cohesion = 0.3
+    const frictionAngle = 10 * deg
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(Wtrue, R)
+    const S = engine.S()
+
+    // Normal stress (positive in compression) and shear stress of a plane
+    const mohr = (n: Vector3) => {
+        const t = tensor_x_Vector({ T: S, V: n })
+        const sn = t[0] * n[0] + t[1] * n[1] + t[2] * n[2]
+        return { sigma: -sn, tau: Math.sqrt(Math.max(0, t[0] * t[0] + t[1] * t[1] + t[2] * t[2] - sn * sn)) }
+    }
+    // Normal of a plane located at (sigma, tau) in the Mohr diagram. The principal values are (-1, -R, 0)
+    // and the rows of Wtrue are sigma_1, sigma_3 and sigma_2
+    const normalAt = (sigma: number, tau: number): Vector3 => {
+        const b = (tau * tau + sigma * sigma - sigma) / (R * R - R)
+        const a = sigma - R * b
+        const p = [Math.sqrt(a), Math.sqrt(1 - a - b), Math.sqrt(b)]
+        return [0, 1, 2].map(k => Wtrue[0][k] * p[0] + Wtrue[1][k] * p[1] + Wtrue[2][k] * p[2]) as Vector3
+    }
+
+    // Two planes on the friction line, the others above it
+    const data: StriatedPlaneKin[] = []
+    for (const sigma of [0.3, 0.7]) {
+        const n = normalAt(sigma, cohesion + sigma * Math.tan(frictionAngle))
+        data.push(createPlane(n, shearDirection(S, n), 'Striated Plane Friction1'))
+    }
+    for (let i = 0; data.length < 30; ++i) {
+        const n = sequenceNormal(i)
+        const { sigma, tau } = mohr(n)
+        if (tau > cohesion + sigma * Math.tan(frictionAngle) + 0.01) {
+            data.push(createPlane(n, shearDirection(S, n), 'Striated Plane Friction1'))
+        }
+    }
+
+    // No friction angle is given to the data: the grid overrides it
+    const packed = new PackedDataset(data)
+    const grid = {
+        cohesionMin: 0.2, cohesionMax: 0.4, nbCohesions: 11,
+        frictionAngleMin: 2 * deg, frictionAngleMax: 22 * deg, nbFrictionAngles: 11
+    }
+
+    // With the true stress tensor, the friction line rests on the two planes
+    const exact = new MonteCarloFriction({ nbRandomTrials: 10, Rrot: Wtrue, rotAngleHalfInterval: 0, stressRatio: R, stressRatioHalfInterval: 0, ...grid })
+    const fixed = exact.runPacked(packed, createDefaultSolution())
+    expect(fixed.friction.cohesion).toBeCloseTo(cohesion, 10)
+    expect(fixed.friction.frictionAngle).toBeCloseTo(frictionAngle, 10)
+
+    // Joint inversion around a perturbed tensor (seeded, so that the trials are the same at each run). The small errors
+    // on the stress tensor trade the cohesion against the friction angle along the friction line
+    const Rrot = multiplyTensors({ A: properRotationTensor({ nRot: normalizeVector([0, 1, 1]), angle: 4 * deg }), B: Wtrue })
+    const search = new MonteCarloFriction({ nbRandomTrials: 5000, Rrot, rotAngleHalfInterval: 8 * deg, stressRatio: R, stressRatioHalfInterval: 0.1, seed: 1, ...grid })
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    const W = solution.rotationMatrixW
+    const cosSigma1 = W[0][0] * Wtrue[0][0] + W[0][1] * Wtrue[0][1] + W[0][2] * Wtrue[0][2]
+    expect(Math.acos(Math.min(1, Math.abs(cosSigma1)))).toBeLessThan(3 * deg)
+    expect(Math.abs(solution.stressRatio - R)).toBeLessThan(0.05)
+    expect(Math.abs(solution.friction.cohesion - cohesion)).toBeLessThan(0.02 + 1e-9)
+    expect(Math.abs(solution.friction.frictionAngle - frictionAngle)).toBeLessThan(2 * deg + 1e-9)
+})
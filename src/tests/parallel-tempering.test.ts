@@ -0,0 +1,69 @@
+/**
+ * @jest-environment node
+ */
+import { join } from "path"
+import { PackedDataset } from "../lib/data"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { ParallelTempering, SearchMethodFactory } from "../lib/search"
+import { minRotAngleRotationTensor, multiplyTensors, normalizeVector, properRotationTensor, transposeTensor } from "../lib/types"
+import { SearchWorkerPool } from "../lib/server"
+import { createPlanes } from "./synthetic-data"
+
+test('parallel tempering finds the stress tensor', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 40))
+
+    const search = SearchMethodFactory.create('Parallel Tempering', { nbSteps: 10000, seed: 1 }) as ParallelTempering
+    expect(search).toBeInstanceOf(ParallelTempering)
+    const solution = search.runPacked(packed, createDefaultSolution())
+    expect(solution.misfit).toBeLessThan(0.05)
+    expect(search.nbSwaps).toBeGreaterThan(0)
+
+    // Wrot = Drot Rrot, with Rrot = I
+    for (let i = 0; i < 3; ++i) for (let j = 0; j < 3; ++j) expect(solution.rotationMatrixD[i][j]).toBeCloseTo(solution.rotationMatrixW[i][j], 10)
+})
+
+test('parallel tempering stays around the interactive solution', () => {
+    const Rrot = properRotationTensor({ nRot: normalizeVector([0, 1, 1]), angle: 0.8 })
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: [1, 0, 0], angle: 2.5 }), 0.5, 20))
+
+    const search = new ParallelTempering({ Rrot, rotAngleHalfInterval: 0.3, nbSteps: 2000, nbChains: 4, seed: 1 })
+    const solution = search.runPacked(packed, createDefaultSolution())
+    const angle = minRotAngleRotationTensor(multiplyTensors({ A: solution.rotationMatrixW, B: transposeTensor(Rrot) }))
+    expect(angle).toBeLessThan(0.3 + 1e-9)
+
+    // Without rotation, almost all the proposals are rejected: the run still stops after its budget of steps
+    const fixed = new ParallelTempering({ Rrot, rotAngleHalfInterval: 0, nbSteps: 2000, nbChains: 4 })
+    const fixedSolution = fixed.runPacked(packed, createDefaultSolution())
+    expect(minRotAngleRotationTensor(multiplyTensors({ A: fixedSolution.rotationMatrixW, B: transposeTensor(Rrot) }))).toBeLessThan(1e-6)
+    // Only the misfits of the initial states are evaluated
+    expect(fixed.nbEvaluations).toBe(4)
+    expect(search.nbEvaluations).toBeGreaterThan(4)
+    expect(search.nbEvaluations).toBeLessThanOrEqual(2000)
+
+    expect(() => new ParallelTempering({ nbChains: 0 })).toThrow()
+    expect(() => new ParallelTempering({ cooling: 2 })).toThrow()
+})
+
+test('parallel tempering runs the segments of the chains in workers', async () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const data = createPlanes(Wtrue, 0.3, 40)
+    const params = { nbSteps: 3003, nbChains: 6, swapInterval: 20, cooling: 0.5, seed: 7 }
+    const local = new ParallelTempering(params)
+    const expected = local.runPacked(new PackedDataset(data), createDefaultSolution())
+
+    const pool = new SearchWorkerPool({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    try {
+        const search = new ParallelTempering(params)
+        search.setWorkers(pool)
+        const solution = search.runPacked(new PackedDataset(data, { shared: true }), createDefaultSolution())
+
+        // Same proposals and exchanges as in the calling thread
+        expect(solution.misfit).toBe(expected.misfit)
+        expect(solution.stressRatio).toBe(expected.stressRatio)
+        expect(search.nbSwaps).toBe(local.nbSwaps)
+        expect(search.nbEvaluations).toBe(local.nbEvaluations)
+    } finally {
+        await pool.close()
+    }
+})
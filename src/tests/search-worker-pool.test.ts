@@ -0,0 +1,40 @@
+import { join } from "path"
+import { PackedDataset } from "../lib/data"
+import { SearchWorkerPool } from "../lib/server"
+import { properRotationTensor } from "../lib/types"
+import { createPlanes } from "./synthetic-data"
+
+test('a worker that stops fails the run and is replaced', async () => {
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: [0, 0, 1], angle: 0.5 }), 0.3, 10), { shared: true })
+    const inputs = new Float64Array([1, 2, 3, 4, 5, 6, 7, 8])
+    const outputs = new Float64Array(8)
+
+    const pool = new SearchWorkerPool({ workers: 1, workerScript: join(__dirname, 'workers', 'stopping-worker.js') })
+    try {
+        pool.run(packed, 'Stop', { stop: false }, inputs, 8, outputs)
+        expect(Array.from(outputs)).toEqual([2, 4, 6, 8, 10, 12, 14, 16])
+
+        expect(() => pool.run(packed, 'Stop', { stop: true }, inputs, 8, outputs)).toThrow('stopped during the run')
+        // The worker is replaced once the events of the pool are received
+        expect(() => pool.run(packed, 'Stop', { stop: false }, inputs, 8, outputs)).toThrow('have stopped')
+
+        await new Promise(resolve => setTimeout(resolve, 200))
+        outputs.fill(0)
+        pool.run(packed, 'Stop', { stop: false }, inputs, 8, outputs)
+        expect(Array.from(outputs)).toEqual([2, 4, 6, 8, 10, 12, 14, 16])
+    } finally {
+        await pool.close()
+    }
+})
+
+test('a run waits at most the timeout of the pool for the next input', async () => {
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: [0, 0, 1], angle: 0.5 }), 0.3, 10), { shared: true })
+    const pool = new SearchWorkerPool({ workers: 1, workerScript: join(__dirname, 'workers', 'stopping-worker.js'), timeout: 200 })
+    try {
+        const start = Date.now()
+        expect(() => pool.run(packed, 'Sleep', { time: 3000 }, new Float64Array(1), 1, new Float64Array(1))).toThrow('200 ms')
+        expect(Date.now() - start).toBeLessThan(2000)
+    } finally {
+        await pool.close()
+    }
+})
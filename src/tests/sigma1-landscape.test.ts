@@ -0,0 +1,73 @@
+/**
+ * @jest-environment node
+ */
+import { join } from "path"
+import { Sigma1Landscape } from "../lib/analysis"
+import { PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { Sigma1LandscapePool } from "../lib/server"
+import { normalizeVector, properRotationTensor, Vector3 } from "../lib/types"
+import { createPlane, createPlanes, shearDirection } from "./synthetic-data"
+
+test('landscape minimum recovers the stress tensor of synthetic data', () => {
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(properRotationTensor({ nRot: normalizeVector([1, 2, 3]), angle: 0.9 }), 0.3)
+    const S = engine.S()
+
+    // Striations parallel to the shear stress of the tensor
+    const normals: Vector3[] = [
+        [1, 0.2, 0.5], [0.1, 1, 0.7], [-0.4, 0.3, 1], [0.8, -0.6, 0.2], [0.3, 0.5, -0.9],
+        [-0.7, 0.1, 0.4], [0.2, -0.9, 0.3], [0.6, 0.6, 0.6], [-0.2, 0.8, -0.5], [0.9, 0.1, -0.3]
+    ]
+    const planes = normals.map(v => {
+        const n = normalizeVector(v)
+        return createPlane(n, shearDirection(S, n))
+    })
+
+    const packed = new PackedDataset(planes)
+    const landscape = new Sigma1Landscape(packed, { resolution: 5, refinements: 6 })
+    const raster = landscape.run()
+
+    let best = -1
+    for (let c = 0; c < landscape.nbCells; ++c) {
+        if (!Number.isNaN(raster.misfits[c]) && (best === -1 || raster.misfits[c] < raster.misfits[best])) {
+            best = c
+        }
+    }
+
+    engine.setHypotheticalStress(landscape.rotation(best, raster.rotations[best]), raster.stressRatios[best])
+    expect(raster.misfits[best]).toBeCloseTo(packed.cost(engine), 5)
+    expect(raster.misfits[best]).toBeLessThan(0.05)
+    expect(raster.stressRatios[best]).toBeCloseTo(0.3, 1)
+})
+
+test('landscape cells are split across workers', async () => {
+    const packed = new PackedDataset(createPlanes(properRotationTensor({ nRot: normalizeVector([1, 2, 3]), angle: 0.9 }), 0.3, 50), { shared: true })
+    const expected = new Sigma1Landscape(packed, { resolution: 8 }).run()
+
+    const pool = new Sigma1LandscapePool({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    try {
+        // The second run reuses the landscapes of the workers
+        for (let k = 0; k < 2; ++k) {
+            const raster = await pool.run(packed, { resolution: 8 })
+            expect(raster.size).toBe(expected.size)
+            expect(Array.from(raster.misfits)).toEqual(Array.from(expected.misfits))
+            expect(Array.from(raster.stressRatios)).toEqual(Array.from(expected.stressRatios))
+        }
+        // Not shared
+        await expect(pool.run(new PackedDataset(packed.data))).rejects.toThrow()
+
+        // A worker which exits fails the run, and is replaced
+        const internals = pool as any
+        const failed = pool.run(packed, { resolution: 8 })
+        const [exited] = internals.workers
+        await exited.terminate()
+        await expect(failed).rejects.toThrow('The worker exited with code')
+        expect(internals.workers.length).toBe(2)
+        expect(internals.workers.includes(exited)).toBe(false)
+        const raster = await pool.run(packed, { resolution: 8 })
+        expect(Array.from(raster.misfits)).toEqual(Array.from(expected.misfits))
+    } finally {
+        await pool.close()
+    }
+})
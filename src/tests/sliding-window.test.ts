@@ -0,0 +1,73 @@
+/**
+ * @jest-environment node
+ */
+import { join } from "path"
+import { PackedDataset } from "../lib/data"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { MonteCarlo } from "../lib/search"
+import { SearchWorkerPool } from "../lib/server"
+import { SlidingWindowInversion, windowCenters, WindowTaper } from "../lib/SlidingWindowInversion"
+import { normalizeVector, Point3D, properRotationTensor } from "../lib/types"
+import { createPlanes } from "./synthetic-data"
+
+// Two regions along x, with different stress tensors
+function createMap() {
+    const west = createPlanes(properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 }), 0.3, 60)
+    const east = createPlanes(properRotationTensor({ nRot: [0, 0, 1], angle: 0.4 }), 0.7, 60)
+    const data = [...west, ...east]
+    data.forEach((d, i) => {
+        const p: Point3D = [(i < 60 ? 0 : 100) + (i * 37) % 60, (i * 53) % 60, 0]
+        d.position.splice(0, 3, ...p)
+    })
+    return data
+}
+
+test('sliding windows evaluate the data of the window only', () => {
+    const data = createMap()
+    const params = { nbRandomTrials: 300, seed: 3 }
+    const radius = 40
+    const sliding = new SlidingWindowInversion(data, new MonteCarlo(params), { radius, taper: WindowTaper.GAUSSIAN, seed: false })
+
+    for (const center of [[30, 30, 0], [130, 30, 0], [90, 30, 0]] as Point3D[]) {
+        const window = sliding.runWindow(center)
+
+        // Same search on the data of the window only
+        const ids = sliding.index.queryRadius(center, radius)
+        const weights = ids.map(i => Math.exp(-2 * sliding.index.distance2(i, center) / (radius * radius)))
+        const local = new MonteCarlo(params).runPacked(new PackedDataset(ids.map(i => data[i]), { weights }), createDefaultSolution())
+        expect(window.nbData).toBe(ids.length)
+        expect(window.solution.misfit).toBeCloseTo(local.misfit, 10)
+        expect(window.solution.stressRatio).toBe(local.stressRatio)
+    }
+})
+
+test('sliding windows run by strips in workers', async () => {
+    const data = createMap()
+    const params = { nbRandomTrials: 300, rotAngleHalfInterval: Math.PI / 4, seed: 3 }
+    const centers = windowCenters([0, 0, 0], [160, 60, 0], [5, 2, 1])
+    const windowParams = { radius: 40, minData: 5, stripLength: 4 }
+
+    // The windows of each strip are seeded from one another only
+    const expected = centers.flatMap((_, i) => i % 4 !== 0 ? [] :
+        new SlidingWindowInversion(data, new MonteCarlo(params), windowParams).run(centers.slice(i, i + 4)))
+
+    const pool = new SearchWorkerPool({ workers: 2, workerScript: join(__dirname, 'workers', 'inversion-worker.js') })
+    try {
+        const sliding = new SlidingWindowInversion(data, new MonteCarlo(params), windowParams)
+        sliding.setWorkers(pool, { method: 'Monte Carlo', params })
+        const windows = sliding.run(centers)
+        expect(windows.length).toBe(centers.length)
+        windows.forEach((w, i) => {
+            expect(w.center).toEqual(centers[i])
+            expect(w.nbData).toBe(expected[i].nbData)
+            if (expected[i].solution === undefined) {
+                expect(w.solution).toBeUndefined()
+            } else {
+                expect(w.solution.misfit).toBeCloseTo(expected[i].solution.misfit, 10)
+                expect(w.solution.rotationMatrixW).toEqual(expected[i].solution.rotationMatrixW)
+            }
+        })
+    } finally {
+        await pool.close()
+    }
+})
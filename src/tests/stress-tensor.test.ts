@@ -1,4 +1,4 @@
-import { MohrCoulombCurve } from "../lib";
+import { MasterStress, MohrCoulombCurve, StressTensor } from "../lib";
 
 test('test stress 1 item', () => {
     const mc = new MohrCoulombCurve([-1, 0, -0.5])
@@ -7,3 +7,112 @@ test('test stress 1 item', () => {
     console.log(l)
     // expect(sigma_1.radius).toEqual(1)
 })
+
+test('lazy stress tensor', () => {
+    const st = new StressTensor({ trendS1: 30, plungeS1: 20, trendS3: 120, masterStress: MasterStress.Sigma1, stressRatio: 0.4 })
+
+    const R = st.Rrot
+    for (let i = 0; i < 3; ++i) {
+        for (let j = 0; j < 3; ++j) {
+            const d = R[i][0] * R[j][0] + R[i][1] * R[j][1] + R[i][2] * R[j][2]
+            expect(d).toBeCloseTo(i === j ? 1 : 0)
+        }
+    }
+
+    // The matrices are updated in place after a change
+    const sigma3 = [...R[1]]
+    st.trendS3 = 150
+    expect(st.Rrot).toBe(R)
+    expect(Math.abs(R[1][0] - sigma3[0]) + Math.abs(R[1][1] - sigma3[1])).toBeGreaterThan(0.1)
+})
+
+// Unit vector of an axis in the geographic reference frame (East, North, Up), the plunge being positive downward
+const axis = (trend: number, plunge: number) => {
+    const t = trend * Math.PI / 180, p = plunge * Math.PI / 180
+    return [Math.sin(t) * Math.cos(p), Math.cos(t) * Math.cos(p), -Math.sin(p)]
+}
+
+// Check that ST = RTrot STP Rrot has the principal stresses (1, R, 0) along (sigma_1, sigma_2, sigma_3), i.e. the rows 0, 2 and 1 of Rrot
+const expectPrincipalStresses = (ST: ArrayLike<number>, Rrot: ArrayLike<number>, R: number) => {
+    [[0, 1], [2, R], [1, 0]].forEach(([row, sigma]) => {
+        for (let i = 0; i < 3; ++i) {
+            const v = ST[3 * i] * Rrot[3 * row] + ST[3 * i + 1] * Rrot[3 * row + 1] + ST[3 * i + 2] * Rrot[3 * row + 2]
+            expect(v).toBeCloseTo(sigma * Rrot[3 * row + i], 12)
+        }
+    })
+}
+
+const flat = (m: number[][]) => m.flat()
+
+test('the master axis has its trend and plunge', () => {
+    const st = new StressTensor({ trendS1: 30, plungeS1: 20, trendS3: 120, masterStress: MasterStress.Sigma1, stressRatio: 0.4 })
+
+    // sigma_1 has the trend and plunge of the master axis
+    axis(30, 20).forEach((v, k) => expect(st.Rrot[0][k]).toBeCloseTo(v, 12))
+    // sigma_3 has the trend of the slave axis and is perpendicular to sigma_1
+    const s3 = st.Rrot[1]
+    expect(Math.atan2(s3[0], s3[1]) * 180 / Math.PI).toBeCloseTo(120, 10)
+    axis(120, st.plungeS3).forEach((v, k) => expect(s3[k]).toBeCloseTo(v, 12))
+
+    // Same with sigma_3 as the master axis
+    const st3 = new StressTensor({ trendS1: 200, trendS3: 110, plungeS3: 35, masterStress: MasterStress.Sigma3, stressRatio: 0.7 })
+    axis(110, 35).forEach((v, k) => expect(st3.Rrot[1][k]).toBeCloseTo(v, 12))
+    axis(200, st3.plungeS1).forEach((v, k) => expect(st3.Rrot[0][k]).toBeCloseTo(v, 12))
+})
+
+test('the stress ratio getter returns R', () => {
+    const st = new StressTensor({ trendS1: 30, plungeS1: 20, trendS3: 120, masterStress: MasterStress.Sigma1, stressRatio: 0.4 })
+    expect(st.stressRatio).toBeCloseTo(0.4, 12)
+
+    st.stressRatio = 0.65
+    expect(st.stressRatio).toBeCloseTo(0.65, 12)
+    expect(st.STP[2][2]).toBeCloseTo(0.65, 12)
+})
+
+test('STP is ordered as the axes of Sr', () => {
+    const st = new StressTensor({ trendS1: 30, plungeS1: 20, trendS3: 120, masterStress: MasterStress.Sigma1, stressRatio: 0.4 })
+
+    // The rows of Rrot are (sigma_1, sigma_3, sigma_2), and so is the diagonal of STP
+    expect(st.STP[0][0]).toBeCloseTo(1, 12)
+    expect(st.STP[1][1]).toBeCloseTo(0, 12)
+    expect(st.STP[2][2]).toBeCloseTo(0.4, 12)
+    expectPrincipalStresses(flat(st.ST), flat(st.Rrot), 0.4)
+
+    const st3 = new StressTensor({ trendS1: 200, trendS3: 110, plungeS3: 35, masterStress: MasterStress.Sigma3, stressRatio: 0.7 })
+    expectPrincipalStresses(flat(st3.ST), flat(st3.Rrot), 0.7)
+})
+
+test('packed batch of stress tensors', () => {
+    const params = {
+        trendS1: new Float64Array([0, 30, 60]),
+        plungeS1: new Float64Array([10, 20, 30]),
+        trendS3: new Float64Array([90, 120, 150]),
+        stressRatio: new Float64Array([0.2, 0.5, 0.8]),
+        masterStress: MasterStress.Sigma1
+    }
+    const batch = StressTensor.createBatch(params)
+    expect(batch.count).toBe(3)
+    for (let i = 0; i < 3; ++i) {
+        const st = new StressTensor({
+            trendS1: params.trendS1[i], plungeS1: params.plungeS1[i], trendS3: params.trendS3[i], plungeS3: 0,
+            stressRatio: params.stressRatio[i], masterStress: MasterStress.Sigma1
+        })
+        for (let j = 0; j < 3; ++j) {
+            for (let k = 0; k < 3; ++k) {
+                expect(batch.Rrot[9 * i + 3 * j + k]).toBe(st.Rrot[j][k])
+                expect(batch.ST[9 * i + 3 * j + k]).toBe(st.ST[j][k])
+            }
+        }
+        expect(batch.plunge[i]).toBe(st.plunge)
+
+        // The tensors have the requested axes and principal stresses
+        const Rrot = batch.Rrot.subarray(9 * i, 9 * i + 9)
+        axis(params.trendS1[i], params.plungeS1[i]).forEach((v, k) => expect(Rrot[k]).toBeCloseTo(v, 12))
+        axis(params.trendS3[i], batch.plunge[i]).forEach((v, k) => expect(Rrot[3 + k]).toBeCloseTo(v, 12))
+        expectPrincipalStresses(batch.ST.subarray(9 * i, 9 * i + 9), Rrot, params.stressRatio[i])
+    }
+
+    // The batch is reused
+    expect(StressTensor.createBatch(params, batch)).toBe(batch)
+    expect(() => StressTensor.createBatch({ ...params, trendS3: [0] })).toThrow()
+})
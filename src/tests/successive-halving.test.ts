@@ -0,0 +1,39 @@
+import { MisfitObjectiveType, PackedDataset } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { createDefaultSolution } from "../lib/InverseMethod"
+import { SearchMethodFactory, SuccessiveHalving } from "../lib/search"
+import { normalizeVector, properRotationTensor } from "../lib/types"
+import { createPlanes } from "./synthetic-data"
+
+test('successive halving evaluates the finalists on all the data', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 20000))
+
+    const search = SearchMethodFactory.create('Successive Halving', { nbRandomTrials: 2000, initialSubsetSize: 100, seed: 1 }) as SuccessiveHalving
+    expect(search).toBeInstanceOf(SuccessiveHalving)
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    // The misfit of the solution is exact
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+    expect(solution.misfit).toBeCloseTo(packed.cost(engine), 12)
+
+    // Far fewer datum evaluations than MonteCarlo with the same candidates
+    expect(search.nbDatumEvaluations).toBeLessThan(2001 * 20000 / 10)
+
+    expect(() => new SuccessiveHalving({ reduction: 1 })).toThrow()
+})
+
+test('successive halving keeps the objective and gives the exact misfit in single precision', () => {
+    const Wtrue = properRotationTensor({ nRot: normalizeVector([1, 2, -1]), angle: 1.1 })
+    const objective = { type: MisfitObjectiveType.QUANTILE, quantile: 0.8 }
+    const packed = new PackedDataset(createPlanes(Wtrue, 0.3, 5000), { objective, singlePrecision: true })
+    expect(packed.subset([0, 1, 2]).objective).toEqual(objective)
+
+    const search = new SuccessiveHalving({ nbRandomTrials: 500, initialSubsetSize: 100, seed: 1 })
+    const solution = search.runPacked(packed, createDefaultSolution())
+
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(solution.rotationMatrixW, solution.stressRatio)
+    expect(solution.misfit).toBe(packed.exactCost(engine))
+})
@@ -0,0 +1,26 @@
+import { eigenSymmetricBatch, eigenSymmetricBatchJacobi } from "../lib/geomeca"
+
+test('closed form eigen decomposition matches Jacobi', () => {
+    const tensors = new Float64Array([
+        -1, 0.2, 0.3, -0.4, 0.1, 0,     // generic
+        2, 0, 0, 2, 0, -1,              // degenerate (Jacobi fallback)
+        0.5, 0, 0, -3, 0, 1             // diagonal
+    ])
+    const values = new Float64Array(9), vectors = new Float64Array(27)
+    const valuesRef = new Float64Array(9), vectorsRef = new Float64Array(27)
+    eigenSymmetricBatch(tensors, values, vectors)
+    eigenSymmetricBatchJacobi(tensors, valuesRef, vectorsRef)
+
+    for (let i = 0; i < 9; ++i) {
+        expect(values[i]).toBeCloseTo(valuesRef[i], 10)
+    }
+    // Ordering (sigma_1, sigma_3, sigma_2)
+    expect(values[6]).toBeCloseTo(-3)
+    expect(values[7]).toBeCloseTo(1)
+    expect(values[8]).toBeCloseTo(0.5)
+
+    // Eigen vectors of the generic tensor (up to the sign)
+    for (let i = 0; i < 6; ++i) {
+        expect(Math.abs(vectors[i])).toBeCloseTo(Math.abs(vectorsRef[i]), 8)
+    }
+})
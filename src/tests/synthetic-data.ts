@@ -0,0 +1,58 @@
+import { DataFactory, StriatedPlaneKin } from "../lib/data"
+import { HomogeneousEngine } from "../lib/geomeca"
+import { crossProduct, Matrix3x3, normalizeVector, tensor_x_Vector, Vector3 } from "../lib/types"
+
+/*
+ * Synthetic data shared by the tests
+ */
+
+/**
+ * A striated plane of the given data type (see DataFactory), the perpendicular to the striation being n x s
+ */
+export function createPlane(normal: Vector3, striation: Vector3, type: string = 'Striated Plane'): StriatedPlaneKin {
+    const d = DataFactory.create(type)
+    if (!(d instanceof StriatedPlaneKin)) {
+        throw new Error(`The data type "${type}" is not a striated plane`)
+    }
+    return d.withOrientation(normal, striation, crossProduct({ U: normal, V: striation }))
+}
+
+/**
+ * The i-th unit vector of a deterministic sequence spread over the sphere
+ */
+export function sequenceNormal(i: number): Vector3 {
+    return normalizeVector([Math.sin(1.3 * i + 0.2), Math.cos(2.1 * i), Math.sin(3.7 * i + 1)] as Vector3)
+}
+
+/**
+ * Direction of the shear stress of S on the plane of the given normal
+ */
+export function shearDirection(S: Matrix3x3, normal: Vector3): Vector3 {
+    const t = tensor_x_Vector({ T: S, V: normal })
+    const sn = t[0] * normal[0] + t[1] * normal[1] + t[2] * normal[2]
+    return normalizeVector([t[0] - sn * normal[0], t[1] - sn * normal[1], t[2] - sn * normal[2]] as Vector3)
+}
+
+/**
+ * Striated planes whose striae are parallel to the shear stress of the given stress tensor (the misfit of the tensor is 0)
+ * @param options.type The data type of the planes
+ * @param options.reversed The planes whose striation is reversed (outliers), if any
+ */
+export function createPlanes(
+    Wrot: Matrix3x3, stressRatio: number, n: number,
+    { type = 'Striated Plane', reversed = undefined }: { type?: string, reversed?: (i: number) => boolean } = {}): StriatedPlaneKin[]
+{
+    const engine = new HomogeneousEngine()
+    engine.setHypotheticalStress(Wrot, stressRatio)
+    const S = engine.S()
+    const planes: StriatedPlaneKin[] = []
+    for (let i = 0; i < n; ++i) {
+        const normal = sequenceNormal(i)
+        let striation = shearDirection(S, normal)
+        if (reversed !== undefined && reversed(i)) {
+            striation = [-striation[0], -striation[1], -striation[2]]
+        }
+        planes.push(createPlane(normal, striation, type))
+    }
+    return planes
+}
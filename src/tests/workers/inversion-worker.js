@@ -0,0 +1,16 @@
+// Worker script of the server tests (see runInversionWorker). The workers are not run by jest, so the sources of the
+// library are compiled on the fly when typescript is available (otherwise a TypeScript loader is expected in execArgv)
+try {
+    const ts = require('typescript')
+    const fs = require('fs')
+    require.extensions['.ts'] = (module, filename) => {
+        const { outputText } = ts.transpileModule(fs.readFileSync(filename, 'utf8'), {
+            compilerOptions: { module: ts.ModuleKind.CommonJS, target: ts.ScriptTarget.ES2020, esModuleInterop: true, preserveConstEnums: true },
+            fileName: filename
+        })
+        module._compile(outputText, filename)
+    }
+} catch (e) {
+}
+
+require('../../lib/core.ts').runInversionWorker()
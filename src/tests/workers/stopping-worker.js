@@ -0,0 +1,17 @@
+// Worker script of the tests of the worker failures: the worker of the server tests, with tasks that stop or block it
+require('./inversion-worker.js')
+
+const { SearchTasks } = require('../../lib/search/SearchWorkers.ts')
+
+// Twice the input, or stops the worker
+SearchTasks.bind('Stop', (packed, params, input, output) => {
+    if (params.stop) {
+        process.exit(1)
+    }
+    output[0] = 2 * input[0]
+})
+
+// Blocks the worker for params.time ms
+SearchTasks.bind('Sleep', (packed, params) => {
+    Atomics.wait(new Int32Array(new SharedArrayBuffer(4)), 0, 0, params.time)
+})
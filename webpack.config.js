@@ -4,7 +4,7 @@ const pkg = require('./package.json');
 const ROOT = path.resolve(__dirname, 'src');
 const DESTINATION = path.resolve(__dirname, 'dist');
 
-module.exports = {
+const library = {
     context: ROOT,
     entry: {
         'main': './index.ts'
@@ -40,4 +40,27 @@ module.exports = {
         ],
     },
     devtool: 'source-map'
-};
\ No newline at end of file
+};
+
+// Inversion server for Node.js (see src/server.ts), self-contained so that it can be used to build a startup snapshot
+// Only built by 'yarn build:server' (the build scripts of the library select the library configuration)
+const server = {
+    name: 'server',
+    context: ROOT,
+    target: 'node',
+    entry: {
+        'server': './server.ts'
+    },
+    output: {
+        path: DESTINATION,
+        libraryTarget: 'commonjs2',
+        filename: 'stress-server.js'
+    },
+    resolve: library.resolve,
+    module: library.module,
+    devtool: false
+};
+
+library.name = 'library';
+
+module.exports = [library, server];